@@ -7,6 +7,12 @@
 /* Define if we don't have proper support for the system's crypt().  */
 #undef HAVE_UNSAFE_CRYPT
 
+/* Define if zlib is available for MCCP compression.  */
+#undef HAVE_ZLIB
+
+/* Define if POSIX threads are available for background file writes.  */
+#undef HAVE_PTHREAD
+
 /* Define is the system has struct in_addr.  */
 #undef HAVE_STRUCT_IN_ADDR
 
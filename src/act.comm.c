@@ -431,8 +431,9 @@ ACMD(do_page)
 ACMD(do_gen_comm)
 {
   struct descriptor_data *i;
+  struct broadcast *b;
   char color_on[24];
-  char buf1[MAX_INPUT_LENGTH], buf2[MAX_INPUT_LENGTH], *msg;
+  char buf1[MAX_INPUT_LENGTH], *msg;
   bool emoting = FALSE;
 
   /* Array of flags which must _not_ be set in order for comm to be heard. */
@@ -553,11 +554,14 @@ ACMD(do_gen_comm)
   if (!emoting)
     snprintf(buf1, sizeof(buf1), "$n %ss, '%s'", com_msgs[subcmd][1], argument);
 
-  /* Now send all the strings out. */
+  /* Now send all the strings out, formatted once for each kind of listener. */
+  b = broadcast_act(buf1, ch, 0, 0, TO_LOWPRI);
   for (i = descriptor_list; i; i = i->next) {
     if (STATE(i) != CON_PLAYING || i == ch->desc || !i->character )
       continue;
-    if (!IS_NPC(ch) && (PRF_FLAGGED(i->character, channels[subcmd]) || PLR_FLAGGED(i->character, PLR_WRITING)))
+    if (PLR_FLAGGED(i->character, PLR_WRITING))
+      continue;
+    if (!IS_NPC(ch) && PRF_FLAGGED(i->character, channels[subcmd]))
       continue;
 
     if (ROOM_FLAGGED(IN_ROOM(i->character), ROOM_SOUNDPROOF) && (GET_LEVEL(ch) < LVL_GOD))
@@ -567,10 +571,9 @@ ACMD(do_gen_comm)
          !AWAKE(i->character)))
       continue;
 
-    snprintf(buf2, sizeof(buf2), "%s%s%s", (COLOR_LEV(i->character) >= C_NRM) ? color_on : "", buf1, KNRM);
-    msg = act(buf2, FALSE, ch, 0, i->character, TO_VICT | TO_SLEEP);
-    add_history(i->character, msg, hist_type[subcmd]);
+    broadcast_to(b, i->character, (COLOR_LEV(i->character) >= C_NRM) ? color_on : "", KNRM, hist_type[subcmd]);
   }
+  broadcast_end(b);
 }
 
 ACMD(do_qcomm)
@@ -290,6 +290,7 @@ void perform_immort_vis(struct char_data *ch);
 void snoop_check(struct char_data *ch);
 bool change_player_name(struct char_data *ch, struct char_data *vict, char *new_name);
 bool AddRecentPlayer(char *chname, char *chhost, bool newplr, bool cpyplr);
+void UpdateRecentHost(char *chname, char *oldhost, char *newhost);
 /* Functions with subcommands */
 /* do_date */
 ACMD(do_date);
@@ -28,6 +28,7 @@
 #include "modify.h"
 #include "asciimap.h"
 #include "quest.h"
+#include "keyword.h"
 
 /* prototypes of local functions */
 /* do_diagnose utility functions */
@@ -1493,6 +1494,11 @@ ACMD(do_users)
     }
     if (STATE(d) != CON_PLAYING || (STATE(d) == CON_PLAYING && CAN_SEE(ch, d->character))) {
       send_to_char(ch, "%s", line);
+      if (*ProtocolCompressStats(d))
+        send_to_char(ch, "    MCCP: %s\r\n", ProtocolCompressStats(d));
+      if (d->output.bytes || d->output.dropped)
+        send_to_char(ch, "    Output: %lu bytes queued, %ld lines dropped\r\n",
+          (unsigned long) d->output.bytes, d->output.dropped);
       num_can_see++;
     }
   }
@@ -1561,9 +1567,9 @@ ACMD(do_gen_ps)
 
 static void perform_mortal_where(struct char_data *ch, char *arg)
 {
-  struct char_data *i;
+  struct char_data *i, **found;
   struct descriptor_data *d;
-  int j;
+  int j, k, count;
 
   if (!*arg) {
     j = world[(IN_ROOM(ch))].zone;
@@ -1580,7 +1586,9 @@ static void perform_mortal_where(struct char_data *ch, char *arg)
       send_to_char(ch, "%-20s%s - %s%s\r\n", GET_NAME(i), QNRM, world[IN_ROOM(i)].name, QNRM);
     }
   } else {			/* print only FIRST char, not all. */
-    for (i = character_list; i; i = i->next) {
+    found = keyword_find_chars(arg, &count);
+    for (k = 0; k < count; k++) {
+      i = found[k];
       if (IN_ROOM(i) == NOWHERE || i == ch)
 	continue;
       if (!CAN_SEE(ch, i) || world[IN_ROOM(i)].zone != world[IN_ROOM(ch)].zone)
@@ -1625,10 +1633,10 @@ static void print_object_location(int num, struct obj_data *obj, struct char_dat
 
 static void perform_immort_where(struct char_data *ch, char *arg)
 {
-  struct char_data *i;
-  struct obj_data *k;
+  struct char_data *i, **chars;
+  struct obj_data **objs;
   struct descriptor_data *d;
-  int num = 0, found = 0;
+  int num = 0, found = 0, j, count;
 
   if (!*arg) {
     send_to_char(ch, "Players  Room    Location                       Zone\r\n");
@@ -1649,8 +1657,10 @@ static void perform_immort_where(struct char_data *ch, char *arg)
         }
       }
   } else {
-    for (i = character_list; i; i = i->next)
-      if (CAN_SEE(ch, i) && IN_ROOM(i) != NOWHERE && isname(arg, i->player.name)) {
+    chars = keyword_find_chars(arg, &count);
+    for (j = 0; j < count; j++)
+      if (CAN_SEE(ch, chars[j]) && IN_ROOM(chars[j]) != NOWHERE && isname(arg, chars[j]->player.name)) {
+        i = chars[j];
         found = 1;
         send_to_char(ch, "M%3d. %-25s%s - [%5d] %-25s%s", ++num, GET_NAME(i), QNRM,
                GET_ROOM_VNUM(IN_ROOM(i)), world[IN_ROOM(i)].name, QNRM);
@@ -1662,10 +1672,11 @@ static void perform_immort_where(struct char_data *ch, char *arg)
         }
       send_to_char(ch, "%s\r\n", QNRM);
       }
-    for (num = 0, k = object_list; k; k = k->next)
-      if (CAN_SEE_OBJ(ch, k) && isname(arg, k->name)) {
+    objs = keyword_find_objs(arg, &count);
+    for (num = 0, j = 0; j < count; j++)
+      if (CAN_SEE_OBJ(ch, objs[j]) && isname(arg, objs[j]->name)) {
         found = 1;
-        print_object_location(++num, k, ch, TRUE);
+        print_object_location(++num, objs[j], ch, TRUE);
       }
     if (!found)
       send_to_char(ch, "Couldn't find any such thing.\r\n");
@@ -2269,8 +2280,7 @@ void free_history(struct char_data *ch, int type)
 
   while ((ftmp = tmp)) {
     tmp = tmp->next;
-    if (ftmp->text)
-      free(ftmp->text);
+    release_str(ftmp->text);
     free(ftmp);
   }
   GET_HISTORY(ch, type) = NULL;
@@ -2313,43 +2323,56 @@ ACMD(do_history)
 #define HIST_LENGTH 100
 void add_history(struct char_data *ch, char *str, int type)
 {
-  int i = 0;
-  char time_str[MAX_STRING_LENGTH], buf[MAX_STRING_LENGTH];
-  struct txt_block *tmp;
+  char time_str[MAX_STRING_LENGTH], buf[MAX_STRING_LENGTH], *line;
   time_t ct;
 
   if (IS_NPC(ch))
     return;
 
-  tmp = GET_HISTORY(ch, type);
   ct = time(0);
   strftime(time_str, sizeof(time_str), "%H:%M ", localtime(&ct));
 
   sprintf(buf, "%s%s", time_str, str);
 
+  line = share_str(buf);
+  add_history_line(ch, line, type);
+  release_str(line);
+}
+
+/* Adds a line already stamped with the time, from share_str(), to a history;
+ * a broadcast hands everyone who got the same message the same line. */
+void add_history_line(struct char_data *ch, char *line, int type)
+{
+  int i = 0;
+  struct txt_block *tmp;
+
+  if (IS_NPC(ch))
+    return;
+
+  tmp = GET_HISTORY(ch, type);
+
   if (!tmp) {
     CREATE(GET_HISTORY(ch, type), struct txt_block, 1);
-    GET_HISTORY(ch, type)->text = strdup(buf);
+    GET_HISTORY(ch, type)->text = hold_str(line);
   }
   else {
     while (tmp->next)
       tmp = tmp->next;
     CREATE(tmp->next, struct txt_block, 1);
-    tmp->next->text = strdup(buf);
+    tmp->next->text = hold_str(line);
 
     for (tmp = GET_HISTORY(ch, type); tmp; tmp = tmp->next, i++);
 
     for (; i > HIST_LENGTH && GET_HISTORY(ch, type); i--) {
       tmp = GET_HISTORY(ch, type);
       GET_HISTORY(ch, type) = tmp->next;
-      if (tmp->text)
-        free(tmp->text);
+      release_str(tmp->text);
       free(tmp);
     }
   }
   /* add this history message to ALL */
   if (type != HIST_ALL)
-    add_history(ch, str, HIST_ALL);
+    add_history_line(ch, line, HIST_ALL);
 }
 
 ACMD(do_whois)
@@ -22,6 +22,8 @@
 #include "oasis.h"
 #include "act.h"
 #include "quest.h"
+#include "reactor.h"
+#include "keyword.h"
 
 
 /* local function prototypes */
@@ -806,6 +808,7 @@ void name_from_drinkcon(struct obj_data *obj)
   if (GET_OBJ_RNUM(obj) == NOTHING || obj->name != obj_proto[GET_OBJ_RNUM(obj)].name)
     free(obj->name);
   obj->name = new_name;
+  keyword_update_obj(obj);
 }
 
 void name_to_drinkcon(struct obj_data *obj, int type)
@@ -822,6 +825,7 @@ void name_to_drinkcon(struct obj_data *obj, int type)
     free(obj->name);
 
   obj->name = new_name;
+  keyword_update_obj(obj);
 }
 
 ACMD(do_drink)
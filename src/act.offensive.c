@@ -20,6 +20,7 @@
 #include "act.h"
 #include "fight.h"
 #include "mud_event.h"
+#include "reactor.h"
 
 ACMD(do_assist)
 {
@@ -29,6 +29,7 @@
 #include "shop.h"
 #include "quest.h"
 #include "modify.h"
+#include "reactor.h"
 
 /* Local defined utility functions */
 /* do_group utility functions */
@@ -764,6 +765,7 @@ ACMD(do_gen_tog)
     break;
   case SCMD_NOHASSLE:
     result = PRF_TOG_CHK(ch, PRF_NOHASSLE);
+    update_zone_players(ch);
     break;
   case SCMD_BRIEF:
     result = PRF_TOG_CHK(ch, PRF_BRIEF);
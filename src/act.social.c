@@ -152,11 +152,13 @@ void create_command_list(void)
     }
   }
 	complete_cmd_info[k] = cmd_info[i];
+  build_command_trie();
   log("Command info rebuilt, %d total commands.", k);
 }
 
 void free_command_list(void)
 {
+  free_command_trie();
   free(complete_cmd_info);
   complete_cmd_info = NULL;
 }
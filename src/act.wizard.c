@@ -34,6 +34,11 @@
 #include "quest.h"
 #include "ban.h"
 #include "screen.h"
+#include "reactor.h"
+#include "pool.h"
+#include "savequeue.h"
+#include "resolver.h"
+#include "keyword.h"
 
 /* local utility functions with file scope */
 static int perform_set(struct char_data *ch, struct char_data *vict, int mode, char *val_arg);
@@ -863,6 +868,12 @@ static void do_stat_character(struct char_data *ch, struct char_data *k)
   } else {
     send_to_char(ch, ", Idle Timer (in tics) [%d]\r\n", k->char_specials.timer);
 
+    if (k->desc && *ProtocolCompressStats(k->desc))
+      send_to_char(ch, "MCCP: %s\r\n", ProtocolCompressStats(k->desc));
+    if (k->desc && (k->desc->output.bytes || k->desc->output.dropped))
+      send_to_char(ch, "Output: %lu bytes queued, %ld lines dropped\r\n",
+        (unsigned long) k->desc->output.bytes, k->desc->output.dropped);
+
     sprintbitarray(PLR_FLAGS(k), player_bits, PM_ARRAY_MAX, buf);
     send_to_char(ch, "PLR: %s%s%s\r\n", CCCYN(ch, C_NRM), buf, CCNRM(ch, C_NRM));
 
@@ -965,7 +976,7 @@ static void do_stat_character(struct char_data *ch, struct char_data *k)
   }
   if (!(IS_NPC(k))) {
     /* this is a PC, display their global variables */
-    if (k->script && k->script->global_vars) {
+    if (k->script && k->script->global_vars.head) {
       struct trig_var_data *tv;
       char uname[MAX_INPUT_LENGTH];
 
@@ -973,7 +984,7 @@ static void do_stat_character(struct char_data *ch, struct char_data *k)
 
       /* currently, variable context for players is always 0, so it is not
        * displayed here. in the future, this might change */
-      for (tv = k->script->global_vars; tv; tv = tv->next) {
+      for (tv = k->script->global_vars.head; tv; tv = tv->next) {
         if (*(tv->value) == UID_CHAR) {
           find_uid_name(tv->value, uname, sizeof(uname));
           send_to_char(ch, "    %10s:  [UID]: %s\r\n", tv->name, uname);
@@ -1235,6 +1246,9 @@ ACMD(do_switch)
 
     victim->desc = ch->desc;
     ch->desc = NULL;
+
+    update_zone_players(victim);
+    update_zone_players(ch);
   }
 }
 
@@ -1249,6 +1263,7 @@ static void do_cheat(struct char_data *ch)
   return;
   }
   send_to_char(ch, "Your level has been restored, for now!\r\n");
+  update_zone_players(ch);
   save_char(ch);
 }
 
@@ -1262,6 +1277,7 @@ void return_to_char(struct char_data * ch)
   if (ch->desc->original->desc) {
     ch->desc->original->desc->character = NULL;
     STATE(ch->desc->original->desc) = CON_DISCONNECT;
+    reactor_wake(ch->desc->original->desc);
   }
 
   /* Now our descriptor points to our original body. */
@@ -1270,7 +1286,9 @@ void return_to_char(struct char_data * ch)
 
   /* And our body's pointer to descriptor now points to our descriptor. */
   ch->desc->character->desc = ch->desc;
+  update_zone_players(ch->desc->character);
   ch->desc = NULL;
+  update_zone_players(ch);
 }
 
 ACMD(do_return)
@@ -1455,8 +1473,10 @@ ACMD(do_purge)
 	mudlog(BRF, MAX(LVL_GOD, GET_INVIS_LEV(ch)), TRUE, "(GC) %s has purged %s.", GET_NAME(ch), GET_NAME(vict));
 	if (vict->desc) {
 	  STATE(vict->desc) = CON_CLOSE;
+	  reactor_wake(vict->desc);
 	  vict->desc->character = NULL;
 	  vict->desc = NULL;
+	  update_zone_players(vict);
 	}
       }
       extract_char(vict);
@@ -1566,6 +1586,7 @@ ACMD(do_advance)
   }
 
   gain_exp_regardless(victim, level_exp(GET_CLASS(victim), newlevel) - GET_EXP(victim));
+  update_zone_players(victim);
   save_char(victim);
 }
 
@@ -1693,6 +1714,7 @@ ACMD(do_invis)
 ACMD(do_gecho)
 {
   struct descriptor_data *pt;
+  struct broadcast *b;
 
   skip_spaces(&argument);
   delete_doubledollar(argument);
@@ -1700,9 +1722,11 @@ ACMD(do_gecho)
   if (!*argument)
     send_to_char(ch, "That must be a mistake...\r\n");
   else {
+    b = broadcast_text("%s\r\n", argument);
     for (pt = descriptor_list; pt; pt = pt->next)
-      if (IS_PLAYING(pt) && pt->character && pt->character != ch)
-	send_to_char(pt->character, "%s\r\n", argument);
+      if (IS_PLAYING(pt) && pt->character && pt->character != ch && pt->character->desc)
+	broadcast_to_desc(b, pt->character->desc);
+    broadcast_end(b);
 
     mudlog(CMP, MAX(LVL_BUILDER, GET_INVIS_LEV(ch)), TRUE, "(GC) %s gechoed: %s", GET_NAME(ch), argument);
 
@@ -1757,6 +1781,7 @@ ACMD(do_dc)
       STATE(d) = CON_DISCONNECT;
     else
       STATE(d) = CON_CLOSE;
+    reactor_wake(d);
 
     send_to_char(ch, "Connection #%d closed.\r\n", num_to_dc);
     log("(GC) Connection closed by %s.", GET_NAME(ch));
@@ -1838,97 +1863,94 @@ static const char *last_array[11] = {
   "Playing"
 };
 
-struct last_entry *find_llog_entry(int punique, long idnum) {
-  FILE *fp;
-  struct last_entry mlast;
-  struct last_entry *llast;
-  int size, recs, tmp;
+/* The last log is kept in memory as well as in LAST_FILE, record for record,
+ * oldest first.  A hash of (idnum, punique) finds the entry a login or logout
+ * updates, "last" reads the log in memory, and the file is only ever written,
+ * one record at a time. */
+#define LAST_HASH_SIZE  1024
+#define LAST_HASH(idnum, punique)  (((unsigned long) (idnum) * 31 + (unsigned int) (punique)) % LAST_HASH_SIZE)
 
-  if(!(fp=fopen(LAST_FILE,"r"))) {
-    log("Error opening last_file for reading, will create.");
-    return NULL;
-  }
-  fseek(fp,0L,SEEK_END);
-  size=ftell(fp);
+static struct last_entry *last_log = NULL;
+static int *last_chain = NULL;       /* next older entry in the same bucket, +1 */
+static int last_hash[LAST_HASH_SIZE]; /* newest entry in each bucket, +1 */
+static int num_last = 0, max_last = 0;
 
-  /* recs = number of records in the last file */
-  recs = size/sizeof(struct last_entry);
-  /* we'll search last to first, since it's faster than any thing else we can
-   * do (like searching for the last shutdown/etc..) */
-  for(tmp=recs-1; tmp > 0; tmp--) {
-    fseek(fp,-1*((long)sizeof(struct last_entry)),SEEK_CUR);
-    if (fread(&mlast,sizeof(struct last_entry),1,fp) != 1)
-      return NULL;
-        /*another one to keep that stepback */
-    fseek(fp,-1*((long)sizeof(struct last_entry)),SEEK_CUR);
-
-    if(mlast.idnum == idnum && mlast.punique == punique) {
-      /* then we've found a match */
-      CREATE(llast,struct last_entry,1);
-      memcpy(llast,&mlast,sizeof(struct last_entry));
-      fclose(fp);
-      return llast;
-    }
-    /*not the one we seek. next */
+static void index_llog_entries(void)
+{
+  int i, bucket;
+
+  memset(last_hash, 0, sizeof(last_hash));
+  for (i = 0; i < num_last; i++) {
+    bucket = LAST_HASH(last_log[i].idnum, last_log[i].punique);
+    last_chain[i] = last_hash[bucket];
+    last_hash[bucket] = i + 1;
   }
+}
+
+/* Returns the newest entry for this login, which is the log's own copy; the
+ * caller must not free it. */
+struct last_entry *find_llog_entry(int punique, long idnum) {
+  int i;
+
+  for (i = last_hash[LAST_HASH(idnum, punique)]; i; i = last_chain[i - 1])
+    if (last_log[i - 1].idnum == idnum && last_log[i - 1].punique == punique)
+      return &last_log[i - 1];
+
   /*not found, no problem, quit */
-  fclose(fp);
   return NULL;
 }
 
+/* Writes the log in memory from entry first on out as the new LAST_FILE,
+ * and drops the entries before first.  Records are rewritten in place by
+ * their position, so the log is only trimmed once the new file is synced
+ * and renamed into place; if it can't be written the log is left as it
+ * was, so it still matches the old file. */
+static void write_llog_file(int first)
+{
+  FILE *fp;
+
+  if (!(fp = savequeue_open_now(LAST_FILE)))
+    return;
+  if (num_last > first)
+    fwrite(last_log + first, sizeof(struct last_entry), num_last - first, fp);
+  if (savequeue_close(fp) < 0)
+    return;
+
+  num_last -= first;
+  memmove(last_log, last_log + first, num_last * sizeof(struct last_entry));
+  index_llog_entries();
+}
+
 /* mod_llog_entry assumes that llast is accurate */
 static void mod_llog_entry(struct last_entry *llast,int type) {
   FILE *fp;
-  struct last_entry mlast;
-  int size, recs, tmp;
 
-  if(!(fp=fopen(LAST_FILE,"r+"))) {
-    log("Error opening last_file for reading and writing.");
-    return;
+  /* Lets assume quit is inviolate, mainly because disconnect is called after
+   * each of these */
+  if(llast->close_type != LAST_QUIT &&
+    llast->close_type != LAST_IDLEOUT &&
+    llast->close_type != LAST_REBOOT &&
+    llast->close_type != LAST_SHUTDOWN) {
+    llast->close_type=type;
   }
-  fseek(fp,0L,SEEK_END);
-  size=ftell(fp);
+  llast->close_time=time(0);
 
-  /* recs = number of records in the last file */
-  recs = size/sizeof(struct last_entry);
-
-  /* We'll search last to first, since it's faster than any thing else we can
-   * do (like searching for the last shutdown/etc..) */
-  for(tmp=recs; tmp > 0; tmp--) {
-    fseek(fp,-1*((long)sizeof(struct last_entry)),SEEK_CUR);
-    if(fread(&mlast,sizeof(struct last_entry),1,fp) != 1) {
-      log("mod_llog_entry: read error or unexpected end of file.");
-      return;
-    }
-    /* Another one to keep that stepback. */
-    fseek(fp,-1*((long)sizeof(struct last_entry)),SEEK_CUR);
-
-    if(mlast.idnum == llast->idnum && mlast.punique == llast->punique) {
-      /* Then we've found a match, lets assume quit is inviolate, mainly
-       * because disconnect is called after each of these */
-      if(mlast.close_type != LAST_QUIT &&
-        mlast.close_type != LAST_IDLEOUT &&
-        mlast.close_type != LAST_REBOOT &&
-        mlast.close_type != LAST_SHUTDOWN) {
-        mlast.close_type=type;
-      }
-      mlast.close_time=time(0);
-      /*write it, and we're done!*/
-      fwrite(&mlast,sizeof(struct last_entry),1,fp);
-      fclose(fp);
-      return;
-    }
-    /* Not the one we seek, next. */
+  /* Rewrite just this record. */
+  savequeue_wait(LAST_FILE);
+  if(!(fp=fopen(LAST_FILE,"r+b"))) {
+    log("Error opening last_file for reading and writing.");
+    return;
   }
+  if (fseek(fp, (long) (llast - last_log) * sizeof(struct last_entry), SEEK_SET) ||
+      fwrite(llast, sizeof(struct last_entry), 1, fp) != 1)
+    log("mod_llog_entry: write error in %s.", LAST_FILE);
   fclose(fp);
-
-  /* Not found, no problem, quit. */
-  return;
 }
 
 void add_llog_entry(struct char_data *ch, int type) {
   FILE *fp;
   struct last_entry *llast;
+  int bucket;
 
   /* so if a char enteres a name, but bad password, otherwise loses link before
    * he gets a pref assinged, we won't record it */
@@ -1939,98 +1961,94 @@ void add_llog_entry(struct char_data *ch, int type) {
   /* See if we have a login stored */
   llast = find_llog_entry(GET_PREF(ch), GET_IDNUM(ch));
 
-  /* we didn't - make a new one */
-  if(llast == NULL) {  /* no entry found, add ..error if close! */
-    CREATE(llast,struct last_entry,1);
-    strncpy(llast->username,GET_NAME(ch),15);
-    strncpy(llast->hostname,GET_HOST(ch),127);
-    llast->username[15]='\0';
-    llast->hostname[127]='\0';
-    llast->idnum=GET_IDNUM(ch);
-    llast->punique=GET_PREF(ch);
-    llast->time=time(0);
-    llast->close_time=0;
-    llast->close_type=type;
-
-    if(!(fp=fopen(LAST_FILE,"a"))) {
-      log("error opening last_file for appending");
-      free(llast);
-      return;
-    }
-    fwrite(llast,sizeof(struct last_entry),1,fp);
-    fclose(fp);
-  } else {
-    /* We've found a login - update it */
+  /* We've found a login - update it */
+  if (llast) {
     mod_llog_entry(llast,type);
+    return;
+  }
+
+  /* we didn't - make a new one */
+  savequeue_wait(LAST_FILE);
+  if(!(fp=fopen(LAST_FILE,"ab"))) {
+    log("error opening last_file for appending");
+    return;
   }
-  free(llast);
+
+  if (num_last >= max_last) {
+    max_last = MAX(max_last * 2, MAX_LAST_ENTRIES);
+    RECREATE(last_log, struct last_entry, max_last);
+    RECREATE(last_chain, int, max_last);
+  }
+  llast = &last_log[num_last];
+  memset(llast, 0, sizeof(struct last_entry));
+  strncpy(llast->username,GET_NAME(ch),15);
+  strncpy(llast->hostname,GET_HOST(ch),127);
+  llast->username[15]='\0';
+  llast->hostname[127]='\0';
+  llast->idnum=GET_IDNUM(ch);
+  llast->punique=GET_PREF(ch);
+  llast->time=time(0);
+  llast->close_time=0;
+  llast->close_type=type;
+
+  bucket = LAST_HASH(llast->idnum, llast->punique);
+  last_chain[num_last] = last_hash[bucket];
+  last_hash[bucket] = ++num_last;
+
+  fwrite(llast,sizeof(struct last_entry),1,fp);
+  fclose(fp);
+
+  /* Trim it back to MAX_LAST_ENTRIES now and then, not just at boot. */
+  if (num_last >= 2 * MAX_LAST_ENTRIES)
+    write_llog_file(num_last - MAX_LAST_ENTRIES);
 }
 
+/* Reads the last log into memory at boot, and cuts it down to the newest
+ * MAX_LAST_ENTRIES. */
 void clean_llog_entries(void) {
-  FILE *ofp, *nfp;
-  struct last_entry mlast;
+  FILE *fp;
+  long size;
   int recs;
 
-  if(!(ofp=fopen(LAST_FILE,"r")))
+  if(!(fp=fopen(LAST_FILE,"rb")))
     return; /* no file, no gripe */
 
-  fseek(ofp,0L,SEEK_END);
-  recs=ftell(ofp)/sizeof(struct last_entry);
-  rewind(ofp);
-
-  if (recs < MAX_LAST_ENTRIES) {
-    fclose(ofp);
-    return;
-  }
-
-  if (!(nfp=fopen("etc/nlast", "w"))) {
-    log("Error trying to open new last file.");
-    fclose(ofp);
-    return;
-  }
-
-  /* skip first entries */
-  fseek(ofp,(recs-MAX_LAST_ENTRIES)* (sizeof(struct last_entry)),SEEK_CUR);
-
-  /* copy the rest */
-  while (!feof(ofp)) {
-    if(fread(&mlast,sizeof(struct last_entry),1,ofp) != 1 ) {
-      log("clean_llog_entries: read error or unexpected end of file.");
-      return;
-    }
-    fwrite(&mlast,sizeof(struct last_entry),1,nfp);
-  }
-  fclose(ofp);
-  fclose(nfp);
+  fseek(fp,0L,SEEK_END);
+  size=ftell(fp);
+  recs=size/sizeof(struct last_entry);
+  rewind(fp);
 
-  remove(LAST_FILE);
-  rename("etc/nlast", LAST_FILE);
+  max_last = MAX(recs, MAX_LAST_ENTRIES);
+  RECREATE(last_log, struct last_entry, max_last);
+  RECREATE(last_chain, int, max_last);
+  num_last = fread(last_log, sizeof(struct last_entry), recs, fp);
+  fclose(fp);
+  index_llog_entries();
+
+  if (num_last != recs || size % sizeof(struct last_entry)) {
+    /* Rewrite it whole, so record n of the file is entry n in memory. */
+    log("clean_llog_entries: read error or unexpected end of file.");
+    write_llog_file(0);
+  } else if (num_last >= MAX_LAST_ENTRIES)
+    write_llog_file(num_last - MAX_LAST_ENTRIES);
 }
 
 /* debugging stuff, if you wanna see the whole file */
 static void list_llog_entries(struct char_data *ch)
 {
-  FILE *fp;
-  struct last_entry llast;
+  struct last_entry *llast;
   char timestr[25];
+  int i;
 
-  if(!(fp=fopen(LAST_FILE,"r"))) {
-    log("llist_log_entries: could not open last log file %s.", LAST_FILE);
-    send_to_char(ch, "Error! - no last log");
-  }
   send_to_char(ch, "Last log\r\n");
 
-  while(fread(&llast, sizeof(struct last_entry), 1, fp) == 1) {
-    strftime(timestr, sizeof(timestr), "%a %b %d %Y %H:%M:%S", localtime(&llast.time));
-    send_to_char(ch, "%10s    %d    %s    %s\r\n", llast.username, llast.punique,
-        last_array[llast.close_type], timestr);
+  for (i = 0; i < num_last; i++) {
+    llast = &last_log[i];
+    strftime(timestr, sizeof(timestr), "%a %b %d %Y %H:%M:%S", localtime(&llast->time));
+    send_to_char(ch, "%10s    %d    %s    %s\r\n", llast->username, llast->punique,
+        last_array[llast->close_type], timestr);
       break;
   }
-
-  if(ferror(fp)) {
-    log("llist_log_entries: error reading %s.", LAST_FILE);
-    send_to_char(ch, "Error reading last_log file.");
-  }
 }
 
 static struct char_data *is_in_game(long idnum) {
@@ -2052,8 +2070,7 @@ ACMD(do_last)
   struct char_data *vict = NULL;
   struct char_data *temp;
   int recs, num = 0;
-  FILE *fp;
-  struct last_entry mlast;
+  struct last_entry *mlast;
 
   *name = '\0';
 
@@ -2102,42 +2119,33 @@ ACMD(do_last)
     num=10;
   }
 
-  if(!(fp=fopen(LAST_FILE,"r"))) {
+  if (!num_last) {
     send_to_char(ch, "No entries found.\r\n");
     return;
   }
-  fseek(fp,0L,SEEK_END);
-  recs=ftell(fp)/sizeof(struct last_entry);
 
   send_to_char(ch, "Last log\r\n");
-  while(num > 0 && recs > 0) {
-    fseek(fp,-1* ((long)sizeof(struct last_entry)),SEEK_CUR);
-    if(fread(&mlast,sizeof(struct last_entry),1,fp) != 1) {
-      send_to_char(ch, "Error reading log file.");
-      return;
-    }
-    fseek(fp,-1*((long)sizeof(struct last_entry)),SEEK_CUR);
-    if(!*name ||(*name && !str_cmp(name, mlast.username))) {
-      strftime(timestr, sizeof(timestr), "%a %b %d %Y %H:%M", localtime(&mlast.time));
+  for (recs = num_last - 1; num > 0 && recs >= 0; recs--) {
+    mlast = &last_log[recs];
+    if(!*name ||(*name && !str_cmp(name, mlast->username))) {
+      strftime(timestr, sizeof(timestr), "%a %b %d %Y %H:%M", localtime(&mlast->time));
       send_to_char(ch, "%10.10s %20.20s %20.21s - ",
-        mlast.username, mlast.hostname, timestr);
-      if((temp=is_in_game(mlast.idnum)) && mlast.punique == GET_PREF(temp)) {
+        mlast->username, mlast->hostname, timestr);
+      if((temp=is_in_game(mlast->idnum)) && mlast->punique == GET_PREF(temp)) {
         send_to_char(ch, "Still Playing  ");
       } else {
-        delta = mlast.close_time - mlast.time;
-	strftime(to, sizeof(to), "%H:%M", localtime(&mlast.close_time));
+        delta = mlast->close_time - mlast->time;
+	strftime(to, sizeof(to), "%H:%M", localtime(&mlast->close_time));
 	strftime(deltastr, sizeof(deltastr), "%H:%M", gmtime(&delta));
 
         send_to_char(ch, "%5.5s (%5.5s) %s", to, deltastr,
-          last_array[mlast.close_type]);
+          last_array[mlast->close_type]);
       }
 
       send_to_char(ch, "\r\n");
       num--;
     }
-    recs--;
   }
-  fclose(fp);
 }
 
 ACMD(do_force)
@@ -2520,6 +2528,10 @@ ACMD(do_show)
     { "thaco",      LVL_IMMORT },
     { "exp",        LVL_IMMORT },
     { "colour",     LVL_IMMORT },
+    { "pools",      LVL_GRGOD },
+    { "occupancy",  LVL_GRGOD },			/* 15 */
+    { "saves",      LVL_GRGOD },
+    { "resolver",   LVL_GRGOD },
     { "\n", 0 }
   };
 
@@ -2663,17 +2675,20 @@ ACMD(do_show)
 	"  %5d objects          %5d prototypes\r\n"
 	"  %5d rooms            %5d zones\r\n"
   "  %5d triggers         %5d shops\r\n"
-  "  %5d large bufs       %5d autoquests\r\n"
-	"  %5d buf switches     %5d overflows\r\n"
-	"  %5d lists\r\n",
+  "  %5d output blocks   %5d autoquests\r\n"
+	"  %5d overflows        %5d lists\r\n"
+	"  %5d KB output queued\r\n"
+	"  %5ld lines dropped    %5ld lines coalesced\r\n",
 	i, con,
 	top_of_p_table + 1,
 	j, top_of_mobt + 1,
 	k, top_of_objt + 1,
 	top_of_world + 1, top_of_zone_table + 1,
 	top_of_trigt + 1, top_shop + 1,
-	buf_largecount, total_quests,
-	buf_switches, buf_overflows, global_lists->iSize
+	out_block_count, total_quests,
+	buf_overflows, global_lists->iSize,
+	(int) (out_queue_total / 1024),
+	out_dropped, out_coalesced
 	);
     break;
 
@@ -2805,6 +2820,45 @@ ACMD(do_show)
     page_string(ch->desc, buf, TRUE);
     break;
 
+  /* show memory pool usage */
+  case 14:
+    print_pool_stats(buf, sizeof(buf));
+    page_string(ch->desc, buf, TRUE);
+    break;
+
+  /* check the zone player counters against a full scan */
+  case 15:
+    len = strlcpy(buf, "Zone   Counted  Scanned\r\n-----  -------  -------\r\n", sizeof(buf));
+    for (k = 0, zrn = 0; zrn <= top_of_zone_table; zrn++) {
+      i = zone_table[zrn].num_players;
+      j = count_zone_players(zrn);
+      if (i == 0 && j == 0)
+        continue;
+      nlen = snprintf(buf + len, sizeof(buf) - len, "%5d  %7d  %7d%s\r\n",
+          zone_table[zrn].number, i, j, i != j ? "  MISMATCH" : "");
+      if (i != j)
+        k++;
+      if (len + nlen >= sizeof(buf))
+        break;
+      len += nlen;
+    }
+    if (len < sizeof(buf))
+      snprintf(buf + len, sizeof(buf) - len, "%d zone%s out of step.\r\n", k, k == 1 ? "" : "s");
+    page_string(ch->desc, buf, TRUE);
+    break;
+
+  /* the file writer and autosave */
+  case 16:
+    print_save_stats(buf, sizeof(buf));
+    send_to_char(ch, "%s", buf);
+    break;
+
+  /* host name lookups */
+  case 17:
+    print_resolver_stats(buf, sizeof(buf));
+    send_to_char(ch, "%s", buf);
+    break;
+
   /* show what? */
   default:
     send_to_char(ch, "Sorry, I don't understand that.\r\n");
@@ -3429,6 +3483,8 @@ ACMD(do_set)
 
   /* save the character if a change was made */
   if (retval) {
+    if (!is_file)
+      update_zone_players(vict);
     if (!is_file && !IS_NPC(vict))
       save_char(vict);
     if (is_file) {
@@ -4206,7 +4262,7 @@ ACMD(do_copyover)
 
   /* drop those logging on */
    if (!d->character || d->connected > CON_PLAYING) {
-     write_to_descriptor (d->descriptor, "\n\rSorry, we are rebooting. Come back in a few minutes.\n\r");
+     ProtocolWrite (d, "\n\rSorry, we are rebooting. Come back in a few minutes.\n\r");
      close_socket (d); /* throw'em out */
    } else {
       fprintf (fp, "%d %ld %s %s %s\n", d->descriptor, GET_PREF(och), GET_NAME(och), d->host, CopyoverGet(d));
@@ -4214,13 +4270,16 @@ ACMD(do_copyover)
       GET_LOADROOM(och) = GET_ROOM_VNUM(IN_ROOM(och));
       Crash_rentsave(och,0);
       save_char(och);
-      write_to_descriptor (d->descriptor, buf);
+      ProtocolWrite (d, buf);
     }
   }
 
   fprintf (fp, "-1\n");
   fclose (fp);
 
+  /* The writer thread dies with the exec, and writes with relative paths. */
+  savequeue_flush();
+
   /* exec - descriptors are inherited */
   sprintf (buf, "%d", port);
   sprintf (buf2, "-C%d", mother_desc);
@@ -4673,11 +4732,7 @@ bool change_player_name(struct char_data *ch, struct char_data *vict, char *new_
   }
 
   /* New playername is OK - find the entry in the index */
-  for (i = 0; i <= top_of_p_table; i++)
-    if (player_table[i].id == GET_IDNUM(vict))
-      break;
-
-  if (player_table[i].id != GET_IDNUM(vict))
+  if ((i = get_ptable_by_id(GET_IDNUM(vict))) < 0)
   {
     send_to_char(ch, "Your target was not found in the player index.\r\n");
     log("SYSERR: Player %s, with ID %ld, could not be found in the player index.", GET_NAME(vict), GET_IDNUM(vict));
@@ -4701,9 +4756,11 @@ bool change_player_name(struct char_data *ch, struct char_data *vict, char *new_
   free(player_table[i].name);              // Free the old name in the index
   player_table[i].name = strdup(new_name); // Insert the new name into the index
   for (k=0; (*(player_table[i].name+k) = LOWER(*(player_table[i].name+k))); k++);
+  index_player_name(i);
 
   free(GET_PC_NAME(vict));
   GET_PC_NAME(vict) = strdup(CAP(new_name));    // Change the name in the victims char struct
+  keyword_update_char(vict);
 
   /* Rename the player's pfile */
   sprintf(buf, "mv %s %s", old_pfile, new_pfile);
@@ -4992,6 +5049,19 @@ bool AddRecentPlayer(char *chname, char *chhost, bool newplr, bool cpyplr)
   return TRUE;
 }
 
+/* The resolver found a name for a player already added under their numeric
+ * address; the newest matching entry is theirs. */
+void UpdateRecentHost(char *chname, char *oldhost, char *newhost)
+{
+  struct recent_player *this;
+
+  for (this = recent_list; this; this = this->next)
+    if (!strcmp(this->name, chname) && !strcmp(this->host, oldhost)) {
+      strcpy(this->host, newhost);	/* strcpy: OK (both HOST_LENGTH+1) */
+      break;
+    }
+}
+
 void free_recent_players(void)
 {
   struct recent_player *this;
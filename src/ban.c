@@ -23,12 +23,42 @@ struct ban_list_element *ban_list = NULL;
 int num_invalid = 0;
 
 /* Local (file) scope variables */
-#define MAX_INVALID_NAMES 200
-static char *invalid_list[MAX_INVALID_NAMES];
+static char **invalid_list = NULL;
+static int max_invalid = 0;
+
+/* A set of strings compiled into an Aho-Corasick automaton, so that one
+ * pass over a host name or player name finds every listed string in it,
+ * however long the list.  Matching ignores case, as isbanned() and
+ * valid_name() always have. */
+struct match_node {
+  int child;                  /* First node one letter further on, or 0 */
+  int sibling;                /* Next child of the same parent, or 0 */
+  int fail;                   /* Longest proper suffix that is in the trie */
+  int value;                  /* Highest value of a string ending here */
+  char letter;                /* Lower case */
+};
+
+struct str_matcher {
+  struct match_node *nodes;   /* nodes[0] is the root */
+  int states;
+  int root[256];              /* The root's children, by letter */
+};
+
+/* Numeric bans ("10.1.0.0/16") in a binary trie over the address bits. */
+struct cidr_node {
+  int child[2];               /* Index of the next node, or 0 for none */
+  int type;                   /* BAN_x of a ban ending here, or -1 */
+};
+
+static struct str_matcher site_matcher;
+static struct str_matcher name_matcher;
+static struct cidr_node *cidr_trie = NULL;
+static int cidr_nodes = 0, max_cidr_nodes = 0;
 
 /* local utility functions */
 static void write_ban_list(void);
 static void _write_one_node(FILE *fp, struct ban_list_element *node);
+static void build_ban_matchers(void);
 
 static const char *ban_types[] = {
   "no",
@@ -38,6 +68,193 @@ static const char *ban_types[] = {
   "ERROR"
 };
 
+static void free_matcher(struct str_matcher *m)
+{
+  if (m->nodes)
+    free(m->nodes);
+  memset(m, 0, sizeof(*m));
+}
+
+/* The child of state reached by c, or 0. */
+static int match_step(const struct str_matcher *m, int state, char c)
+{
+  int i;
+
+  if (!state)
+    return (m->root[(unsigned char) c]);
+  for (i = m->nodes[state].child; i; i = m->nodes[i].sibling)
+    if (m->nodes[i].letter == c)
+      return (i);
+  return (0);
+}
+
+/* Compile num strings, each with a value, into m.  Empty strings are left
+ * out; strstr() would have matched them against everything. */
+static void build_matcher(struct str_matcher *m, const char **strs, const int *values, int num)
+{
+  int i, state, next, head = 0, tail = 0, max_states = 1, *queue;
+  const char *p;
+
+  free_matcher(m);
+
+  for (i = 0; i < num; i++)
+    max_states += strlen(strs[i]);
+  CREATE(m->nodes, struct match_node, max_states);
+  m->states = 1;
+
+  /* A trie of the strings. */
+  for (i = 0; i < num; i++) {
+    for (state = 0, p = strs[i]; *p; p++, state = next)
+      if (!(next = match_step(m, state, LOWER(*p)))) {
+        next = m->states++;
+        m->nodes[next].letter = LOWER(*p);
+        m->nodes[next].sibling = m->nodes[state].child;
+        m->nodes[state].child = next;
+        if (!state)
+          m->root[(unsigned char) LOWER(*p)] = next;
+      }
+    if (state)
+      m->nodes[state].value = MAX(m->nodes[state].value, values[i]);
+  }
+
+  /* Breadth first, link each node to its longest proper suffix in the trie
+   * and let it inherit that suffix's value, so a match never has to look
+   * further than the node it is on. */
+  CREATE(queue, int, m->states);
+  for (i = m->nodes[0].child; i; i = m->nodes[i].sibling)
+    queue[tail++] = i;
+  while (head < tail) {
+    state = queue[head++];
+    for (i = m->nodes[state].child; i; i = m->nodes[i].sibling) {
+      for (next = m->nodes[state].fail; next && !match_step(m, next, m->nodes[i].letter); )
+        next = m->nodes[next].fail;
+      m->nodes[i].fail = match_step(m, next, m->nodes[i].letter);
+      m->nodes[i].value = MAX(m->nodes[i].value, m->nodes[m->nodes[i].fail].value);
+      queue[tail++] = i;
+    }
+  }
+  free(queue);
+}
+
+/* The highest value of the strings in m found in text, or 0. */
+static int run_matcher(const struct str_matcher *m, const char *text)
+{
+  int state = 0, next, best = 0;
+  char c;
+
+  if (!m->states)
+    return (0);
+
+  for (; *text; text++) {
+    c = LOWER(*text);
+    while (!(next = match_step(m, state, c)) && state)
+      state = m->nodes[state].fail;
+    state = next;
+    best = MAX(best, m->nodes[state].value);
+  }
+  return (best);
+}
+
+/* Read "a.b.c.d" or "a.b.c.d/bits".  Returns TRUE and the address in host
+ * order if that is all there is to site. */
+static int parse_cidr(const char *site, unsigned long *addr, int *bits)
+{
+  unsigned int a, b, c, d;
+  int n = 0;
+
+  *bits = 32;
+  if (sscanf(site, "%u.%u.%u.%u%n", &a, &b, &c, &d, &n) != 4 || !n)
+    return (FALSE);
+  if (site[n] == '/') {
+    site += n + 1;
+    n = 0;
+    if (sscanf(site, "%d%n", bits, &n) != 1 || !n || *bits < 0 || *bits > 32)
+      return (FALSE);
+  }
+  if (site[n] || a > 255 || b > 255 || c > 255 || d > 255)
+    return (FALSE);
+
+  *addr = ((unsigned long) a << 24) | (b << 16) | (c << 8) | d;
+  return (TRUE);
+}
+
+/* Is this ban matched against the address rather than the host name? */
+static int is_cidr_ban(const char *site, unsigned long *addr, int *bits)
+{
+  return (strchr(site, '/') && parse_cidr(site, addr, bits));
+}
+
+static int new_cidr_node(void)
+{
+  if (cidr_nodes >= max_cidr_nodes) {
+    max_cidr_nodes = MAX(64, max_cidr_nodes * 2);
+    RECREATE(cidr_trie, struct cidr_node, max_cidr_nodes);
+  }
+  cidr_trie[cidr_nodes].child[0] = cidr_trie[cidr_nodes].child[1] = 0;
+  cidr_trie[cidr_nodes].type = -1;
+  return (cidr_nodes++);
+}
+
+static void add_cidr(unsigned long addr, int bits, int type)
+{
+  int node = 0, bit, i;
+
+  for (i = 0; i < bits; i++) {
+    bit = (addr >> (31 - i)) & 1;
+    if (!cidr_trie[node].child[bit]) {
+      int child = new_cidr_node();
+      cidr_trie[node].child[bit] = child;
+    }
+    node = cidr_trie[node].child[bit];
+  }
+  cidr_trie[node].type = MAX(cidr_trie[node].type, type);
+}
+
+/* The highest type of the numeric bans covering addr, or -1. */
+static int run_cidr(unsigned long addr)
+{
+  int node = 0, best = -1, i;
+
+  if (!cidr_nodes)
+    return (-1);
+
+  for (i = 0; ; i++) {
+    best = MAX(best, cidr_trie[node].type);
+    if (i == 32 || !(node = cidr_trie[node].child[(addr >> (31 - i)) & 1]))
+      return (best);
+  }
+}
+
+/* Compile ban_list; call whenever it changes. */
+static void build_ban_matchers(void)
+{
+  struct ban_list_element *node;
+  const char **sites;
+  int *types, num = 0, bits;
+  unsigned long addr;
+
+  for (node = ban_list; node; node = node->next)
+    num++;
+  CREATE(sites, const char *, MAX(num, 1));
+  CREATE(types, int, MAX(num, 1));
+
+  cidr_nodes = 0;
+  new_cidr_node();
+
+  num = 0;
+  for (node = ban_list; node; node = node->next)
+    if (is_cidr_ban(node->site, &addr, &bits))
+      add_cidr(addr, bits, node->type);
+    else {
+      sites[num] = node->site;
+      types[num++] = node->type;
+    }
+  build_matcher(&site_matcher, sites, types, num);
+
+  free(sites);
+  free(types);
+}
+
 void load_banned(void)
 {
   FILE *fl;
@@ -72,24 +289,30 @@ void load_banned(void)
   }
 
   fclose(fl);
+  build_ban_matchers();
 }
 
-int isbanned(char *hostname)
+/* How banned a connection is: the highest BAN_x of the bans naming part
+ * of hostname, or covering addr.  addr may be NULL, or zero if unknown, in
+ * which case a numeric hostname is used.  hostname is lower cased. */
+int isbanned(char *hostname, struct in_addr *addr)
 {
-  int i;
-  struct ban_list_element *banned_node;
+  unsigned long ip;
   char *nextchar;
+  int i, bits;
 
   if (!hostname || !*hostname)
     return (0);
 
-  i = 0;
   for (nextchar = hostname; *nextchar; nextchar++)
     *nextchar = LOWER(*nextchar);
 
-  for (banned_node = ban_list; banned_node; banned_node = banned_node->next)
-    if (strstr(hostname, banned_node->site))	/* if hostname is a substring */
-      i = MAX(i, banned_node->type);
+  i = run_matcher(&site_matcher, hostname);
+
+  if (addr && addr->s_addr)
+    i = MAX(i, run_cidr(ntohl(addr->s_addr)));
+  else if (parse_cidr(hostname, &ip, &bits))
+    i = MAX(i, run_cidr(ip));
 
   return (i);
 }
@@ -121,7 +344,8 @@ ACMD(do_ban)
 {
   char flag[MAX_INPUT_LENGTH], site[MAX_INPUT_LENGTH], *nextchar;
   char timestr[16];
-  int i;
+  int i, bits;
+  unsigned long addr;
   struct ban_list_element *ban_node;
 
   if (!*argument) {
@@ -153,7 +377,7 @@ ACMD(do_ban)
 
   two_arguments(argument, flag, site);
   if (!*site || !*flag) {
-    send_to_char(ch, "Usage: ban {all | select | new} site_name\r\n");
+    send_to_char(ch, "Usage: ban {all | select | new} {site_name | a.b.c.d/bits}\r\n");
     return;
   }
   if (!(!str_cmp(flag, "select") || !str_cmp(flag, "all") || !str_cmp(flag, "new"))) {
@@ -166,6 +390,10 @@ ACMD(do_ban)
       return;
     }
   }
+  if (strchr(site, '/') && !parse_cidr(site, &addr, &bits)) {
+    send_to_char(ch, "A numeric ban looks like 10.1.0.0/16.\r\n");
+    return;
+  }
 
   CREATE(ban_node, struct ban_list_element, 1);
   strncpy(ban_node->site, site, BANNED_SITE_LENGTH);	/* strncpy: OK (b_n->site:BANNED_SITE_LENGTH+1) */
@@ -182,6 +410,7 @@ ACMD(do_ban)
 
   ban_node->next = ban_list;
   ban_list = ban_node;
+  build_ban_matchers();
 
   mudlog(NRM, MAX(LVL_GOD, GET_INVIS_LEV(ch)), TRUE, "%s has banned %s for %s players.",
 	GET_NAME(ch), site, ban_types[ban_node->type]);
@@ -214,6 +443,7 @@ ACMD(do_unban)
     return;
   }
   REMOVE_FROM_LIST(ban_node, ban_list, next);
+  build_ban_matchers();
   send_to_char(ch, "Site unbanned.\r\n");
   mudlog(NRM, MAX(LVL_GOD, GET_INVIS_LEV(ch)), TRUE, "%s removed the %s-player ban on %s.",
 	GET_NAME(ch), ban_types[ban_node->type], ban_node->site);
@@ -229,7 +459,6 @@ int valid_name(char *newname)
 {
   int i, vowels = 0;
   struct descriptor_data *dt;
-  char tempname[MAX_INPUT_LENGTH];
 
   /* Make sure someone isn't trying to create this same name.  We want to do a
    * 'str_cmp' so people can't do 'Bob' and 'BoB'.  The creating login will not
@@ -258,21 +487,8 @@ int valid_name(char *newname)
   if (strchr(newname, ' '))
     return (0);
 
-  /* return valid if list doesn't exist */
-  if (num_invalid < 1)
-    return (1);
-
-  /* change to lowercase */
-  strlcpy(tempname, newname, sizeof(tempname));
-  for (i = 0; tempname[i]; i++)
-    tempname[i] = LOWER(tempname[i]);
-
   /* Does the desired name contain a string in the invalid list? */
-  for (i = 0; i < num_invalid; i++)
-    if (strstr(tempname, invalid_list[i]))
-      return (0);
-
-  return (1);
+  return (!run_matcher(&name_matcher, newname));
 }
 
 void free_invalid_list(void)
@@ -283,12 +499,14 @@ void free_invalid_list(void)
     free(invalid_list[invl]);
 
   num_invalid = 0;
+  free_matcher(&name_matcher);
 }
 
 void read_invalid_list(void)
 {
   FILE *fp;
   char temp[256];
+  int *values, i;
 
   if (!(fp = fopen(XNAME_FILE, "r"))) {
     perror("SYSERR: Unable to open '" XNAME_FILE "' for reading");
@@ -296,13 +514,19 @@ void read_invalid_list(void)
   }
 
   num_invalid = 0;
-  while (get_line(fp, temp) && num_invalid < MAX_INVALID_NAMES)
+  while (get_line(fp, temp)) {
+    if (num_invalid >= max_invalid) {
+      max_invalid = MAX(64, max_invalid * 2);
+      RECREATE(invalid_list, char *, max_invalid);
+    }
     invalid_list[num_invalid++] = strdup(temp);
-
-  if (num_invalid >= MAX_INVALID_NAMES) {
-    log("SYSERR: Too many invalid names; change MAX_INVALID_NAMES in ban.c");
-    exit(1);
   }
 
   fclose(fp);
+
+  CREATE(values, int, MAX(num_invalid, 1));
+  for (i = 0; i < num_invalid; i++)
+    values[i] = 1;
+  build_matcher(&name_matcher, (const char **) invalid_list, values, num_invalid);
+  free(values);
 }
@@ -36,7 +36,7 @@ struct ban_list_element {
 /* Global functions */
 /* Utility Functions */
 void load_banned(void);
-int isbanned(char *hostname);
+int isbanned(char *hostname, struct in_addr *addr);
 int valid_name(char *newname);
 void read_invalid_list(void);
 void free_invalid_list(void);
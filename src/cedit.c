@@ -17,6 +17,7 @@
 #include "oasis.h"
 #include "improved-edit.h"
 #include "modify.h"
+#include "graph.h"
 
 /* local scope functions, not used externally */
 static void cedit_disp_menu(struct descriptor_data *d);
@@ -94,6 +95,8 @@ static void cedit_setup(struct descriptor_data *d)
   OLC_CONFIG(d)->play.dts_are_dumps       = CONFIG_DTS_ARE_DUMPS;
   OLC_CONFIG(d)->play.load_into_inventory = CONFIG_LOAD_INVENTORY;
   OLC_CONFIG(d)->play.track_through_doors = CONFIG_TRACK_T_DOORS;
+  OLC_CONFIG(d)->play.track_path_cache    = CONFIG_TRACK_CACHE;
+  OLC_CONFIG(d)->play.track_search_mode   = CONFIG_TRACK_SEARCH;
   OLC_CONFIG(d)->play.no_mort_to_immort   = CONFIG_NO_MORT_TO_IMMORT;
   OLC_CONFIG(d)->play.disp_closed_doors   = CONFIG_DISP_CLOSED_DOORS;
   OLC_CONFIG(d)->play.diagonal_dirs       = CONFIG_DIAGONAL_DIRS;
@@ -110,6 +113,7 @@ static void cedit_setup(struct descriptor_data *d)
   OLC_CONFIG(d)->csd.autosave_time        = CONFIG_AUTOSAVE_TIME;
   OLC_CONFIG(d)->csd.crash_file_timeout   = CONFIG_CRASH_TIMEOUT;
   OLC_CONFIG(d)->csd.rent_file_timeout    = CONFIG_RENT_TIMEOUT;
+  OLC_CONFIG(d)->csd.binary_pfiles        = CONFIG_BINARY_PFILES;
 
   /* Room Numbers */
   OLC_CONFIG(d)->room_nums.mortal_start_room = CONFIG_MORTAL_START;
@@ -198,6 +202,8 @@ static void cedit_save_internally(struct descriptor_data *d)
   CONFIG_DTS_ARE_DUMPS       = OLC_CONFIG(d)->play.dts_are_dumps;
   CONFIG_LOAD_INVENTORY      = OLC_CONFIG(d)->play.load_into_inventory;
   CONFIG_TRACK_T_DOORS       = OLC_CONFIG(d)->play.track_through_doors;
+  CONFIG_TRACK_CACHE         = OLC_CONFIG(d)->play.track_path_cache;
+  CONFIG_TRACK_SEARCH        = OLC_CONFIG(d)->play.track_search_mode;
   CONFIG_NO_MORT_TO_IMMORT   = OLC_CONFIG(d)->play.no_mort_to_immort;
   CONFIG_DISP_CLOSED_DOORS   = OLC_CONFIG(d)->play.disp_closed_doors;
   CONFIG_DIAGONAL_DIRS       = OLC_CONFIG(d)->play.diagonal_dirs;
@@ -214,6 +220,7 @@ static void cedit_save_internally(struct descriptor_data *d)
   CONFIG_AUTOSAVE_TIME        = OLC_CONFIG(d)->csd.autosave_time;
   CONFIG_CRASH_TIMEOUT   = OLC_CONFIG(d)->csd.crash_file_timeout;
   CONFIG_RENT_TIMEOUT    = OLC_CONFIG(d)->csd.rent_file_timeout;
+  CONFIG_BINARY_PFILES   = OLC_CONFIG(d)->csd.binary_pfiles;
 
   /* Room Numbers */
   CONFIG_MORTAL_START = OLC_CONFIG(d)->room_nums.mortal_start_room;
@@ -368,6 +375,10 @@ int save_config( IDXTYPE nowhere )
               "load_into_inventory = %d\n\n", CONFIG_LOAD_INVENTORY);
   fprintf(fl, "* Should PC's be able to track through hidden or closed doors?\n"
               "track_through_doors = %d\n\n", CONFIG_TRACK_T_DOORS);
+  fprintf(fl, "* Should tracking remember the paths it finds?\n"
+              "track_path_cache = %d\n\n", CONFIG_TRACK_CACHE);
+  fprintf(fl, "* How should tracking search for a path? 0=breadth-first, 1=bidirectional\n"
+              "track_search_mode = %d\n\n", CONFIG_TRACK_SEARCH);
   fprintf(fl, "* Should players who reach enough exp be prevented from automatically levelling to immortal?\n"
               "no_mort_to_immort = %d\n\n", CONFIG_NO_MORT_TO_IMMORT);
   fprintf(fl, "* Should closed doors be shown on autoexit / exit?\n"
@@ -430,6 +441,9 @@ int save_config( IDXTYPE nowhere )
   fprintf(fl, "* Lifetime of normal rent files in days.\n"
               "rent_file_timeout = %d\n\n", CONFIG_RENT_TIMEOUT);
 
+  fprintf(fl, "* Should player files be saved in the binary format instead of ASCII?\n"
+              "binary_pfiles = %d\n\n", CONFIG_BINARY_PFILES);
+
    /* ROOM NUMBERS */
   fprintf(fl, "\n\n\n* [ Room Numbers ]\n");
 
@@ -634,6 +648,8 @@ static void cedit_disp_game_play_options(struct descriptor_data *d)
         "%sP%s) Display Closed Doors        : %s%s\r\n"
         "%sR%s) Diagonal Directions         : %s%s\r\n"
         "%sS%s) Prevent Mortal Level To Immortal : %s%s\r\n"
+        "%sT%s) Cache Tracking Paths        : %s%s\r\n"
+        "%sU%s) Tracking Search Mode        : %s%s\r\n"
 	"%s1%s) OK Message Text         : %s%s"
 	"%s2%s) HUH Message Text        : %s%s"
         "%s3%s) NOPERSON Message Text   : %s%s"
@@ -663,6 +679,8 @@ static void cedit_disp_game_play_options(struct descriptor_data *d)
         grn, nrm, cyn, CHECK_VAR(OLC_CONFIG(d)->play.disp_closed_doors),
         grn, nrm, cyn, CHECK_VAR(OLC_CONFIG(d)->play.diagonal_dirs),
         grn, nrm, cyn, CHECK_VAR(OLC_CONFIG(d)->play.no_mort_to_immort),
+        grn, nrm, cyn, CHECK_VAR(OLC_CONFIG(d)->play.track_path_cache),
+        grn, nrm, cyn, OLC_CONFIG(d)->play.track_search_mode == TRACK_SEARCH_BIDIR ? "Bidirectional" : "Breadth-first",
 
         grn, nrm, cyn, OLC_CONFIG(d)->play.OK,
         grn, nrm, cyn, OLC_CONFIG(d)->play.HUH,
@@ -692,6 +710,7 @@ static void cedit_disp_crash_save_options(struct descriptor_data *d)
   	"%sE%s) Auto Save Time     : %s%d minute(s)\r\n"
   	"%sF%s) Crash File Timeout : %s%d day(s)\r\n"
   	"%sG%s) Rent File Timeout  : %s%d day(s)\r\n"
+  	"%sH%s) Binary Player Files: %s%s\r\n"
   	"%sQ%s) Exit To The Main Menu\r\n"
   	"Enter your choice : ",
   	grn, nrm, cyn, CHECK_VAR(OLC_CONFIG(d)->csd.free_rent),
@@ -701,6 +720,7 @@ static void cedit_disp_crash_save_options(struct descriptor_data *d)
   	grn, nrm, cyn, OLC_CONFIG(d)->csd.autosave_time,
   	grn, nrm, cyn, OLC_CONFIG(d)->csd.crash_file_timeout,
   	grn, nrm, cyn, OLC_CONFIG(d)->csd.rent_file_timeout,
+  	grn, nrm, cyn, CHECK_VAR(OLC_CONFIG(d)->csd.binary_pfiles),
   	grn, nrm
   	);
 
@@ -981,6 +1001,19 @@ void cedit_parse(struct descriptor_data *d, char *arg)
 		  TOGGLE_VAR(OLC_CONFIG(d)->play.no_mort_to_immort);
           break;
 
+        case 't':
+        case 'T':
+          TOGGLE_VAR(OLC_CONFIG(d)->play.track_path_cache);
+          break;
+
+        case 'u':
+        case 'U':
+          write_to_output(d, "1) Breadth-first search\r\n");
+          write_to_output(d, "2) Bidirectional search, checked against the zone graph\r\n");
+          write_to_output(d, "Enter choice: ");
+          OLC_MODE(d) = CEDIT_TRACK_SEARCH_MODE;
+          return;
+
         case '1':
           write_to_output(d, "Enter the OK message : ");
           OLC_MODE(d) = CEDIT_OK;
@@ -1077,6 +1110,11 @@ void cedit_parse(struct descriptor_data *d, char *arg)
           OLC_MODE(d) = CEDIT_RENT_FILE_TIMEOUT;
           return;
 
+        case 'h':
+        case 'H':
+          TOGGLE_VAR(OLC_CONFIG(d)->csd.binary_pfiles);
+          break;
+
         case 'q':
         case 'Q':
           cedit_disp_menu(d);
@@ -1686,6 +1724,18 @@ void cedit_parse(struct descriptor_data *d, char *arg)
       }
       break;
 
+    case CEDIT_TRACK_SEARCH_MODE:
+      if (!*arg) {
+        write_to_output(d,
+          "That is an invalid choice!\r\n"
+          "Select 1 or 2 (0 to cancel) :");
+      } else {
+        if ((atoi(arg) >= 1) && (atoi(arg) <= NUM_TRACK_SEARCH))
+          OLC_CONFIG(d)->play.track_search_mode = (atoi(arg) - 1);
+        cedit_disp_game_play_options(d);
+      }
+      break;
+
     case CEDIT_MAP_SIZE:
       if (!*arg) {
    /* User just pressed return - restore to default */
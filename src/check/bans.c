@@ -0,0 +1,283 @@
+/**
+* @file bans.c
+* Check and time the compiled site ban and invalid name lists (ban.c).
+*
+* Part of the core altMUD source code distribution, which is a derivative
+* of, and continuation of, CircleMUD.
+*
+* All rights reserved.  See license for complete information.
+*
+* A ban file of name bans and numeric (address/prefix) bans and an xnames
+* list are written into the scratch lib and loaded.  Connections from made
+* up hosts and addresses, some of them banned, and made up player names,
+* some of them containing an invalid name, are then put to isbanned() and
+* valid_name() and compared with a brute-force scan of the same lists.  The
+* ban file is then cut in half and reloaded, and the hosts checked again.
+* Then all 100000 connection attempts (or as many as the argument says) are
+* replayed through both lists and timed; the first 20000 of them are the
+* ones compared, as the brute force takes a good while.
+*/
+
+#include "conf.h"
+#include "sysdep.h"
+#include "structs.h"
+#include "utils.h"
+#include "comm.h"
+#include "db.h"
+#include "ban.h"
+#include "check.h"
+
+#define NAME_BANS   5000  /**< Name bans in the ban file. */
+#define CIDR_BANS   1000  /**< Numeric bans in the ban file. */
+#define XNAMES      2000  /**< Entries in the xnames list. */
+#define COMPARED   20000  /**< Connections compared with the brute force. */
+
+static const char *ban_type_names[] = { "no", "new", "select", "all" };
+
+/** The bans as written, for the brute-force reference. */
+static char sites[NAME_BANS][BANNED_SITE_LENGTH + 1];
+static int site_types[NAME_BANS];
+static unsigned long cidr_nets[CIDR_BANS], cidr_masks[CIDR_BANS];
+static int cidr_bits[CIDR_BANS], cidr_types[CIDR_BANS];
+static char xnames[XNAMES][20];
+
+/** The connections put to the lists. */
+static char **hosts, **names;
+static struct in_addr *addrs;
+
+static volatile long sink;  /**< Keeps timed lookups from being optimized out. */
+
+static void lower_copy(char *to, const char *from, size_t len)
+{
+  size_t i;
+
+  for (i = 0; i < len - 1 && from[i]; i++)
+    to[i] = LOWER(from[i]);
+  to[i] = '\0';
+}
+
+/** A random lower case string of n letters. */
+static void random_word(char *buf, int n)
+{
+  int i;
+
+  for (i = 0; i < n; i++)
+    buf[i] = 'a' + rand_number(0, 25);
+  buf[n] = '\0';
+}
+
+/** Write the first num_sites name bans and num_cidrs numeric bans.  Some
+ * name bans are written in mixed case, which must not matter. */
+static void write_bans(int num_sites, int num_cidrs)
+{
+  struct in_addr a;
+  FILE *fl;
+  int i;
+
+  if (!(fl = fopen(BAN_FILE, "w"))) {
+    perror("check: " BAN_FILE);
+    exit(1);
+  }
+  for (i = 0; i < num_sites; i++) {
+    char site[BANNED_SITE_LENGTH + 1];
+
+    strcpy(site, sites[i]);
+    if (i % 3 == 0)
+      *site = UPPER(*site);
+    fprintf(fl, "%s %s %d Checker\n", ban_type_names[site_types[i]], site, 1600000000 + i);
+  }
+  for (i = 0; i < num_cidrs; i++) {
+    a.s_addr = htonl(cidr_nets[i]);
+    fprintf(fl, "%s %s/%d %d Checker\n", ban_type_names[cidr_types[i]], inet_ntoa(a), cidr_bits[i], 1600000000 + i);
+  }
+  fclose(fl);
+}
+
+static void write_xnames(void)
+{
+  FILE *fl;
+  int i;
+
+  if (!(fl = fopen(XNAME_FILE, "w"))) {
+    perror("check: " XNAME_FILE);
+    exit(1);
+  }
+  for (i = 0; i < XNAMES; i++)
+    fprintf(fl, "%s\n", xnames[i]);
+  fclose(fl);
+}
+
+/** What isbanned() gave before the lists were compiled, plus numeric bans:
+ * the highest type of any name ban in the host, and of any numeric ban
+ * covering the address (or the host, if it is an address and addr is 0). */
+static int ref_isbanned(const char *host, struct in_addr addr, int num_sites, int num_cidrs)
+{
+  char lower[MAX_INPUT_LENGTH], site[BANNED_SITE_LENGTH + 1];
+  unsigned long ip = ntohl(addr.s_addr);
+  unsigned int a, b, c, d;
+  int i, type = BAN_NOT;
+
+  lower_copy(lower, host, sizeof(lower));
+  for (i = 0; i < num_sites; i++) {
+    lower_copy(site, sites[i], sizeof(site));
+    if (strstr(lower, site))
+      type = MAX(type, site_types[i]);
+  }
+  if (!ip && sscanf(host, "%u.%u.%u.%u", &a, &b, &c, &d) == 4)
+    ip = (unsigned long) a << 24 | b << 16 | c << 8 | d;
+  if (ip)
+    for (i = 0; i < num_cidrs; i++)
+      if ((ip & cidr_masks[i]) == cidr_nets[i])
+        type = MAX(type, cidr_types[i]);
+  return (type);
+}
+
+/** What valid_name() gave before the list was compiled. */
+static int ref_valid_name(const char *name)
+{
+  char lower[MAX_INPUT_LENGTH];
+  int i;
+
+  if (!strpbrk(name, "aeiouyAEIOUY") || strchr(name, ' '))
+    return (0);
+  lower_copy(lower, name, sizeof(lower));
+  for (i = 0; i < XNAMES; i++)
+    if (strstr(lower, xnames[i]))
+      return (0);
+  return (1);
+}
+
+/** Make up the bans, and n connections: one host in ten contains a banned
+ * site, half are addresses, and two in five of those are inside a numeric
+ * ban. */
+static void make_connections(int n)
+{
+  char buf[MAX_INPUT_LENGTH], word[16];
+  unsigned long ip = 0;
+  struct in_addr a;
+  int i, j;
+
+  for (i = 0; i < NAME_BANS; i++) {
+    random_word(word, rand_number(4, 8));
+    snprintf(sites[i], sizeof(sites[i]), "%s%d.%s", word, i, i % 2 ? "net" : "com");
+    site_types[i] = rand_number(BAN_NEW, BAN_ALL);
+  }
+  for (i = 0; i < CIDR_BANS; i++) {
+    cidr_bits[i] = rand_number(8, 32);
+    cidr_masks[i] = (0xFFFFFFFFUL << (32 - cidr_bits[i])) & 0xFFFFFFFFUL;
+    cidr_nets[i] = ((unsigned long) rand_number(1, 223) << 24 | (circle_random() & 0xFFFFFF)) & cidr_masks[i];
+    cidr_types[i] = rand_number(BAN_NEW, BAN_ALL);
+  }
+  for (i = 0; i < XNAMES; i++)
+    random_word(xnames[i], rand_number(3, 5));
+
+  CREATE(hosts, char *, n);
+  CREATE(names, char *, n);
+  CREATE(addrs, struct in_addr, n);
+  for (i = 0; i < n; i++) {
+    if (i % 10 == 0)
+      snprintf(buf, sizeof(buf), "Dial%d.%s", rand_number(0, 99), sites[rand_number(0, NAME_BANS - 1)]);
+    else if (i % 2 == 0)
+      snprintf(buf, sizeof(buf), "host%ld.Some-ISP%d.example.com", circle_random() % 100000, rand_number(0, 49));
+    else {
+      if (i % 10 < 5) {
+        j = rand_number(0, CIDR_BANS - 1);
+        ip = cidr_nets[j] | (circle_random() & ~cidr_masks[j] & 0xFFFFFFFFUL);
+      } else
+        ip = (unsigned long) rand_number(1, 223) << 24 | (circle_random() & 0xFFFFFF);
+      a.s_addr = htonl(ip);
+      snprintf(buf, sizeof(buf), "%s", inet_ntoa(a));
+    }
+    hosts[i] = strdup(buf);
+
+    /* Half the numeric hosts go without an address, as they would have
+     * before copyover_recover() looked it up; the others resolved. */
+    if (i % 2 && i % 4 == 1)
+      addrs[i].s_addr = 0;
+    else if (i % 2)
+      addrs[i].s_addr = htonl(ip);
+    else
+      addrs[i].s_addr = htonl(0x0A000000UL | (circle_random() & 0xFFFFFF));
+
+    random_word(buf, rand_number(4, 10));
+    *buf = UPPER(*buf);
+    names[i] = strdup(buf);
+  }
+}
+
+static void check_hosts(const char *when, int n, int num_sites, int num_cidrs)
+{
+  char host[MAX_INPUT_LENGTH];
+  int i, got, want, banned = 0;
+
+  for (i = 0; i < n; i++) {
+    strcpy(host, hosts[i]);
+    got = isbanned(host, &addrs[i]);
+    want = ref_isbanned(hosts[i], addrs[i], num_sites, num_cidrs);
+    if (got != want)
+      CHECK_FAIL("%s: isbanned(%s) is %d, brute force says %d", when, hosts[i], got, want);
+    if (got)
+      banned++;
+  }
+  printf("  %s: %d of %d hosts banned, as brute force says\n", when, banned, n);
+}
+
+int main(int argc, char **argv)
+{
+  char host[MAX_INPUT_LENGTH];
+  int n, compared, i, invalid = 0;
+  double t;
+
+  n = check_start(argc, argv, 100000);
+  compared = MIN(n, COMPARED);
+  circle_srandom(22);
+  check_config();
+  make_connections(n);
+  write_bans(NAME_BANS, CIDR_BANS);
+  write_xnames();
+
+  t = check_now();
+  load_banned();
+  read_invalid_list();
+  printf("%d name bans, %d numeric bans and %d xnames compiled in %.1f ms\n",
+    NAME_BANS, CIDR_BANS, XNAMES, (check_now() - t) * 1e3);
+
+  check_hosts("after loading", compared, NAME_BANS, CIDR_BANS);
+  for (i = 0; i < compared; i++) {
+    if (valid_name(names[i]) != ref_valid_name(names[i]))
+      CHECK_FAIL("valid_name(%s) is %d, brute force says %d", names[i], valid_name(names[i]), ref_valid_name(names[i]));
+    if (!valid_name(names[i]))
+      invalid++;
+  }
+  printf("  %d of %d names invalid, as brute force says\n", invalid, compared);
+
+  write_bans(NAME_BANS / 2, CIDR_BANS / 2);
+  load_banned();
+  check_hosts("after reloading half", compared, NAME_BANS / 2, CIDR_BANS / 2);
+  write_bans(NAME_BANS, CIDR_BANS);
+  load_banned();
+
+  /* Timing: every connection through the compiled lists, and a sample
+   * through the scans they replaced. */
+  t = check_now();
+  for (i = 0; i < compared / 10; i++)
+    sink += ref_isbanned(hosts[i], addrs[i], NAME_BANS, CIDR_BANS);
+  printf("  isbanned(), brute force:   %8.3f us\n", (check_now() - t) * 1e6 / (compared / 10));
+  t = check_now();
+  for (i = 0; i < n; i++) {
+    strcpy(host, hosts[i]);
+    sink += isbanned(host, &addrs[i]);
+  }
+  t = check_now() - t;
+  printf("  isbanned(), compiled:      %8.3f us, %d connections in %.1f ms\n", t * 1e6 / n, n, t * 1e3);
+  t = check_now();
+  for (i = 0; i < compared / 10; i++)
+    sink += ref_valid_name(names[i]);
+  printf("  valid_name(), brute force: %8.3f us\n", (check_now() - t) * 1e6 / (compared / 10));
+  t = check_now();
+  for (i = 0; i < n; i++)
+    sink += valid_name(names[i]);
+  printf("  valid_name(), compiled:    %8.3f us\n", (check_now() - t) * 1e6 / n);
+
+  return (check_end());
+}
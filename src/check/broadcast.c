@@ -0,0 +1,397 @@
+/**
+* @file broadcast.c
+* Check and time the broadcasts of the channels, gemotes and send_to_all()
+* and the like (comm.c's broadcast_act(), broadcast_to() and friends).
+*
+* Part of the core altMUD source code distribution, which is a derivative
+* of, and continuation of, CircleMUD.
+*
+* All rights reserved.  See license for complete information.
+*
+* Players with a spread of colour levels, client protocols, levels, ways of
+* seeing and channel settings, some asleep and some writing in an editor,
+* are put in two rooms of different zones.  Gossip, auction and shout from a
+* player and from a mobile, gemotes naming a victim and an object, and the
+* text broadcasts are each sent once the way the game sends them now and
+* once the way it did before broadcasts, with act() or write_to_output() for
+* every listener.  Each player's queued output and history must come out
+* the same both ways.  Then both ways are timed.
+*/
+
+#include "conf.h"
+#include "sysdep.h"
+#include "structs.h"
+#include "utils.h"
+#include "comm.h"
+#include "db.h"
+#include "handler.h"
+#include "interpreter.h"
+#include "protocol.h"
+#include "screen.h"
+#include "act.h"
+#include "check.h"
+
+int check_process_output(struct descriptor_data *t);
+
+/** One way of sending a message: one of each pair of functions below. */
+typedef void (*send_fn)(void);
+
+static struct char_data *speaker;  /**< An invisible player, with no link. */
+static struct char_data *mob;      /**< A mobile, for channels from scripts. */
+static struct char_data *victim;   /**< The player gemotes are done to. */
+static struct obj_data *thing;     /**< The object gemotes show off. */
+static room_rnum room_a, room_b;   /**< Where everyone is, in two zones. */
+
+/** What each descriptor got, the first way and the second. */
+static char **got[2];
+
+/** Make a playing character with a descriptor that writes to /dev/null, so
+ * that its output can be read from the queue and then flushed as
+ * game_loop() would. */
+static struct char_data *make_player(int n, room_rnum room)
+{
+  struct descriptor_data *d;
+  struct char_data *ch;
+  char name[32];
+
+  CREATE(ch, struct char_data, 1);
+  clear_char(ch);
+  CREATE(ch->player_specials, struct player_special_data, 1);
+  snprintf(name, sizeof(name), "Player%d", n);
+  ch->player.name = strdup(name);
+  GET_IDNUM(ch) = n + 1;
+  GET_POS(ch) = POS_STANDING;
+  GET_LEVEL(ch) = 10 + 3 * (n % 3);
+  char_to_room(ch, room);
+
+  CREATE(d, struct descriptor_data, 1);
+  if ((d->descriptor = open("/dev/null", O_WRONLY)) < 0) {
+    perror("check: /dev/null");
+    exit(1);
+  }
+  d->reactor_slot = -1;
+  d->connected = CON_PLAYING;
+  d->pProtocol = ProtocolCreate();
+  d->character = ch;
+  ch->desc = d;
+  d->next = descriptor_list;
+  descriptor_list = d;
+
+  /* A spread of clients and settings. */
+  if (n % 2)
+    SET_BIT_AR(PRF_FLAGS(ch), PRF_COLOR_1);
+  if (n % 4 >= 2)
+    SET_BIT_AR(PRF_FLAGS(ch), PRF_COLOR_2);
+  d->pProtocol->pVariables[eMSDP_ANSI_COLORS]->ValueInt = (n % 3 != 0);
+  d->pProtocol->pVariables[eMSDP_XTERM_256_COLORS]->ValueInt = (n % 5 == 0);
+  d->pProtocol->pVariables[eMSDP_UTF_8]->ValueInt = (n % 7 == 0);
+  d->pProtocol->pVariables[eMSDP_MXP]->ValueInt = (n % 11 == 0);
+  if (n % 6 == 1)
+    SET_BIT_AR(AFF_FLAGS(ch), AFF_DETECT_INVIS);
+  if (n % 13 == 0)
+    SET_BIT_AR(PRF_FLAGS(ch), PRF_NOGOSS);
+  if (n % 17 == 3)
+    SET_BIT_AR(PLR_FLAGS(ch), PLR_WRITING);
+  if (n % 9 == 4)
+    GET_POS(ch) = POS_SLEEPING;
+  return (ch);
+}
+
+/** Flush every descriptor's output, and forget everyone's history. */
+static void drain(void)
+{
+  struct descriptor_data *d;
+  int k;
+
+  for (d = descriptor_list; d; d = d->next) {
+    while (d->output.bytes) {
+      d->pProtocol->WriteOOB = 1;
+      if (check_process_output(d) < 0) {
+        perror("check: /dev/null");
+        exit(1);
+      }
+    }
+    d->pProtocol->WriteOOB = 0;
+    for (k = 0; k < NUM_HIST; k++)
+      free_history(d->character, k);
+  }
+}
+
+/** Read what each descriptor has queued, and its history past the time
+ * stamp, into got[way]; then drain. */
+static void capture(int way, int num)
+{
+  struct descriptor_data *d;
+  struct out_block *blk;
+  struct txt_block *h;
+  char *s;
+  size_t len, size;
+  int i, k, off;
+
+  for (i = 0, d = descriptor_list; d && i < num; d = d->next, i++) {
+    size = d->output.bytes + 64;
+    for (k = 0; k < NUM_HIST; k++)
+      for (h = GET_HISTORY(d->character, k); h; h = h->next)
+        size += strlen(h->text) + 8;
+    CREATE(s, char, size);
+
+    len = 0;
+    for (off = d->output.head_off, blk = d->output.head; blk; off = 0, blk = blk->next) {
+      memcpy(s + len, blk->text + off, blk->len - off);
+      len += blk->len - off;
+    }
+    for (k = 0; k < NUM_HIST; k++)
+      for (h = GET_HISTORY(d->character, k); h; h = h->next)
+        len += snprintf(s + len, size - len, "[%d] %s", k, strlen(h->text) > 6 ? h->text + 6 : h->text);
+    s[len] = '\0';
+    if (got[way][i])
+      free(got[way][i]);
+    got[way][i] = s;
+  }
+  drain();
+}
+
+/** Send a message both ways and compare what everyone got. */
+static void check_both(const char *what, send_fn broadcast, send_fn reference, int num)
+{
+  long bytes = 0;
+  int i;
+
+  drain();
+  broadcast();
+  capture(0, num);
+  reference();
+  capture(1, num);
+
+  for (i = 0; i < num; i++) {
+    if (strcmp(got[0][i], got[1][i]))
+      CHECK_FAIL("%s: descriptor %d got \"%s\", one at a time it gets \"%s\"", what, i, got[0][i], got[1][i]);
+    bytes += strlen(got[0][i]);
+  }
+  printf("  %-30s %6ld bytes to %d players, as one at a time\n", what, bytes, num);
+}
+
+/** Time a message both ways. */
+static void time_both(const char *what, send_fn broadcast, send_fn reference, int num)
+{
+  double t, t_ref;
+  int i;
+
+  drain();
+  t_ref = check_now();
+  for (i = 0; i < 100; i++) {
+    reference();
+    if (i % 10 == 9)
+      drain();
+  }
+  t_ref = check_now() - t_ref;
+  t = check_now();
+  for (i = 0; i < 100; i++) {
+    broadcast();
+    if (i % 10 == 9)
+      drain();
+  }
+  t = check_now() - t;
+  printf("  %-13s to %d: one at a time %8.1f us, broadcast %8.1f us\n", what, num, t_ref * 1e4, t * 1e4);
+}
+
+/* What the channels were before broadcasts: do_gen_comm()'s loop with an
+ * act() for every listener.  It also added a "(null)" history line for each
+ * player in an editor on a channel from a mobile, which is left out. */
+static void ref_gen_comm(struct char_data *ch, const char *arg, int subcmd)
+{
+  struct descriptor_data *i;
+  char buf1[MAX_INPUT_LENGTH], buf2[MAX_INPUT_LENGTH], *msg;
+  const char *name, *color_on;
+  int channel, hist;
+
+  switch (subcmd) {
+  case SCMD_SHOUT:   name = "shout";   color_on = KYEL; channel = PRF_NOSHOUT; hist = HIST_SHOUT;   break;
+  case SCMD_AUCTION: name = "auction"; color_on = KMAG; channel = PRF_NOAUCT;  hist = HIST_AUCTION; break;
+  default:           name = "gossip";  color_on = KYEL; channel = PRF_NOGOSS;  hist = HIST_GOSSIP;  break;
+  }
+  snprintf(buf1, sizeof(buf1), "$n %ss, '%s'", name, arg);
+
+  for (i = descriptor_list; i; i = i->next) {
+    if (STATE(i) != CON_PLAYING || i == ch->desc || !i->character)
+      continue;
+    if (!IS_NPC(ch) && (PRF_FLAGGED(i->character, channel) || PLR_FLAGGED(i->character, PLR_WRITING)))
+      continue;
+    if (ROOM_FLAGGED(IN_ROOM(i->character), ROOM_SOUNDPROOF) && (GET_LEVEL(ch) < LVL_GOD))
+      continue;
+    if (subcmd == SCMD_SHOUT && ((world[IN_ROOM(ch)].zone != world[IN_ROOM(i->character)].zone) ||
+         !AWAKE(i->character)))
+      continue;
+
+    snprintf(buf2, sizeof(buf2), "%s%s%s", (COLOR_LEV(i->character) >= C_NRM) ? color_on : "", buf1, KNRM);
+    msg = act(buf2, FALSE, ch, 0, i->character, TO_VICT | TO_SLEEP | TO_LOWPRI);
+    if (msg)
+      add_history(i->character, msg, hist);
+  }
+}
+
+/* What gemotes were before broadcasts: act()'s TO_GMOTE loop. */
+static void ref_gmote(const char *str, struct char_data *ch, struct obj_data *obj, void *vict_obj)
+{
+  struct descriptor_data *i;
+  char buf[MAX_STRING_LENGTH];
+
+  for (i = descriptor_list; i; i = i->next)
+    if (!i->connected && i->character &&
+        !PRF_FLAGGED(i->character, PRF_NOGOSS) &&
+        !PLR_FLAGGED(i->character, PLR_WRITING) &&
+        !ROOM_FLAGGED(IN_ROOM(i->character), ROOM_SOUNDPROOF)) {
+      snprintf(buf, sizeof(buf), "%s%s%s", CCYEL(i->character, C_NRM), str, CCNRM(i->character, C_NRM));
+      perform_act(buf, ch, obj, vict_obj, i->character);
+    }
+}
+
+/** The channels: a copy of the argument, as do_gen_comm() may change it. */
+static void gen_comm(struct char_data *ch, const char *arg, int subcmd)
+{
+  char buf[MAX_INPUT_LENGTH];
+
+  strlcpy(buf, arg, sizeof(buf));
+  do_gen_comm(ch, buf, 0, subcmd);
+}
+
+#define GOSSIP  "hello \tRred\tn and \tGgreen\tn, everyone"
+#define GEMOTE  "$n hugs $N warmly, showing off $p."
+#define ALL     "Rebooting.. \t(link\t) come back in %d minutes.\r\n"
+
+static void gossip(void)         { gen_comm(speaker, GOSSIP, SCMD_GOSSIP); }
+static void ref_gossip(void)     { ref_gen_comm(speaker, GOSSIP, SCMD_GOSSIP); }
+static void auction(void)        { gen_comm(speaker, "a plain sword, cheap", SCMD_AUCTION); }
+static void ref_auction(void)    { ref_gen_comm(speaker, "a plain sword, cheap", SCMD_AUCTION); }
+static void shout(void)          { gen_comm(speaker, "over \tYhere\tn!", SCMD_SHOUT); }
+static void ref_shout(void)      { ref_gen_comm(speaker, "over \tYhere\tn!", SCMD_SHOUT); }
+static void mob_gossip(void)     { gen_comm(mob, GOSSIP, SCMD_GOSSIP); }
+static void ref_mob_gossip(void) { ref_gen_comm(mob, GOSSIP, SCMD_GOSSIP); }
+static void mob_shout(void)      { gen_comm(mob, "intruders!", SCMD_SHOUT); }
+static void ref_mob_shout(void)  { ref_gen_comm(mob, "intruders!", SCMD_SHOUT); }
+static void gmote(void)          { act(GEMOTE, FALSE, speaker, thing, victim, TO_GMOTE); }
+static void ref_gmote_vict(void) { ref_gmote(GEMOTE, speaker, thing, victim); }
+static void gmote_text(void)     { act("Gemote: $n waves \t[F050]green\tn.", FALSE, victim, 0, 0, TO_GMOTE); }
+static void ref_gmote_text(void) { ref_gmote("Gemote: $n waves \t[F050]green\tn.", victim, 0, 0); }
+
+static void all(void)
+{
+  send_to_all(ALL, 5);
+}
+
+static void ref_all(void)
+{
+  struct descriptor_data *i;
+
+  for (i = descriptor_list; i; i = i->next)
+    if (STATE(i) == CON_PLAYING)
+      write_to_output(i, ALL, 5);
+}
+
+static void outdoor(void)
+{
+  send_to_outdoor("The sun rises in the \tYeast\tn.\r\n");
+}
+
+static void ref_outdoor(void)
+{
+  struct descriptor_data *i;
+
+  for (i = descriptor_list; i; i = i->next)
+    if (STATE(i) == CON_PLAYING && i->character && AWAKE(i->character) && OUTSIDE(i->character))
+      write_to_output(i, "The sun rises in the \tYeast\tn.\r\n");
+}
+
+static void room(void)
+{
+  send_to_room(room_a, "A \tRred\tn bang!\r\n");
+}
+
+static void ref_room(void)
+{
+  struct char_data *i;
+
+  for (i = world[room_a].people; i; i = i->next_in_room)
+    if (i->desc)
+      write_to_output(i->desc, "A \tRred\tn bang!\r\n");
+}
+
+static void game_info_msg(void)
+{
+  game_info("%s has entered %s.", "Someone", "the game");
+}
+
+static void ref_game_info_msg(void)
+{
+  struct descriptor_data *i;
+
+  for (i = descriptor_list; i; i = i->next)
+    if (STATE(i) == CON_PLAYING && i->character) {
+      write_to_output(i, "\tcInfo: \ty");
+      write_to_output(i, "%s has entered %s.", "Someone", "the game");
+      write_to_output(i, "\tn\r\n");
+    }
+}
+
+int main(int argc, char **argv)
+{
+  int n, i;
+
+  n = check_start(argc, argv, 200);
+  circle_srandom(25);
+  check_boot();
+
+  /* Two rooms in different zones, for shouts, one of them outdoors. */
+  room_a = 0;
+  for (room_b = 1; room_b < top_of_world; room_b++)
+    if (world[room_b].zone != world[room_a].zone && !ROOM_FLAGGED(room_b, ROOM_INDOORS))
+      break;
+
+  for (i = 0; i < n; i++)
+    make_player(i, i % 2 ? room_a : room_b);
+  CREATE(got[0], char *, n);
+  CREATE(got[1], char *, n);
+
+  /* A linkless speaker some can't see, a victim that fewer can, and an
+   * object only some can, for more kinds of listener than a broadcast keeps
+   * renderings for. */
+  CREATE(speaker, struct char_data, 1);
+  clear_char(speaker);
+  CREATE(speaker->player_specials, struct player_special_data, 1);
+  speaker->player.name = strdup("Speaker");
+  GET_LEVEL(speaker) = 20;
+  GET_POS(speaker) = POS_STANDING;
+  GET_INVIS_LEV(speaker) = 12;
+  SET_BIT_AR(PRF_FLAGS(speaker), PRF_NOREPEAT);
+  char_to_room(speaker, room_a);
+
+  victim = descriptor_list->character;
+  GET_INVIS_LEV(victim) = 15;
+  thing = read_object(0, REAL);
+  SET_BIT_AR(GET_OBJ_EXTRA(thing), ITEM_INVISIBLE);
+  obj_to_room(thing, room_a);
+
+  mob = read_mobile(0, REAL);
+  GET_LEVEL(mob) = 20;
+  char_to_room(mob, room_a);
+
+  printf("%d players in rooms %d and %d:\n", n, world[room_a].number, world[room_b].number);
+  check_both("gossip", gossip, ref_gossip, n);
+  check_both("auction", auction, ref_auction, n);
+  check_both("shout", shout, ref_shout, n);
+  check_both("gossip from a mobile", mob_gossip, ref_mob_gossip, n);
+  check_both("shout from a mobile", mob_shout, ref_mob_shout, n);
+  check_both("gemote with victim and object", gmote, ref_gmote_vict, n);
+  check_both("gemote with codes", gmote_text, ref_gmote_text, n);
+  check_both("send_to_all", all, ref_all, n);
+  check_both("send_to_outdoor", outdoor, ref_outdoor, n);
+  check_both("send_to_room", room, ref_room, n);
+  check_both("game_info", game_info_msg, ref_game_info_msg, n);
+
+  /* Timing. */
+  time_both("gossip", gossip, ref_gossip, n);
+  time_both("gemote", gmote, ref_gmote_vict, n);
+  time_both("send_to_all", all, ref_all, n);
+
+  return (check_end());
+}
@@ -0,0 +1,81 @@
+/**
+* @file check.h
+* Helpers shared by the programs in src/check, which 'make check' builds
+* against the game's own objects and runs on a scratch copy of lib.
+*
+* Part of the core altMUD source code distribution, which is a derivative
+* of, and continuation of, CircleMUD.
+*
+* All rights reserved.  See license for complete information.
+*
+* Each program checks one subsystem against a plain reference version of it
+* and times it.  It prints its figures, and exits non-zero if any result
+* differs from the reference.  An optional first argument scales the run.
+*/
+#ifndef _CHECK_H_
+#define _CHECK_H_
+
+#include <time.h>
+#include "db.h"
+#include "dg_event.h"
+#include "dg_scripts.h"
+
+extern FILE *logfile;
+
+/** Number of results found to differ from the reference. */
+static int check_failures = 0;
+
+/** Seconds on a monotonic clock, for timing. */
+static inline double check_now(void)
+{
+  struct timespec t;
+
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (t.tv_sec + t.tv_nsec / 1e9);
+}
+
+/** Report a result that differs from the reference. */
+#define CHECK_FAIL(...) \
+  do { if (check_failures++ < 10) { printf("  MISMATCH: "); printf(__VA_ARGS__); printf("\n"); } } while (0)
+
+/** Move into the scratch lib and send the game's log to check.log.
+ * @param argc, argv From main(); argv[1], if given, is the scale factor.
+ * @param def The scale used when none is given.
+ * @retval int The scale factor. */
+static inline int check_start(int argc, char **argv, int def)
+{
+  setvbuf(stdout, NULL, _IONBF, 0);
+  if (!(logfile = fopen("check.log", "a")))
+    logfile = stderr;
+  if (chdir("lib") < 0) {
+    perror("check: chdir lib");
+    exit(1);
+  }
+  return (argc > 1 && atoi(argv[1]) > 0 ? atoi(argv[1]) : def);
+}
+
+/** Load the game configuration from the scratch lib, as main() does. */
+static inline void check_config(void)
+{
+  if (!CONFIG_CONFFILE)
+    CONFIG_CONFFILE = strdup(CONFIG_FILE);
+  load_config();
+}
+
+/** Boot the world in the scratch lib, as main() does. */
+static inline void check_boot(void)
+{
+  check_config();
+  event_init();
+  init_lookup_table();
+  boot_db();
+}
+
+/** Print the mismatch count and give the exit code. */
+static inline int check_end(void)
+{
+  printf("  %d mismatch%s\n", check_failures, check_failures == 1 ? "" : "es");
+  return (check_failures ? 1 : 0);
+}
+
+#endif /* _CHECK_H_ */
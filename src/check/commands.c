@@ -0,0 +1,117 @@
+/**
+* @file commands.c
+* Check and time command lookups through the command trie (interpreter.c).
+*
+* Part of the core altMUD source code distribution, which is a derivative
+* of, and continuation of, CircleMUD.
+*
+* All rights reserved.  See license for complete information.
+*
+* The world and socials are booted, which builds the command list and its
+* trie.  Every prefix of every command name, and every name with a letter
+* too many, is then put to lookup_command() at every level and compared
+* with the two-pass scan of complete_cmd_info that command_interpreter()
+* used to make; every name is put to find_command() and compared with the
+* first entry of that name.  The list is rebuilt, as aedit does, and checked
+* again.  Then typical input is timed both ways.
+*/
+
+#include "conf.h"
+#include "sysdep.h"
+#include "structs.h"
+#include "utils.h"
+#include "comm.h"
+#include "db.h"
+#include "interpreter.h"
+#include "act.h"
+#include "check.h"
+
+/** What players type most, for the timing. */
+static const char *typical[] = {
+  "l", "look", "n", "s", "get", "say", "k", "inv", "eq", "score",
+  "gos", "tell", "wh", "cast", "smile", "nod", "bow", "grin"
+};
+
+#define NUM_TYPICAL  (int) (sizeof(typical) / sizeof(typical[0]))
+
+static volatile long sink;  /**< Keeps timed lookups from being optimized out. */
+
+/** The lookup lookup_command() replaces: real commands first, then
+ * socials, each in table order. */
+static int scan_command(const char *arg, int level)
+{
+  int cmd, length = strlen(arg);
+
+  for (cmd = 0; *complete_cmd_info[cmd].command != '\n'; cmd++)
+    if (complete_cmd_info[cmd].command_pointer != do_action &&
+        !strncmp(complete_cmd_info[cmd].command, arg, length) &&
+        level >= complete_cmd_info[cmd].minimum_level)
+      return (cmd);
+
+  for (cmd = 0; *complete_cmd_info[cmd].command != '\n'; cmd++)
+    if (complete_cmd_info[cmd].command_pointer == do_action &&
+        !strncmp(complete_cmd_info[cmd].command, arg, length) &&
+        level >= complete_cmd_info[cmd].minimum_level)
+      return (cmd);
+
+  return (-1);
+}
+
+/** Every prefix of every command, plus one letter past its end, at every
+ * level, and every name through find_command(). */
+static void check_commands(const char *when)
+{
+  char prefix[MAX_INPUT_LENGTH];
+  const char *name;
+  int cmd, first, len, level, want, got, checked = 0, commands = 0, socials = 0;
+
+  for (cmd = 0; *(name = complete_cmd_info[cmd].command) != '\n'; cmd++) {
+    if (complete_cmd_info[cmd].command_pointer == do_action)
+      socials++;
+    else
+      commands++;
+
+    for (len = 1; len <= (int) strlen(name) + 1 && len < (int) sizeof(prefix) - 1; len++) {
+      if (len <= (int) strlen(name))
+        strlcpy(prefix, name, len + 1);
+      else
+        snprintf(prefix, sizeof(prefix), "%sz", name);
+
+      for (level = -1; level <= LVL_IMPL + 1; level++, checked++)
+        if ((want = scan_command(prefix, level)) != (got = lookup_command(prefix, level)))
+          CHECK_FAIL("%s: '%s' at level %d is %d, the scan says %d", when, prefix, level, got, want);
+    }
+
+    for (first = 0; strcmp(complete_cmd_info[first].command, name); first++)
+      ;
+    if ((got = find_command(name)) != first)
+      CHECK_FAIL("%s: find_command(%s) is %d, not %d", when, name, got, first);
+  }
+  printf("  %s: %d commands and %d socials, %d lookups as the scan gives them\n",
+      when, commands, socials, checked);
+}
+
+int main(int argc, char **argv)
+{
+  int n, i;
+  double t;
+
+  n = check_start(argc, argv, 100000);
+  check_boot();
+
+  check_commands("after boot");
+  create_command_list();
+  check_commands("after rebuilding");
+
+  /* Timing, against the scan the trie replaced. */
+  t = check_now();
+  for (i = 0; i < n; i++)
+    sink += scan_command(typical[i % NUM_TYPICAL], 1);
+  printf("  typical input, scan:  %8.3f us\n", (check_now() - t) * 1e6 / n);
+  t = check_now();
+  for (i = 0; i < n; i++)
+    sink += lookup_command(typical[i % NUM_TYPICAL], 1);
+  printf("  typical input, trie:  %8.3f us\n", (check_now() - t) * 1e6 / n);
+
+  return (check_end());
+}
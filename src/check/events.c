@@ -0,0 +1,152 @@
+/**
+* @file events.c
+* Check and time the DG event queue (dg_event.c).
+*
+* Part of the core altMUD source code distribution, which is a derivative
+* of, and continuation of, CircleMUD.
+*
+* All rights reserved.  See license for complete information.
+*
+* Random events, some of which reschedule themselves, are run through the
+* queue one pulse at a time, and every one must fire on exactly the pulse it
+* was due.  Keys beyond the wheel's horizon must keep their time.  Then a
+* large mixed load is scheduled, partly cancelled and fired, and timed.
+*/
+
+#include "conf.h"
+#include "sysdep.h"
+#include "structs.h"
+#include "utils.h"
+#include "comm.h"
+#include "db.h"
+#include "dg_event.h"
+#include "check.h"
+
+/** An event's own record of when it is due. */
+struct due {
+  unsigned long pulse; /**< The pulse it must fire on. */
+  int again;           /**< Times left to reschedule itself. */
+};
+
+static long fired = 0;
+
+static EVENTFUNC(check_event)
+{
+  struct due *due = (struct due *) event_obj;
+  long delay;
+
+  fired++;
+  if (pulse != due->pulse)
+    CHECK_FAIL("event due on pulse %lu fired on %lu", due->pulse, pulse);
+
+  if (due->again-- > 0) {
+    delay = 1 + rand_number(0, 70000);
+    due->pulse = pulse + delay;
+    return (delay);
+  }
+  free(due);
+  return (0);
+}
+
+static EVENTFUNC(count_event)
+{
+  fired++;
+  return (0);
+}
+
+/** A delay like those the game schedules: mostly seconds, some minutes and
+ * a few hours. */
+static long mixed_delay(void)
+{
+  int r = rand_number(0, 99);
+
+  if (r < 60)
+    return (1 + rand_number(0, 49));
+  if (r < 90)
+    return (1 + rand_number(0, 2999));
+  return (1 + rand_number(0, 199999));
+}
+
+int main(int argc, char **argv)
+{
+  int n, i, scheduled = 0;
+  long delay, end;
+  struct due *due;
+  struct event **events;
+  double t0, t1, t2;
+
+  n = check_start(argc, argv, 1000000);
+  circle_srandom(3);
+  event_init();
+
+  /* Exactness: every firing is checked in check_event(). */
+  printf("Firing on the due pulse, with rescheduling:\n");
+  for (i = 0; i < 200000; i++) {
+    CREATE(due, struct due, 1);
+    delay = 1 + (rand_number(0, 2) ? rand_number(0, 999) : rand_number(0, 19999999));
+    due->pulse = pulse + delay;
+    due->again = rand_number(0, 2);
+    event_create(check_event, due, delay);
+    scheduled += 1 + due->again;
+    /* Keep the wheel turning while the queue fills. */
+    if (i % 1000 == 0) {
+      int k;
+
+      for (k = 0; k < 37; k++) {
+        pulse++;
+        event_process();
+      }
+    }
+  }
+  for (end = pulse + 25000000; pulse < (unsigned long) end && fired < scheduled; ) {
+    pulse++;
+    event_process();
+  }
+  if (fired != scheduled)
+    CHECK_FAIL("%ld of %d firings happened", fired, scheduled);
+  printf("  %ld firings checked\n", fired);
+
+  /* Keys past the horizon wait in the top level and must keep their time. */
+  if (sizeof(long) > 4) {
+    struct event *far[4];
+
+    for (i = 0; i < 4; i++) {
+      delay = (long) (WHEEL_HORIZON + 1) * (i + 1) + i;
+      far[i] = event_create(count_event, NULL, delay);
+      if (event_time(far[i]) != delay)
+        CHECK_FAIL("event %ld pulses ahead reports %ld", delay, event_time(far[i]));
+    }
+    for (i = 0; i < 300; i++) {
+      pulse++;
+      event_process();
+    }
+    for (i = 0; i < 4; i++) {
+      if (!event_is_queued(far[i]))
+        CHECK_FAIL("event far ahead fired early");
+      else
+        event_cancel(far[i]);
+    }
+    printf("  keys beyond the horizon kept their time\n");
+  }
+
+  /* Timing. */
+  CREATE(events, struct event *, n);
+  fired = 0;
+  t0 = check_now();
+  for (i = 0; i < n; i++)
+    events[i] = event_create(count_event, NULL, mixed_delay());
+  t1 = check_now();
+  for (i = 0; i < n; i += 10)
+    event_cancel(events[i]);
+  while (fired < n - (n + 9) / 10) {
+    pulse++;
+    event_process();
+  }
+  t2 = check_now();
+  printf("Mixed delays (60%% under 5s, 30%% under 5min, 10%% up to 5.5h):\n");
+  printf("  schedule %d events:        %.3f s\n", n, t1 - t0);
+  printf("  cancel 10%%, fire the rest: %.3f s\n", t2 - t1);
+  free(events);
+
+  return (check_end());
+}
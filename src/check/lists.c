@@ -0,0 +1,308 @@
+/**
+* @file lists.c
+* Check and time the doubly linked room, content and world lists (handler.c).
+*
+* Part of the core altMUD source code distribution, which is a derivative
+* of, and continuation of, CircleMUD.
+*
+* All rights reserved.  See license for complete information.
+*
+* The world is booted and filled out with extra mobiles and objects, then
+* characters and objects are moved at random between rooms, inventories and
+* containers, with extractions and reloads mixed in.  Every so often each
+* list is walked forwards and checked against its back pointers and against
+* the in_room, carried_by and in_obj fields that say where things should
+* be, and every object on object_list must turn up in exactly one place.
+* Moves in and out of one crowded room and extractions are then timed.
+*/
+
+#include "conf.h"
+#include "sysdep.h"
+#include "structs.h"
+#include "utils.h"
+#include "comm.h"
+#include "db.h"
+#include "handler.h"
+#include "check.h"
+
+#define COPIES   15      /**< Extra copies of each prototype loaded at boot. */
+#define CROWD_OBJS 2000  /**< Objects in the crowded room. */
+#define CROWD_CHARS 500  /**< Characters in the crowded room. */
+
+static struct char_data **chars;  /**< Snapshot of character_list. */
+static struct obj_data **objs;    /**< Snapshot of object_list. */
+static int num_chars, num_objs, max_chars, max_objs;
+
+/** Take a snapshot of both world lists to pick from at random. */
+static void snapshot(void)
+{
+  struct char_data *ch;
+  struct obj_data *obj;
+
+  num_chars = num_objs = 0;
+  for (ch = character_list; ch; ch = ch->next) {
+    if (num_chars == max_chars) {
+      max_chars = max_chars * 2 + 1024;
+      RECREATE(chars, struct char_data *, max_chars);
+    }
+    chars[num_chars++] = ch;
+  }
+  for (obj = object_list; obj; obj = obj->next) {
+    if (num_objs == max_objs) {
+      max_objs = max_objs * 2 + 1024;
+      RECREATE(objs, struct obj_data *, max_objs);
+    }
+    objs[num_objs++] = obj;
+  }
+}
+
+static room_rnum random_room(void)
+{
+  return (rand_number(0, top_of_world));
+}
+
+/** Walk every list and check it against its back pointers and the fields
+ * that say where each character and object is. */
+static void check_lists(const char *when)
+{
+  struct char_data *ch, *prev_ch = NULL;
+  struct obj_data *obj, *prev_obj = NULL, *k, *prev_k;
+  long chars_in_rooms = 0, placed = 0, nchars = 0, nobjs = 0, n;
+  room_rnum r;
+  int w;
+
+  for (ch = character_list; ch; prev_ch = ch, ch = ch->next) {
+    if (ch->prev != prev_ch)
+      CHECK_FAIL("%s: character_list back pointer broken", when);
+    nchars++;
+    if (IN_ROOM(ch) != NOWHERE)
+      chars_in_rooms++;
+    for (prev_k = NULL, k = ch->carrying; k; prev_k = k, k = k->next_content) {
+      if (k->prev_content != prev_k)
+        CHECK_FAIL("%s: inventory back pointer broken", when);
+      if (k->carried_by != ch || k->in_obj || IN_ROOM(k) != NOWHERE)
+        CHECK_FAIL("%s: carried object says it is elsewhere", when);
+      placed++;
+    }
+    for (w = 0; w < NUM_WEARS; w++)
+      if (GET_EQ(ch, w))
+        placed++;
+  }
+
+  for (r = 0; r <= top_of_world; r++) {
+    for (n = 0, prev_ch = NULL, ch = world[r].people; ch; prev_ch = ch, ch = ch->next_in_room) {
+      if (ch->prev_in_room != prev_ch)
+        CHECK_FAIL("%s: room %d people back pointer broken", when, world[r].number);
+      if (IN_ROOM(ch) != r)
+        CHECK_FAIL("%s: character in room %d's list says it is elsewhere", when, world[r].number);
+      if (++n > nchars) {
+        CHECK_FAIL("%s: room %d people list loops", when, world[r].number);
+        break;
+      }
+    }
+    chars_in_rooms -= n;
+    for (prev_k = NULL, k = world[r].contents; k; prev_k = k, k = k->next_content) {
+      if (k->prev_content != prev_k)
+        CHECK_FAIL("%s: room %d contents back pointer broken", when, world[r].number);
+      if (IN_ROOM(k) != r || k->carried_by || k->in_obj)
+        CHECK_FAIL("%s: object in room %d says it is elsewhere", when, world[r].number);
+      placed++;
+    }
+  }
+
+  for (obj = object_list; obj; prev_obj = obj, obj = obj->next) {
+    if (obj->prev != prev_obj)
+      CHECK_FAIL("%s: object_list back pointer broken", when);
+    nobjs++;
+    for (prev_k = NULL, k = obj->contains; k; prev_k = k, k = k->next_content) {
+      if (k->prev_content != prev_k)
+        CHECK_FAIL("%s: container back pointer broken", when);
+      if (k->in_obj != obj || k->carried_by || IN_ROOM(k) != NOWHERE)
+        CHECK_FAIL("%s: contained object says it is elsewhere", when);
+      placed++;
+    }
+  }
+
+  if (chars_in_rooms)
+    CHECK_FAIL("%s: %ld characters missing from their room's list", when, chars_in_rooms);
+  if (placed != nobjs)
+    CHECK_FAIL("%s: %ld objects on object_list, %ld found in the world", when, nobjs, placed);
+  printf("  %s: %ld chars, %ld objs checked\n", when, nchars, nobjs);
+}
+
+/** Is container 'in' the object 'obj' or inside it? */
+static bool inside(struct obj_data *obj, struct obj_data *in)
+{
+  for (; in; in = in->in_obj)
+    if (in == obj)
+      return (TRUE);
+  return (FALSE);
+}
+
+static void detach(struct obj_data *obj)
+{
+  if (IN_ROOM(obj) != NOWHERE)
+    obj_from_room(obj);
+  else if (obj->carried_by)
+    obj_from_char(obj);
+  else if (obj->in_obj)
+    obj_from_obj(obj);
+}
+
+/** Move one object somewhere at random: a room, an inventory or a
+ * container it is not already around. */
+static void move_obj(struct obj_data *obj)
+{
+  struct obj_data *to;
+
+  detach(obj);
+  switch (rand_number(0, 2)) {
+  case 0:
+    obj_to_room(obj, random_room());
+    break;
+  case 1:
+    obj_to_char(obj, chars[rand_number(0, num_chars - 1)]);
+    break;
+  default:
+    to = objs[rand_number(0, num_objs - 1)];
+    if (GET_OBJ_TYPE(to) == ITEM_CONTAINER && !to->worn_by && !inside(obj, to))
+      obj_to_obj(obj, to);
+    else
+      obj_to_room(obj, random_room());
+    break;
+  }
+}
+
+int main(int argc, char **argv)
+{
+  struct obj_data *crowd_objs[CROWD_OBJS], *obj;
+  struct char_data *crowd_chars[CROWD_CHARS], *ch;
+  long i, moves, roll;
+  double t, t_snap;
+  char when[64];
+
+  moves = check_start(argc, argv, 100000);
+  circle_srandom(18);
+  check_boot();
+
+  for (i = 0; i < COPIES; i++) {
+    mob_rnum m;
+    obj_rnum o;
+
+    for (m = 0; m <= top_of_mobt; m++)
+      char_to_room(read_mobile(m, REAL), random_room());
+    for (o = 0; o <= top_of_objt; o++)
+      obj_to_room(read_object(o, REAL), random_room());
+  }
+  check_lists("after boot");
+
+  /* Random moves.  A character may be extracted twice, which must do
+   * nothing the second time. */
+  snapshot();
+  t = check_now();
+  for (i = 1; i <= moves; i++) {
+    roll = rand_number(0, 99);
+    if (roll < 40) {
+      ch = chars[rand_number(0, num_chars - 1)];
+      if (IN_ROOM(ch) != NOWHERE)
+        char_from_room(ch);
+      char_to_room(ch, random_room());
+    } else if (roll < 90) {
+      obj = objs[rand_number(0, num_objs - 1)];
+      if (!obj->worn_by)
+        move_obj(obj);
+    } else if (roll < 95) {
+      ch = chars[rand_number(0, num_chars - 1)];
+      if (IS_NPC(ch)) {
+        extract_char(ch);
+        if (rand_number(0, 1))
+          extract_char(ch);
+      }
+      if (!rand_number(0, 2))
+        extract_pending_chars();
+      char_to_room(read_mobile(rand_number(0, top_of_mobt), REAL), random_room());
+      extract_pending_chars();
+      snapshot();
+    } else {
+      obj = objs[rand_number(0, num_objs - 1)];
+      if (!obj->worn_by)
+        extract_obj(obj);
+      obj_to_room(read_object(rand_number(0, top_of_objt), REAL), random_room());
+      snapshot();
+    }
+    if (i == moves || (moves >= 5 && i % (moves / 5) == 0)) {
+      snprintf(when, sizeof(when), "after %ld moves", i);
+      check_lists(when);
+    }
+  }
+  printf("%ld random moves, with the checks: %.2f s\n", moves, check_now() - t);
+
+  /* Timing: in and out of one crowded room. */
+  for (i = 0; i < CROWD_OBJS; i++) {
+    crowd_objs[i] = read_object(rand_number(0, top_of_objt), REAL);
+    obj_to_room(crowd_objs[i], 0);
+  }
+  t = check_now();
+  for (i = 0; i < 200000; i++) {
+    obj = crowd_objs[rand_number(0, CROWD_OBJS - 1)];
+    obj_from_room(obj);
+    obj_to_room(obj, 0);
+  }
+  printf("  obj out of and into a %d object room:  %8.3f us\n", CROWD_OBJS, (check_now() - t) * 1e6 / 200000);
+
+  for (i = 0; i < CROWD_CHARS; i++) {
+    crowd_chars[i] = read_mobile(rand_number(0, top_of_mobt), REAL);
+    char_to_room(crowd_chars[i], 0);
+  }
+  t = check_now();
+  for (i = 0; i < 200000; i++) {
+    ch = crowd_chars[rand_number(0, CROWD_CHARS - 1)];
+    char_from_room(ch);
+    char_to_room(ch, 0);
+  }
+  printf("  char out of and into a %d char room:    %8.3f us\n", CROWD_CHARS, (check_now() - t) * 1e6 / 200000);
+
+  /* Timing: extraction and reload.  Taking the snapshot is the same either
+   * way, so its cost is taken back out. */
+  snapshot();
+  t = check_now();
+  for (i = 0; i < 2000; i++) {
+    do
+      obj = objs[rand_number(0, num_objs - 1)];
+    while (obj->worn_by || obj->in_obj || obj->contains);
+    extract_obj(obj);
+    obj_to_room(read_object(rand_number(0, top_of_objt), REAL), random_room());
+    snapshot();
+  }
+  t = check_now() - t;
+  t_snap = check_now();
+  for (i = 0; i < 2000; i++)
+    snapshot();
+  t -= check_now() - t_snap;
+  printf("  extract_obj() + read_object(), %d objs: %8.3f us\n", num_objs, t * 1e6 / 2000);
+
+  t = check_now();
+  for (i = 0; i < 2000; i++) {
+    do
+      ch = chars[rand_number(0, num_chars - 1)];
+    while (!IS_NPC(ch) || ch->carrying);
+    extract_char(ch);
+    extract_pending_chars();
+    char_to_room(read_mobile(rand_number(0, top_of_mobt), REAL), random_room());
+    snapshot();
+  }
+  t = check_now() - t;
+  t_snap = check_now();
+  for (i = 0; i < 2000; i++)
+    snapshot();
+  t -= check_now() - t_snap;
+  printf("  extract_char() + read_mobile(), %d chars: %8.3f us\n", num_chars, t * 1e6 / 2000);
+
+  t = check_now();
+  for (i = 0; i < 100000; i++)
+    extract_pending_chars();
+  printf("  extract_pending_chars(), none pending:  %8.3f us\n", (check_now() - t) * 1e6 / 100000);
+
+  check_lists("after timing");
+  return (check_end());
+}
@@ -0,0 +1,94 @@
+/**
+* @file mccp.c
+* Check MCCP3 input (protocol.c).
+*
+* Part of the core altMUD source code distribution, which is a derivative
+* of, and continuation of, CircleMUD.
+*
+* All rights reserved.  See license for complete information.
+*
+* A client turns on MCCP3 and then sends one packet that inflates to several
+* times what the input buffer holds.  ProtocolInput() must hold back what
+* does not fit rather than fail, and hand it all over, in order, as the game
+* empties the buffer pass by pass.
+*/
+
+#include "conf.h"
+#include "sysdep.h"
+#include "structs.h"
+#include "utils.h"
+#include "comm.h"
+#include "protocol.h"
+#include "check.h"
+
+#ifdef USING_MCCP
+#include <zlib.h>
+#include <arpa/telnet.h>
+
+#define LINES 4000  /**< Lines in the compressed packet. */
+
+int main(int argc, char **argv)
+{
+  static const char start[] = { (char) IAC, (char) SB, TELOPT_MCCP3, (char) IAC, (char) SE };
+  static char sent[LINES * 32], packet[LINES * 32], got[LINES * 32 + MAX_RAW_INPUT_LENGTH];
+  static char inbuf[MAX_RAW_INPUT_LENGTH];
+  struct descriptor_data d;
+  int i, sent_len = 0, got_len = 0, passes = 0;
+  uLongf packet_len = sizeof(packet);
+  ssize_t n;
+
+  check_start(argc, argv, 0);
+  memset(&d, 0, sizeof(d));
+  d.descriptor = -1;
+  d.reactor_slot = -1;
+  d.pProtocol = ProtocolCreate();
+  d.pProtocol->bMCCP3 = TRUE;
+
+  for (i = 0; i < LINES; i++)
+    sent_len += sprintf(sent + sent_len, "say line %d of the packet\r\n", i);
+  if (compress((Bytef *) packet, &packet_len, (Bytef *) sent, sent_len) != Z_OK) {
+    printf("check: compress failed\n");
+    return (1);
+  }
+  printf("One %lu byte MCCP3 packet inflating to %d bytes, a %d byte input buffer:\n",
+    (unsigned long) packet_len, sent_len, MAX_RAW_INPUT_LENGTH);
+
+  if (ProtocolInput(&d, (char *) start, sizeof(start), inbuf) < 0 || !d.pProtocol->pInZ)
+    CHECK_FAIL("MCCP3 did not start");
+
+  /* Each pass the game takes every line out of the buffer, as process_input()
+   * does, and then lets ProtocolInput() carry on. */
+  n = ProtocolInput(&d, packet, packet_len, inbuf);
+  for (;;) {
+    if (n < 0) {
+      CHECK_FAIL("pass %d: ProtocolInput() failed", passes);
+      break;
+    }
+    passes++;
+    memcpy(got + got_len, inbuf, strlen(inbuf));
+    got_len += strlen(inbuf);
+    *inbuf = '\0';
+    if (!ProtocolInputPending(&d))
+      break;
+    n = ProtocolInput(&d, packet, 0, inbuf);
+  }
+
+  if (got_len != sent_len || memcmp(got, sent, sent_len))
+    CHECK_FAIL("%d of %d bytes came through intact", got_len, sent_len);
+  if (passes < 2)
+    CHECK_FAIL("delivered in one pass, but the packet needs several");
+  printf("  delivered over %d passes\n", passes);
+
+  ProtocolDestroy(d.pProtocol);
+  return (check_end());
+}
+
+#else
+
+int main(int argc, char **argv)
+{
+  printf("MCCP is not compiled in.\n");
+  return (0);
+}
+
+#endif /* USING_MCCP */
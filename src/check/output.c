@@ -0,0 +1,350 @@
+/**
+* @file output.c
+* Check and time descriptor output (comm.c's output queue and
+* process_output(), protocol.c's ProtocolWritev()).
+*
+* Part of the core altMUD source code distribution, which is a derivative
+* of, and continuation of, CircleMUD.
+*
+* All rights reserved.  See license for complete information.
+*
+* Descriptors on socket pairs are sent messages of random length, some
+* longer than an output block, through write_to_output() and flushed with
+* process_output() as game_loop() does.  What comes out of the other end of
+* each socket, inflated for the descriptors that negotiated MCCP2, must be
+* exactly the messages in order, including through the short writes of
+* sockets with small buffers.  The CRLFs and the prompt around the output
+* are checked separately.  Then combat spam to many descriptors is timed.
+*/
+
+#include "conf.h"
+#include "sysdep.h"
+#include "structs.h"
+#include "utils.h"
+#include "comm.h"
+#include "db.h"
+#include "protocol.h"
+#include "check.h"
+#include <sys/socket.h>
+#include <arpa/telnet.h>
+#ifdef USING_MCCP
+#include <zlib.h>
+#endif
+
+int check_process_output(struct descriptor_data *t);
+
+static int short_flushes = 0;  /**< Flushes the socket took in more than one go. */
+
+/** One end of a socket pair: the descriptor, and what its peer reads. */
+struct peer {
+  struct descriptor_data *d;
+  socket_t fd;          /**< The client's end. */
+  char *want;           /**< Sent text the client has not read yet. */
+  size_t want_off, want_len, want_size;
+  size_t got;           /**< Bytes the client has read, after inflating. */
+#ifdef USING_MCCP
+  z_stream *z;          /**< The client's inflate stream, once MCCP2 starts. */
+  int marker;           /**< Bytes of the MCCP2 start marker still to come. */
+#endif
+};
+
+/** Connect a playing descriptor to a fresh socket pair.
+ * @param sndbuf The size of the kernel's buffers for it.
+ * @param mccp Negotiate MCCP2 as a client would. */
+static void peer_open(struct peer *p, int sndbuf, bool mccp)
+{
+  static const char do_mccp[] = { (char) IAC, (char) DO, (char) 86 };
+  char inbuf[MAX_RAW_INPUT_LENGTH] = "";
+  struct descriptor_data *d;
+  int sv[2];
+
+  if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) < 0) {
+    perror("check: socketpair");
+    exit(1);
+  }
+  setsockopt(sv[0], SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+  setsockopt(sv[1], SOL_SOCKET, SO_RCVBUF, &sndbuf, sizeof(sndbuf));
+  fcntl(sv[0], F_SETFL, O_NONBLOCK);
+  fcntl(sv[1], F_SETFL, O_NONBLOCK);
+
+  memset(p, 0, sizeof(*p));
+  CREATE(d, struct descriptor_data, 1);
+  d->descriptor = sv[0];
+  d->reactor_slot = -1;
+  d->connected = CON_PLAYING;
+  d->pProtocol = ProtocolCreate();
+  CREATE(d->character, struct char_data, 1);
+  clear_char(d->character);
+  CREATE(d->character->player_specials, struct player_special_data, 1);
+  d->character->desc = d;
+  GET_HIT(d->character) = 100;
+  GET_MAX_HIT(d->character) = 500;
+  p->d = d;
+  p->fd = sv[1];
+#ifdef USING_MCCP
+  if (mccp) {
+    ProtocolInput(d, (char *) do_mccp, sizeof(do_mccp), inbuf);
+    p->marker = 5;  /* IAC SB MCCP IAC SE */
+  }
+#endif
+}
+
+static void peer_close(struct peer *p)
+{
+  close(p->fd);
+  close(p->d->descriptor);
+}
+
+/** Queue a message, and remember it as what the client must read next. */
+static void peer_send(struct peer *p, const char *msg)
+{
+  size_t len = strlen(msg);
+
+  write_to_output(p->d, "%s", msg);
+  if (p->want_off > p->want_size / 2) {
+    memmove(p->want, p->want + p->want_off, p->want_len - p->want_off);
+    p->want_len -= p->want_off;
+    p->want_off = 0;
+  }
+  if (p->want_len + len > p->want_size) {
+    p->want_size = (p->want_len + len) * 2;
+    RECREATE(p->want, char, p->want_size);
+  }
+  memcpy(p->want + p->want_len, msg, len);
+  p->want_len += len;
+}
+
+/** Match text the client read against what it should have. */
+static void peer_match(struct peer *p, const char *text, size_t len)
+{
+  if (len > p->want_len - p->want_off)
+    CHECK_FAIL("descriptor %d read %lu bytes more than was sent", p->d->descriptor,
+      (unsigned long) (len - (p->want_len - p->want_off)));
+  else if (memcmp(p->want + p->want_off, text, len))
+    CHECK_FAIL("descriptor %d read something else after byte %lu", p->d->descriptor, (unsigned long) p->got);
+  else
+    p->want_off += len;
+  p->got += len;
+}
+
+/** Read everything the socket holds, as the client.
+ * @param check Match it against what was sent. */
+static void peer_read(struct peer *p, bool check)
+{
+  static char buf[65536];
+  ssize_t n;
+
+  while ((n = read(p->fd, buf, sizeof(buf))) > 0) {
+    char *text = buf;
+
+    if (!check)
+      continue;
+#ifdef USING_MCCP
+    if (p->marker) {
+      int m = MIN(p->marker, n);
+
+      p->marker -= m;
+      text += m;
+      n -= m;
+      if (!p->marker) {
+        CREATE(p->z, z_stream, 1);
+        inflateInit(p->z);
+      }
+    }
+    if (p->z) {
+      static char out[65536];
+
+      p->z->next_in = (Bytef *) text;
+      p->z->avail_in = n;
+      do {
+        p->z->next_out = (Bytef *) out;
+        p->z->avail_out = sizeof(out);
+        if (inflate(p->z, Z_SYNC_FLUSH) == Z_DATA_ERROR) {
+          CHECK_FAIL("descriptor %d sent a corrupt MCCP2 stream", p->d->descriptor);
+          return;
+        }
+        peer_match(p, out, sizeof(out) - p->z->avail_out);
+      } while (p->z->avail_out == 0);
+      continue;
+    }
+#endif
+    peer_match(p, text, n);
+  }
+}
+
+/** Flush a descriptor as game_loop() does, letting the client read in
+ * between, until nothing is left.  It is marked as sending out of band
+ * output, so that only the queued text goes out. */
+static void peer_flush(struct peer *p)
+{
+  int passes = 0;
+
+  while (p->d->output.bytes || p->d->pProtocol->MCCPBufLen) {
+    if (p->d->output.bytes) {
+      p->d->pProtocol->WriteOOB = 1;
+      if (check_process_output(p->d) < 0) {
+        CHECK_FAIL("descriptor %d failed to write", p->d->descriptor);
+        return;
+      }
+    } else if (ProtocolFlush(p->d) < 0) {
+      CHECK_FAIL("descriptor %d failed to flush", p->d->descriptor);
+      return;
+    }
+    peer_read(p, TRUE);
+    if (++passes == 2)
+      short_flushes++;
+    if (passes > 10000) {
+      CHECK_FAIL("descriptor %d never finished writing", p->d->descriptor);
+      return;
+    }
+  }
+}
+
+/** A random message: printable text with some colour escapes, ending in a
+ * CRLF, from a few bytes to nearly two output blocks. */
+static void random_message(char *msg)
+{
+  int len = rand_number(0, 9) ? rand_number(8, 200) : rand_number(200, 2 * OUT_BLOCK_SIZE - 100);
+  int i = 0;
+
+  while (i < len) {
+    if (!rand_number(0, 40)) {
+      strcpy(msg + i, "\x1b[1;31m");
+      i += 7;
+    } else
+      msg[i++] = 'a' + rand_number(0, 25);
+  }
+  strcpy(msg + i, "\r\n");
+}
+
+/** Messages through every kind of descriptor, checked byte for byte. */
+static void check_delivery(int descs, int rounds)
+{
+  char msg[2 * OUT_BLOCK_SIZE];
+  struct peer *peers;
+  int i, r, k;
+
+  CREATE(peers, struct peer, descs);
+  for (i = 0; i < descs; i++) {
+    peer_open(&peers[i], i % 2 ? 4096 : 1 << 20, i % 4 >= 2);
+#ifdef USING_MCCP
+    if (i % 4 >= 2 && !peers[i].d->pProtocol->pOutZ)
+      CHECK_FAIL("descriptor %d did not start MCCP2", peers[i].d->descriptor);
+#endif
+  }
+  for (r = 0; r < rounds; r++)
+    for (i = 0; i < descs; i++) {
+      for (k = rand_number(0, 40); k > 0; k--) {
+        random_message(msg);
+        peer_send(&peers[i], msg);
+      }
+      peer_flush(&peers[i]);
+    }
+  for (i = 0; i < descs; i++) {
+    if (peers[i].want_off != peers[i].want_len)
+      CHECK_FAIL("descriptor %d is missing %lu bytes", peers[i].d->descriptor,
+        (unsigned long) (peers[i].want_len - peers[i].want_off));
+    peer_close(&peers[i]);
+  }
+  printf("  %d descriptors, %d rounds: every byte delivered in order, %d flushes cut short\n",
+    descs, rounds, short_flushes);
+}
+
+/** What a client reads for one message and its prompt. */
+static void read_all(struct peer *p, char *buf, size_t size)
+{
+  ssize_t n;
+  size_t len = 0;
+
+  while (len < size - 1 && (n = read(p->fd, buf + len, size - 1 - len)) > 0)
+    len += n;
+  buf[len] = '\0';
+}
+
+/** The CRLFs and the prompt process_output() puts around the text. */
+static void check_prompt(void)
+{
+  char buf[MAX_STRING_LENGTH];
+  struct peer p;
+
+  peer_open(&p, 1 << 20, FALSE);
+  write_to_output(p.d, "Hello.\r\n");
+  check_process_output(p.d);
+  read_all(&p, buf, sizeof(buf));
+  if (strncmp(buf, "Hello.\r\n\r\n", 10) || !buf[10])
+    CHECK_FAIL("first output reads \"%.20s\", not the text, a CRLF and a prompt", buf);
+
+  /* A prompt is showing now, so the next output starts on a fresh line. */
+  p.d->has_prompt = TRUE;
+  write_to_output(p.d, "Again.\r\n");
+  check_process_output(p.d);
+  read_all(&p, buf, sizeof(buf));
+  if (strncmp(buf, "\r\nAgain.\r\n\r\n", 12) || !buf[12])
+    CHECK_FAIL("later output reads \"%.20s\", not a CRLF, the text, a CRLF and a prompt", buf);
+
+  SET_BIT_AR(PRF_FLAGS(p.d->character), PRF_COMPACT);
+  p.d->has_prompt = FALSE;
+  write_to_output(p.d, "Compact.\r\n");
+  check_process_output(p.d);
+  read_all(&p, buf, sizeof(buf));
+  if (strncmp(buf, "Compact.\r\n", 10) || !buf[10] || buf[10] == '\r')
+    CHECK_FAIL("compact output reads \"%.20s\", not the text and a prompt", buf);
+  peer_close(&p);
+  printf("  CRLFs and prompts around the output as before\n");
+}
+
+/** Combat spam: k lines to each of descs descriptors, then output, timed
+ * per round. */
+static void time_spam(int descs, int rounds, int k, int sndbuf)
+{
+  struct peer *peers;
+  double queue = 0, output = 0, t;
+  long bytes = 0;
+  int i, r, j;
+  char buf[65536];
+  ssize_t n;
+
+  CREATE(peers, struct peer, descs);
+  for (i = 0; i < descs; i++)
+    peer_open(&peers[i], sndbuf, FALSE);
+  for (r = 0; r < rounds; r++) {
+    t = check_now();
+    for (i = 0; i < descs; i++)
+      for (j = 0; j < k; j++)
+        write_to_output(peers[i].d, "\x1b[1;31mThe %s cityguard's slash %s %s!\x1b[0m (%d)\r\n", "burly",
+          j & 1 ? "massacres" : "obliterates", i & 1 ? "you" : "the fido", j);
+    queue += check_now() - t;
+    t = check_now();
+    for (i = 0; i < descs; i++)
+      if (check_process_output(peers[i].d) < 0)
+        CHECK_FAIL("descriptor %d failed to write", peers[i].d->descriptor);
+    output += check_now() - t;
+    for (i = 0; i < descs; i++)
+      while ((n = read(peers[i].fd, buf, sizeof(buf))) > 0)
+        bytes += n;
+  }
+  for (i = 0; i < descs; i++)
+    peer_close(&peers[i]);
+  printf("  %d lines, %4d KB buffers: queue %6.2f ms, output %6.2f ms per round, %ld bytes\n",
+    k, sndbuf / 1024, queue * 1e3 / rounds, output * 1e3 / rounds, bytes);
+}
+
+int main(int argc, char **argv)
+{
+  int rounds = check_start(argc, argv, 20);
+
+  circle_srandom(12);
+  check_config();
+
+  printf("Output through socket pairs, half with MCCP2, half with small buffers:\n");
+  check_delivery(16, rounds * 5);
+  check_prompt();
+
+  printf("Combat spam to 500 descriptors, %d rounds:\n", rounds);
+  time_spam(500, rounds, 12, 1 << 20);
+  time_spam(500, rounds, 60, 4096);
+  time_spam(500, rounds, 200, 1 << 20);
+  time_spam(500, rounds, 200, 4096);
+
+  return (check_end());
+}
@@ -0,0 +1,200 @@
+/**
+* @file players.c
+* Check and time the player table's name and id indexes (players.c).
+*
+* Part of the core altMUD source code distribution, which is a derivative
+* of, and continuation of, CircleMUD.
+*
+* All rights reserved.  See license for complete information.
+*
+* A player index of random names, some of them used several times, is
+* written into the scratch lib and loaded.  Every lookup by name and by id
+* must give what a walk through the whole table gives, the lower position
+* winning where a key is there twice.  This is checked after loading, after
+* new characters are made, after some are deleted and after a rename, and
+* both ways of looking up are timed.
+*/
+
+#include "conf.h"
+#include "sysdep.h"
+#include "structs.h"
+#include "utils.h"
+#include "comm.h"
+#include "db.h"
+#include "check.h"
+
+#define NEW_ENTRIES 3000  /**< Characters made after loading. */
+
+static volatile long sink;  /**< Keeps timed lookups from being optimized out. */
+
+/** The lookup the index replaced: walk the table for the name. */
+static long ref_by_name(const char *name)
+{
+  int i;
+
+  for (i = 0; i <= top_of_p_table; i++)
+    if (!str_cmp(player_table[i].name, name))
+      return (i);
+  return (-1);
+}
+
+/** The lookup the index replaced: walk the table for the id. */
+static long ref_by_id(long id)
+{
+  int i;
+
+  for (i = 0; i <= top_of_p_table; i++)
+    if (player_table[i].id == id)
+      return (i);
+  return (-1);
+}
+
+/** Write a plrfiles index of n players.  One name in fifty is one of seven
+ * shared names, so those come up many times. */
+static void write_index(int n)
+{
+  FILE *fl;
+  int i;
+
+  if (!(fl = fopen(LIB_PLRFILES INDEX_FILE, "w"))) {
+    perror("check: " LIB_PLRFILES INDEX_FILE);
+    exit(1);
+  }
+  for (i = 0; i < n; i++) {
+    if (i % 50)
+      fprintf(fl, "%d p%06dx %d 0 %d\n", i + 1, rand_number(0, 999999), rand_number(1, 34), 1600000000 + i);
+    else
+      fprintf(fl, "%d dup%d %d 0 %d\n", i + 1, i % 7, rand_number(1, 34), 1600000000 + i);
+  }
+  fprintf(fl, "~\n");
+  fclose(fl);
+}
+
+/** A table position, for the sorted copies lookups are checked against. */
+struct ref_entry {
+  const char *name;
+  long id;
+  int pos;
+};
+
+static int ref_cmp_name(const void *a, const void *b)
+{
+  const struct ref_entry *x = a, *y = b;
+  int r = str_cmp(x->name, y->name);
+
+  return (r ? r : x->pos - y->pos);
+}
+
+static int ref_cmp_id(const void *a, const void *b)
+{
+  const struct ref_entry *x = a, *y = b;
+
+  if (x->id != y->id)
+    return (x->id < y->id ? -1 : 1);
+  return (x->pos - y->pos);
+}
+
+/** Look up every entry, in the case a player would type it, and a few keys
+ * that are not there, both ways.  What the table walk would give comes from
+ * copies of the table sorted by name and by id: the first of a run of equal
+ * keys is the lowest position, the one the walk finds. */
+static void check_lookups(const char *when)
+{
+  struct ref_entry *by_name, *by_id;
+  char name[MAX_NAME_LENGTH + 20];
+  int i, n = top_of_p_table + 1;
+  long pos;
+
+  CREATE(by_name, struct ref_entry, n);
+  CREATE(by_id, struct ref_entry, n);
+  for (i = 0; i < n; i++) {
+    by_name[i].name = by_id[i].name = player_table[i].name;
+    by_name[i].id = by_id[i].id = player_table[i].id;
+    by_name[i].pos = by_id[i].pos = i;
+  }
+  qsort(by_name, n, sizeof(*by_name), ref_cmp_name);
+  qsort(by_id, n, sizeof(*by_id), ref_cmp_id);
+
+  for (i = 0; i < n; i++) {
+    if (i && !str_cmp(by_name[i].name, by_name[i - 1].name))
+      continue;
+    snprintf(name, sizeof(name), "%s", by_name[i].name);
+    *name = UPPER(*name);
+    if ((pos = get_ptable_by_name(name)) != by_name[i].pos)
+      CHECK_FAIL("%s: name %s at %ld, table walk says %d", when, name, pos, by_name[i].pos);
+    else if (get_id_by_name(name) != by_name[i].id)
+      CHECK_FAIL("%s: get_id_by_name(%s) is wrong", when, name);
+  }
+  for (i = 0; i < n; i++) {
+    if (i && by_id[i].id == by_id[i - 1].id)
+      continue;
+    if ((pos = get_ptable_by_id(by_id[i].id)) != by_id[i].pos)
+      CHECK_FAIL("%s: id %ld at %ld, table walk says %d", when, by_id[i].id, pos, by_id[i].pos);
+    else if (str_cmp(get_name_by_id(by_id[i].id), by_id[i].name))
+      CHECK_FAIL("%s: get_name_by_id(%ld) is wrong", when, by_id[i].id);
+  }
+  if (get_ptable_by_name("nobodyhere") != -1 || get_ptable_by_id(-5) != -1 || get_name_by_id(top_idnum + 1))
+    CHECK_FAIL("%s: found a key that is not there", when);
+  printf("  %s: %d entries, lookups agree with the table walk\n", when, n);
+  free(by_name);
+  free(by_id);
+}
+
+int main(int argc, char **argv)
+{
+  int n, i, pos, lookups = 2000;
+  char name[MAX_NAME_LENGTH + 20];
+  double t;
+
+  n = check_start(argc, argv, 100000);
+  circle_srandom(16);
+  check_config();
+  write_index(n);
+
+  t = check_now();
+  build_player_index();
+  printf("build_player_index() on %d entries: %.1f ms\n", top_of_p_table + 1, (check_now() - t) * 1e3);
+  check_lookups("after loading");
+
+  /* New characters, enough to make the indexes grow. */
+  for (i = 0; i < NEW_ENTRIES; i++) {
+    snprintf(name, sizeof(name), "Newbie%d", i);
+    pos = create_entry(name);
+    player_table[pos].id = ++top_idnum;
+    index_player_id(pos);
+  }
+  check_lookups("after new characters");
+
+  remove_player(5);
+  remove_player(top_of_p_table / 2);
+  check_lookups("after deletions");
+
+  pos = get_ptable_by_name("newbie7");
+  free(player_table[pos].name);
+  player_table[pos].name = strdup("renamedguy");
+  index_player_name(pos);
+  if (get_ptable_by_name("RenamedGuy") != pos || get_ptable_by_name("newbie7") != -1)
+    CHECK_FAIL("after a rename: new name at %ld, old name at %ld",
+      get_ptable_by_name("RenamedGuy"), get_ptable_by_name("newbie7"));
+  check_lookups("after a rename");
+
+  /* Timing: one hit and one miss per name lookup. */
+  t = check_now();
+  for (i = 0; i < lookups; i++)
+    sink += ref_by_name(player_table[(i * 37) % top_of_p_table].name) + ref_by_name("missing");
+  printf("  by name, table walk: %8.3f us\n", (check_now() - t) * 1e6 / (2 * lookups));
+  t = check_now();
+  for (i = 0; i < lookups * 100; i++)
+    sink += get_ptable_by_name(player_table[(i * 37) % top_of_p_table].name) + get_ptable_by_name("missing");
+  printf("  by name, index:      %8.3f us\n", (check_now() - t) * 1e6 / (200 * lookups));
+  t = check_now();
+  for (i = 0; i < lookups; i++)
+    sink += ref_by_id(player_table[(i * 37) % top_of_p_table].id);
+  printf("  by id, table walk:   %8.3f us\n", (check_now() - t) * 1e6 / lookups);
+  t = check_now();
+  for (i = 0; i < lookups * 100; i++)
+    sink += get_ptable_by_id(player_table[(i * 37) % top_of_p_table].id);
+  printf("  by id, index:        %8.3f us\n", (check_now() - t) * 1e6 / (100 * lookups));
+
+  return (check_end());
+}
@@ -0,0 +1,420 @@
+/**
+* @file resolver.c
+* Check and time the host name resolver (resolver.c) with a stub backend.
+*
+* Part of the core altMUD source code distribution, which is a derivative
+* of, and continuation of, CircleMUD.
+*
+* All rights reserved.  See license for complete information.
+*
+* A stub name server, installed with resolver_set_backend(), knows a few
+* made up sites and can be held to keep lookups pending.  Descriptors are
+* looked up first from the game loop, before resolver_init(), to check the
+* cache: names and "no name" answers are reused until their TTLs run out on
+* a clock the check winds forward.  Then with the resolver threads running,
+* a second descriptor joins a pending lookup, and names that turn out to be
+* site banned come in for descriptors at the name prompt, making a new
+* character and playing; the late ban must close those it applies to, and
+* the 'recent' entry and the player's host must be given the name.  Then
+* lookups against a slow stub are timed from the game loop's side.
+*/
+
+#include "conf.h"
+#include "sysdep.h"
+#include "structs.h"
+#include "utils.h"
+#include "comm.h"
+#include "db.h"
+#include "ban.h"
+#include "act.h"
+#include "protocol.h"
+#include "resolver.h"
+#include "check.h"
+#ifdef CIRCLE_RESOLVER_THREAD
+#include <pthread.h>
+#endif
+
+#define ADDR(a, b, c, d)  ((unsigned long) (a) << 24 | (b) << 16 | (c) << 8 | (d))
+
+/** The stub's sites.  Anything else in 10.1/16 is named for its address,
+ * and anything else at all has no name. */
+static struct {
+  unsigned long ip;
+  const char *name;
+} sites[] = {
+  { ADDR(10, 2, 0, 1), "gate.evil.example.net" },
+  { ADDR(10, 2, 0, 2), "dial.newbie.example.net" },
+  { ADDR(10, 2, 0, 3), "pc1.picky.example.net" },
+  { ADDR(10, 2, 0, 4), "pc2.picky.example.net" },
+  { ADDR(10, 2, 0, 5), "home.example.org" },
+};
+
+#define NUM_SITES  (int) (sizeof(sites) / sizeof(sites[0]))
+
+static int stub_calls = 0;    /**< Lookups the stub has been asked for. */
+static int stub_usec = 0;     /**< How long each one takes. */
+#ifdef CIRCLE_RESOLVER_THREAD
+static pthread_mutex_t stub_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t stub_open = PTHREAD_COND_INITIALIZER;
+static bool stub_held = FALSE;  /**< Lookups wait until this is cleared. */
+#endif
+
+static time_t clock_offset = 0;  /**< How far the clock has been wound on. */
+
+/** The game's clock, which this check can wind forward past the resolver's
+ * TTLs.  It stands in for the C library's for everything linked in. */
+time_t time(time_t *t)
+{
+  struct timeval now;
+
+  gettimeofday(&now, NULL);
+  if (t)
+    *t = now.tv_sec + clock_offset;
+  return (now.tv_sec + clock_offset);
+}
+
+/** The stub name server.  It is called from the resolver threads. */
+static int stub(struct in_addr addr, char *name, size_t len)
+{
+  unsigned long ip = ntohl(addr.s_addr);
+  int i, usec;
+
+#ifdef CIRCLE_RESOLVER_THREAD
+  pthread_mutex_lock(&stub_lock);
+  stub_calls++;
+  while (stub_held)
+    pthread_cond_wait(&stub_open, &stub_lock);
+  usec = stub_usec;
+  pthread_mutex_unlock(&stub_lock);
+#else
+  stub_calls++;
+  usec = stub_usec;
+#endif
+  if (usec)
+    usleep(usec);
+
+  for (i = 0; i < NUM_SITES; i++)
+    if (sites[i].ip == ip) {
+      snprintf(name, len, "%s", sites[i].name);
+      return (TRUE);
+    }
+  if ((ip >> 16) == ADDR(0, 0, 10, 1)) {
+    snprintf(name, len, "host-%lu-%lu.example.com", (ip >> 8) & 0xFF, ip & 0xFF);
+    return (TRUE);
+  }
+  return (FALSE);
+}
+
+static int calls(void)
+{
+  int n;
+
+#ifdef CIRCLE_RESOLVER_THREAD
+  pthread_mutex_lock(&stub_lock);
+  n = stub_calls;
+  pthread_mutex_unlock(&stub_lock);
+#else
+  n = stub_calls;
+#endif
+  return (n);
+}
+
+#ifdef CIRCLE_RESOLVER_THREAD
+static void hold(bool held)
+{
+  pthread_mutex_lock(&stub_lock);
+  stub_held = held;
+  pthread_cond_broadcast(&stub_open);
+  pthread_mutex_unlock(&stub_lock);
+}
+#endif
+
+/** A new connection from ip, in the given state, as new_descriptor() makes
+ * it: its numeric address as its host.  Output goes to /dev/null once read. */
+static struct descriptor_data *new_connection(unsigned long ip, int state)
+{
+  struct descriptor_data *d;
+
+  CREATE(d, struct descriptor_data, 1);
+  if ((d->descriptor = open("/dev/null", O_WRONLY)) < 0) {
+    perror("check: /dev/null");
+    exit(1);
+  }
+  d->reactor_slot = -1;
+  d->pProtocol = ProtocolCreate();
+  d->addr.s_addr = htonl(ip);
+  strcpy(d->host, inet_ntoa(d->addr));
+  STATE(d) = state;
+  d->next = descriptor_list;
+  descriptor_list = d;
+  return (d);
+}
+
+/** A new connection, with its lookup asked for. */
+static struct descriptor_data *connect_from(unsigned long ip, int state)
+{
+  struct descriptor_data *d = new_connection(ip, state);
+
+  resolver_lookup(d);
+  return (d);
+}
+
+/** Give d a character, as the login has by the time of its state. */
+static struct char_data *log_in(struct descriptor_data *d, const char *name)
+{
+  struct char_data *ch;
+
+  CREATE(ch, struct char_data, 1);
+  clear_char(ch);
+  CREATE(ch->player_specials, struct player_special_data, 1);
+  ch->player.name = strdup(name);
+  GET_LEVEL(ch) = LVL_GRGOD;
+  GET_HOST(ch) = strdup(d->host);
+  ch->desc = d;
+  d->character = ch;
+  return (ch);
+}
+
+/** What d has queued to send. */
+static void queued(struct descriptor_data *d, char *buf, size_t size)
+{
+  struct out_block *blk;
+  size_t len = 0, n;
+  int off;
+
+  for (off = d->output.head_off, blk = d->output.head; blk && len < size - 1; off = 0, blk = blk->next) {
+    n = MIN(size - 1 - len, (size_t) (blk->len - off));
+    memcpy(buf + len, blk->text + off, n);
+    len += n;
+  }
+  buf[len] = '\0';
+}
+
+/** A number from 'show resolver', by the text before it. */
+static unsigned long resolver_stat(const char *after)
+{
+  char buf[MAX_STRING_LENGTH], *p;
+
+  print_resolver_stats(buf, sizeof(buf));
+  if (!(p = strstr(buf, after))) {
+    CHECK_FAIL("no \"%s\" in the resolver's stats", after);
+    return (0);
+  }
+  return (strtoul(p + strlen(after), NULL, 10));
+}
+
+static void check_host(const char *what, struct descriptor_data *d, const char *want)
+{
+  if (strcmp(d->host, want))
+    CHECK_FAIL("%s: host is %s, not %s", what, d->host, want);
+}
+
+static void check_calls(const char *what, int want)
+{
+  if (calls() != want)
+    CHECK_FAIL("%s: the stub was asked %d times, not %d", what, calls(), want);
+}
+
+#ifdef CIRCLE_RESOLVER_THREAD
+/** Pulse until none of the descriptors is waiting for a name. */
+static double wait_for(struct descriptor_data **ds, int num)
+{
+  double t, busy = 0, start = check_now();
+  int i, waiting;
+
+  do {
+    t = check_now();
+    resolver_pulse();
+    busy += check_now() - t;
+    for (waiting = i = 0; i < num; i++)
+      if (ds[i]->resolving)
+        waiting++;
+    if (waiting)
+      usleep(1000);
+  } while (waiting && check_now() - start < 10);
+  if (waiting)
+    CHECK_FAIL("%d of %d lookups never came back", waiting, num);
+  return (busy);
+}
+#endif
+
+/** Lookups made from the game loop, before there are resolver threads. */
+static void check_cache(void)
+{
+  struct descriptor_data *d;
+  int n;
+
+  d = connect_from(ADDR(10, 1, 0, 7), CON_GET_NAME);
+  check_host("first lookup", d, "host-0-7.example.com");
+  check_calls("first lookup", 1);
+  d = connect_from(ADDR(10, 1, 0, 7), CON_GET_NAME);
+  check_host("cached name", d, "host-0-7.example.com");
+  check_calls("cached name", 1);
+
+  d = connect_from(ADDR(10, 3, 0, 1), CON_GET_NAME);
+  check_host("no name", d, "10.3.0.1");
+  check_calls("no name", 2);
+  d = connect_from(ADDR(10, 3, 0, 1), CON_GET_NAME);
+  check_host("cached no name", d, "10.3.0.1");
+  check_calls("cached no name", 2);
+  if (resolver_stat("Connections            : ") != 4 || resolver_stat("Lookups                : ") != 1)
+    CHECK_FAIL("the stats don't show 4 connections and 1 name found");
+  printf("  names and no names cached: 4 connections, 2 lookups\n");
+
+  /* Past the fail TTL the address is asked about again, and the name is
+   * still good. */
+  clock_offset += RESOLVER_FAIL_TTL + 1;
+  d = connect_from(ADDR(10, 3, 0, 1), CON_GET_NAME);
+  check_calls("no name, after its TTL", 3);
+  d = connect_from(ADDR(10, 1, 0, 7), CON_GET_NAME);
+  check_host("name, after the fail TTL", d, "host-0-7.example.com");
+  check_calls("name, after the fail TTL", 3);
+
+  clock_offset += RESOLVER_CACHE_TTL;
+  d = connect_from(ADDR(10, 1, 0, 7), CON_GET_NAME);
+  check_host("name, after its TTL", d, "host-0-7.example.com");
+  check_calls("name, after its TTL", 4);
+
+  /* And forgotten once stale. */
+  clock_offset += RESOLVER_CACHE_TTL + 1;
+  resolver_pulse();
+  if ((n = resolver_stat("Cached addresses       : ")) != 0)
+    CHECK_FAIL("%d addresses still cached after their TTLs", n);
+  printf("  asked again after the fail TTL and then the name TTL, then forgotten\n");
+}
+
+#ifdef CIRCLE_RESOLVER_THREAD
+/** Lookups through the resolver threads, with bans on what they find. */
+static void check_threads(void)
+{
+  struct descriptor_data *ds[8], *viewer;
+  struct char_data *ch;
+  char buf[MAX_STRING_LENGTH * 4], *line;
+  int base, shared;
+  FILE *fl;
+
+  /* A second connection from an address being looked up waits on it. */
+  base = calls();
+  shared = resolver_stat("answered from the cache, ");
+  hold(TRUE);
+  ds[0] = connect_from(ADDR(10, 1, 0, 8), CON_GET_NAME);
+  ds[1] = connect_from(ADDR(10, 1, 0, 8), CON_GET_NAME);
+  if (!ds[0]->resolving || !ds[1]->resolving)
+    CHECK_FAIL("held lookups are not pending");
+  check_host("pending lookup", ds[1], "10.1.0.8");
+  if (resolver_stat("answered from the cache, ") != shared + 1)
+    CHECK_FAIL("the second connection did not join the first's lookup");
+  hold(FALSE);
+  wait_for(ds, 2);
+  check_host("first of two", ds[0], "host-0-8.example.com");
+  check_host("joined lookup", ds[1], "host-0-8.example.com");
+  check_calls("joined lookup", base + 1);
+  printf("  two connections from one address: one lookup, both named\n");
+
+  /* Names that come in banned. */
+  if (!(fl = fopen(BAN_FILE, "w"))) {
+    perror("check: " BAN_FILE);
+    exit(1);
+  }
+  fprintf(fl, "all evil.example.net 1600000000 Checker\n");
+  fprintf(fl, "new newbie.example.net 1600000000 Checker\n");
+  fprintf(fl, "select picky.example.net 1600000000 Checker\n");
+  fclose(fl);
+  load_banned();
+
+  hold(TRUE);
+  ds[0] = connect_from(sites[0].ip, CON_GET_NAME);
+  ds[1] = connect_from(sites[1].ip, CON_QSEX);
+  log_in(ds[1], "Newbie");
+  ds[2] = connect_from(sites[1].ip, CON_GET_NAME);
+  ds[3] = connect_from(sites[2].ip, CON_PLAYING);
+  AddRecentPlayer(GET_NAME(log_in(ds[3], "Picky")), ds[3]->host, FALSE, FALSE);
+  ds[4] = connect_from(sites[3].ip, CON_PLAYING);
+  ch = log_in(ds[4], "Trusted");
+  SET_BIT_AR(PLR_FLAGS(ch), PLR_SITEOK);
+  AddRecentPlayer(GET_NAME(ch), ds[4]->host, FALSE, FALSE);
+  ds[5] = connect_from(sites[4].ip, CON_PLAYING);
+  AddRecentPlayer(GET_NAME(log_in(ds[5], "Homely")), ds[5]->host, FALSE, FALSE);
+  hold(FALSE);
+  wait_for(ds, 6);
+
+  if (STATE(ds[0]) != CON_CLOSE)
+    CHECK_FAIL("a connection named into a full ban was not closed");
+  queued(ds[1], buf, sizeof(buf));
+  if (STATE(ds[1]) != CON_CLOSE || !strstr(buf, "new characters are not allowed"))
+    CHECK_FAIL("a new character named into a new ban was not turned away");
+  if (STATE(ds[2]) == CON_CLOSE)
+    CHECK_FAIL("a connection at the name prompt was closed by a new ban");
+  queued(ds[3], buf, sizeof(buf));
+  if (STATE(ds[3]) != CON_CLOSE || !strstr(buf, "not been cleared for login"))
+    CHECK_FAIL("a player named into a select ban was not turned away");
+  if (STATE(ds[4]) == CON_CLOSE)
+    CHECK_FAIL("a site-ok player was closed by a select ban");
+  if (STATE(ds[5]) == CON_CLOSE)
+    CHECK_FAIL("a player from an unbanned site was closed");
+  if (strcmp(GET_HOST(ds[5]->character), sites[4].name))
+    CHECK_FAIL("the player's host is %s, not %s", GET_HOST(ds[5]->character), sites[4].name);
+  printf("  late bans: full, new and select closed their connections, and no others\n");
+
+  /* The 'recent' entries made against the addresses now have the names. */
+  viewer = connect_from(ADDR(10, 3, 0, 2), CON_PLAYING);
+  log_in(viewer, "Viewer");
+  *buf = '\0';
+  do_recent(viewer->character, buf, 0, 0);
+  queued(viewer, buf, sizeof(buf));
+  if (!(line = strstr(buf, "Homely")) || !strstr(buf, sites[4].name) || strstr(buf, "10.2.0.5"))
+    CHECK_FAIL("the recent entry for Homely does not have the name %s", sites[4].name);
+  if (!strstr(buf, sites[3].name) || strstr(buf, "10.2.0.4"))
+    CHECK_FAIL("the recent entry for Trusted does not have the name %s", sites[3].name);
+  printf("  recent entries given the names\n");
+}
+
+/** How long the game loop spends on lookups that take the stub a while. */
+static void time_lookups(int n)
+{
+  struct descriptor_data **ds;
+  double t, busy, wall;
+  int i;
+
+  CREATE(ds, struct descriptor_data *, n);
+  for (i = 0; i < n; i++)
+    ds[i] = new_connection(ADDR(10, 1, 1 + i / 250, i % 250), CON_GET_NAME);
+  stub_usec = 2000;
+  wall = t = check_now();
+  for (i = 0; i < n; i++)
+    resolver_lookup(ds[i]);
+  busy = check_now() - t;
+  busy += wait_for(ds, n);
+  wall = check_now() - wall;
+  printf("  %d lookups of 2 ms: game loop busy %.2f ms of %.0f ms, blocking would be %d ms\n",
+      n, busy * 1e3, wall * 1e3, n * 2);
+
+  t = check_now();
+  for (i = 0; i < n; i++)
+    resolver_lookup(ds[i]);
+  printf("  resolver_lookup(), cached:    %8.3f us\n", (check_now() - t) * 1e6 / n);
+  free(ds);
+}
+#endif
+
+int main(int argc, char **argv)
+{
+  int n;
+
+  n = check_start(argc, argv, 500);
+  check_config();
+  resolver_set_backend(stub);
+
+  printf("From the game loop:\n");
+  check_cache();
+
+#ifdef CIRCLE_RESOLVER_THREAD
+  printf("From %d resolver threads:\n", RESOLVER_THREADS);
+  resolver_init();
+  check_threads();
+  time_lookups(n);
+  resolver_shutdown();
+#endif
+
+  return (check_end());
+}
@@ -0,0 +1,304 @@
+/**
+* @file track.c
+* Check and time the track and hunt path search (graph.c).
+*
+* Part of the core altMUD source code distribution, which is a derivative
+* of, and continuation of, CircleMUD.
+*
+* All rights reserved.  See license for complete information.
+*
+* The world is replaced by a square grid of rooms, 16x16 to a zone, with a
+* tenth of the exits missing and a walled-in pocket no exit leads into.
+* find_first_step() is compared with a plain breadth-first search written
+* out here:
+*   - in breadth-first mode it must give the very direction the plain search
+*     does;
+*   - in bidirectional mode, and through the path cache, each step it gives
+*     must lie on a shortest path, and it must find no path exactly when
+*     there is none.
+* Hunts are then walked step by step, before and after exits are removed,
+* with the cache on.  Searches and hunts are timed with and without it.
+*/
+
+#include "conf.h"
+#include "sysdep.h"
+#include "structs.h"
+#include "utils.h"
+#include "comm.h"
+#include "db.h"
+#include "graph.h"
+#include "check.h"
+
+#define ZONE_SIDE 16   /**< Rooms along each side of a zone. */
+#define MAX_HUNT  40   /**< Steps a hunter takes before giving up. */
+
+static int side;
+static room_rnum *ref_queue, *ref_parent;
+static sbyte *ref_dir;
+static int *ref_dist;
+static unsigned int *ref_seen, ref_gen = 0;
+
+static const int grid_dx[4] = { 0, 1, 0, -1 };  /* NORTH, EAST, SOUTH, WEST */
+static const int grid_dy[4] = { -1, 0, 1, 0 };
+
+static room_rnum to_room(room_rnum r, int dir)
+{
+  if (!world[r].dir_option[dir])
+    return (NOWHERE);
+  return (world[r].dir_option[dir]->to_room);
+}
+
+/** Build the grid: each room links to its neighbours, except that a tenth of
+ * the exits are left out.  The last rooms form a pocket that leads out but
+ * that nothing leads into. */
+static void build_grid(int pocket)
+{
+  room_rnum r, to;
+  int x, y, dir, zones_across = (side + ZONE_SIDE - 1) / ZONE_SIDE;
+
+  top_of_world = side * side + pocket - 1;
+  CREATE(world, struct room_data, top_of_world + 1);
+  top_of_zone_table = zones_across * zones_across;  /* Plus one for the pocket. */
+  CREATE(zone_table, struct zone_data, top_of_zone_table + 1);
+
+  for (r = 0; r <= top_of_world; r++) {
+    world[r].number = r;
+    if (r >= side * side) {
+      world[r].zone = top_of_zone_table;
+      continue;
+    }
+    x = r % side;
+    y = r / side;
+    world[r].zone = (y / ZONE_SIDE) * zones_across + x / ZONE_SIDE;
+    for (dir = 0; dir < 4; dir++) {
+      if (x + grid_dx[dir] < 0 || x + grid_dx[dir] >= side ||
+          y + grid_dy[dir] < 0 || y + grid_dy[dir] >= side)
+        continue;
+      if (rand_number(0, 9) == 0)
+        continue;
+      CREATE(world[r].dir_option[dir], struct room_direction_data, 1);
+      world[r].dir_option[dir]->to_room = (y + grid_dy[dir]) * side + x + grid_dx[dir];
+    }
+  }
+
+  /* The pocket: a corridor of rooms, the first of which leads east into the
+   * grid, with nothing leading back. */
+  for (r = side * side; r <= top_of_world; r++) {
+    to = (r == side * side) ? 0 : r - 1;
+    CREATE(world[r].dir_option[EAST], struct room_direction_data, 1);
+    world[r].dir_option[EAST]->to_room = to;
+  }
+}
+
+static void ref_mark(room_rnum r)
+{
+  ref_seen[r] = ref_gen;
+}
+
+/** The search find_first_step() did before it was reworked: breadth-first
+ * from src, trying directions in order, stopping when target is reached, and
+ * keeping to the same exits. */
+static int ref_first_step(room_rnum src, room_rnum target)
+{
+  int head = 0, tail = 0, dir;
+  room_rnum r, to;
+
+  if (src == target)
+    return (BFS_ALREADY_THERE);
+  ref_gen++;
+  ref_mark(src);
+  ref_queue[tail++] = src;
+  while (head < tail) {
+    r = ref_queue[head++];
+    for (dir = 0; dir < NUM_OF_DIRS; dir++) {
+      if ((to = to_room(r, dir)) == NOWHERE || ref_seen[to] == ref_gen)
+        continue;
+      if (!CONFIG_TRACK_T_DOORS && EXIT_FLAGGED(world[r].dir_option[dir], EX_CLOSED))
+        continue;
+      if (ROOM_FLAGGED(to, ROOM_NOTRACK))
+        continue;
+      ref_mark(to);
+      ref_parent[to] = r;
+      ref_dir[to] = dir;
+      if (to == target) {
+        for (; ref_parent[to] != src; to = ref_parent[to])
+          ;
+        return (ref_dir[to]);
+      }
+      ref_queue[tail++] = to;
+    }
+  }
+  return (BFS_NO_PATH);
+}
+
+/** Fill ref_dist with every room's distance to target, -1 if it has none. */
+static void ref_distances(room_rnum target)
+{
+  int head = 0, tail = 0, dir;
+  room_rnum r, from;
+
+  for (r = 0; r <= top_of_world; r++)
+    ref_dist[r] = -1;
+  ref_dist[target] = 0;
+  ref_queue[tail++] = target;
+  /* Exits into a grid room can only come from its neighbours; exits into
+   * the pocket's rooms come from the next pocket room along. */
+  while (head < tail) {
+    r = ref_queue[head++];
+    for (from = side * side; from <= top_of_world; from++)
+      if (to_room(from, EAST) == r && ref_dist[from] < 0) {
+        ref_dist[from] = ref_dist[r] + 1;
+        ref_queue[tail++] = from;
+      }
+    if (r >= side * side)
+      continue;
+    for (dir = 0; dir < 4; dir++) {
+      int x = r % side - grid_dx[dir], y = r / side - grid_dy[dir];
+
+      if (x < 0 || x >= side || y < 0 || y >= side)
+        continue;
+      from = y * side + x;
+      if (to_room(from, dir) == r && ref_dist[from] < 0) {
+        ref_dist[from] = ref_dist[r] + 1;
+        ref_queue[tail++] = from;
+      }
+    }
+  }
+}
+
+/** Check one step against ref_dist, which must be for target. */
+static void check_step(room_rnum src, room_rnum target, int dir, const char *how)
+{
+  room_rnum to;
+
+  if (ref_dist[src] < 0) {
+    if (dir != BFS_NO_PATH)
+      CHECK_FAIL("%s: %d -> %d has no path, got %d", how, src, target, dir);
+    return;
+  }
+  if (src == target) {
+    if (dir != BFS_ALREADY_THERE)
+      CHECK_FAIL("%s: %d -> %d is already there, got %d", how, src, target, dir);
+    return;
+  }
+  if (dir < 0 || dir >= NUM_OF_DIRS || (to = to_room(src, dir)) == NOWHERE)
+    CHECK_FAIL("%s: %d -> %d gave %d, not an exit", how, src, target, dir);
+  else if (ref_dist[to] != ref_dist[src] - 1)
+    CHECK_FAIL("%s: %d -> %d stepped %d, off the shortest path", how, src, target, dir);
+}
+
+/** Walk from src toward target the way a hunter does, checking each step.
+ * @retval int The number of searches made. */
+static int hunt(room_rnum src, room_rnum target, bool check)
+{
+  int steps, dir;
+
+  for (steps = 0; steps < MAX_HUNT; steps++) {
+    dir = find_first_step(src, target);
+    if (check)
+      check_step(src, target, dir, "hunt");
+    if (dir < 0)
+      return (steps + 1);
+    src = to_room(src, dir);
+  }
+  return (steps);
+}
+
+static room_rnum random_room(void)
+{
+  return (rand_number(0, top_of_world));
+}
+
+int main(int argc, char **argv)
+{
+  int pairs, i, calls, dir;
+  room_rnum *src, *dst, r;
+  double t;
+
+  side = check_start(argc, argv, 60);
+  pairs = 1000;
+  circle_srandom(7);
+  check_config();
+  build_grid(8);
+
+  CREATE(ref_queue, room_rnum, top_of_world + 1);
+  CREATE(ref_parent, room_rnum, top_of_world + 1);
+  CREATE(ref_dir, sbyte, top_of_world + 1);
+  CREATE(ref_dist, int, top_of_world + 1);
+  CREATE(ref_seen, unsigned int, top_of_world + 1);
+  CREATE(src, room_rnum, pairs);
+  CREATE(dst, room_rnum, pairs);
+  for (i = 0; i < pairs; i++) {
+    src[i] = random_room();
+    dst[i] = i % 20 ? random_room() : top_of_world - rand_number(0, 7);
+  }
+  dst[0] = src[0];
+  printf("%d rooms in a %dx%d grid, %d pairs:\n", top_of_world + 1, side, side, pairs);
+
+  CONFIG_TRACK_T_DOORS = TRUE;
+  CONFIG_TRACK_CACHE = FALSE;
+  build_zone_graph();
+
+  /* Breadth-first: the same direction as the plain search. */
+  CONFIG_TRACK_SEARCH = TRACK_SEARCH_BFS;
+  for (i = 0; i < pairs; i++)
+    if ((dir = find_first_step(src[i], dst[i])) != ref_first_step(src[i], dst[i]))
+      CHECK_FAIL("bfs: %d -> %d gave %d, plain search %d", src[i], dst[i], dir, ref_first_step(src[i], dst[i]));
+
+  /* Bidirectional, and cached hunts: a step along some shortest path. */
+  for (i = 0; i < pairs; i++) {
+    ref_distances(dst[i]);
+    CONFIG_TRACK_SEARCH = TRACK_SEARCH_BIDIR;
+    CONFIG_TRACK_CACHE = FALSE;
+    check_step(src[i], dst[i], find_first_step(src[i], dst[i]), "bidir");
+    CONFIG_TRACK_CACHE = TRUE;
+    hunt(src[i], dst[i], TRUE);
+    CONFIG_TRACK_SEARCH = TRACK_SEARCH_BFS;
+    hunt(random_room(), dst[i], TRUE);
+  }
+
+  /* Take exits away; the cache must not remember paths through them. */
+  for (i = 0; i < (top_of_world + 1) / 20; i++) {
+    r = rand_number(0, side * side - 1);
+    dir = rand_number(0, 3);
+    if (world[r].dir_option[dir]) {
+      free(world[r].dir_option[dir]);
+      world[r].dir_option[dir] = NULL;
+    }
+  }
+  invalidate_path_cache();
+  CONFIG_TRACK_SEARCH = TRACK_SEARCH_BIDIR;
+  for (i = 0; i < pairs; i++) {
+    ref_distances(dst[i]);
+    hunt(src[i], dst[i], TRUE);
+  }
+  printf("  directions checked against a plain breadth-first search\n");
+
+  /* Timing. */
+  CONFIG_TRACK_CACHE = FALSE;
+  CONFIG_TRACK_SEARCH = TRACK_SEARCH_BFS;
+  t = check_now();
+  for (i = 0; i < pairs; i++)
+    ref_first_step(src[i], dst[i]);
+  printf("  one search, reference:      %7.3f ms\n", (check_now() - t) * 1e3 / pairs);
+  t = check_now();
+  for (i = 0; i < pairs; i++)
+    find_first_step(src[i], dst[i]);
+  printf("  one search, breadth-first:  %7.3f ms\n", (check_now() - t) * 1e3 / pairs);
+  CONFIG_TRACK_SEARCH = TRACK_SEARCH_BIDIR;
+  t = check_now();
+  for (i = 0; i < pairs; i++)
+    find_first_step(src[i], dst[i]);
+  printf("  one search, bidirectional:  %7.3f ms\n", (check_now() - t) * 1e3 / pairs);
+
+  for (dir = 0; dir < 2; dir++) {
+    CONFIG_TRACK_CACHE = dir;
+    invalidate_path_cache();
+    t = check_now();
+    for (calls = i = 0; i < pairs; i++)
+      calls += hunt(src[i], dst[i], FALSE);
+    printf("  hunts, cache %-3s (%d searches): %7.3f s\n", dir ? "on" : "off", calls, check_now() - t);
+  }
+
+  return (check_end());
+}
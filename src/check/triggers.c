@@ -0,0 +1,402 @@
+/**
+* @file triggers.c
+* Check and time the DG trigger interpreter (dg_scripts.c, dg_variables.c).
+*
+* Part of the core altMUD source code distribution, which is a derivative
+* of, and continuation of, CircleMUD.
+*
+* All rights reserved.  See license for complete information.
+*
+* Every trigger prototype in the world, plus the edge cases in triggers.trg,
+* is run through script_driver() on a fresh host and actor: by an NPC and by
+* a PC, with three random seeds each, and with its waits driven through the
+* event queue.  Each run is forked so that triggers cannot disturb each
+* other.  What a run did (the return value, the actor's room, gold, hit
+* points, position and output, the host's globals, and any log lines) is
+* folded into one digest per trigger and compared with triggers.sum.
+*
+* triggers.sum was written by this program built against the interpreter
+* as it was before the trigger lines were compiled, so a mismatch means a
+* trigger now behaves differently.
+*   check/triggers -w      prints the digests, to rewrite triggers.sum;
+*   check/triggers <vnum>  prints what the runs of one trigger did, to diff
+*                          against a build from before a change.
+*/
+
+#include "conf.h"
+#include "sysdep.h"
+#include "structs.h"
+#include "utils.h"
+#include "comm.h"
+#include "db.h"
+#include "handler.h"
+#include "dg_scripts.h"
+#include "dg_event.h"
+#include "protocol.h"
+#include "check.h"
+#include <sys/wait.h>
+
+#define CHECK_TRIGGERS "../triggers.trg"  /**< The edge cases, from lib/. */
+#define CHECK_SUMS     "../triggers.sum"  /**< The expected digests. */
+#define SEEDS          3                  /**< Runs per actor kind. */
+#define RUN_PULSES     3000               /**< Pulses given to waits. */
+
+/** Add the edge case triggers to the scratch world's trigger index. */
+static void install_triggers(void)
+{
+  FILE *in, *out;
+  char line[READ_SIZE];
+
+  if (!(in = fopen(CHECK_TRIGGERS, "r")) || !(out = fopen(TRG_PREFIX "check.trg", "w"))) {
+    perror("check: " CHECK_TRIGGERS);
+    exit(1);
+  }
+  while (fgets(line, sizeof(line), in))
+    fputs(line, out);
+  fclose(in);
+  fclose(out);
+
+  if (!(in = fopen(TRG_PREFIX INDEX_FILE, "r")) || !(out = fopen(TRG_PREFIX INDEX_FILE ".new", "w"))) {
+    perror("check: " TRG_PREFIX INDEX_FILE);
+    exit(1);
+  }
+  while (fgets(line, sizeof(line), in)) {
+    if (!strcmp(line, "check.trg\n"))
+      continue;
+    if (*line == '$')
+      fputs("check.trg\n", out);
+    fputs(line, out);
+  }
+  fclose(in);
+  fclose(out);
+  rename(TRG_PREFIX INDEX_FILE ".new", TRG_PREFIX INDEX_FILE);
+}
+
+static void print_vars(struct trig_var_data *v)
+{
+  for (; v; v = v->next)
+    printf("  global %s=%s (%ld)\n", v->name, v->value, v->context);
+}
+
+static void print_output(struct descriptor_data *d)
+{
+  struct out_block *b;
+  int off = d->output.head_off;
+
+  for (b = d->output.head; b; b = b->next, off = 0)
+    fwrite(b->text + off, 1, b->len - off, stdout);
+}
+
+/** Run trigger rn once, printing what it did.  Runs in its own process. */
+static void run_one(int rn, int pc, unsigned long seed)
+{
+  trig_data *proto = trig_index[rn]->proto, *t;
+  struct char_data *actor, *host_ch = NULL;
+  struct obj_data *host_obj, *thing;
+  struct room_data *host_room = NULL;
+  struct descriptor_data *d;
+  room_rnum room = 1;
+  long actor_id, host_id = 0;
+  char buf[MAX_INPUT_LENGTH];
+  void *go;
+  int ret, i;
+
+  circle_srandom(seed);
+
+  actor = read_mobile(real_mobile(1), REAL);
+  if (SCRIPT(actor))
+    extract_script(actor, MOB_TRIGGER);
+  if (pc) {
+    REMOVE_BIT_AR(MOB_FLAGS(actor), MOB_ISNPC);
+    CREATE(actor->player_specials, struct player_special_data, 1);
+    GET_LEVEL(actor) = 10;
+  }
+  CREATE(d, struct descriptor_data, 1);
+  d->reactor_slot = -1;
+  d->connected = CON_PLAYING;
+  d->pProtocol = ProtocolCreate();
+  d->character = actor;
+  actor->desc = d;
+  char_to_room(actor, room);
+  GET_GOLD(actor) = 1000;
+  thing = read_object(0, REAL);
+  obj_to_char(thing, actor);
+  actor_id = char_script_id(actor);
+
+  t = read_trigger(rn);
+  switch (proto->attach_type) {
+    case MOB_TRIGGER:
+      host_ch = read_mobile(real_mobile(2), REAL);
+      if (SCRIPT(host_ch))
+        extract_script(host_ch, MOB_TRIGGER);
+      char_to_room(host_ch, room);
+      SCRIPT(host_ch) = create_script(host_ch, MOB_TRIGGER);
+      add_trigger(SCRIPT(host_ch), t, -1);
+      go = host_ch;
+      host_id = char_script_id(host_ch);
+      break;
+    case OBJ_TRIGGER:
+      host_obj = read_object(1, REAL);
+      if (SCRIPT(host_obj))
+        extract_script(host_obj, OBJ_TRIGGER);
+      obj_to_char(host_obj, actor);
+      SCRIPT(host_obj) = create_script(host_obj, OBJ_TRIGGER);
+      add_trigger(SCRIPT(host_obj), t, -1);
+      go = host_obj;
+      break;
+    default:
+      host_room = &world[room];
+      if (SCRIPT(host_room))
+        extract_script(host_room, WLD_TRIGGER);
+      SCRIPT(host_room) = create_script(host_room, WLD_TRIGGER);
+      add_trigger(SCRIPT(host_room), t, -1);
+      go = host_room;
+      break;
+  }
+
+  ADD_UID_VAR(buf, t, actor_id, "actor", 0);
+  ADD_UID_VAR(buf, t, actor_id, "victim", 0);
+  ADD_UID_VAR(buf, t, obj_script_id(thing), "object", 0);
+  add_var(&GET_TRIG_VARS(t), "speech", "hello there friend", 0);
+  add_var(&GET_TRIG_VARS(t), "arg", proto->arglist ? proto->arglist : "", 0);
+  add_var(&GET_TRIG_VARS(t), "cmd", "look", 0);
+  add_var(&GET_TRIG_VARS(t), "direction", "north", 0);
+  add_var(&GET_TRIG_VARS(t), "amount", "25", 0);
+  add_var(&GET_TRIG_VARS(t), "damage", "5", 0);
+
+  printf("== trig %d %s seed %lu\n", trig_index[rn]->vnum, pc ? "pc" : "npc", seed);
+  ret = script_driver(&go, t, proto->attach_type, TRIG_NEW);
+  printf("  ret %d\n", ret);
+  for (i = 0; i < RUN_PULSES; i++) {
+    pulse++;
+    event_process();
+  }
+
+  if ((actor = find_char(actor_id)) && actor->desc) {
+    printf("  actor room %d gold %d hit %d pos %d\n  output:\n",
+      GET_ROOM_VNUM(IN_ROOM(actor)), GET_GOLD(actor), GET_HIT(actor), GET_POS(actor));
+    print_output(actor->desc);
+    printf("\n");
+  } else
+    printf("  actor gone\n");
+  if (proto->attach_type == MOB_TRIGGER && (host_ch = find_char(host_id)) && SCRIPT(host_ch))
+    print_vars(SCRIPT(host_ch)->global_vars.head);
+  else if (proto->attach_type == WLD_TRIGGER && SCRIPT(host_room))
+    print_vars(SCRIPT(host_room)->global_vars.head);
+  fflush(stdout);
+}
+
+/** Drop what a log line says about where in the source it was written: the
+ * time stamp, and the line number in "at file.c:123".
+ * @retval char * The line, or NULL for one that is not compared: "'if'
+ * without 'end'" is now logged once when the trigger is compiled, rather
+ * than each time it runs. */
+static char *normalize(char *line)
+{
+  char *p, *q;
+
+  if (strstr(line, "has 'if' without 'end'"))
+    return (NULL);
+  if (strlen(line) > 24 && !strncmp(line + 20, " :: ", 4))
+    line += 24;
+  for (p = line; (p = strstr(p, ".c:")); ) {
+    for (p += 3, q = p; isdigit(*q); q++)
+      ;
+    memmove(p, q, strlen(q) + 1);
+  }
+  return (line);
+}
+
+/** Run every variant of trigger rn, each in a child, and fold what they did
+ * into a digest.
+ * @param show Also print it all.
+ * @retval unsigned long The digest. */
+static unsigned long run_trigger(int rn, bool show)
+{
+  unsigned long hash = 2166136261UL, seed;
+  char line[MAX_STRING_LENGTH], *p;
+  int pc, fds[2], status;
+  FILE *fl;
+  pid_t pid;
+
+  for (pc = 0; pc < 2; pc++)
+    for (seed = 1; seed <= SEEDS; seed++) {
+      if (pipe(fds) < 0 || (pid = fork()) < 0) {
+        perror("check: fork");
+        exit(1);
+      }
+      if (pid == 0) {
+        close(fds[0]);
+        dup2(fds[1], STDOUT_FILENO);
+        logfile = stdout;
+        alarm(10);
+        run_one(rn, pc, seed);
+        _exit(0);
+      }
+      close(fds[1]);
+      fl = fdopen(fds[0], "r");
+      while (fgets(line, sizeof(line), fl)) {
+        if (!(p = normalize(line)))
+          continue;
+        if (show)
+          fputs(p, stdout);
+        for (; *p; p++)
+          hash = (hash ^ (unsigned char) *p) * 16777619UL & 0xffffffffUL;
+      }
+      fclose(fl);
+      waitpid(pid, &status, 0);
+      if (!WIFEXITED(status)) {
+        if (show)
+          printf("  child died, signal %d\n", WTERMSIG(status));
+        hash = (hash ^ 0xdead) * 16777619UL & 0xffffffffUL;
+      }
+    }
+  return (hash);
+}
+
+/** Attach a trigger to room 1 for timing, running another there first.
+ * @param setup A trigger to run once before, or NOTHING. */
+static trig_data *bench_trigger(trig_vnum vnum, trig_vnum setup)
+{
+  void *go = &world[1];
+  trig_data *t;
+
+  if (!SCRIPT(&world[1]))
+    SCRIPT(&world[1]) = create_script(&world[1], WLD_TRIGGER);
+  if (setup != NOTHING) {
+    t = read_trigger(real_trigger(setup));
+    add_trigger(SCRIPT(&world[1]), t, -1);
+    script_driver(&go, t, WLD_TRIGGER, TRIG_NEW);
+  }
+  t = read_trigger(real_trigger(vnum));
+  add_trigger(SCRIPT(&world[1]), t, -1);
+  return (t);
+}
+
+/** Time runs of one trigger, in this process, on room 1.  The log is
+ * turned off, and the best of five batches is given.
+ * @param setup A trigger to run once before, or NOTHING. */
+static void time_trigger(trig_vnum vnum, trig_vnum setup, int runs)
+{
+  struct char_data *mob = read_mobile(real_mobile(1), REAL);
+  void *go = &world[1];
+  char buf[MAX_INPUT_LENGTH];
+  FILE *real_log = logfile;
+  double start, best = 0;
+  trig_data *t;
+  int i, batch;
+
+  char_to_room(mob, 1);
+  if (!(logfile = fopen("/dev/null", "w")))
+    logfile = real_log;
+  t = bench_trigger(vnum, setup);
+  for (batch = 0; batch < 5; batch++) {
+    start = check_now();
+    for (i = 0; i < runs; i++) {
+      ADD_UID_VAR(buf, t, char_script_id(mob), "actor", 0);
+      script_driver(&go, t, WLD_TRIGGER, TRIG_NEW);
+    }
+    if (!batch || check_now() - start < best)
+      best = check_now() - start;
+  }
+  if (logfile != real_log)
+    fclose(logfile);
+  logfile = real_log;
+  extract_char(mob);
+  printf("  trigger %d: %.1f us per run\n", vnum, best * 1e6 / runs);
+}
+
+/** Time var_subst() alone on one line, with a number of locals set and
+ * the 60 globals of trigger 9200 on the room. */
+static void time_subst(int locals, int runs)
+{
+  char name[MAX_INPUT_LENGTH], value[MAX_INPUT_LENGTH], out[MAX_INPUT_LENGTH];
+  char line[] = "%echo% %local_1% %quest_var_60% %quest_var_1% %local_7% %self.quest_var_30% %nosuch%";
+  double start, best = 0;
+  trig_data *t;
+  int i, batch;
+
+  t = bench_trigger(9201, 9200);
+  for (i = 1; i <= locals; i++) {
+    snprintf(name, sizeof(name), "local_%d", i);
+    snprintf(value, sizeof(value), "%d", i);
+    add_var(&GET_TRIG_VARS(t), name, value, 0);
+  }
+  for (batch = 0; batch < 5; batch++) {
+    start = check_now();
+    for (i = 0; i < runs; i++)
+      var_subst(&world[1], SCRIPT(&world[1]), t, WLD_TRIGGER, line, out);
+    if (!batch || check_now() - start < best)
+      best = check_now() - start;
+  }
+  printf("  var_subst, %2d locals: %.3f us per line\n", locals, best * 1e6 / runs);
+}
+
+int main(int argc, char **argv)
+{
+  int rn, vnum, show = NOTHING, write_sums = FALSE, checked = 0;
+  unsigned long hash, want;
+  char line[READ_SIZE];
+  FILE *sums = NULL;
+  FILE *real_log;
+
+  if (argc > 1 && !strcmp(argv[1], "-w"))
+    write_sums = TRUE;
+  else if (argc > 1)
+    show = atoi(argv[1]);
+  check_start(1, argv, 0);
+  install_triggers();
+  check_boot();
+
+  /* Triggers that read the game clock must see the same time every run. */
+  time_info.hours = 12;
+  time_info.day = 14;
+  time_info.month = 6;
+  time_info.year = 650;
+  weather_info.sunlight = SUN_LIGHT;
+
+  real_log = logfile;
+  if (show != NOTHING) {
+    if ((rn = real_trigger(show)) == NOTHING) {
+      printf("No trigger %d.\n", show);
+      return (1);
+    }
+    printf("digest %08lx\n", run_trigger(rn, TRUE));
+    return (0);
+  }
+
+  if (!write_sums && !(sums = fopen(CHECK_SUMS, "r"))) {
+    perror("check: " CHECK_SUMS);
+    return (1);
+  }
+  if (!write_sums)
+    printf("Every trigger by an NPC and a PC, %d seeds each:\n", SEEDS);
+  for (rn = 0; rn < top_of_trigt; rn++) {
+    fflush(stdout);
+    hash = run_trigger(rn, FALSE);
+    logfile = real_log;
+    if (write_sums) {
+      printf("%d %08lx\n", trig_index[rn]->vnum, hash);
+      continue;
+    }
+    if (!fgets(line, sizeof(line), sums) || sscanf(line, "%d %lx", &vnum, &want) != 2)
+      CHECK_FAIL("trigger %d is not in " CHECK_SUMS, trig_index[rn]->vnum);
+    else if (vnum != trig_index[rn]->vnum)
+      CHECK_FAIL("trigger %d found where " CHECK_SUMS " has %d", trig_index[rn]->vnum, vnum);
+    else if (hash != want)
+      CHECK_FAIL("trigger %d behaves differently, see 'check/triggers %d'", vnum, vnum);
+    checked++;
+  }
+  if (write_sums)
+    return (0);
+  fclose(sums);
+  printf("  %d triggers replayed\n", checked);
+
+  time_trigger(9001, NOTHING, 1000);
+  time_trigger(9201, 9200, 1000);
+  time_subst(4, 100000);
+  time_subst(20, 100000);
+  time_subst(60, 100000);
+
+  return (check_end());
+}
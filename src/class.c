@@ -20,6 +20,7 @@
 #include "db.h"
 #include "spells.h"
 #include "interpreter.h"
+#include "handler.h"
 #include "constants.h"
 #include "act.h"
 #include "class.h"
@@ -583,6 +584,7 @@ void advance_level(struct char_data *ch)
   }
 
   snoop_check(ch);
+  update_zone_players(ch);
   save_char(ch);
 }
 
@@ -82,6 +82,11 @@
 #include "quest.h"
 #include "ibt.h" /* for free_ibt_lists */
 #include "mud_event.h"
+#include "reactor.h"
+#include "pool.h"
+#include "savequeue.h"
+#include "resolver.h"
+#include "mail.h"
 
 #ifndef INVALID_SOCKET
 #define INVALID_SOCKET (-1)
@@ -92,9 +97,11 @@ extern time_t newsmod;
 
 /* locally defined globals, used externally */
 struct descriptor_data *descriptor_list = NULL;   /* master desc list */
-int buf_largecount = 0;   /* # of large buffers which exist */
+int out_block_count = 0;  /* # of output blocks queued on descriptors */
+size_t out_queue_total = 0; /* bytes of output queued on all descriptors */
+long out_dropped = 0;     /* # of low priority lines dropped while backed up */
+long out_coalesced = 0;   /* # of repeated lines counted instead of queued */
 int buf_overflows = 0;    /* # of overflows of output */
-int buf_switches = 0;     /* # of switches from small to large buf */
 int circle_shutdown = 0;  /* clean shutdown */
 int circle_reboot = 0;    /* reboot the game after a shutdown */
 int no_specials = 0;      /* Suppress ass. of special routines */
@@ -108,7 +115,7 @@ int next_tick = SECS_PER_MUD_HOUR;  /* Tick countdown */
 long last_webster_teller = -1L;
 
 /* static local global variable declarations (current file scope only) */
-static struct txt_block *bufpool = 0;  /* pool of large output buffers */
+static struct mem_pool *out_block_pool = NULL; /* output queue blocks */
 static int max_players = 0;   /* max descriptors available */
 static int tics_passed = 0;     /* for extern checkpointing */
 static struct timeval null_time; /* zero-valued time structure */
@@ -118,6 +125,8 @@ static byte reread_wizlist;   /* signal: SIGUSR1 */
 static byte emergency_unban;
 */
 static int dg_act_check;         /* toggle for act_trigger */
+static int act_lowpri;           /* act() is sending TO_LOWPRI chatter */
+static int output_lowpri;        /* the text being written is chatter */
 static bool fCopyOver;          /* Are we booting in copyover mode? */
 static char *last_act_message = NULL;
 static byte webster_file_ready = FALSE;/* signal: SIGUSR2 */
@@ -132,8 +141,12 @@ static RETSIGTYPE checkpointing(int sig);
 static RETSIGTYPE hupsig(int sig);
 static ssize_t perform_socket_read(socket_t desc, char *read_point,size_t space_left);
 static ssize_t perform_socket_write(socket_t desc, const char *txt,size_t length);
+static ssize_t perform_socket_writev(socket_t desc, struct iovec *iov, int iovcnt);
 static void circle_sleep(struct timeval *timeout);
-static int get_from_q(struct txt_q *queue, char *dest, int *aliased);
+static int get_from_q(struct input_ring *queue, char *dest, int *aliased);
+static void ring_write(struct input_ring *q, int pos, const char *src, int len);
+static void ring_read(const struct input_ring *q, int pos, char *dest, int len);
+static void input_flood(struct descriptor_data *t);
 static void init_game(ush_int port);
 static void signal_setup(void);
 static socket_t init_socket(ush_int port);
@@ -144,17 +157,28 @@ static int process_input(struct descriptor_data *t);
 static void timediff(struct timeval *diff, struct timeval *a, struct timeval *b);
 static void timeadd(struct timeval *sum, struct timeval *a, struct timeval *b);
 static void flush_queues(struct descriptor_data *d);
+static void flush_input(struct input_ring *queue);
+static bool output_refused(struct descriptor_data *t);
+static void expand_act(const char *orig, struct char_data *ch, struct obj_data *obj,
+    void *vict_obj, struct char_data *to, char *lbuf, struct char_data **dg_victim,
+    struct obj_data **dg_target, char **dg_arg);
+static size_t write_output(struct descriptor_data *t, const char *out, int size, int truncated);
+static void queue_output(struct descriptor_data *t, const char *txt, size_t len);
+static void dequeue_output(struct out_queue *q, size_t len);
+static void flush_repeats(struct descriptor_data *t);
+static unsigned long output_hash(const char *txt, int len);
+static void snoop_output(struct descriptor_data *t, size_t len);
 static void nonblock(socket_t s);
 static int perform_subst(struct descriptor_data *t, char *orig, char *subst);
 static void record_usage(void);
 static char *make_prompt(struct descriptor_data *point);
 static void check_idle_passwords(void);
 static void init_descriptor (struct descriptor_data *newd, int desc);
+static int desc_has_work(struct descriptor_data *d);
 
 static struct in_addr *get_bind_addr(void);
 static int parse_ip(const char *addr, struct in_addr *inaddr);
 static int set_sendbuf(socket_t s);
-static void free_bufpool(void);
 static void setup_log(const char *filename, int fd);
 static int open_logfile(const char *filename, FILE *stderr_fp);
 #if defined(POSIX)
@@ -357,7 +381,6 @@ int main(int argc, char **argv)
 
   if (!scheck) {
     log("Clearing other memory.");
-    free_bufpool();         /* comm.c */
     free_player_index();    /* players.c */
     free_messages();        /* fight.c */
     free_text_files();      /* db.c */
@@ -373,6 +396,7 @@ int main(int argc, char **argv)
     free_recent_players();  /* act.informative.c */
     free_list(world_events); /* free up our global lists */
     free_list(global_lists);
+    free_pools();           /* pool.c */
   }
 
   if (last_act_message)
@@ -400,6 +424,8 @@ void copyover_recover()
   bool fOld;
   char name[MAX_INPUT_LENGTH];
   long pref;
+  struct sockaddr_in peer;
+  socklen_t len;
 
   log ("Copyover recovery initiated");
 
@@ -447,11 +473,20 @@ void copyover_recover()
     init_descriptor (d,desc); /* set up various stuff */
 
     strcpy(d->host, host);
+    /* the peer's address, for numeric site bans */
+    len = sizeof(peer);
+    if (getpeername(desc, (struct sockaddr *) &peer, &len) == 0)
+      d->addr = peer.sin_addr;
     d->next = descriptor_list;
     descriptor_list = d;
 
     d->connected = CON_CLOSE;
 
+    if (reactor_add(d) < 0) {
+      close_socket(d);
+      continue;
+    }
+
     CopyoverSet(d,guiopt);
 
     /* Now, find the pfile */
@@ -476,10 +511,10 @@ void copyover_recover()
 
     /* Player file not found?! */
     if (!fOld) {
-      write_to_descriptor (desc, "\n\rSomehow, your character was lost in the copyover. Sorry.\n\r");
+      ProtocolWrite (d, "\n\rSomehow, your character was lost in the copyover. Sorry.\n\r");
       close_socket (d);
     } else {
-      write_to_descriptor (desc, "\n\rCopyover recovery complete.\n\r");
+      ProtocolWrite (d, "\n\rCopyover recovery complete.\n\r");
       GET_PREF(d->character) = pref;
 
       enter_player_game(d);
@@ -518,8 +553,14 @@ static void init_game(ush_int local_port)
      mother_desc = init_socket (local_port);
   }
 
+  reactor_init(mother_desc);
+
   event_init();
 
+  savequeue_init();
+
+  resolver_init();
+
   /* set up hash table for find_char() */
   init_lookup_table();
 
@@ -547,10 +588,14 @@ static void init_game(ush_int local_port)
     close_socket(descriptor_list);
 
   CLOSE_SOCKET(mother_desc);
+  reactor_destroy();
 
   if (circle_reboot != 2)
     save_all();
 
+  savequeue_shutdown();
+  resolver_shutdown();
+
   log("Saving current MUD time.");
   save_mud_time(&time_info);
 
@@ -743,19 +788,18 @@ static int get_max_players(void)
  * such as mobile_activity(). */
 void game_loop(socket_t local_mother_desc)
 {
-  fd_set input_set, output_set, exc_set, null_set;
   struct timeval last_time, opt_time, process_time, temp_time;
   struct timeval before_sleep, now, timeout;
   char comm[MAX_INPUT_LENGTH];
-  struct descriptor_data *d, *next_d;
-  int missed_pulses, maxdesc, aliased;
+  struct descriptor_data *d;
+  int missed_pulses, aliased, i;
+  bool mother_ready;
 
   /* initialize various time values */
   null_time.tv_sec = 0;
   null_time.tv_usec = 0;
   opt_time.tv_usec = OPT_USEC;
   opt_time.tv_sec = 0;
-  FD_ZERO(&null_set);
 
   gettimeofday(&last_time, (struct timezone *) 0);
 
@@ -765,33 +809,15 @@ void game_loop(socket_t local_mother_desc)
     /* Sleep if we don't have any connections */
     if (descriptor_list == NULL) {
       log("No connections.  Going to sleep.");
-      FD_ZERO(&input_set);
-      FD_SET(local_mother_desc, &input_set);
-      if (select(local_mother_desc + 1, &input_set, (fd_set *) 0, (fd_set *) 0, NULL) < 0) {
+      if (reactor_poll(NULL, &mother_ready) < 0) {
 	if (errno == EINTR)
 	  log("Waking up to process signal.");
 	else
-	  perror("SYSERR: Select coma");
+	  perror("SYSERR: Reactor coma");
       } else
 	log("New connection.  Waking up.");
       gettimeofday(&last_time, (struct timezone *) 0);
     }
-    /* Set up the input, output, and exception sets for select(). */
-    FD_ZERO(&input_set);
-    FD_ZERO(&output_set);
-    FD_ZERO(&exc_set);
-    FD_SET(local_mother_desc, &input_set);
-
-    maxdesc = local_mother_desc;
-    for (d = descriptor_list; d; d = d->next) {
-#ifndef CIRCLE_WINDOWS
-      if (d->descriptor > maxdesc)
-	maxdesc = d->descriptor;
-#endif
-      FD_SET(d->descriptor, &input_set);
-      FD_SET(d->descriptor, &output_set);
-      FD_SET(d->descriptor, &exc_set);
-    }
 
     /* At this point, we have completed all input, output and heartbeat
      * activity from the previous iteration, so we have to put ourselves
@@ -827,40 +853,37 @@ void game_loop(socket_t local_mother_desc)
       timediff(&timeout, &last_time, &now);
     } while (timeout.tv_usec || timeout.tv_sec);
 
-    /* Poll (without blocking) for new input, output, and exceptions */
-    if (select(maxdesc + 1, &input_set, &output_set, &exc_set, &null_time) < 0) {
-      perror("SYSERR: Select poll");
+    /* Poll (without blocking) for new input, output, and exceptions.  Only
+     * the descriptors that are ready, plus those still carrying queued input,
+     * output, wait states or prompts from earlier passes, end up in the
+     * reactor's active set; everyone else is left alone this pass. */
+    if (reactor_poll(&null_time, &mother_ready) < 0 && errno != EINTR) {
+      perror("SYSERR: Reactor poll");
       return;
     }
     /* If there are new connections waiting, accept them. */
-    if (FD_ISSET(local_mother_desc, &input_set))
+    if (mother_ready)
       new_descriptor(local_mother_desc);
 
-    /* Kick out the freaky folks in the exception set and marked for close */
-    for (d = descriptor_list; d; d = next_d) {
-      next_d = d->next;
-      if (FD_ISSET(d->descriptor, &exc_set)) {
-        FD_CLR(d->descriptor, &input_set);
-	      FD_CLR(d->descriptor, &output_set);
-	      close_socket(d);
-      }
-    }
+    /* Kick out the freaky folks in the exception set */
+    for (i = 0; i < reactor_active_count(); i++)
+      if ((d = reactor_active(i)) && IS_SET(d->ready, RDY_EXCEPT))
+	close_socket(d);
 
     /* Process descriptors with input pending */
-    for (d = descriptor_list; d; d = next_d) {
-      next_d = d->next;
-      if (FD_ISSET(d->descriptor, &input_set))
-       {
-        if ( d->pProtocol != NULL )      /* KaVir's plugin */
-          d->pProtocol->WriteOOB = 0;    /* KaVir's plugin */
-	      if (process_input(d) < 0)
-	        close_socket(d);
-       }
+    for (i = 0; i < reactor_active_count(); i++) {
+      if (!(d = reactor_active(i)) || (!IS_SET(d->ready, RDY_READ) && !ProtocolInputPending(d)))
+        continue;
+      if ( d->pProtocol != NULL )      /* KaVir's plugin */
+        d->pProtocol->WriteOOB = 0;    /* KaVir's plugin */
+      if (process_input(d) < 0)
+        close_socket(d);
     }
 
     /* Process commands we just read from process_input */
-    for (d = descriptor_list; d; d = next_d) {
-      next_d = d->next;
+    for (i = 0; i < reactor_active_count(); i++) {
+      if (!(d = reactor_active(i)))
+        continue;
 
       /* Not combined to retain --(d->wait) behavior. -gg 2/20/98 If no wait
        * state, no subtraction.  If there is a wait state then 1 is subtracted.
@@ -905,32 +928,47 @@ void game_loop(socket_t local_mother_desc)
       }
     }
 
-    /* Send queued output out to the operating system (ultimately to user). */
-    for (d = descriptor_list; d; d = next_d) {
-      next_d = d->next;
-      if (*(d->output) && FD_ISSET(d->descriptor, &output_set)) {
-	/* Output for this player is ready */
-	if (process_output(d) < 0)
-	  close_socket(d);
-	else
-	  d->has_prompt = 1;
+    /* Send queued output out to the operating system (ultimately to user).
+     * A descriptor whose last write was cut short waits for RDY_WRITE. */
+    for (i = 0; i < reactor_active_count(); i++) {
+      if (!(d = reactor_active(i)))
+        continue;
+      if (d->want_write && !IS_SET(d->ready, RDY_WRITE))
+        continue;
+      if (!d->output.bytes) {
+        /* Compressed output the kernel had no room for last time. */
+        if (d->pProtocol->MCCPBufLen > 0) {
+          if (ProtocolFlush(d) < 0)
+            close_socket(d);
+          else
+            reactor_want_write(d, d->pProtocol->MCCPBufLen > 0);
+        }
+        continue;
       }
+      /* Output for this player is ready */
+      if (process_output(d) < 0)
+        close_socket(d);
+      else
+        d->has_prompt = 1;
     }
 
     /* Print prompts for other descriptors who had no other output */
-    for (d = descriptor_list; d; d = d->next) {
-      if (!d->has_prompt) {
-	      write_to_descriptor(d->descriptor, make_prompt(d));
-	      d->has_prompt = TRUE;
+    for (i = 0; i < reactor_active_count(); i++) {
+      if ((d = reactor_active(i)) && !d->has_prompt) {
+        ProtocolWrite(d, make_prompt(d));
+        d->has_prompt = TRUE;
+        if (d->pProtocol->MCCPBufLen > 0)
+          reactor_want_write(d, TRUE);
       }
     }
 
     /* Kick out folks in the CON_CLOSE or CON_DISCONNECT state */
-    for (d = descriptor_list; d; d = next_d) {
-      next_d = d->next;
-      if (STATE(d) == CON_CLOSE || STATE(d) == CON_DISCONNECT)
+    for (i = 0; i < reactor_active_count(); i++)
+      if ((d = reactor_active(i)) && (STATE(d) == CON_CLOSE || STATE(d) == CON_DISCONNECT))
 	close_socket(d);
-    }
+
+    /* Forget about everyone who has nothing left to do. */
+    reactor_settle(desc_has_work);
 
     /* Now, we execute as many pulses as necessary--just one if we haven't
      * missed any pulses, or make up for lost time if we missed a few
@@ -1017,10 +1055,13 @@ void heartbeat(int heart_pulse)
   if (CONFIG_AUTO_SAVE && !(heart_pulse % PULSE_AUTOSAVE)) {	/* 1 minute */
     if (++mins_since_crashsave >= CONFIG_AUTOSAVE_TIME) {
       mins_since_crashsave = 0;
-      Crash_save_all();
-      House_save_all();
+      autosave_start();
     }
   }
+  autosave_pulse();
+
+  /* Names looked up for new connections since the last pulse. */
+  resolver_pulse();
 
   if (!(heart_pulse % PULSE_USAGE))
     record_usage();
@@ -1028,6 +1069,9 @@ void heartbeat(int heart_pulse)
   if (!(heart_pulse % PULSE_TIMESAVE))
   save_mud_time(&time_info);
 
+  if (!(heart_pulse % PULSE_MAILCOMPACT))
+    mail_compact_pulse();
+
   /* Every pulse! Don't want them to stink the place up... */
   extract_pending_chars();
 }
@@ -1058,6 +1102,20 @@ static void timediff(struct timeval *rslt, struct timeval *a, struct timeval *b)
   }
 }
 
+/* Decides whether a descriptor stays in the reactor's active set for the next
+ * pass of game_loop() even if its socket has nothing new to report. */
+static int desc_has_work(struct descriptor_data *d)
+{
+  if (d->input.lines || !d->has_prompt || ProtocolInputPending(d))
+    return (TRUE);
+  if (d->output.bytes && !d->want_write)
+    return (TRUE);
+  if (d->character && GET_WAIT_STATE(d->character) > 0)
+    return (TRUE);
+
+  return (FALSE);
+}
+
 /* Add 2 time values.  Patch sent by "d. hall" to fix 'static' usage. */
 static void timeadd(struct timeval *rslt, struct timeval *a, struct timeval *b)
 {
@@ -1084,6 +1142,12 @@ static void record_usage(void)
   log("nusage: %-3d sockets connected, %-3d sockets playing",
 	  sockets_connected, sockets_playing);
 
+  if (mobiles_acted + mobiles_skipped > 0)
+    log("nusage: %ld mobile turns, %ld skipped in dormant zones (%ld%%)",
+        mobiles_acted + mobiles_skipped, mobiles_skipped,
+        mobiles_skipped * 100 / (mobiles_acted + mobiles_skipped));
+  mobiles_acted = mobiles_skipped = 0;
+
 #ifdef RUSAGE	/* Not RUSAGE_SELF because it doesn't guarantee prototype. */
   {
     struct rusage ru;
@@ -1231,59 +1295,119 @@ static char *make_prompt(struct descriptor_data *d)
   return (prompt);
 }
 
-/* NOTE: 'txt' must be at most MAX_INPUT_LENGTH big. */
-void write_to_q(const char *txt, struct txt_q *queue, int aliased)
+/* Copy 'len' bytes into an input ring at 'pos', wrapping at the end. */
+static void ring_write(struct input_ring *q, int pos, const char *src, int len)
 {
-  struct txt_block *newt;
+  int first = MIN(len, INPUT_RING_SIZE - pos);
 
-  CREATE(newt, struct txt_block, 1);
-  newt->text = strdup(txt);
-  newt->aliased = aliased;
+  memcpy(q->buf + pos, src, first);
+  memcpy(q->buf, src + first, len - first);
+}
 
-  /* queue empty? */
-  if (!queue->head) {
-    newt->next = NULL;
-    queue->head = queue->tail = newt;
-  } else {
-    queue->tail->next = newt;
-    queue->tail = newt;
-    newt->next = NULL;
-  }
+/* Copy 'len' bytes out of an input ring from 'pos', wrapping at the end. */
+static void ring_read(const struct input_ring *q, int pos, char *dest, int len)
+{
+  int first = MIN(len, INPUT_RING_SIZE - pos);
+
+  memcpy(dest, q->buf + pos, first);
+  memcpy(dest + first, q->buf, len - first);
+}
+
+/* Add a line to the end of an input queue.  Returns FALSE, and queues
+ * nothing, if the ring has no room for it.
+ * NOTE: 'txt' must be at most MAX_INPUT_LENGTH big. */
+int write_to_q(const char *txt, struct input_ring *queue, int aliased)
+{
+  char hdr[2];
+  int len = MIN(strlen(txt), MAX_INPUT_LENGTH - 1), tail;
+
+  if (queue->used + 2 + len > INPUT_RING_SIZE)
+    return (FALSE);
+
+  hdr[0] = len & 0xFF;
+  hdr[1] = (len >> 8) | (aliased ? 0x80 : 0);
+
+  tail = (queue->head + queue->used) % INPUT_RING_SIZE;
+  ring_write(queue, tail, hdr, 2);
+  ring_write(queue, (tail + 2) % INPUT_RING_SIZE, txt, len);
+  queue->used += 2 + len;
+  queue->lines++;
+
+  return (TRUE);
+}
+
+/* Put all the lines of 'lines', in order, in front of whatever is waiting in
+ * 'queue'.  Used to run alias expansions before the rest of the input.
+ * Returns FALSE, and moves nothing, if there isn't room. */
+int prepend_to_q(struct input_ring *queue, const struct input_ring *lines)
+{
+  int start, first;
+
+  if (queue->used + lines->used > INPUT_RING_SIZE)
+    return (FALSE);
+
+  /* The lines are position independent, so they move as one run of bytes. */
+  start = (queue->head - lines->used + INPUT_RING_SIZE) % INPUT_RING_SIZE;
+  first = MIN(lines->used, INPUT_RING_SIZE - lines->head);
+  ring_write(queue, start, lines->buf + lines->head, first);
+  ring_write(queue, (start + first) % INPUT_RING_SIZE, lines->buf, lines->used - first);
+
+  queue->head = start;
+  queue->used += lines->used;
+  queue->lines += lines->lines;
+
+  return (TRUE);
 }
 
 /* NOTE: 'dest' must be at least MAX_INPUT_LENGTH big. */
-static int get_from_q(struct txt_q *queue, char *dest, int *aliased)
+static int get_from_q(struct input_ring *queue, char *dest, int *aliased)
 {
-  struct txt_block *tmp;
+  unsigned char hdr[2];
+  int len;
 
   /* queue empty? */
-  if (!queue->head)
+  if (!queue->lines)
     return (0);
 
-  strcpy(dest, queue->head->text);	/* strcpy: OK (mutual MAX_INPUT_LENGTH) */
-  *aliased = queue->head->aliased;
+  ring_read(queue, queue->head, (char *) hdr, 2);
+  len = hdr[0] | ((hdr[1] & 0x7F) << 8);
+  *aliased = (hdr[1] & 0x80) != 0;
 
-  tmp = queue->head;
-  queue->head = queue->head->next;
-  free(tmp->text);
-  free(tmp);
+  ring_read(queue, (queue->head + 2) % INPUT_RING_SIZE, dest, len);
+  dest[len] = '\0';
+
+  queue->head = (queue->head + 2 + len) % INPUT_RING_SIZE;
+  queue->used -= 2 + len;
+  queue->lines--;
 
   return (1);
 }
 
+/* Drop every line waiting in an input queue. */
+static void flush_input(struct input_ring *queue)
+{
+  queue->head = queue->used = queue->lines = 0;
+}
+
 /* Empty the queues before closing connection */
 static void flush_queues(struct descriptor_data *d)
 {
-  if (d->large_outbuf) {
-    d->large_outbuf->next = bufpool;
-    bufpool = d->large_outbuf;
-  }
-  while (d->input.head) {
-    struct txt_block *tmp = d->input.head;
-    d->input.head = d->input.head->next;
-    free(tmp->text);
-    free(tmp);
-  }
+  dequeue_output(&d->output, d->output.bytes);
+  flush_input(&d->input);
+}
+
+/* More input came than a player could have meant to type; what didn't fit
+ * is dropped.  Say so once per flood, to the player and the immortals. */
+static void input_flood(struct descriptor_data *t)
+{
+  if (t->input_flooded)
+    return;
+
+  t->input_flooded = TRUE;
+  write_to_output(t, "Input flood!  Commands beyond the first %d waiting were dropped.\r\n", t->input.lines);
+  mudlog(BRF, t->character ? MAX(LVL_IMMORT, GET_INVIS_LEV(t->character)) : LVL_IMMORT, TRUE,
+    "Input flood from %s [%s]: %d lines queued, the rest dropped.",
+    t->character ? GET_NAME(t->character) : "<unknown>", t->host, t->input.lines);
 }
 
 /* Add a new string to a player's output queue. For outside use. */
@@ -1302,82 +1426,180 @@ size_t write_to_output(struct descriptor_data *t, const char *txt, ...)
 /* Add a new string to a player's output queue. */
 size_t vwrite_to_output(struct descriptor_data *t, const char *format, va_list args)
 {
-  const char *text_overflow = "\r\nOVERFLOW\r\n";
   static char txt[MAX_STRING_LENGTH];
-  size_t wantsize;
-  int size;
+  const char *out;
+  int size, truncated;
 
-  /* if we're in the overflow state already, ignore this new output */
-  if (t->bufspace == 0)
+  if (output_refused(t))
     return (0);
 
-  wantsize = size = vsnprintf(txt, sizeof(txt), format, args);
+  size = vsnprintf(txt, sizeof(txt), format, args);
+  if ((truncated = (size < 0 || size >= (int)sizeof(txt))))
+    size = sizeof(txt) - 1;
 
-  strcpy(txt, ProtocolOutput( t, txt, (int*)&wantsize )); /* <--- Add this line */
-  size = wantsize;                    /* <--- Add this line */
-  if ( t->pProtocol->WriteOOB > 0 )   /* <--- Add this line */
-    --t->pProtocol->WriteOOB;         /* <--- Add this line */
+  /* ProtocolOutput() hands back its own buffer; queue straight from it. */
+  out = ProtocolOutput(t, txt, &size);
+  if ( t->pProtocol->WriteOOB > 0 )
+    --t->pProtocol->WriteOOB;
 
-  /* If exceeding the size of the buffer, truncate it for the overflow message */
-  if (size < 0 || wantsize >= sizeof(txt)) {
-    size = sizeof(txt) - 1;
-    strcpy(txt + size - strlen(text_overflow), text_overflow);	/* strcpy: OK */
+  return (write_output(t, out, size, truncated));
+}
+
+/* Whether t is to be spared this output: it has overflowed already, or it
+ * is chatter and t isn't keeping up. */
+static bool output_refused(struct descriptor_data *t)
+{
+  /* if we're in the overflow state already, ignore this new output */
+  if (t->output_overflow)
+    return (TRUE);
+
+  /* A player who isn't keeping up loses channel chatter first, so there is
+   * room left for what happens to them. */
+  if (output_lowpri && t->output.bytes >= OUTPUT_SOFT_LIMIT) {
+    t->output.dropped++;
+    out_dropped++;
+    return (TRUE);
   }
+  return (FALSE);
+}
 
-  /* If the text is too big to fit into even a large buffer, truncate
-   * the new text to make it fit.  (This will switch to the overflow
-   * state automatically because t->bufspace will end up 0.) */
-  if (size + t->bufptr + 1 > LARGE_BUFSIZE) {
-    size = LARGE_BUFSIZE - t->bufptr - 1;
-    txt[size] = '\0';
+/* Queue text that has been through ProtocolOutput() already, within the
+ * limits.  Returns the room left in t's queue. */
+static size_t write_output(struct descriptor_data *t, const char *out, int size, int truncated)
+{
+  const char *text_overflow = "\r\nOVERFLOW\r\n";
+  struct out_queue *q = &t->output;
+  unsigned long hash;
+  size_t limit;
+
+  /* make sure the game loop flushes this descriptor */
+  reactor_wake(t);
+
+  /* While backed up, the same line over and over is only counted; it is
+   * summed up once the next different line, or the next flush, comes. */
+  if (q->bytes >= OUTPUT_SOFT_LIMIT) {
+    hash = output_hash(out, size);
+    if (size == q->last_len && hash == q->last_hash) {
+      q->repeats++;
+      out_coalesced++;
+      return (MAX_OUTPUT_QUEUE - q->bytes);
+    }
+    q->last_hash = hash;
+    q->last_len = size;
+  } else
+    q->last_len = 0;
+  flush_repeats(t);
+
+  /* Everyone may queue up to MAX_OUTPUT_QUEUE, unless so much is queued
+   * mud-wide that backed up players have to make do with less. */
+  limit = out_queue_total > MAX_OUTPUT_TOTAL ? OUTPUT_SOFT_LIMIT : MAX_OUTPUT_QUEUE;
+
+  /* If the queue is full, keep what fits and switch to the overflow state. */
+  if (q->bytes + size > limit) {
+    size = q->bytes < limit ? limit - q->bytes : 0;
+    t->output_overflow = TRUE;
     buf_overflows++;
   }
 
-  /* If we have enough space, just write to buffer and that's it! If the
-   * text just barely fits, then it's switched to a large buffer instead. */
-  if (t->bufspace > size) {
-    strcpy(t->output + t->bufptr, txt);	/* strcpy: OK (size checked above) */
-    t->bufspace -= size;
-    t->bufptr += size;
-    return (t->bufspace);
-  }
+  queue_output(t, out, size);
+  if (truncated && !t->output_overflow)
+    queue_output(t, text_overflow, strlen(text_overflow));
 
-  buf_switches++;
+  return (q->bytes < limit ? limit - q->bytes : 0);
+}
 
-  /* if the pool has a buffer in it, grab it */
-  if (bufpool != NULL) {
-    t->large_outbuf = bufpool;
-    bufpool = bufpool->next;
-  } else {			/* else create a new one */
-    CREATE(t->large_outbuf, struct txt_block, 1);
-    CREATE(t->large_outbuf->text, char, LARGE_BUFSIZE);
-    buf_largecount++;
-  }
+/* Tell a player how often the last line came while they were backed up. */
+static void flush_repeats(struct descriptor_data *t)
+{
+  char buf[80];
+  int len, n = t->output.repeats;
 
-  strcpy(t->large_outbuf->text, t->output);	/* strcpy: OK (size checked previously) */
-  t->output = t->large_outbuf->text;	/* make big buffer primary */
-  strcat(t->output, txt);	/* strcat: OK (size checked) */
+  if (!n)
+    return;
 
-  /* set the pointer for the next write */
-  t->bufptr = strlen(t->output);
+  t->output.repeats = 0;
+  len = snprintf(buf, sizeof(buf), "[ The last message was repeated %d more time%s. ]\r\n", n, n == 1 ? "" : "s");
+  queue_output(t, buf, len);
+}
 
-  /* calculate how much space is left in the buffer */
-  t->bufspace = LARGE_BUFSIZE - 1 - t->bufptr;
+/* FNV-1a, to spot a line that was just queued without keeping a copy. */
+static unsigned long output_hash(const char *txt, int len)
+{
+  unsigned long hash = 2166136261UL;
+
+  while (len-- > 0)
+    hash = (hash ^ (unsigned char) *txt++) * 16777619UL;
+
+  return (hash);
+}
+
+/* Append text to a descriptor's output queue, topping up the last block
+ * before taking a new one from the pool.  No limit is checked here. */
+static void queue_output(struct descriptor_data *t, const char *txt, size_t len)
+{
+  struct out_queue *q = &t->output;
+  struct out_block *blk;
+  size_t n;
+
+  while (len > 0) {
+    if (!(blk = q->tail) || blk->len == OUT_BLOCK_SIZE) {
+      POOL_CREATE(blk, out_block_pool, struct out_block);
+      out_block_count++;
+      if (q->tail)
+        q->tail->next = blk;
+      else
+        q->head = blk;
+      q->tail = blk;
+    }
+    n = MIN(len, (size_t)(OUT_BLOCK_SIZE - blk->len));
+    memcpy(blk->text + blk->len, txt, n);
+    blk->len += n;
+    q->bytes += n;
+    out_queue_total += n;
+    txt += n;
+    len -= n;
+  }
+}
 
-  return (t->bufspace);
+/* Drop 'len' bytes from the front of an output queue, once they have been
+ * sent, returning emptied blocks to the pool. */
+static void dequeue_output(struct out_queue *q, size_t len)
+{
+  struct out_block *blk;
+  size_t left;
+
+  while (len > 0 && (blk = q->head) != NULL) {
+    left = blk->len - q->head_off;
+    if (len < left) {
+      q->head_off += len;
+      q->bytes -= len;
+      out_queue_total -= len;
+      return;
+    }
+    len -= left;
+    q->bytes -= left;
+    out_queue_total -= left;
+    q->head_off = 0;
+    if (!(q->head = blk->next))
+      q->tail = NULL;
+    pool_free(out_block_pool, blk);
+    out_block_count--;
+  }
 }
 
-static void free_bufpool(void)
+/* Show the first 'len' queued bytes of t's output to whoever is snooping. */
+static void snoop_output(struct descriptor_data *t, size_t len)
 {
-  struct txt_block *tmp;
+  struct out_block *blk;
+  int off = t->output.head_off, n;
 
-  while (bufpool) {
-    tmp = bufpool->next;
-    if (bufpool->text)
-      free(bufpool->text);
-    free(bufpool);
-    bufpool = tmp;
+  write_to_output(t->snoop_by, "%% ");
+  for (blk = t->output.head; blk && len > 0; blk = blk->next, off = 0) {
+    n = MIN(len, (size_t)(blk->len - off));
+    write_to_output(t->snoop_by, "%.*s", n, blk->text + off);
+    len -= n;
   }
+  write_to_output(t->snoop_by, "%%%%");
 }
 
 /*  socket handling */
@@ -1469,11 +1691,7 @@ static void init_descriptor (struct descriptor_data *newd, int desc)
 
   newd->descriptor = desc;
   newd->idle_tics = 0;
-  newd->output = newd->small_outbuf;
-  newd->bufspace = SMALL_BUFSIZE - 1;
   newd->login_time = time(0);
-  *newd->output = '\0';
-  newd->bufptr = 0;
   newd->has_prompt = 1;  /* prompt is part of greetings */
   STATE(newd) = CONFIG_PROTOCOL_NEGOTIATION ? CON_GET_PROTOCOL : CON_GET_NAME;
   CREATE(newd->history, char *, HISTORY_SIZE);
@@ -1488,12 +1706,10 @@ static void init_descriptor (struct descriptor_data *newd, int desc)
 static int new_descriptor(socket_t s)
 {
   socket_t desc;
-  int sockets_connected = 0;
   int greetsize;
   socklen_t i;
   struct descriptor_data *newd;
   struct sockaddr_in peer;
-  struct hostent *from;
 
   /* accept the new connection */
   i = sizeof(peer);
@@ -1511,10 +1727,7 @@ static int new_descriptor(socket_t s)
   }
 
   /* make sure we have room for it */
-  for (newd = descriptor_list; newd; newd = newd->next)
-    sockets_connected++;
-
-  if (sockets_connected >= CONFIG_MAX_PLAYING) {
+  if (reactor_count() >= CONFIG_MAX_PLAYING) {
     write_to_descriptor(desc, "Sorry, the game is full right now... please try again later!\r\n");
     CLOSE_SOCKET(desc);
     return (0);
@@ -1522,25 +1735,16 @@ static int new_descriptor(socket_t s)
   /* create a new descriptor */
   CREATE(newd, struct descriptor_data, 1);
 
-  /* find the sitename */
-  if (CONFIG_NS_IS_SLOW ||
-      !(from = gethostbyaddr((char *) &peer.sin_addr,
-		             sizeof(peer.sin_addr), AF_INET))) {
-
-    /* resolution failed */
-    if (!CONFIG_NS_IS_SLOW)
-      perror("SYSERR: gethostbyaddr");
-
-    /* find the numeric site address */
-    strncpy(newd->host, (char *)inet_ntoa(peer.sin_addr), HOST_LENGTH);	/* strncpy: OK (n->host:HOST_LENGTH+1) */
-    *(newd->host + HOST_LENGTH) = '\0';
-  } else {
-    strncpy(newd->host, from->h_name, HOST_LENGTH);	/* strncpy: OK (n->host:HOST_LENGTH+1) */
-    *(newd->host + HOST_LENGTH) = '\0';
-  }
+  /* find the sitename: the numeric address for now, and the name once the
+   * resolver has it, unless name lookups are off */
+  strncpy(newd->host, (char *)inet_ntoa(peer.sin_addr), HOST_LENGTH);	/* strncpy: OK (n->host:HOST_LENGTH+1) */
+  *(newd->host + HOST_LENGTH) = '\0';
+  newd->addr = peer.sin_addr;
+  if (!CONFIG_NS_IS_SLOW)
+    resolver_lookup(newd);
 
   /* determine if the site is banned */
-  if (isbanned(newd->host) == BAN_ALL) {
+  if (isbanned(newd->host, &newd->addr) == BAN_ALL) {
     CLOSE_SOCKET(desc);
     mudlog(CMP, LVL_GOD, TRUE, "Connection attempt denied from [%s]", newd->host);
     free(newd);
@@ -1554,6 +1758,12 @@ static int new_descriptor(socket_t s)
   newd->next = descriptor_list;
   descriptor_list = newd;
 
+  /* and have the reactor watch it */
+  if (reactor_add(newd) < 0) {
+    close_socket(newd);
+    return (0);
+  }
+
   if (CONFIG_PROTOCOL_NEGOTIATION) {
     /* Attach Event */
     NEW_EVENT(ePROTOCOLS, newd, NULL, 1.5 * PASSES_PER_SEC);
@@ -1568,89 +1778,119 @@ static int new_descriptor(socket_t s)
 }
 
 /* Send all of the output that we've accumulated for a player out to the
- * player's descriptor. 32 byte GARBAGE_SPACE in MAX_SOCK_BUF used for:
- *	 2 bytes: prepended \r\n
- *	14 bytes: overflow message
- *	 2 bytes: extra \r\n for non-comapct
- *      14 bytes: unused */
+ * player's descriptor.  The queued blocks, plus the pieces that go around
+ * them, are handed to the kernel together with writev():
+ *	a CRLF ahead of the output, if this is an 'interruption'
+ *	the overflow message, if output was dropped
+ *	an extra CRLF for non-compact players
+ *	the prompt */
 static int process_output(struct descriptor_data *t)
 {
-  char i[MAX_SOCK_BUF], *osb = i + 2;
-  int result;
+  static const char crlf[] = "\r\n", overflow[] = "**OVERFLOW**\r\n";
+  struct iovec iov[MAX_OUTPUT_IOV + 4], extra[3];
+  struct out_block *blk;
+  size_t body = 0, sent;
+  int n = 0, lead = 0, trailer, off, result, i;
+
+  /* Repeats counted since the last pass go out behind what came before. */
+  flush_repeats(t);
 
-  /* we may need this \r\n for later -- see below */
-  strcpy(i, "\r\n");	/* strcpy: OK (for 'MAX_SOCK_BUF >= 3') */
+  /* If this is an 'interruption', use a prepended CRLF. */
+  if (t->has_prompt && !t->pProtocol->WriteOOB) {
+    t->has_prompt = FALSE;
+    iov[n].iov_base = (char *) crlf;
+    iov[n++].iov_len = lead = 2;
+  }
+
+  /* now, the 'real' output, straight out of the queue's blocks; no more per
+   * pass than the old flat buffer held, so a slow reader can't make us walk
+   * a long queue the kernel has no room for anyway */
+  off = t->output.head_off;
+  for (blk = t->output.head; blk && n < MAX_OUTPUT_IOV && body < MAX_SOCK_BUF; blk = blk->next) {
+    iov[n].iov_base = blk->text + off;
+    iov[n++].iov_len = blk->len - off;
+    body += blk->len - off;
+    off = 0;
+  }
+
+  /* The rest only goes out once everything queued ahead of it has. */
+  trailer = n;
+  if (!blk) {
+    /* if we're in the overflow state, notify the user */
+    if (t->output_overflow) {
+      iov[n].iov_base = (char *) overflow;
+      iov[n++].iov_len = sizeof(overflow) - 1;
+    }
 
-  /* now, append the 'real' output */
-  strcpy(osb, t->output);	/* strcpy: OK (t->output:LARGE_BUFSIZE < osb:MAX_SOCK_BUF-2) */
+    /* add the extra CRLF if the person isn't in compact mode */
+    if (STATE(t) == CON_PLAYING && t->character && !IS_NPC(t->character) && !PRF_FLAGGED(t->character, PRF_COMPACT))
+      if ( !t->pProtocol->WriteOOB ) {
+        iov[n].iov_base = (char *) crlf;
+        iov[n++].iov_len = 2;
+      }
 
-  /* if we're in the overflow state, notify the user */
-  if (t->bufspace == 0)
-    strcat(osb, "**OVERFLOW**\r\n");	/* strcpy: OK (osb:MAX_SOCK_BUF-2 reserves space) */
+    if (!t->pProtocol->WriteOOB) { /* add a prompt */
+      char *prompt = make_prompt(t);
 
-  /* add the extra CRLF if the person isn't in compact mode */
-  if (STATE(t) == CON_PLAYING && t->character && !IS_NPC(t->character) && !PRF_FLAGGED(t->character, PRF_COMPACT))
-    if ( !t->pProtocol->WriteOOB )
-      strcat(osb, "\r\n");	/* strcpy: OK (osb:MAX_SOCK_BUF-2 reserves space) */
+      iov[n].iov_base = prompt;
+      iov[n++].iov_len = strlen(prompt);
+    }
+  }
 
-  if (!t->pProtocol->WriteOOB) /* add a prompt */
-    strcat(i, make_prompt(t));	/* strcpy: OK (i:MAX_SOCK_BUF reserves space) */
+  /* Sending may use up iov, so keep what the save below needs. */
+  for (i = trailer; i < n; i++)
+    extra[i - trailer] = iov[i];
 
-  /* now, send the output.  If this is an 'interruption', use the prepended
-   * CRLF, otherwise send the straight output sans CRLF. */
-  if (t->has_prompt && !t->pProtocol->WriteOOB) {
-    t->has_prompt = FALSE;
-    result = write_to_descriptor(t->descriptor, i);
-    if (result >= 2)
-      result -= 2;
-  } else
-    result = write_to_descriptor(t->descriptor, osb);
+  result = ProtocolWritev(t, iov, n);
 
   if (result < 0) {	/* Oops, fatal error. Bye! */
     close_socket(t);
     return (-1);
-  } else if (result == 0)	/* Socket buffer full. Try later. */
+  } else if (result == 0) {	/* Socket buffer full. Try later. */
+    reactor_want_write(t, TRUE);
     return (0);
+  }
+
+  /* Don't count the prepended CRLF as output. */
+  result = MAX(result - lead, 0);
+  sent = MIN((size_t) result, body);
 
   /* Handle snooping: prepend "% " and send to snooper. */
-  if (t->snoop_by)
-    write_to_output(t->snoop_by, "%% %*s%%%%", result, t->output);
-
-  /* The common case: all saved output was handed off to the kernel buffer. */
-  if (result >= t->bufptr) {
-    /* If we were using a large buffer, put the large buffer on the buffer pool
-     * and switch back to the small one. */
-    if (t->large_outbuf) {
-      t->large_outbuf->next = bufpool;
-      bufpool = t->large_outbuf;
-      t->large_outbuf = NULL;
-      t->output = t->small_outbuf;
-    }
-    /* reset total bufspace back to that of a small buffer */
-    t->bufspace = SMALL_BUFSIZE - 1;
-    t->bufptr = 0;
-    *(t->output) = '\0';
+  if (t->snoop_by && sent)
+    snoop_output(t, sent);
 
-    /* If the overflow message or prompt were partially written, try to save
-     * them. There will be enough space for them if this is true.  'result'
-     * is effectively unsigned here anyway. */
-    if ((unsigned int)result < strlen(osb)) {
-      size_t savetextlen = strlen(osb + result);
+  dequeue_output(&t->output, sent);
 
-      strcat(t->output, osb + result);
-      t->bufptr   -= savetextlen;
-      t->bufspace += savetextlen;
-    }
+  /* The common case: all queued output was handed off to the kernel. */
+  if (sent == body && !blk) {
+    t->output_overflow = FALSE;
 
-  } else {
-    /* Not all data in buffer sent.  result < output buffersize. */
-    strcpy(t->output, t->output + result);	/* strcpy: OK (overlap) */
-    t->bufptr   -= result;
-    t->bufspace += result;
+    /* If the overflow message or prompt were partially written, try to save
+     * them for next time. */
+    for (result -= body, i = 0; i < n - trailer; i++) {
+      if ((size_t) result >= extra[i].iov_len)
+        result -= extra[i].iov_len;
+      else {
+        queue_output(t, (char *) extra[i].iov_base + result, extra[i].iov_len - result);
+        result = 0;
+      }
+    }
   }
 
-  return (result);
+  /* Anything left over waits until the kernel has room for it again. */
+  reactor_want_write(t, t->output.bytes > 0 || t->pProtocol->MCCPBufLen > 0);
+
+  return (sent);
+}
+
+#ifdef CIRCLE_CHECK
+/* Lets the programs in check/, which link their own build of this file, send
+ * a descriptor's output the way game_loop() does. */
+int check_process_output(struct descriptor_data *t)
+{
+  return (process_output(t));
 }
+#endif
 
 /* perform_socket_write: takes a descriptor, a pointer to text, and a
  * text length, and tries once to send that text to the OS.  This is
@@ -1738,15 +1978,98 @@ static ssize_t perform_socket_write(socket_t desc, const char *txt, size_t lengt
 }
 #endif /* CIRCLE_WINDOWS */
 
+/* perform_socket_writev: the same as perform_socket_write, but gathers the
+ * text from several buffers in one system call.  Platforms without writev()
+ * just send the first buffer. */
+static ssize_t perform_socket_writev(socket_t desc, struct iovec *iov, int iovcnt)
+{
+#if defined(HAVE_SYS_UIO_H) && !defined(CIRCLE_WINDOWS)
+  ssize_t result;
+
+  result = writev(desc, iov, iovcnt);
+
+  if (result > 0)
+    return (result);
+
+  if (result == 0) {
+    /* This should never happen! */
+    log("SYSERR: Huh??  writev() returned 0???  Please report this!");
+    return (-1);
+  }
+
+#ifdef EAGAIN		/* POSIX */
+  if (errno == EAGAIN)
+    return (0);
+#endif
+
+#ifdef EWOULDBLOCK	/* BSD */
+  if (errno == EWOULDBLOCK)
+    return (0);
+#endif
+
+  return (-1);
+#else
+  return (perform_socket_write(desc, iov->iov_base, iov->iov_len));
+#endif
+}
+
 /* write_to_descriptor takes a descriptor, and text to write to the descriptor.
  * It keeps calling the system-level write() until all the text has been
  * delivered to the OS, or until an error is encountered. Returns:
  * >=0  If all is well and good.
- *  -1  If an error was encountered, so that the player should be cut off. */
+ *  -1  If an error was encountered, so that the player should be cut off.
+ * This bypasses MCCP; use ProtocolWrite() when you have a descriptor_data. */
 int write_to_descriptor(socket_t desc, const char *txt)
+{
+  return (write_bytes_to_descriptor(desc, txt, strlen(txt)));
+}
+
+/* write_iov_to_descriptor: the same as write_bytes_to_descriptor, for text
+ * spread over several buffers.  The iovec array is used up as it is sent. */
+int write_iov_to_descriptor(socket_t desc, struct iovec *iov, int iovcnt)
 {
   ssize_t bytes_written;
-  size_t total = strlen(txt), write_total = 0;
+  size_t write_total = 0;
+
+  while (iovcnt > 0) {
+    /* Skip empty buffers, so writev() is never asked to send nothing. */
+    if (iov->iov_len == 0) {
+      iov++;
+      iovcnt--;
+      continue;
+    }
+
+    bytes_written = perform_socket_writev(desc, iov, iovcnt);
+
+    if (bytes_written < 0) {
+      /* Fatal error.  Disconnect the player. */
+      perror("SYSERR: Write to socket");
+      return (-1);
+    } else if (bytes_written == 0) {
+      /* Temporary failure -- socket buffer full. */
+      break;
+    }
+
+    write_total += bytes_written;
+    while (bytes_written > 0 && (size_t) bytes_written >= iov->iov_len) {
+      bytes_written -= iov->iov_len;
+      iov++;
+      iovcnt--;
+    }
+    if (bytes_written > 0) {
+      iov->iov_base = (char *) iov->iov_base + bytes_written;
+      iov->iov_len -= bytes_written;
+    }
+  }
+
+  return (write_total);
+}
+
+/* The same, for data that may hold NULs (such as compressed output). */
+int write_bytes_to_descriptor(socket_t desc, const char *txt, size_t total)
+{
+  ssize_t bytes_written;
+  size_t write_total = 0;
 
   while (total > 0) {
     bytes_written = perform_socket_write(desc, txt, total);
@@ -1850,6 +2173,10 @@ static int process_input(struct descriptor_data *t)
   char tmp[MAX_INPUT_LENGTH];
   static char read_buf[MAX_PROTOCOL_BUFFER] = { '\0' }; /* KaVir's plugin */
 
+  /* once everything queued has been dealt with, a new flood is news again */
+  if (!t->input.lines)
+    t->input_flooded = FALSE;
+
   /* first, find the point where we left off reading data */
   buf_length = strlen(t->inbuf);
   read_point = t->inbuf + buf_length;
@@ -1861,15 +2188,23 @@ static int process_input(struct descriptor_data *t)
       return (-1);
     }
 
-    /* Read # of "bytes_read" from socket, and if we have something, mark the sizeof data
-     * in the read_buf array as NULL */
-    if ((bytes_read = perform_socket_read(t->descriptor, read_buf, space_left)) > 0)
-      read_buf[bytes_read] = '\0';
-
-    /* Since we have recieved atleast 1 byte of data from the socket, lets run it through
-     * ProtocolInput() and rip out anything that is Out Of Band */
-    if ( bytes_read > 0 )
-      bytes_read = ProtocolInput( t, read_buf, bytes_read, t->inbuf );
+    /* Compressed input that didn't fit last time is inflated before anything
+     * more is read from the socket. */
+    bytes_read = 0;
+    if (ProtocolInputPending(t))
+      bytes_read = ProtocolInput(t, read_buf, 0, t->inbuf);
+
+    if (bytes_read == 0 && !ProtocolInputPending(t)) {
+      /* Read # of "bytes_read" from socket, and if we have something, mark the sizeof data
+       * in the read_buf array as NULL */
+      if ((bytes_read = perform_socket_read(t->descriptor, read_buf, space_left)) > 0)
+        read_buf[bytes_read] = '\0';
+
+      /* Since we have recieved atleast 1 byte of data from the socket, lets run it through
+       * ProtocolInput() and rip out anything that is Out Of Band */
+      if ( bytes_read > 0 )
+        bytes_read = ProtocolInput( t, read_buf, bytes_read, t->inbuf );
+    }
 
     if (bytes_read < 0)	/* Error, disconnect them. */
       return (-1);
@@ -1938,7 +2273,7 @@ static int process_input(struct descriptor_data *t)
       char buffer[MAX_INPUT_LENGTH + 64];
 
       snprintf(buffer, sizeof(buffer), "Line too long.  Truncated to:\r\n%s\r\n", tmp);
-      if (write_to_descriptor(t->descriptor, buffer) < 0)
+      if (ProtocolWrite(t, buffer) < 0)
 	return (-1);
     }
     if (t->snoop_by)
@@ -1979,12 +2314,15 @@ static int process_input(struct descriptor_data *t)
    if ( (*tmp == '-') && (*(tmp+1) == '-') && !(*(tmp+2)) )
    {
      write_to_output(t, "All queued commands cancelled.\r\n");
-     flush_queues(t);  /* Flush the command queue */
+     flush_input(&t->input);  /* Flush the command queue */
      failed_subst = 1;  /* Allow the read point to be moved, but don't add to queue */
    }
 
-    if (!failed_subst)
-      write_to_q(tmp, &t->input, 0);
+    /* The ring is where the flood limit is enforced; the string editor,
+     * which takes pasted text, only has to fit in it. */
+    if (!failed_subst && ((!t->str && t->input.lines >= INPUT_FLOOD_LINES) ||
+        !write_to_q(tmp, &t->input, 0)))
+      input_flood(t);
 
     /* find the end of this line */
     while (ISNEWL(*nl_pos))
@@ -2059,6 +2397,7 @@ void close_socket(struct descriptor_data *d)
   struct descriptor_data *temp;
 
   REMOVE_FROM_LIST(d, descriptor_list, next);
+  reactor_remove(d);
   CLOSE_SOCKET(d->descriptor);
   flush_queues(d);
 
@@ -2074,6 +2413,7 @@ void close_socket(struct descriptor_data *d)
   if (d->character) {
     /* If we're switched, this resets the mobile taken. */
     d->character->desc = NULL;
+    update_zone_players(d->character);
 
     /* Plug memory leak, from Eric Green. */
     if (!IS_NPC(d->character) && PLR_FLAGGED(d->character, PLR_MAILING) && d->str) {
@@ -2103,8 +2443,10 @@ void close_socket(struct descriptor_data *d)
     mudlog(CMP, LVL_IMMORT, TRUE, "Losing descriptor without char.");
 
   /* JE 2/22/95 -- part of my unending quest to make switch stable */
-  if (d->original && d->original->desc)
+  if (d->original && d->original->desc) {
     d->original->desc = NULL;
+    update_zone_players(d->original);
+  }
 
   /* Clear the command history. */
   if (d->history) {
@@ -2170,6 +2512,7 @@ static void check_idle_passwords(void)
       echo_on(d);
       write_to_output(d, "\r\nTimed out... goodbye.\r\n");
       STATE(d) = CON_CLOSE;
+      reactor_wake(d);
     }
   }
 }
@@ -2355,23 +2698,24 @@ static void signal_setup(void)
 void game_info(const char *format, ...)
 {
   struct descriptor_data *i;
+  struct broadcast *b;
   va_list args;
   char messg[MAX_STRING_LENGTH];
   if (format == NULL)
     return;
-  sprintf(messg, "\tcInfo: \ty");
+  va_start(args, format);
+  vsnprintf(messg, sizeof(messg), format, args);
+  va_end(args);
+  b = broadcast_text("\tcInfo: \ty%s\tn\r\n", messg);
   for (i = descriptor_list; i; i = i->next) {
     if (STATE(i) != CON_PLAYING)
       continue;
     if (!(i->character))
       continue;
 
-    write_to_output(i, "%s", messg);
-    va_start(args, format);
-    vwrite_to_output(i, format, args);
-    va_end(args);
-    write_to_output(i, "\tn\r\n");
+    broadcast_to_desc(b, i);
   }
+  broadcast_end(b);
 }
 
 size_t send_to_char(struct char_data *ch, const char *messg, ...)
@@ -2388,32 +2732,43 @@ size_t send_to_char(struct char_data *ch, const char *messg, ...)
   return 0;
 }
 
+/* The send_to_x() functions format the message once for everyone, with
+ * vbroadcast_text(). */
 void send_to_all(const char *messg, ...)
 {
   struct descriptor_data *i;
+  struct broadcast *b;
   va_list args;
 
   if (messg == NULL)
     return;
 
+  va_start(args, messg);
+  b = vbroadcast_text(messg, args);
+  va_end(args);
+
   for (i = descriptor_list; i; i = i->next) {
     if (STATE(i) != CON_PLAYING)
       continue;
 
-    va_start(args, messg);
-    vwrite_to_output(i, messg, args);
-    va_end(args);
+    broadcast_to_desc(b, i);
   }
+  broadcast_end(b);
 }
 
 void send_to_outdoor(const char *messg, ...)
 {
   struct descriptor_data *i;
+  struct broadcast *b;
   va_list args;
 
   if (!messg || !*messg)
     return;
 
+  va_start(args, messg);
+  b = vbroadcast_text(messg, args);
+  va_end(args);
+
   for (i = descriptor_list; i; i = i->next) {
 
     if (STATE(i) != CON_PLAYING || i->character == NULL)
@@ -2421,28 +2776,31 @@ void send_to_outdoor(const char *messg, ...)
     if (!AWAKE(i->character) || !OUTSIDE(i->character))
       continue;
 
-    va_start(args, messg);
-    vwrite_to_output(i, messg, args);
-    va_end(args);
+    broadcast_to_desc(b, i);
   }
+  broadcast_end(b);
 }
 
 void send_to_room(room_rnum room, const char *messg, ...)
 {
   struct char_data *i;
+  struct broadcast *b;
   va_list args;
 
   if (messg == NULL)
     return;
 
+  va_start(args, messg);
+  b = vbroadcast_text(messg, args);
+  va_end(args);
+
   for (i = world[room].people; i; i = i->next_in_room) {
     if (!i->desc)
       continue;
 
-    va_start(args, messg);
-    vwrite_to_output(i->desc, messg, args);
-    va_end(args);
+    broadcast_to_desc(b, i->desc);
   }
+  broadcast_end(b);
 }
 
 /* Sends a message to the entire group, except for ch.
@@ -2472,6 +2830,7 @@ void send_to_group(struct char_data *ch, struct group_data *group, const char *
 void send_to_range(room_vnum start, room_vnum finish, const char *messg, ...)
 {
   struct char_data *i;
+  struct broadcast *b;
   va_list args;
   int j;
 
@@ -2482,33 +2841,304 @@ void send_to_range(room_vnum start, room_vnum finish, const char *messg, ...)
   if (messg == NULL)
     return;
 
+  va_start(args, messg);
+  b = vbroadcast_text(messg, args);
+  va_end(args);
+
   for (j = 0; j < top_of_world; j++) {
     if (GET_ROOM_VNUM(j) >= start && GET_ROOM_VNUM(j) <= finish) {
       for (i = world[j].people; i; i = i->next_in_room) {
         if (!i->desc)
           continue;
 
-        va_start(args, messg);
-        vwrite_to_output(i->desc, messg, args);
-        va_end(args);
+        broadcast_to_desc(b, i->desc);
       }
     }
   }
+  broadcast_end(b);
+}
+
+/* A message going to many players at once: the channels, gemotes, gecho,
+ * send_to_all() and the like.  It is rendered once for each distinct way it
+ * comes out - the colour wrapped around it, what its recipients can see of
+ * those it names, and what their clients make of colour and MXP codes - and
+ * each rendering is queued for everyone who gets it, along with one history
+ * line they all share. */
+#define BROADCAST_VARIANTS  8  /* act() texts kept for one broadcast */
+#define BROADCAST_RENDERS   4  /* ProtocolOutput() results kept for each */
+
+/* What the recipient of an act() broadcast can see, where it matters. */
+#define BC_SEES_CH    (1 << 0)  /* $n */
+#define BC_SEES_VICT  (1 << 1)  /* $N */
+#define BC_SEES_OBJ   (1 << 2)  /* $o, $p */
+#define BC_SEES_VOBJ  (1 << 3)  /* $O, $P */
+
+struct broadcast_render {
+  unsigned long proto;    /* ProtocolOutputKey() of those it is for */
+  char *out;              /* the text after ProtocolOutput() */
+  int len;                /* bytes in out */
+  bool block_mxp;         /* bBlockMXP once out has been sent */
+};
+
+struct broadcast_variant {
+  const char *pre, *post; /* what the message was wrapped in */
+  int sees;               /* BC_SEES_x bits of its recipients */
+  char *text;             /* the text itself, from share_str() */
+  int len;                /* bytes in text */
+  bool plain;             /* no codes, so ProtocolOutput() leaves it be */
+  char *hist;             /* its history line, from share_str() */
+  int num_renders;
+  struct broadcast_render renders[BROADCAST_RENDERS];
+};
+
+struct broadcast {
+  const char *str;        /* the act() string, for act() broadcasts */
+  struct char_data *ch;
+  struct obj_data *obj;
+  void *vict_obj;
+  int needs;              /* BC_SEES_x bits that str depends on */
+  int lowpri;             /* TO_LOWPRI chatter */
+  int dg_check;           /* act triggers are checked: no DG_NO_TRIG */
+  int truncated;          /* the text was cut to MAX_STRING_LENGTH */
+  char time_str[16];      /* stamp for history lines */
+  const char *last;       /* text last sent, for last_act_message */
+  int num_variants;
+  struct broadcast_variant variants[BROADCAST_VARIANTS];
+};
+
+static struct broadcast_variant *add_variant(struct broadcast *b, const char *pre,
+    const char *post, int sees, const char *text, int len)
+{
+  struct broadcast_variant *v = &b->variants[b->num_variants++];
+
+  v->pre = pre;
+  v->post = post;
+  v->sees = sees;
+  v->text = share_str(text);
+  v->len = len;
+  v->plain = (len < MAX_OUTPUT_BUFFER && !strchr(text, '\t') && !strstr(text, "!!"));
+  return (v);
+}
+
+/* Queue a variant for d, putting it through ProtocolOutput() only if no one
+ * with the same kind of client has had it yet. */
+static void queue_variant(struct broadcast *b, struct broadcast_variant *v,
+    struct descriptor_data *d)
+{
+  struct broadcast_render *r;
+  unsigned long proto;
+  const char *out;
+  int i, size, refused;
+
+  output_lowpri = b->lowpri;
+  refused = output_refused(d);
+  output_lowpri = FALSE;
+  if (refused)
+    return;
+
+  if (v->plain) {
+    out = v->text;
+    size = v->len;
+  } else {
+    proto = ProtocolOutputKey(d);
+    for (i = 0; i < v->num_renders && v->renders[i].proto != proto; i++);
+
+    if (i < v->num_renders) {
+      r = &v->renders[i];
+      out = r->out;
+      size = r->len;
+      d->pProtocol->bBlockMXP = r->block_mxp;
+    } else {
+      size = v->len;
+      out = ProtocolOutput(d, v->text, &size);
+      if (v->num_renders < BROADCAST_RENDERS) {
+        r = &v->renders[v->num_renders++];
+        r->proto = proto;
+        CREATE(r->out, char, size + 1);
+        memcpy(r->out, out, size);
+        r->len = size;
+        r->block_mxp = d->pProtocol->bBlockMXP;
+      }
+    }
+  }
+  if ( d->pProtocol->WriteOOB > 0 )
+    --d->pProtocol->WriteOOB;
+
+  write_output(d, out, size, b->truncated);
+}
+
+/* Start broadcasting an act() string; ch, obj and vict_obj are as for act(),
+ * and type may have TO_LOWPRI and DG_NO_TRIG set.  Send it with
+ * broadcast_to() and finish with broadcast_end(). */
+struct broadcast *broadcast_act(const char *str, struct char_data *ch,
+    struct obj_data *obj, void *vict_obj, int type)
+{
+  struct broadcast *b;
+  const char *s;
+  time_t ct = time(0);
+
+  CREATE(b, struct broadcast, 1);
+  b->str = str;
+  b->ch = ch;
+  b->obj = obj;
+  b->vict_obj = vict_obj;
+  b->lowpri = IS_SET(type, TO_LOWPRI);
+  b->dg_check = !IS_SET(type, DG_NO_TRIG);
+  strftime(b->time_str, sizeof(b->time_str), "%H:%M ", localtime(&ct));
+
+  /* Which of what a recipient can see changes what they are shown. */
+  for (s = str; (s = strchr(s, '$')) != NULL && *++s; s++)
+    switch (*s) {
+    case 'n':           if (ch)       b->needs |= BC_SEES_CH;   break;
+    case 'N':           if (vict_obj) b->needs |= BC_SEES_VICT; break;
+    case 'o': case 'p': if (obj)      b->needs |= BC_SEES_OBJ;  break;
+    case 'O': case 'P': if (vict_obj) b->needs |= BC_SEES_VOBJ; break;
+    }
+
+  return (b);
+}
+
+/* Start broadcasting text formatted as for send_to_char().  Send it with
+ * broadcast_to_desc() and finish with broadcast_end(). */
+struct broadcast *broadcast_text(const char *messg, ...)
+{
+  struct broadcast *b;
+  va_list args;
+
+  va_start(args, messg);
+  b = vbroadcast_text(messg, args);
+  va_end(args);
+
+  return (b);
+}
+
+struct broadcast *vbroadcast_text(const char *messg, va_list args)
+{
+  struct broadcast *b;
+  char txt[MAX_STRING_LENGTH];
+  int size;
+
+  size = vsnprintf(txt, sizeof(txt), messg, args);
+
+  CREATE(b, struct broadcast, 1);
+  if ((b->truncated = (size < 0 || size >= (int)sizeof(txt))))
+    size = sizeof(txt) - 1;
+  add_variant(b, NULL, NULL, 0, txt, size);
+
+  return (b);
+}
+
+/* Send an act() broadcast to one character, wrapped in pre and post, such
+ * as colour codes for their colour level, and add it to their history of
+ * type hist unless that is HIST_NONE.  As act() does with TO_SLEEP, this
+ * passes over anyone SENDOK() would, such as players in an editor; whether
+ * the rest ought to get it is up to the caller. */
+void broadcast_to(struct broadcast *b, struct char_data *to, const char *pre,
+    const char *post, int hist)
+{
+  struct broadcast_variant *v = NULL;
+  struct char_data *dg_victim = NULL;
+  struct obj_data *dg_target = NULL;
+  struct char_data *vict = (struct char_data *) b->vict_obj;
+  struct obj_data *vobj = (struct obj_data *) b->vict_obj;
+  char buf[MAX_STRING_LENGTH], lbuf[MAX_STRING_LENGTH], *dg_arg = NULL;
+  int i, sees = 0, old_lowpri, old_check;
+
+  if ((!to->desc && !SCRIPT_CHECK(to, MTRIG_ACT)) || PLR_FLAGGED(to, PLR_WRITING))
+    return;
+
+  if (b->needs & BC_SEES_CH && CAN_SEE(to, b->ch))
+    sees |= BC_SEES_CH;
+  if (b->needs & BC_SEES_VICT && CAN_SEE(to, vict))
+    sees |= BC_SEES_VICT;
+  if (b->needs & BC_SEES_OBJ && CAN_SEE_OBJ(to, b->obj))
+    sees |= BC_SEES_OBJ;
+  if (b->needs & BC_SEES_VOBJ && CAN_SEE_OBJ(to, vobj))
+    sees |= BC_SEES_VOBJ;
+
+  for (i = 0; i < b->num_variants; i++)
+    if (b->variants[i].pre == pre && b->variants[i].post == post &&
+        b->variants[i].sees == sees) {
+      v = &b->variants[i];
+      break;
+    }
+
+  /* Mobs may have act triggers, and a broadcast with more renderings than
+   * it keeps has run out; either way this one is done as act() does it. */
+  if (IS_NPC(to) || !to->desc || (!v && b->num_variants == BROADCAST_VARIANTS)) {
+    snprintf(buf, sizeof(buf), "%s%s%s", pre, b->str, post);
+    old_lowpri = act_lowpri;
+    old_check = dg_act_check;
+    act_lowpri = b->lowpri;
+    dg_act_check = b->dg_check;
+    perform_act(buf, b->ch, b->obj, b->vict_obj, to);
+    act_lowpri = old_lowpri;
+    dg_act_check = old_check;
+    b->last = NULL;
+    if (hist != HIST_NONE)
+      add_history(to, last_act_message, hist);
+    return;
+  }
+
+  if (!v) {
+    snprintf(buf, sizeof(buf), "%s%s%s", pre, b->str, post);
+    expand_act(buf, b->ch, b->obj, b->vict_obj, to, lbuf, &dg_victim, &dg_target, &dg_arg);
+    CAP(lbuf);
+    v = add_variant(b, pre, post, sees, lbuf, strlen(lbuf));
+  }
+  queue_variant(b, v, to->desc);
+  b->last = v->text;
+
+  if (hist != HIST_NONE) {
+    if (!v->hist) {
+      snprintf(buf, sizeof(buf), "%s%s", b->time_str, v->text);
+      v->hist = share_str(buf);
+    }
+    add_history_line(to, v->hist, hist);
+  }
+}
+
+/* Send a broadcast_text() to one descriptor. */
+void broadcast_to_desc(struct broadcast *b, struct descriptor_data *d)
+{
+  queue_variant(b, &b->variants[0], d);
+}
+
+void broadcast_end(struct broadcast *b)
+{
+  struct broadcast_variant *v;
+  int i;
+
+  /* act() hands back what it sent last; so does a broadcast of one. */
+  if (b->last) {
+    if (last_act_message)
+      free(last_act_message);
+    last_act_message = strdup(b->last);
+  }
+
+  for (v = b->variants; v < b->variants + b->num_variants; v++) {
+    release_str(v->text);
+    release_str(v->hist);
+    for (i = 0; i < v->num_renders; i++)
+      free(v->renders[i].out);
+  }
+  free(b);
 }
 
 static const char *ACTNULL = "<NULL>";
 #define CHECK_NULL(pointer, expression) \
   if ((pointer) == NULL) i = ACTNULL; else i = (expression);
 /* higher-level communication: the act() function */
-void perform_act(const char *orig, struct char_data *ch, struct obj_data *obj,
-    void *vict_obj, struct char_data *to)
+/* Expands the $-codes of an act() string as to sees them, into lbuf, which
+ * holds MAX_STRING_LENGTH, and ends it with a newline.  What act triggers
+ * are to be told of is left in the dg_ arguments. */
+static void expand_act(const char *orig, struct char_data *ch, struct obj_data *obj,
+    void *vict_obj, struct char_data *to, char *lbuf, struct char_data **dg_victim,
+    struct obj_data **dg_target, char **dg_arg)
 {
   const char *i = NULL;
-  char lbuf[MAX_STRING_LENGTH], *buf, *j;
+  char *buf, *j;
   bool uppercasenext = FALSE;
-  struct char_data *dg_victim = NULL;
-  struct obj_data *dg_target = NULL;
-  char *dg_arg = NULL;
 
   buf = lbuf;
 
@@ -2520,53 +3150,53 @@ void perform_act(const char *orig, struct char_data *ch, struct obj_data *obj,
 	break;
       case 'N':
 	CHECK_NULL(vict_obj, PERS((const struct char_data *) vict_obj, to));
-	dg_victim = (struct char_data *) vict_obj;
+	*dg_victim = (struct char_data *) vict_obj;
 	break;
       case 'm':
 	i = HMHR(ch);
 	break;
       case 'M':
 	CHECK_NULL(vict_obj, HMHR((const struct char_data *) vict_obj));
-	dg_victim = (struct char_data *) vict_obj;
+	*dg_victim = (struct char_data *) vict_obj;
 	break;
       case 's':
 	i = HSHR(ch);
 	break;
       case 'S':
 	CHECK_NULL(vict_obj, HSHR((const struct char_data *) vict_obj));
-	dg_victim = (struct char_data *) vict_obj;
+	*dg_victim = (struct char_data *) vict_obj;
 	break;
       case 'e':
 	i = HSSH(ch);
 	break;
       case 'E':
 	CHECK_NULL(vict_obj, HSSH((const struct char_data *) vict_obj));
-	dg_victim = (struct char_data *) vict_obj;
+	*dg_victim = (struct char_data *) vict_obj;
 	break;
       case 'o':
 	CHECK_NULL(obj, OBJN(obj, to));
 	break;
       case 'O':
 	CHECK_NULL(vict_obj, OBJN((const struct obj_data *) vict_obj, to));
-	dg_target = (struct obj_data *) vict_obj;
+	*dg_target = (struct obj_data *) vict_obj;
 	break;
       case 'p':
 	CHECK_NULL(obj, OBJS(obj, to));
 	break;
       case 'P':
 	CHECK_NULL(vict_obj, OBJS((const struct obj_data *) vict_obj, to));
-	dg_target = (struct obj_data *) vict_obj;
+	*dg_target = (struct obj_data *) vict_obj;
 	break;
       case 'a':
 	CHECK_NULL(obj, SANA(obj));
 	break;
       case 'A':
 	CHECK_NULL(vict_obj, SANA((const struct obj_data *) vict_obj));
-	dg_target = (struct obj_data *) vict_obj;
+	*dg_target = (struct obj_data *) vict_obj;
 	break;
        case 'T':
  	CHECK_NULL(vict_obj, (const char *) vict_obj);
- 	dg_arg = (char *) vict_obj;
+ 	*dg_arg = (char *) vict_obj;
 	break;
       case 't':
  	CHECK_NULL(obj, (char *) obj);
@@ -2616,9 +3246,23 @@ void perform_act(const char *orig, struct char_data *ch, struct obj_data *obj,
   *(--buf) = '\r';
   *(++buf) = '\n';
   *(++buf) = '\0';
+}
+
+void perform_act(const char *orig, struct char_data *ch, struct obj_data *obj,
+    void *vict_obj, struct char_data *to)
+{
+  char lbuf[MAX_STRING_LENGTH];
+  struct char_data *dg_victim = NULL;
+  struct obj_data *dg_target = NULL;
+  char *dg_arg = NULL;
+
+  expand_act(orig, ch, obj, vict_obj, to, lbuf, &dg_victim, &dg_target, &dg_arg);
 
-  if (to->desc)
+  if (to->desc) {
+    output_lowpri = act_lowpri;
     write_to_output(to->desc, "%s", CAP(lbuf));
+    output_lowpri = FALSE;
+  }
 
   if ((IS_NPC(to) && dg_act_check) && (to != ch))
     act_mtrigger(to, lbuf, ch, dg_victim, obj, dg_target, dg_arg);
@@ -2654,6 +3298,11 @@ char *act(const char *str, int hide_invisible, struct char_data *ch,
   if (!(dg_act_check = !IS_SET(type, DG_NO_TRIG)))
     REMOVE_BIT(type, DG_NO_TRIG);
 
+  /* Same again for TO_LOWPRI, which perform_act() passes on to the output
+   * queue so channel chatter can be dropped for players who are backed up. */
+  if ((act_lowpri = IS_SET(type, TO_LOWPRI)))
+    REMOVE_BIT(type, TO_LOWPRI);
+
   if (type == TO_CHAR) {
     if (ch && SENDOK(ch)) {
       perform_act(str, ch, obj, vict_obj, ch);
@@ -2672,18 +3321,18 @@ char *act(const char *str, int hide_invisible, struct char_data *ch,
 
   if (type == TO_GMOTE && !IS_NPC(ch)) {
     struct descriptor_data *i;
-    char buf[MAX_STRING_LENGTH];
+    struct broadcast *b;
 
+    /* global emotes are chatter too */
+    b = broadcast_act(str, ch, obj, vict_obj, TO_LOWPRI | (dg_act_check ? 0 : DG_NO_TRIG));
     for (i = descriptor_list; i; i = i->next) {
       if (!i->connected && i->character &&
           !PRF_FLAGGED(i->character, PRF_NOGOSS) &&
           !PLR_FLAGGED(i->character, PLR_WRITING) &&
-          !ROOM_FLAGGED(IN_ROOM(i->character), ROOM_SOUNDPROOF)) {
-
-        sprintf(buf, "%s%s%s", CCYEL(i->character, C_NRM), str, CCNRM(i->character, C_NRM));
-        perform_act(buf, ch, obj, vict_obj, i->character);
-      }
+          !ROOM_FLAGGED(IN_ROOM(i->character), ROOM_SOUNDPROOF))
+        broadcast_to(b, i->character, CCYEL(i->character, C_NRM), CCNRM(i->character, C_NRM), HIST_NONE);
     }
+    broadcast_end(b);
     return last_act_message;
   }
   /* ASSUMPTION: at this point we know type must be TO_NOTVICT or TO_ROOM */
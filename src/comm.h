@@ -40,15 +40,27 @@ void send_to_range(room_vnum start, room_vnum finish, const char *messg, ...)
 #define TO_GMOTE    5   /**< act() type: to gemote channel (global emote) */
 #define TO_SLEEP    128	/**< act() flag: to char, even if sleeping */
 #define DG_NO_TRIG  256 /**< act() flag: don't check act trigger   */
+#define TO_LOWPRI   512 /**< act() flag: chatter, dropped first when output backs up */
 
 
 /* act functions */
 void perform_act(const char *orig, struct char_data *ch, struct obj_data *obj, void *vict_obj, struct char_data *to);
 char * act(const char *str, int hide_invisible, struct char_data *ch, struct obj_data *obj, void *vict_obj, int type);
 
+/* broadcasts: one message to many, formatted once per kind of recipient */
+struct broadcast *broadcast_act(const char *str, struct char_data *ch, struct obj_data *obj, void *vict_obj, int type);
+struct broadcast *broadcast_text(const char *messg, ...) __attribute__ ((format (printf, 1, 2)));
+struct broadcast *vbroadcast_text(const char *messg, va_list args);
+void broadcast_to(struct broadcast *b, struct char_data *to, const char *pre, const char *post, int hist);
+void broadcast_to_desc(struct broadcast *b, struct descriptor_data *d);
+void broadcast_end(struct broadcast *b);
+
 /* I/O functions */
-void	write_to_q(const char *txt, struct txt_q *queue, int aliased);
+int	write_to_q(const char *txt, struct input_ring *queue, int aliased);
+int	prepend_to_q(struct input_ring *queue, const struct input_ring *lines);
 int	write_to_descriptor(socket_t desc, const char *txt);
+int	write_bytes_to_descriptor(socket_t desc, const char *txt, size_t total);
+int	write_iov_to_descriptor(socket_t desc, struct iovec *iov, int iovcnt);
 size_t	write_to_output(struct descriptor_data *d, const char *txt, ...) __attribute__ ((format (printf, 2, 3)));
 size_t	vwrite_to_output(struct descriptor_data *d, const char *format, va_list args);
 
@@ -64,9 +76,11 @@ void copyover_recover(void);
 extern long last_webster_teller;
 
 extern struct descriptor_data *descriptor_list;
-extern int buf_largecount;
+extern int out_block_count;
+extern size_t out_queue_total;
+extern long out_dropped;
+extern long out_coalesced;
 extern int buf_overflows;
-extern int buf_switches;
 extern int circle_shutdown;
 extern int circle_reboot;
 extern int no_specials;
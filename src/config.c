@@ -15,6 +15,7 @@
 #include "interpreter.h"	/* alias_data definition for structs.h */
 #include "config.h"
 #include "asciimap.h"
+#include "graph.h"
 
 /* Update:  The following constants and variables are now the default values
  * for backwards compatibility with the new cedit game configurator.  If you
@@ -95,6 +96,19 @@ const char *NOEFFECT = "Nothing seems to happen.\r\n";
  * through doors to find the target. */
 int track_through_doors = YES;
 
+/* Should tracking and hunting remember the paths they find, per zone? A
+ * hunting mobile then pays for one search per trip instead of one per step.
+ * Cached paths are dropped whenever an exit is changed, and are only used
+ * while track_through_doors is on, since door state is not part of the key. */
+int track_path_cache = YES;
+
+/* How should track search for a path? TRACK_SEARCH_BFS floods outwards over
+ * every room it can reach, which is slow for far away or unreachable targets.
+ * TRACK_SEARCH_BIDIR searches from both ends at once, and first checks the
+ * zone graph built at boot so unreachable targets are answered without any
+ * search. Both find shortest paths. */
+int track_search_mode = TRACK_SEARCH_BIDIR;
+
 /* If you do not want mortals to level up to immortal once they have enough
  * experience, then set this to YES. Subtracting this from LVL_IMMORT gives
  * the top level that people can advance to in gain_exp() in limits.c */
@@ -132,6 +146,12 @@ int crash_file_timeout = 10;
 /* Lifetime of normal rent files in days. */
 int rent_file_timeout = 30;
 
+/* Should player files be saved in the binary format instead of ASCII? Either
+ * kind is read whatever this is set to, so it can be changed at any time and
+ * each file is converted the next time its player is saved.  bin/pfconv
+ * converts player files between the two offline. */
+int binary_pfiles = NO;
+
 /* Do you want to automatically wipe players who've been gone too long? */
 int auto_pwipe = NO;
 
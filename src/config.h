@@ -34,6 +34,8 @@ extern const char *HUH;
 extern const char *NOPERSON;
 extern const char *NOEFFECT;
 extern int track_through_doors;
+extern int track_path_cache;
+extern int track_search_mode;
 extern int no_mort_to_immort;
 extern int diagonal_dirs;
 extern int free_rent;
@@ -43,6 +45,7 @@ extern int auto_save;
 extern int autosave_time;
 extern int crash_file_timeout;
 extern int rent_file_timeout;
+extern int binary_pfiles;
 /* Room Numbers */
 extern room_vnum mortal_start_room;
 extern room_vnum immort_start_room;
@@ -97,6 +97,7 @@ const char *zone_bits[] = {
   "NOBUILD",
   "!ASTRAL",
   "WORLDMAP",
+  "ALWAYS_ACTIVE",
   "\n"
 };
 
@@ -38,6 +38,8 @@
 #include "mud_event.h"
 #include "msgedit.h"
 #include "screen.h"
+#include "graph.h"
+#include "keyword.h"
 #include <sys/stat.h>
 
 /*  declarations of most of the 'global' variables */
@@ -469,6 +471,9 @@ void boot_world(void)
   log("Renumbering zone table.");
   renum_zone_table();
 
+  log("Building zone graph.");
+  build_zone_graph();
+
   if(converting) {
     log("Saving 128bit world files to disk.");
     save_all();
@@ -606,6 +611,8 @@ void destroy_db(void)
   destroy_quests();
 
   /* Zones */
+  free_path_cache();
+
 #define THIS_CMD zone_table[cnt].cmd[itr]
 
   for (cnt = 0; cnt <= top_of_zone_table; cnt++) {
@@ -652,6 +659,8 @@ void destroy_db(void)
           j = i->next;
           if (i->cmd)
             free(i->cmd);
+          if (i->segs)
+            free(i->segs);
           free(i);
           i = j;
         }
@@ -2394,8 +2403,8 @@ struct char_data *create_char(void)
 
   new_mobile_data(ch);
 
-  ch->next = character_list;
-  character_list = ch;
+  ADD_TO_DLIST(ch, character_list, next, prev);
+  keyword_add_char(ch);
 
   ch->script_id = 0;	// set later by char_script_id
 
@@ -2427,8 +2436,8 @@ struct char_data *read_mobile(mob_vnum nr, int type) /* and mob_rnum */
   clear_char(mob);
 
   *mob = mob_proto[i];
-  mob->next = character_list;
-  character_list = mob;
+  ADD_TO_DLIST(mob, character_list, next, prev);
+  keyword_add_char(mob);
 
   new_mobile_data(mob);
 
@@ -2464,8 +2473,8 @@ struct obj_data *create_obj(void)
 
   CREATE(obj, struct obj_data, 1);
   clear_object(obj);
-  obj->next = object_list;
-  object_list = obj;
+  ADD_TO_DLIST(obj, object_list, next, prev);
+  keyword_add_obj(obj);
 
   obj->events = NULL;
 
@@ -2488,8 +2497,8 @@ struct obj_data *read_object(obj_vnum nr, int type) /* and obj_rnum */
   CREATE(obj, struct obj_data, 1);
   clear_object(obj);
   *obj = obj_proto[i];
-  obj->next = object_list;
-  object_list = obj;
+  ADD_TO_DLIST(obj, object_list, next, prev);
+  keyword_add_obj(obj);
 
   obj->events = NULL;
 
@@ -2753,12 +2762,12 @@ void reset_zone(zone_rnum zone)
     case 'T': /* trigger command */
       if (ZCMD.arg1==MOB_TRIGGER && tmob) {
         if (!SCRIPT(tmob))
-          CREATE(SCRIPT(tmob), struct script_data, 1);
+          SCRIPT(tmob) = create_script(tmob, MOB_TRIGGER);
         add_trigger(SCRIPT(tmob), read_trigger(ZCMD.arg2), -1);
         last_cmd = 1;
       } else if (ZCMD.arg1==OBJ_TRIGGER && tobj) {
         if (!SCRIPT(tobj))
-          CREATE(SCRIPT(tobj), struct script_data, 1);
+          SCRIPT(tobj) = create_script(tobj, OBJ_TRIGGER);
         add_trigger(SCRIPT(tobj), read_trigger(ZCMD.arg2), -1);
         last_cmd = 1;
       } else if (ZCMD.arg1==WLD_TRIGGER) {
@@ -2766,7 +2775,7 @@ void reset_zone(zone_rnum zone)
           ZONE_ERROR("Invalid room number in trigger assignment");
         }
         if (!world[ZCMD.arg3].script)
-          CREATE(world[ZCMD.arg3].script, struct script_data, 1);
+          world[ZCMD.arg3].script = create_script(&world[ZCMD.arg3], WLD_TRIGGER);
         add_trigger(world[ZCMD.arg3].script, read_trigger(ZCMD.arg2), -1);
         last_cmd = 1;
       }
@@ -2822,25 +2831,32 @@ void reset_zone(zone_rnum zone)
 
 /* for use in reset_zone; return TRUE if zone 'nr' is free of PC's  */
 int is_empty(zone_rnum zone_nr)
+{
+  /* Kept up to date by update_zone_players() as players come and go. If an
+   * immortal has nohassle off, he counts as present. Added for testing zone
+   * reset triggers -Welcor */
+  return (zone_table[zone_nr].num_players == 0);
+}
+
+/* Count the players in a zone the slow way, by walking the descriptor list, to
+ * check the num_players counters against. */
+int count_zone_players(zone_rnum zone_nr)
 {
   struct descriptor_data *i;
+  int count = 0;
 
   for (i = descriptor_list; i; i = i->next) {
-    if (STATE(i) != CON_PLAYING)
-      continue;
-    if (IN_ROOM(i->character) == NOWHERE)
+    if (!i->character || IN_ROOM(i->character) == NOWHERE)
       continue;
     if (world[IN_ROOM(i->character)].zone != zone_nr)
       continue;
-    /* If an immortal has nohassle off, he counts as present. Added for testing
-     * zone reset triggers -Welcor */
     if ((!IS_NPC(i->character)) && (GET_LEVEL(i->character) >= LVL_IMMORT) && (PRF_FLAGGED(i->character, PRF_NOHASSLE)))
       continue;
 
-    return (0);
+    count++;
   }
 
-  return (1);
+  return (count);
 }
 
 /* Functions of a general utility nature. */
@@ -3215,6 +3231,8 @@ void free_char(struct char_data *ch)
   int i;
   struct alias_data *a;
 
+  keyword_remove_char(ch);
+
   if (ch->player_specials != NULL && ch->player_specials != &dummy_mob) {
     while ((a = GET_ALIASES(ch)) != NULL) {
       GET_ALIASES(ch) = (GET_ALIASES(ch))->next;
@@ -3306,6 +3324,8 @@ void free_char(struct char_data *ch)
 /* release memory allocated for an obj struct */
 void free_obj(struct obj_data *obj)
 {
+  keyword_remove_obj(obj);
+
   if (GET_OBJ_RNUM(obj) == NOWHERE) {
     free_object_strings(obj);
     /* free script proto list */
@@ -3431,8 +3451,10 @@ void reset_char(struct char_data *ch)
   IN_ROOM(ch) = NOWHERE;
   ch->carrying = NULL;
   ch->next = NULL;
+  ch->prev = NULL;
   ch->next_fighting = NULL;
   ch->next_in_room = NULL;
+  ch->prev_in_room = NULL;
   FIGHTING(ch) = NULL;
   char_from_furniture(ch);
   ch->char_specials.position = POS_STANDING;
@@ -3532,9 +3554,10 @@ void init_char(struct char_data *ch)
     GET_HEIGHT(ch) = rand_number(150, 180); /* 5'0" - 6'0" */
   }
 
-  if ((i = get_ptable_by_name(GET_NAME(ch))) != -1)
+  if ((i = get_ptable_by_name(GET_NAME(ch))) != -1) {
     player_table[i].id = GET_IDNUM(ch) = ++top_idnum;
-  else
+    index_player_id(i);
+  } else
     log("SYSERR: init_char: Character '%s' not found in player table.", GET_NAME(ch));
 
   for (i = 1; i <= MAX_SKILLS; i++) {
@@ -3846,6 +3869,8 @@ static void load_default_config( void )
   CONFIG_NOPERSON	        = strdup(NOPERSON);
   CONFIG_NOEFFECT	        = strdup(NOEFFECT);
   CONFIG_TRACK_T_DOORS          = track_through_doors;
+  CONFIG_TRACK_CACHE            = track_path_cache;
+  CONFIG_TRACK_SEARCH           = track_search_mode;
   CONFIG_NO_MORT_TO_IMMORT	    = no_mort_to_immort;
   CONFIG_DISP_CLOSED_DOORS      = display_closed_doors;
   CONFIG_PROTOCOL_NEGOTIATION   = protocol_negotiation;
@@ -3865,6 +3890,7 @@ static void load_default_config( void )
   CONFIG_AUTOSAVE_TIME	        = autosave_time;
   CONFIG_CRASH_TIMEOUT          = crash_file_timeout;
   CONFIG_RENT_TIMEOUT	        = rent_file_timeout;
+  CONFIG_BINARY_PFILES          = binary_pfiles;
 
   /* Room numbers. */
   CONFIG_MORTAL_START           = mortal_start_room;
@@ -3938,6 +3964,11 @@ void load_config( void )
           CONFIG_OLC_SAVE = num;
         break;
 
+      case 'b':
+        if (!str_cmp(tag, "binary_pfiles"))
+          CONFIG_BINARY_PFILES = num;
+        break;
+
       case 'c':
         if (!str_cmp(tag, "crash_file_timeout"))
           CONFIG_CRASH_TIMEOUT = num;
@@ -4136,6 +4167,10 @@ void load_config( void )
           CONFIG_TUNNEL_SIZE = num;
         else if (!str_cmp(tag, "track_through_doors"))
           CONFIG_TRACK_T_DOORS = num;
+        else if (!str_cmp(tag, "track_path_cache"))
+          CONFIG_TRACK_CACHE = num;
+        else if (!str_cmp(tag, "track_search_mode"))
+          CONFIG_TRACK_SEARCH = num;
         break;
 
       case 'u':
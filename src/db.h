@@ -189,6 +189,11 @@ struct zone_data {
    zone_vnum number;	    /* virtual number of this zone	  */
    struct reset_com *cmd;   /* command table for reset	          */
 
+   int num_players;         /* players in this zone, see is_empty() */
+   unsigned long last_player; /* pulse the last player left       */
+   struct script_data *random_scripts; /* random triggers in zone */
+   struct path_cache_entry *path_cache; /* next-hop cache, see graph.c */
+
    /* Reset mode:
     *   0: Don't reset, and don't update age.
     *   1: Reset if no PC's are located in zone.
@@ -265,6 +270,7 @@ obj_rnum real_object(obj_vnum vnum);
 
 /* Public Procedures from objsave.c */
 void  Crash_save_all(void);
+int   Crash_save_some(int round, int max);
 void  Crash_idlesave(struct char_data *ch);
 void  Crash_crashsave(struct char_data *ch);
 int Crash_load(struct char_data *ch);
@@ -283,6 +289,8 @@ SPECIAL(cryogenicist);
 /* Functions from players.c */
 void   tag_argument(char *argument, char *tag);
 int    load_char(const char *name, struct char_data *ch);
+int    load_char_lazy(const char *name, struct char_data *ch);
+void   load_char_deferred(struct char_data *ch);
 void   save_char(struct char_data *ch);
 void   init_char(struct char_data *ch);
 struct char_data* create_char(void);
@@ -293,6 +301,9 @@ void   reset_char(struct char_data *ch);
 void   free_char(struct char_data *ch);
 void   save_player_index(void);
 long   get_ptable_by_name(const char *name);
+long   get_ptable_by_id(long id);
+void   index_player_name(int pos);
+void   index_player_id(int pos);
 void   remove_player(int pfilepos);
 void   clean_pfiles(void);
 void   build_player_index(void);
@@ -312,6 +323,7 @@ void parse_room(FILE *fl, int virtual_nr);
 void parse_mobile(FILE *mob_f, int nr);
 char *parse_object(FILE *obj_f, int nr);
 int is_empty(zone_rnum zone_nr);
+int count_zone_players(zone_rnum zone_nr);
 void reset_zone(zone_rnum zone);
 void reboot_wizlists(void);
 ACMD(do_reboot);
@@ -71,6 +71,8 @@ void parse_trigger(FILE *trig_f, int nr)
     free(cmds);
 
     trig_index[top_of_trigt++] = t_index;
+
+    compile_trigger(trig);
 }
 
 /* Create a new trigger from a prototype. nr is the real number of the trigger. */
@@ -104,7 +106,7 @@ static void trig_data_init(trig_data *this_data)
     this_data->depth = 0;
     this_data->wait_event = NULL;
     this_data->purged = FALSE;
-    this_data->var_list = NULL;
+    memset(&this_data->var_list, 0, sizeof(this_data->var_list));
 
     this_data->next = NULL;
 }
@@ -200,7 +202,7 @@ void dg_read_trigger(FILE *fp, void *proto, int type)
 
       if (rnum != NOTHING) {
         if (!(room->script))
-          CREATE(room->script, struct script_data, 1);
+          room->script = create_script(room, WLD_TRIGGER);
         add_trigger(SCRIPT(room), read_trigger(rnum), -1);
       } else {
         mudlog(BRF, LVL_BUILDER, TRUE,
@@ -270,7 +272,7 @@ void assign_triggers(void *i, int type)
                  trg_proto->vnum, mob_index[mob->nr].vnum);
         } else {
           if (!SCRIPT(mob))
-            CREATE(SCRIPT(mob), struct script_data, 1);
+            SCRIPT(mob) = create_script(mob, MOB_TRIGGER);
           add_trigger(SCRIPT(mob), read_trigger(rnum), -1);
         }
         trg_proto = trg_proto->next;
@@ -286,7 +288,7 @@ void assign_triggers(void *i, int type)
             trg_proto->vnum, obj_index[obj->item_number].vnum);
         } else {
           if (!SCRIPT(obj))
-            CREATE(SCRIPT(obj), struct script_data, 1);
+            SCRIPT(obj) = create_script(obj, OBJ_TRIGGER);
           add_trigger(SCRIPT(obj), read_trigger(rnum), -1);
         }
         trg_proto = trg_proto->next;
@@ -303,7 +305,7 @@ void assign_triggers(void *i, int type)
                  trg_proto->vnum, room->number);
         } else {
           if (!SCRIPT(room))
-            CREATE(SCRIPT(room), struct script_data, 1);
+            SCRIPT(room) = create_script(room, WLD_TRIGGER);
           add_trigger(SCRIPT(room), read_trigger(rnum), -1);
         }
         trg_proto = trg_proto->next;
@@ -25,6 +25,7 @@
 #include "constants.h"
 #include "comm.h"  /* For access to the game pulse */
 #include "mud_event.h"
+#include "pool.h"
 
 /***************************************************************************
  * Begin mud specific event queue functions
@@ -32,6 +33,9 @@
 /* file scope variables */
 /** The mud specific queue of events. */
 static struct dg_queue *event_q;
+/** Pools for events and their queue elements. */
+static struct mem_pool *event_pool = NULL;
+static struct mem_pool *q_element_pool = NULL;
 
 
 /** Initializes the main event queue event_q.
@@ -61,7 +65,7 @@ struct event *event_create(EVENTFUNC(*func), void *event_obj, long when)
   if (when < 1) /* make sure its in the future */
     when = 1;
 
-  CREATE(new_event, struct event, 1);
+  POOL_CREATE(new_event, event_pool, struct event);
   new_event->func = func;
   new_event->event_obj = event_obj;
   new_event->q_el = queue_enq(event_q, new_event, when + pulse);
@@ -88,7 +92,7 @@ void event_cancel(struct event *event)
   if (event->event_obj)
       cleanup_event_obj(event);
 
-  free(event);
+  pool_free(event_pool, event);
 }
 
 /* The memory freeing routine tied into the mud event system */
@@ -111,11 +115,7 @@ void event_process(void)
   struct event *the_event;
   long new_time;
 
-  while ((long) pulse >= queue_key(event_q)) {
-    if (!(the_event = (struct event *) queue_head(event_q))) {
-      log("SYSERR: Attempt to get a NULL event");
-      return;
-    }
+  while ((the_event = (struct event *) queue_head(event_q)) != NULL) {
 
     /* Set the_event->q_el to NULL so that any functions called beneath
      * event_process can tell if they're being called beneath the actual
@@ -130,7 +130,7 @@ void event_process(void)
       if (the_event->isMudEvent && the_event->event_obj != NULL)
         free_mud_event((struct mud_event_data *) the_event->event_obj);
       /* It is assumed that the_event will already have freed ->event_obj. */
-      free(the_event);
+      pool_free(event_pool, the_event);
     }
 
   }
@@ -179,10 +179,100 @@ struct dg_queue *queue_init(void)
   struct dg_queue *q;
 
   CREATE(q, struct dg_queue, 1);
+  q->now = pulse;
 
   return q;
 }
 
+/** Find the wheel slot a key belongs in, given the queue's current position.
+ * Keys due within WHEEL_SIZE pulses go to level 0; later keys go to the
+ * lowest level whose span still covers them.
+ * @param q The queue.
+ * @param key The pulse the element is due on; must not be before q->now.
+ * @retval q_slot * The slot to link the element into. */
+static struct q_slot *queue_slot(struct dg_queue *q, unsigned long key)
+{
+  unsigned long delta = key - q->now;
+  int level;
+
+  /* Anything beyond the top level's span waits in its furthest slot and is
+   * simply cascaded again when that slot comes around. */
+  if (delta >= WHEEL_HORIZON)
+    key = q->now + WHEEL_HORIZON;
+
+  for (level = 0; level < WHEEL_LEVELS - 1; level++)
+    if (delta < (1UL << (WHEEL_BITS * (level + 1))))
+      break;
+
+  return &q->wheel[level][(key >> (WHEEL_BITS * level)) & WHEEL_MASK];
+}
+
+/** Append qe to the end of a slot. */
+static void slot_link(struct q_slot *slot, struct q_element *qe)
+{
+  qe->slot = slot;
+  qe->next = NULL;
+  qe->prev = slot->tail;
+
+  if (slot->tail)
+    slot->tail->next = qe;
+  else
+    slot->head = qe;
+  slot->tail = qe;
+}
+
+/** Detach qe from whatever slot it is in. */
+static void slot_unlink(struct q_element *qe)
+{
+  struct q_slot *slot = qe->slot;
+
+  if (qe->prev == NULL)
+    slot->head = qe->next;
+  else
+    qe->prev->next = qe->next;
+
+  if (qe->next == NULL)
+    slot->tail = qe->prev;
+  else
+    qe->next->prev = qe->prev;
+
+  qe->prev = qe->next = NULL;
+  qe->slot = NULL;
+}
+
+/** Move every element of a higher level slot down to where it now belongs.
+ * @param q The queue.
+ * @param level The level being cascaded, 1 or higher.
+ * @retval int The index of the slot that was cascaded. */
+static int queue_cascade(struct dg_queue *q, int level)
+{
+  struct q_slot *slot;
+  struct q_element *qe;
+  int index = (q->now >> (WHEEL_BITS * level)) & WHEEL_MASK;
+
+  slot = &q->wheel[level][index];
+  while ((qe = slot->head) != NULL) {
+    slot_unlink(qe);
+    slot_link(queue_slot(q, (unsigned long) qe->key), qe);
+  }
+
+  return index;
+}
+
+/** Step level 0 forward one pulse, cascading higher levels as they wrap. */
+static void queue_advance(struct dg_queue *q)
+{
+  int level;
+
+  q->now++;
+
+  for (level = 1; level < WHEEL_LEVELS; level++) {
+    if ((q->now >> (WHEEL_BITS * (level - 1))) & WHEEL_MASK)
+      break;
+    queue_cascade(q, level);
+  }
+}
+
 /** Add some 'data' to a priority queue.
  * @pre The paremeter q must have been previously created by queue_init.
  * @post A new q_element is created to hold the data parameter.
@@ -195,43 +285,18 @@ struct dg_queue *queue_init(void)
  * the data. */
 struct q_element *queue_enq(struct dg_queue *q, void *data, long key)
 {
-  struct q_element *qe, *i;
-  int bucket;
+  struct q_element *qe;
 
-  CREATE(qe, struct q_element, 1);
+  POOL_CREATE(qe, q_element_pool, struct q_element);
   qe->data = data;
-  qe->key = key;
-
-  bucket = key % NUM_EVENT_QUEUES;   /* which queue does this go in */
-
-  if (!q->head[bucket]) { /* queue is empty */
-    q->head[bucket] = qe;
-    q->tail[bucket] = qe;
-  }
 
-  else {
-    for (i = q->tail[bucket]; i; i = i->prev) {
-
-      if (i->key < key) { /* found insertion point */
-	if (i == q->tail[bucket])
-	  q->tail[bucket] = qe;
-	else {
-	  qe->next = i->next;
-	  i->next->prev = qe;
-	}
-
-	qe->prev = i;
-	i->next = qe;
-	break;
-      }
-    }
+  /* Never schedule behind the wheel; it would not come around again. */
+  if (key < (long) q->now)
+    key = q->now;
+  qe->key = key;
 
-    if (i == NULL) { /* insertion point is front of list */
-      qe->next = q->head[bucket];
-      q->head[bucket] = qe;
-      qe->next->prev = qe;
-    }
-  }
+  slot_link(queue_slot(q, (unsigned long) key), qe);
+  q->size++;
 
   return qe;
 }
@@ -244,61 +309,57 @@ struct q_element *queue_enq(struct dg_queue *q, void *data, long key)
  */
 void queue_deq(struct dg_queue *q, struct q_element *qe)
 {
-  int i;
-
   assert(qe);
 
-  i = qe->key % NUM_EVENT_QUEUES;
-
-  if (qe->prev == NULL)
-    q->head[i] = qe->next;
-  else
-    qe->prev->next = qe->next;
+  slot_unlink(qe);
+  q->size--;
 
-  if (qe->next == NULL)
-    q->tail[i] = qe->prev;
-  else
-    qe->next->prev = qe->prev;
-
-  free(qe);
+  pool_free(q_element_pool, qe);
 }
 
-/** Removes and returns the data of the first element of the priority queue q.
- * @pre pulse must be defined. This is a multi-headed queue, the current
- * head is determined by the current pulse.
- * @post the q->head is dequeued.
+/** Removes and returns the data of the next element that is due.
+ * @pre pulse must be defined. The wheel is advanced, one pulse at a time,
+ * until it catches up with the current pulse.
+ * @post the returned element is dequeued.
  * @param q The queue to return the head of.
- * @retval void * NULL if there is not a currently available head, pointer
- * to any data object associated with the queue element. */
+ * @retval void * NULL if nothing is due by the current pulse, otherwise a
+ * pointer to the data object associated with the queue element. */
 void *queue_head(struct dg_queue *q)
 {
+  struct q_slot *slot;
   void *dg_data;
-  int i;
 
-  i = pulse % NUM_EVENT_QUEUES;
+  for (;;) {
+    slot = &q->wheel[0][q->now & WHEEL_MASK];
+
+    if (slot->head) {
+      dg_data = slot->head->data;
+      queue_deq(q, slot->head);
+      return dg_data;
+    }
 
-  if (!q->head[i])
-    return NULL;
+    if (q->now >= pulse || q->size == 0) {
+      /* Nothing queued: jump straight to the present. The wheel is empty,
+       * so there is nothing to cascade. */
+      if (q->size == 0)
+        q->now = pulse;
+      return NULL;
+    }
 
-  dg_data = q->head[i]->data;
-  queue_deq(q, q->head[i]);
-  return dg_data;
+    queue_advance(q);
+  }
 }
 
-/** Returns the key of the head element of the priority queue.
- * @pre pulse must be defined. This is a multi-headed queue, the current
- * head is determined by the current pulse.
+/** Returns the key of the next element due at the wheel's current position.
  * @param q Queue to check for.
- * @retval long Return the key element of the head q_element. If no head
- * q_element is available, return LONG_MAX. */
+ * @retval long Return the key element of the head q_element. If no element
+ * is due at the current position, return LONG_MAX. */
 long queue_key(struct dg_queue *q)
 {
-  int i;
-
-  i = pulse % NUM_EVENT_QUEUES;
+  struct q_slot *slot = &q->wheel[0][q->now & WHEEL_MASK];
 
-  if (q->head[i])
-    return q->head[i]->key;
+  if (slot->head)
+    return slot->head->key;
   else
     return LONG_MAX;
 }
@@ -318,23 +379,26 @@ long queue_elmt_key(struct q_element *qe)
  */
 void queue_free(struct dg_queue *q)
 {
-  int i;
+  int level, i;
   struct q_element *qe, *next_qe;
   struct event *event;
 
-  for (i = 0; i < NUM_EVENT_QUEUES; i++)
+  for (level = 0; level < WHEEL_LEVELS; level++)
   {
-    for (qe = q->head[i]; qe; qe = next_qe)
+    for (i = 0; i < WHEEL_SIZE; i++)
     {
-      next_qe = qe->next;
-      if ((event = (struct event *) qe->data) != NULL)
+      for (qe = q->wheel[level][i].head; qe; qe = next_qe)
       {
-        if (event->event_obj)
-          cleanup_event_obj(event);
-
-        free(event);
+        next_qe = qe->next;
+        if ((event = (struct event *) qe->data) != NULL)
+        {
+          if (event->event_obj)
+            cleanup_event_obj(event);
+
+          pool_free(event_pool, event);
+        }
+        pool_free(q_element_pool, qe);
       }
-      free(qe);
     }
   }
 
@@ -42,19 +42,40 @@ struct event {
 /**************************************************************************
  * Begin priority queue structures and defines.
  **************************************************************************/
-/** Number of buckets available in each queue. Reduces enqueue cost. */
-#define NUM_EVENT_QUEUES    10
+/** Bits of the pulse key resolved by each level of the timing wheel. */
+#define WHEEL_BITS    8
+/** Number of slots in each level of the timing wheel. */
+#define WHEEL_SIZE    (1 << WHEEL_BITS)
+/** Mask used to find a slot within one level. */
+#define WHEEL_MASK    (WHEEL_SIZE - 1)
+/** Number of levels; together they cover 2^32 pulses (about 13 real years). */
+#define WHEEL_LEVELS  4
+/** Furthest ahead of the wheel a key can be placed.  Wider than a long, since
+ * the levels span all 32 bits of a long where it has only 32. */
+#define WHEEL_HORIZON (((unsigned long long) 1 << (WHEEL_BITS * WHEEL_LEVELS)) - 1)
 
-/** The priority queue. */
+/** One slot of the timing wheel, an unordered list of queued elements. */
+struct q_slot {
+  struct q_element *head; /**< First element in this slot. */
+  struct q_element *tail; /**< Last element in this slot. */
+};
+
+/** The priority queue, a hierarchical timing wheel keyed on pulse. Level 0
+ * holds elements due within the next WHEEL_SIZE pulses, one slot per pulse.
+ * Each higher level covers WHEEL_SIZE times the span of the one below and is
+ * cascaded down a level whenever the lower level wraps around, so enqueue,
+ * dequeue and firing are all constant time regardless of queue depth. */
 struct dg_queue {
-  struct q_element *head[NUM_EVENT_QUEUES]; /**< Front of each queue bucket. */
-  struct q_element *tail[NUM_EVENT_QUEUES]; /**< Rear of each queue bucket. */
+  struct q_slot wheel[WHEEL_LEVELS][WHEEL_SIZE]; /**< The wheel levels. */
+  unsigned long now; /**< The pulse level 0 is currently positioned at. */
+  long size;         /**< Number of elements in the queue. */
 };
 
 /** Queued elements. */
 struct q_element {
   void *data;  /**< The event to be handled. */
   long key;    /**< When the event should be handled. */
+  struct q_slot *slot; /**< The wheel slot this element is linked into. */
   struct q_element *prev, *next; /**< Points to other q_elements in line. */
 };
 /**************************************************************************
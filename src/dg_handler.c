@@ -34,35 +34,46 @@ void free_var_el(struct trig_var_data *var)
   free(var);
 }
 
-/* release memory allocated for a variable list */
-void free_varlist(struct trig_var_data *vd)
+/* release memory allocated for a variable list, leaving it empty */
+void free_varlist(struct trig_var_list *vars)
 {
     struct trig_var_data *i, *j;
 
-    for (i = vd; i;) {
+    for (i = vars->head; i;) {
 	j = i;
 	i = i->next;
 	free_var_el(j);
     }
+    if (vars->buckets)
+      free(vars->buckets);
+    memset(vars, 0, sizeof(*vars));
+}
+
+/* Unlink var from the list and its hash chain, and free it. */
+void remove_var_el(struct trig_var_list *vars, struct trig_var_data *var)
+{
+  struct trig_var_data **p;
+
+  for (p = &vars->head; *p != var; p = &(*p)->next);
+  *p = var->next;
+
+  if (vars->buckets) {
+    for (p = &vars->buckets[var->hash & (vars->num_buckets - 1)]; *p != var;
+         p = &(*p)->next_in_bucket);
+    *p = var->next_in_bucket;
+  }
+
+  vars->count--;
+  free_var_el(var);
 }
 
 /* Remove var name from var_list. Returns 1 if found, else 0. */
-int remove_var(struct trig_var_data **var_list, char *name)
+int remove_var(struct trig_var_list *vars, char *name)
 {
-  struct trig_var_data *i, *j;
-
-  for (j = NULL, i = *var_list; i && str_cmp(name, i->name);
-       j = i, i = i->next);
-
-  if (i) {
-    if (j) {
-      j->next = i->next;
-      free_var_el(i);
-    } else {
-      *var_list = i->next;
-      free_var_el(i);
-    }
+  struct trig_var_data *i;
 
+  if ((i = find_var(vars, name))) {
+    remove_var_el(vars, i);
     return 1;
   }
 
@@ -80,10 +91,7 @@ void free_trigger(struct trig_data *trig)
       free(trig->arglist);
       trig->arglist = NULL;
     }
-    if (trig->var_list) {
-      free_varlist(trig->var_list);
-      trig->var_list = NULL;
-    }
+    free_varlist(&trig->var_list);
     if (GET_TRIG_WAIT(trig))
       event_cancel(GET_TRIG_WAIT(trig));
 
@@ -108,6 +116,23 @@ void extract_trigger(struct trig_data *trig)
   free_trigger(trig);
 }
 
+/* allocate an empty script for a mob/obj/room, remembering what it is on */
+struct script_data *create_script(void *thing, int type)
+{
+  struct script_data *sc;
+
+  CREATE(sc, struct script_data, 1);
+  sc->attach_type = type;
+
+  /* Rooms move about in world[] as rooms are added, so keep the vnum. */
+  if (type == WLD_TRIGGER)
+    sc->attached_room = ((struct room_data *)thing)->number;
+  else
+    sc->attached = thing;
+
+  return sc;
+}
+
 /* remove all triggers from a mob/obj/room */
 void extract_script(void *thing, int type)
 {
@@ -152,6 +177,8 @@ void extract_script(void *thing, int type)
     }
   }
 #endif
+  random_index_remove(sc);
+
   for (trig = TRIGGERS(sc); trig; trig = next_trig) {
     next_trig = trig->next;
     extract_trigger(trig);
@@ -159,7 +186,7 @@ void extract_script(void *thing, int type)
   TRIGGERS(sc) = NULL;
 
   /* Thanks to James Long for tracking down this memory leak */
-  free_varlist(sc->global_vars);
+  free_varlist(&sc->global_vars);
 
   free(sc);
 }
@@ -134,8 +134,7 @@ void do_dg_cast(void *go, struct script_data *sc, trig_data *trig, int type, cha
         strdup(((struct obj_data *)go)->short_description);
     else if (type==WLD_TRIGGER)
       caster->player.short_descr = strdup("The gods");
-    caster->next_in_room = caster_room->people;
-    caster_room->people = caster;
+    ADD_TO_DLIST(caster, caster_room->people, next_in_room, prev_in_room);
     caster->in_room = real_room(caster_room->number);
     call_magic(caster, tch, tobj, spellnum, DG_SPELL_LEVEL, CAST_SPELL);
     extract_char(caster);
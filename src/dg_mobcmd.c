@@ -22,6 +22,8 @@
 #include "genzon.h" /* for real_zone_by_thing */
 #include "act.h"
 #include "fight.h"
+#include "graph.h"
+#include "keyword.h"
 
 
 /* Local file scope functions. */
@@ -958,11 +960,14 @@ ACMD(do_mtransform)
     tmpmob.memory = ch->memory;
     tmpmob.events = ch->events;
     tmpmob.next_in_room = ch->next_in_room;
+    tmpmob.prev_in_room = ch->prev_in_room;
     tmpmob.next = ch->next;
+    tmpmob.prev = ch->prev;
     tmpmob.next_fighting = ch->next_fighting;
     tmpmob.followers = ch->followers;
     tmpmob.master = ch->master;
     tmpmob.group = ch->group;
+    tmpmob.keywords = ch->keywords;
 
     GET_WAS_IN(&tmpmob) = GET_WAS_IN(ch);
     if (keep_hp) {
@@ -976,7 +981,10 @@ ACMD(do_mtransform)
     IS_CARRYING_N(&tmpmob) = IS_CARRYING_N(ch);
     FIGHTING(&tmpmob) = FIGHTING(ch);
     HUNTING(&tmpmob) = HUNTING(ch);
+    tmpmob.char_specials.zone_counted = ch->char_specials.zone_counted;
     memcpy(ch, &tmpmob, sizeof(*ch));
+    update_zone_players(ch);
+    keyword_update_char(ch);
 
     for (pos = 0; pos < NUM_WEARS; pos++) {
       if (obj[pos])
@@ -1049,6 +1057,7 @@ ACMD(do_mdoor)
                 free(newexit->keyword);
             free(newexit);
             rm->dir_option[dir] = NULL;
+            invalidate_path_cache();
         }
     }
 
@@ -1056,6 +1065,7 @@ ACMD(do_mdoor)
         if (!newexit) {
             CREATE(newexit, struct room_direction_data, 1);
             rm->dir_option[dir] = newexit;
+            invalidate_path_cache();
         }
 
         switch (fd) {
@@ -1079,9 +1089,10 @@ ACMD(do_mdoor)
             strcpy(newexit->keyword, value);
             break;
         case 5:  /* room        */
-            if ((to_room = real_room(atoi(value))) != NOWHERE)
+            if ((to_room = real_room(atoi(value))) != NOWHERE) {
                 newexit->to_room = to_room;
-            else
+                invalidate_path_cache();
+            } else
                 mob_log(ch, "mdoor: invalid door target");
             break;
         }
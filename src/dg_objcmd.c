@@ -20,6 +20,8 @@
 #include "constants.h"
 #include "genzon.h" /* for access to real_zone_by_thing */
 #include "fight.h" /* for die() */
+#include "graph.h"  /* for invalidate_path_cache() */
+#include "keyword.h"
 
 
 
@@ -334,8 +336,12 @@ static OCMD(do_otransform)
     tmpobj.proto_script = obj->proto_script;
     tmpobj.script = obj->script;
     tmpobj.next_content = obj->next_content;
+    tmpobj.prev_content = obj->prev_content;
     tmpobj.next = obj->next;
+    tmpobj.prev = obj->prev;
+    tmpobj.keywords = obj->keywords;
     memcpy(obj, &tmpobj, sizeof(*obj));
+    keyword_update_obj(obj);
 
     if (wearer) {
       equip_char(wearer, obj, pos);
@@ -650,6 +656,7 @@ static OCMD(do_odoor)
                 free(newexit->keyword);
             free(newexit);
             rm->dir_option[dir] = NULL;
+            invalidate_path_cache();
         }
     }
 
@@ -657,6 +664,7 @@ static OCMD(do_odoor)
         if (!newexit) {
             CREATE(newexit, struct room_direction_data, 1);
             rm->dir_option[dir] = newexit;
+            invalidate_path_cache();
         }
 
         switch (fd) {
@@ -680,9 +688,10 @@ static OCMD(do_odoor)
             strcpy(newexit->keyword, value);
             break;
         case 5:  /* room        */
-            if ((to_room = real_room(atoi(value))) != NOWHERE)
+            if ((to_room = real_room(atoi(value))) != NOWHERE) {
                 newexit->to_room = to_room;
-            else
+                invalidate_path_cache();
+            } else
                 obj_log(obj, "odoor: invalid door target");
             break;
         }
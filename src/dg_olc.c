@@ -642,6 +642,8 @@ void trigedit_save(struct descriptor_data *d)
       next_cmd = cmd->next;
       if (cmd->cmd)
         free(cmd->cmd);
+      if (cmd->segs)
+        free(cmd->segs);
       free(cmd);
     }
 
@@ -671,6 +673,7 @@ void trigedit_save(struct descriptor_data *d)
 
     /* make the prorotype look like what we have */
     trig_data_copy(proto, trig);
+    compile_trigger(proto);
 
     /* go through the mud and replace existing triggers         */
     live_trig = trigger_list;
@@ -696,10 +699,7 @@ void trigedit_save(struct descriptor_data *d)
           event_cancel(GET_TRIG_WAIT(live_trig));
           GET_TRIG_WAIT(live_trig)=NULL;
         }
-        if (live_trig->var_list) {
-          free_varlist(live_trig->var_list);
-          live_trig->var_list=NULL;
-        }
+        free_varlist(&live_trig->var_list);
 
         live_trig->cmdlist = proto->cmdlist;
         live_trig->curr_state = live_trig->cmdlist;
@@ -782,6 +782,8 @@ void trigedit_save(struct descriptor_data *d)
     trig_index = new_index;
     top_of_trigt++;
 
+    compile_trigger(trig_index[rnum]->proto);
+
     /* HERE IT HAS TO GO THROUGH AND FIX ALL SCRIPTS/TRIGS OF HIGHER RNUM */
     for (live_trig = trigger_list; live_trig; live_trig = live_trig->next_in_world)
       GET_TRIG_RNUM(live_trig) += (GET_TRIG_RNUM(live_trig) != NOTHING && GET_TRIG_RNUM(live_trig) > rnum);
@@ -29,6 +29,7 @@
 #include "genzon.h" /* for real_zone_by_thing */
 #include "act.h"
 #include "modify.h"
+#include "keyword.h"
 
 #define PULSES_PER_MUD_HOUR     (SECS_PER_MUD_HOUR*PASSES_PER_SEC)
 
@@ -51,6 +52,8 @@ static int process_if(char *cond, void *go, struct script_data *sc,
 static struct cmdlist_element *find_end(trig_data *trig, struct cmdlist_element *cl);
 static struct cmdlist_element *find_else_end(trig_data *trig,
           struct cmdlist_element *cl, void *go, struct script_data *sc, int type);
+static struct cmdlist_element *scan_else_end(trig_data *trig,
+          struct cmdlist_element *cl, byte *op);
 static void process_wait(void *go, trig_data *trig, int type, char *cmd,
           struct cmdlist_element *cl);
 static void process_set(struct script_data *sc, trig_data *trig, char *cmd);
@@ -70,7 +73,10 @@ static void extract_value(struct script_data *sc, trig_data *trig, char *cmd);
 static void dg_letter_value(struct script_data *sc, trig_data *trig, char *cmd);
 static struct cmdlist_element * find_case(struct trig_data *trig, struct cmdlist_element *cl,
           void *go, struct script_data *sc, int type, char *cond);
+static struct cmdlist_element *scan_case(struct cmdlist_element *cl, byte *op);
 static struct cmdlist_element *find_done(struct cmdlist_element *cl);
+static int dg_line_kind(const char *p);
+static int dg_command_verb(const char *cmd);
 static struct char_data *find_char_by_uid_in_lookup_table(long uid);
 static struct obj_data *find_obj_by_uid_in_lookup_table(long uid);
 static EVENTFUNC(trig_wait_event);
@@ -336,7 +342,8 @@ static room_data *find_room(long n)
  * @retval char_data * Pointer to the char or NULL if char is not found. */
 char_data *get_char(char *name)
 {
-  char_data *i;
+  char_data *i, **found;
+  int j, count;
 
   if (*name == UID_CHAR) {
     i = find_char(atoi(name + 1));
@@ -344,10 +351,11 @@ char_data *get_char(char *name)
     if (i && valid_dg_target(i, DG_ALLOW_GODS))
       return i;
   } else {
-    for (i = character_list; i; i = i->next)
-      if (isname(name, i->player.name) &&
-          valid_dg_target(i, DG_ALLOW_GODS))
-        return i;
+    found = keyword_find_chars(name, &count);
+    for (j = 0; j < count; j++)
+      if (isname(name, found[j]->player.name) &&
+          valid_dg_target(found[j], DG_ALLOW_GODS))
+        return found[j];
   }
 
   return NULL;
@@ -466,14 +474,16 @@ obj_data *get_obj_near_obj(obj_data *obj, char *name)
 /* returns the object in the world with name name, or NULL if not found */
 obj_data *get_obj(char *name)
 {
-  obj_data *obj;
+  obj_data **found;
+  int j, count;
 
   if (*name == UID_CHAR)
     return find_obj(atoi(name + 1));
   else {
-    for (obj = object_list; obj; obj = obj->next)
-      if (isname(name, obj->name))
-        return obj;
+    found = keyword_find_objs(name, &count);
+    for (j = 0; j < count; j++)
+      if (isname(name, found[j]->name))
+        return found[j];
   }
 
   return NULL;
@@ -496,7 +506,8 @@ room_data *get_room(char *name)
  * none found.  Starts searching with the person owing the object. */
 char_data *get_char_by_obj(obj_data *obj, char *name)
 {
-  char_data *ch;
+  char_data *ch, **found;
+  int j, count;
 
   if (*name == UID_CHAR) {
     ch = find_char(atoi(name + 1));
@@ -514,10 +525,11 @@ char_data *get_char_by_obj(obj_data *obj, char *name)
         valid_dg_target(obj->worn_by, DG_ALLOW_GODS))
       return obj->worn_by;
 
-    for (ch = character_list; ch; ch = ch->next)
-      if (isname(name, ch->player.name) &&
-          valid_dg_target(ch, DG_ALLOW_GODS))
-        return ch;
+    found = keyword_find_chars(name, &count);
+    for (j = 0; j < count; j++)
+      if (isname(name, found[j]->player.name) &&
+          valid_dg_target(found[j], DG_ALLOW_GODS))
+        return found[j];
   }
 
   return NULL;
@@ -527,7 +539,8 @@ char_data *get_char_by_obj(obj_data *obj, char *name)
  * none found.  Starts searching in room room first. */
 char_data *get_char_by_room(room_data *room, char *name)
 {
-  char_data *ch;
+  char_data *ch, **found;
+  int j, count;
 
   if (*name == UID_CHAR) {
     ch = find_char(atoi(name + 1));
@@ -540,10 +553,11 @@ char_data *get_char_by_room(room_data *room, char *name)
           valid_dg_target(ch, DG_ALLOW_GODS))
         return ch;
 
-    for (ch = character_list; ch; ch = ch->next)
-      if (isname(name, ch->player.name) &&
-          valid_dg_target(ch, DG_ALLOW_GODS))
-        return ch;
+    found = keyword_find_chars(name, &count);
+    for (j = 0; j < count; j++)
+      if (isname(name, found[j]->player.name) &&
+          valid_dg_target(found[j], DG_ALLOW_GODS))
+        return found[j];
   }
 
   return NULL;
@@ -614,55 +628,151 @@ obj_data *get_obj_by_room(room_data *room, char *name)
     if (isname(name, obj->name))
       return obj;
 
-  for (obj = object_list; obj; obj = obj->next)
-    if (isname(name, obj->name))
-      return obj;
-
-  return NULL;
+  return get_obj(name);
 }
 
 /* checks every PULSE_SCRIPT for random triggers */
-void script_trigger_check(void)
-{
-  char_data *ch;
-  obj_data *obj;
-  struct room_data *room=NULL;
-  room_rnum nr;
-  struct script_data *sc;
+/* Scripts with random triggers are kept in buckets so script_trigger_check()
+ * only looks at the ones that can fire.  Mobs and rooms go in the bucket of
+ * the zone they are in, and are only checked while players are there.
+ * Objects, and anything with a global trigger, go in random_global and are
+ * checked every time. */
+static struct script_data *random_global = NULL;
+/* The next script script_trigger_check() will visit.  Moved on if that script
+ * leaves its bucket while a trigger is running. */
+static struct script_data *random_cursor = NULL;
+/* Bumped on every check, so a mob that walks into a zone still to be visited
+ * does not get a second turn. */
+static unsigned long random_pass = 0;
+
+/* Work out the bucket a script belongs in.  Returns FALSE if it should not be
+ * indexed at all. */
+static bool random_bucket(struct script_data *sc, zone_rnum *zone)
+{
+  struct char_data *ch;
+  room_rnum rnum;
 
-  for (ch = character_list; ch; ch = ch->next) {
-    if (SCRIPT(ch)) {
-      sc = SCRIPT(ch);
+  if (!IS_SET(SCRIPT_TYPES(sc), WTRIG_RANDOM))
+    return FALSE;
 
-      if (IS_SET(SCRIPT_TYPES(sc), WTRIG_RANDOM) &&
-          (!is_empty(world[IN_ROOM(ch)].zone) ||
-           IS_SET(SCRIPT_TYPES(sc), WTRIG_GLOBAL)))
-        random_mtrigger(ch);
-    }
+  switch (sc->attach_type) {
+  case MOB_TRIGGER:
+    ch = (struct char_data *) sc->attached;
+    if (IN_ROOM(ch) == NOWHERE)
+      return FALSE;
+    *zone = world[IN_ROOM(ch)].zone;
+    break;
+  case OBJ_TRIGGER:
+    *zone = NOWHERE;
+    return TRUE;
+  case WLD_TRIGGER:
+    if ((rnum = real_room(sc->attached_room)) == NOWHERE)
+      return FALSE;
+    *zone = world[rnum].zone;
+    break;
+  default:
+    return FALSE;
   }
 
-  for (obj = object_list; obj; obj = obj->next) {
-    if (SCRIPT(obj)) {
-      sc = SCRIPT(obj);
+  if (IS_SET(SCRIPT_TYPES(sc), WTRIG_GLOBAL))
+    *zone = NOWHERE;
 
-      if (IS_SET(SCRIPT_TYPES(sc), OTRIG_RANDOM))
-        random_otrigger(obj);
-    }
+  return TRUE;
+}
+
+/* Take a script out of the random trigger index. */
+void random_index_remove(struct script_data *sc)
+{
+  if (!sc->rand_indexed)
+    return;
+
+  if (random_cursor == sc)
+    random_cursor = sc->rand_next;
+
+  if (sc->rand_prev)
+    sc->rand_prev->rand_next = sc->rand_next;
+  else if (sc->rand_zone == NOWHERE)
+    random_global = sc->rand_next;
+  else
+    zone_table[sc->rand_zone].random_scripts = sc->rand_next;
+
+  if (sc->rand_next)
+    sc->rand_next->rand_prev = sc->rand_prev;
+
+  sc->rand_next = sc->rand_prev = NULL;
+  sc->rand_indexed = FALSE;
+}
+
+/* Put a script in the right random trigger bucket, or take it out of the
+ * index.  Called whenever its trigger types change, and when a mob with a
+ * script moves from room to room. */
+void random_index_update(struct script_data *sc)
+{
+  struct script_data **head;
+  zone_rnum zone = NOWHERE;
+
+  if (!random_bucket(sc, &zone)) {
+    random_index_remove(sc);
+    return;
   }
 
-  for (nr = 0; nr <= top_of_world; nr++) {
-    if (SCRIPT(&world[nr])) {
-      room = &world[nr];
-      sc = SCRIPT(room);
+  if (sc->rand_indexed && sc->rand_zone == zone)
+    return;
 
-      if (IS_SET(SCRIPT_TYPES(sc), WTRIG_RANDOM) &&
-          (!is_empty(room->zone) ||
-           IS_SET(SCRIPT_TYPES(sc), WTRIG_GLOBAL)))
-        random_wtrigger(room);
+  random_index_remove(sc);
+
+  head = (zone == NOWHERE) ? &random_global : &zone_table[zone].random_scripts;
+  sc->rand_prev = NULL;
+  sc->rand_next = *head;
+  if (*head)
+    (*head)->rand_prev = sc;
+  *head = sc;
+
+  sc->rand_zone = zone;
+  sc->rand_indexed = TRUE;
+}
+
+/* Run the random triggers of every script in one bucket. */
+static void random_bucket_check(struct script_data *list)
+{
+  struct script_data *sc;
+  room_rnum rnum;
+
+  for (random_cursor = list; (sc = random_cursor) != NULL; ) {
+    random_cursor = sc->rand_next;
+
+    if (sc->rand_pass == random_pass)
+      continue;
+    sc->rand_pass = random_pass;
+
+    switch (sc->attach_type) {
+    case MOB_TRIGGER:
+      random_mtrigger((struct char_data *) sc->attached);
+      break;
+    case OBJ_TRIGGER:
+      random_otrigger((struct obj_data *) sc->attached);
+      break;
+    case WLD_TRIGGER:
+      if ((rnum = real_room(sc->attached_room)) != NOWHERE)
+        random_wtrigger(&world[rnum]);
+      break;
     }
   }
 }
 
+void script_trigger_check(void)
+{
+  zone_rnum zone;
+
+  random_pass++;
+
+  for (zone = 0; zone <= top_of_zone_table; zone++)
+    if (zone_table[zone].random_scripts && zone_table[zone].num_players > 0)
+      random_bucket_check(zone_table[zone].random_scripts);
+
+  random_bucket_check(random_global);
+}
+
 void check_time_triggers(void)
 {
   char_data *ch;
@@ -827,10 +937,10 @@ static void script_stat (char_data *ch, struct script_data *sc)
   char namebuf[512];
   char buf1[MAX_STRING_LENGTH];
 
-  send_to_char(ch, "Global Variables: %s\r\n", sc->global_vars ? "" : "None");
+  send_to_char(ch, "Global Variables: %s\r\n", sc->global_vars.head ? "" : "None");
   send_to_char(ch, "Global context: %ld\r\n", sc->context);
 
-  for (tv = sc->global_vars; tv; tv = tv->next) {
+  for (tv = sc->global_vars.head; tv; tv = tv->next) {
     snprintf(namebuf, sizeof(namebuf), "%s:%ld", tv->name, tv->context);
     if (*(tv->value) == UID_CHAR) {
       find_uid_name(tv->value, name, sizeof(name));
@@ -865,9 +975,9 @@ static void script_stat (char_data *ch, struct script_data *sc)
       send_to_char(ch, "    Wait: %ld, Current line: %s\r\n",
               event_time(GET_TRIG_WAIT(t)),
               t->curr_state ? t->curr_state->cmd : "End of Script");
-      send_to_char(ch, "  Variables: %s\r\n", GET_TRIG_VARS(t) ? "" : "None");
+      send_to_char(ch, "  Variables: %s\r\n", GET_TRIG_VARS(t).head ? "" : "None");
 
-      for (tv = GET_TRIG_VARS(t); tv; tv = tv->next) {
+      for (tv = GET_TRIG_VARS(t).head; tv; tv = tv->next) {
         if (*(tv->value) == UID_CHAR) {
           find_uid_name(tv->value, name, sizeof(name));
           send_to_char(ch, "    %15s:  %s\r\n", tv->name, name);
@@ -931,6 +1041,7 @@ void add_trigger(struct script_data *sc, trig_data *t, int loc)
   }
 
   SCRIPT_TYPES(sc) |= GET_TRIG_TYPE(t);
+  random_index_update(sc);
 
   t->next_in_world = trigger_list;
   trigger_list = t;
@@ -987,7 +1098,7 @@ ACMD(do_attach)
     }
 
     if (!SCRIPT(victim))
-      CREATE(SCRIPT(victim), struct script_data, 1);
+      SCRIPT(victim) = create_script(victim, MOB_TRIGGER);
     add_trigger(SCRIPT(victim), trig, loc);
 
     if (IS_NPC(victim))
@@ -1029,7 +1140,7 @@ ACMD(do_attach)
     }
 
     if (!SCRIPT(object))
-      CREATE(SCRIPT(object), struct script_data, 1);
+      SCRIPT(object) = create_script(object, OBJ_TRIGGER);
     add_trigger(SCRIPT(object), trig, loc);
 
     send_to_char(ch, "Trigger %d (%s) attached to %s [%d].\r\n",
@@ -1066,7 +1177,7 @@ ACMD(do_attach)
     room = &world[rnum];
 
     if (!SCRIPT(room))
-      CREATE(SCRIPT(room), struct script_data, 1);
+      SCRIPT(room) = create_script(room, WLD_TRIGGER);
     add_trigger(SCRIPT(room), trig, loc);
 
     send_to_char(ch, "Trigger %d (%s) attached to room %d.\r\n",
@@ -1134,6 +1245,7 @@ static int remove_trigger(struct script_data *sc, char *name)
     SCRIPT_TYPES(sc) = 0;
     for (i = TRIGGERS(sc); i; i = i->next)
       SCRIPT_TYPES(sc) |= GET_TRIG_TYPE(i);
+    random_index_update(sc);
 
     return 1;
   } else
@@ -1640,31 +1752,59 @@ static struct cmdlist_element *find_end(trig_data *trig, struct cmdlist_element
 }
 
 /* Searches for valid elseif, else, or end to continue execution at. Returns
- * line of elseif, else, or end if found, or last line of trigger. */
+ * line of elseif, else, or end if found, or last line of trigger. Only the
+ * elseif conditions are evaluated here, the rest of the scan was done by
+ * scan_else_end() when the trigger was compiled. */
 static struct cmdlist_element *find_else_end(trig_data *trig,
     struct cmdlist_element *cl, void *go, struct script_data *sc, int type)
+{
+  struct cmdlist_element *c = cl;
+  byte op;
+
+  for (;;) {
+    op = c->branch_op;
+    c = c->branch;
+
+    if (op == DG_BRANCH_TEST) {
+      if (process_if(c->text + 7, go, sc, trig, type)) {
+        GET_TRIG_DEPTH(trig)++;
+        return c;
+      }
+      continue;
+    }
+    if (op == DG_BRANCH_ENTER)
+      GET_TRIG_DEPTH(trig)++;
+    return c;
+  }
+}
+
+/* Finds the line a failed 'if' or 'elseif' at cl would stop at, without
+ * evaluating anything: the next elseif (op set to DG_BRANCH_TEST), else
+ * (DG_BRANCH_ENTER), end, or the last line of the trigger (DG_BRANCH_STOP). */
+static struct cmdlist_element *scan_else_end(trig_data *trig,
+    struct cmdlist_element *cl, byte *op)
 {
   struct cmdlist_element *c;
   char *p;
 
+  *op = DG_BRANCH_STOP;
+
   if (!(cl->next))
     return cl;
 
   for (c = cl->next;c->next; c = c->next) {
-    for (p = c->cmd; *p && isspace(*p); p++); /* skip spaces */
+    p = c->text;
 
     if (!strn_cmp("if ", p, 3))
       c = find_end(trig, c);
 
     else if (!strn_cmp("elseif ", p, 7)) {
-      if (process_if(p + 7, go, sc, trig, type)) {
-        GET_TRIG_DEPTH(trig)++;
-        return c;
-      }
+      *op = DG_BRANCH_TEST;
+      return c;
     }
 
     else if (!strn_cmp("else", p, 4)) {
-      GET_TRIG_DEPTH(trig)++;
+      *op = DG_BRANCH_ENTER;
       return c;
     }
 
@@ -1679,8 +1819,7 @@ static struct cmdlist_element *find_else_end(trig_data *trig,
   }
 
   /* rryan: if we got here, it's the last line, if its not an end, log it. */
-  for (p = c->cmd; *p && isspace(*p); p++); /* skip spaces */
-  if(strn_cmp("end", p, 3))
+  if(strn_cmp("end", c->text, 3))
     script_log("Trigger VNum %d has 'if' without 'end'. (error 5)", GET_TRIG_VNUM(trig));
   return c;
 }
@@ -1845,21 +1984,21 @@ static void process_attach(void *go, struct script_data *sc, trig_data *trig,
       return;
     }
     if (!SCRIPT(c))
-      CREATE(SCRIPT(c), struct script_data, 1);
+      SCRIPT(c) = create_script(c, MOB_TRIGGER);
     add_trigger(SCRIPT(c), newtrig, -1);
     return;
   }
 
   if (o) {
     if (!SCRIPT(o))
-      CREATE(SCRIPT(o), struct script_data, 1);
+      SCRIPT(o) = create_script(o, OBJ_TRIGGER);
     add_trigger(SCRIPT(o), newtrig, -1);
     return;
   }
 
   if (r) {
     if (!SCRIPT(r))
-      CREATE(SCRIPT(r), struct script_data, 1);
+      SCRIPT(r) = create_script(r, WLD_TRIGGER);
     add_trigger(SCRIPT(r), newtrig, -1);
     return;
   }
@@ -2126,15 +2265,10 @@ static void process_remote(struct script_data *sc, trig_data *trig, char *cmd)
   }
 
   /* find the locally owned variable */
-  for (vd = GET_TRIG_VARS(trig); vd; vd = vd->next)
-    if (!str_cmp(vd->name, buf))
-      break;
+  vd = find_var(&GET_TRIG_VARS(trig), buf);
 
   if (!vd)
-    for (vd = sc->global_vars; vd; vd = vd->next)
-      if (!str_cmp(vd->name, var) &&
-          (vd->context==0 || vd->context==sc->context))
-        break;
+    vd = find_var_in_context(&sc->global_vars, var, sc->context);
 
   if (!vd) {
     script_log("Trigger: %s, VNum %d. local var '%s' not found in remote call",
@@ -2175,7 +2309,7 @@ static void process_remote(struct script_data *sc, trig_data *trig, char *cmd)
  * was to delete rooms. */
 ACMD(do_vdelete)
 {
-  struct trig_var_data *vd, *vd_prev=NULL;
+  struct trig_var_data *vd;
   struct script_data *sc_remote=NULL;
   char *var, *uid_p;
   char buf[MAX_INPUT_LENGTH], buf2[MAX_INPUT_LENGTH];
@@ -2219,42 +2353,25 @@ ACMD(do_vdelete)
     return;
   }
 
-  if (sc_remote->global_vars==NULL) {
+  if (sc_remote->global_vars.head==NULL) {
     send_to_char(ch, "That id represents no global variables.(2)\r\n");
     return;
   }
 
   if (*var == '*' || is_abbrev(var, "all")) {
-    struct trig_var_data *vd_next;
-    for (vd = sc_remote->global_vars; vd; vd = vd_next) {
-      vd_next = vd->next;
-      free(vd->value);
-      free(vd->name);
-      free(vd);
-    }
-    sc_remote->global_vars = NULL;
+    free_varlist(&sc_remote->global_vars);
     send_to_char(ch, "All variables deleted from that id.\r\n");
     return;
   }
 
   /* find the global */
-  for (vd = sc_remote->global_vars; vd; vd_prev = vd, vd = vd->next)
-    if (!str_cmp(vd->name, var))
-      break;
-
-  if (!vd) {
+  if (!(vd = find_var(&sc_remote->global_vars, var))) {
     send_to_char(ch, "That variable cannot be located.\r\n");
     return;
   }
 
-  /* ok, delete the variable */
-  if (vd_prev) vd_prev->next = vd->next;
-  else sc_remote->global_vars = vd->next;
-
-  /* and free up the space */
-  free(vd->value);
-  free(vd->name);
-  free(vd);
+  /* ok, delete the variable and free up the space */
+  remove_var_el(&sc_remote->global_vars, vd);
 
   send_to_char(ch, "Deleted.\r\n");
 }
@@ -2272,7 +2389,7 @@ int perform_set_dg_var(struct char_data *ch, struct char_data *vict, char *val_a
     return 0;
   }
   if (!SCRIPT(vict))
-    CREATE(SCRIPT(vict), struct script_data, 1);
+    SCRIPT(vict) = create_script(vict, MOB_TRIGGER);
 
   add_var(&(SCRIPT(vict)->global_vars), var_name, var_value, 0);
   return 1;
@@ -2282,7 +2399,7 @@ int perform_set_dg_var(struct char_data *ch, struct char_data *vict, char *val_a
  * 'rdelete <variable_name> <uid>' */
 static void process_rdelete(struct script_data *sc, trig_data *trig, char *cmd)
 {
-  struct trig_var_data *vd, *vd_prev=NULL;
+  struct trig_var_data *vd;
   struct script_data *sc_remote=NULL;
   char *line, *var, *uid_p;
   char arg[MAX_INPUT_LENGTH], buf[MAX_STRING_LENGTH], buf2[MAX_STRING_LENGTH];
@@ -2325,24 +2442,15 @@ static void process_rdelete(struct script_data *sc, trig_data *trig, char *cmd)
   }
 
   if (sc_remote==NULL) return; /* no script to delete a trigger from */
-  if (sc_remote->global_vars==NULL) return; /* no script globals */
+  if (sc_remote->global_vars.head==NULL) return; /* no script globals */
 
   /* find the global */
-  for (vd = sc_remote->global_vars; vd; vd_prev = vd, vd = vd->next)
-    if (!str_cmp(vd->name, var) &&
-        (vd->context==0 || vd->context==sc->context))
-      break;
+  vd = find_var_in_context(&sc_remote->global_vars, var, sc->context);
 
   if (!vd) return; /* the variable doesn't exist, or is the wrong context */
 
-  /* ok, delete the variable */
-  if (vd_prev) vd_prev->next = vd->next;
-  else sc_remote->global_vars = vd->next;
-
-  /* and free up the space */
-  free(vd->value);
-  free(vd->name);
-  free(vd);
+  /* ok, delete the variable and free up the space */
+  remove_var_el(&sc_remote->global_vars, vd);
 }
 
 /* Makes a local variable into a global variable. */
@@ -2361,9 +2469,7 @@ static void process_global(struct script_data *sc, trig_data *trig, char *cmd, l
     return;
   }
 
-  for (vd = GET_TRIG_VARS(trig); vd; vd = vd->next)
-    if (!str_cmp(vd->name, var))
-      break;
+  vd = find_var(&GET_TRIG_VARS(trig), var);
 
   if (!vd) {
     script_log("Trigger: %s, VNum %d. local var '%s' not found in global call",
@@ -2488,6 +2594,7 @@ int script_driver(void *go_adress, trig_data *trig, int type, int mode)
   struct cmdlist_element *temp;
   unsigned long loops = 0;
   void *go = NULL;
+  int verb;
 
   void obj_command_interpreter(obj_data *obj, char *argument);
   void wld_command_interpreter(struct room_data *room, char *argument);
@@ -2536,6 +2643,10 @@ int script_driver(void *go_adress, trig_data *trig, int type, int mode)
 
   depth++;
 
+  /* command lists built outside the loaders are compiled on first use */
+  if (trig->cmdlist && !trig->cmdlist->text)
+    compile_trigger(trig);
+
   if (mode == TRIG_NEW) {
     GET_TRIG_DEPTH(trig) = 1;
     GET_TRIG_LOOPS(trig) = 0;
@@ -2546,30 +2657,29 @@ int script_driver(void *go_adress, trig_data *trig, int type, int mode)
 
   for (cl = (mode == TRIG_NEW) ? trig->cmdlist : trig->curr_state;
       cl && GET_TRIG_DEPTH(trig); cl = cl->next) {
-    for (p = cl->cmd; *p && isspace(*p); p++);
+    p = cl->text;
 
-    if (*p == '*') /* comment */
+    if (cl->kind == DG_LINE_COMMENT)
       continue;
 
-    else if (!strn_cmp(p, "if ", 3)) {
+    else if (cl->kind == DG_LINE_IF) {
       if (process_if(p + 3, go, sc, trig, type))
         GET_TRIG_DEPTH(trig)++;
       else
         cl = find_else_end(trig, cl, go, sc, type);
     }
 
-    else if (!strn_cmp("elseif ", p, 7) ||
-       !strn_cmp("else", p, 4)) {
+    else if (cl->kind == DG_LINE_ELSE) {
       /* If not in an if-block, ignore the extra 'else[if]' and warn about it. */
       if (GET_TRIG_DEPTH(trig) == 1) {
         script_log("Trigger VNum %d has 'else' without 'if'.",
                    GET_TRIG_VNUM(trig));
         continue;
       }
-      cl = find_end(trig, cl);
+      cl = cl->jump;
       GET_TRIG_DEPTH(trig)--;
-    } else if (!strn_cmp("while ", p, 6)) {
-      temp = find_done(cl);
+    } else if (cl->kind == DG_LINE_WHILE) {
+      temp = cl->jump;
       if (!temp) {
         script_log("Trigger VNum %d has 'while' without 'done'.",
                    GET_TRIG_VNUM(trig));
@@ -2581,9 +2691,9 @@ int script_driver(void *go_adress, trig_data *trig, int type, int mode)
          cl = temp;
          loops = 0;
       }
-    } else if (!strn_cmp("switch ", p, 7)) {
+    } else if (cl->kind == DG_LINE_SWITCH) {
       cl = find_case(trig, cl, go, sc, type, p + 7);
-    } else if (!strn_cmp("end", p, 3)) {
+    } else if (cl->kind == DG_LINE_END) {
       /* If not in an if-block, ignore the extra 'end' and warn about it. */
       if (GET_TRIG_DEPTH(trig) == 1) {
         script_log("Trigger VNum %d has 'end' without 'if'.",
@@ -2591,12 +2701,10 @@ int script_driver(void *go_adress, trig_data *trig, int type, int mode)
         continue;
       }
       GET_TRIG_DEPTH(trig)--;
-    } else if (!strn_cmp("done", p, 4)) {
+    } else if (cl->kind == DG_LINE_DONE) {
       /* if in a while loop, cl->original is non-NULL */
       if (cl->original) {
-      char *orig_cmd = cl->original->cmd;
-      while (*orig_cmd && isspace(*orig_cmd)) orig_cmd++;
-      if (cl->original && process_if(orig_cmd + 6, go, sc, trig,
+      if (cl->original && process_if(cl->original->text + 6, go, sc, trig,
           type)) {
         cl = cl->original;
         loops++;
@@ -2615,69 +2723,72 @@ int script_driver(void *go_adress, trig_data *trig, int type, int mode)
          /* if we're falling through a switch statement, this ends it. */
         }
       }
-    } else if (!strn_cmp("break", p, 5)) {
-      cl = find_done(cl);
-    } else if (!strn_cmp("case", p, 4)) {
+    } else if (cl->kind == DG_LINE_BREAK) {
+      /* a break in an unterminated block has nowhere to go */
+      if (!(cl = cl->jump))
+        break;
+    } else if (cl->kind == DG_LINE_CASE) {
        /* Do nothing, this allows multiple cases to a single instance */
     }
 
     else {
-      var_subst(go, sc, trig, type, p, cmd);
+      var_subst_line(go, sc, trig, type, cl, cmd);
+      verb = (cl->verb == DG_CMD_DYNAMIC) ? dg_command_verb(cmd) : cl->verb;
 
-      if (!strn_cmp(cmd, "eval ", 5))
+      if (verb == DG_CMD_EVAL)
         process_eval(go, sc, trig, type, cmd);
 
-      else if (!strn_cmp(cmd, "nop ", 4)); /* nop: do nothing */
+      else if (verb == DG_CMD_NOP); /* nop: do nothing */
 
-      else if (!strn_cmp(cmd, "extract ", 8))
+      else if (verb == DG_CMD_EXTRACT)
         extract_value(sc, trig, cmd);
 
-      else if (!strn_cmp(cmd, "dg_letter ", 10))
+      else if (verb == DG_CMD_DG_LETTER)
         dg_letter_value(sc, trig, cmd);
 
-      else if (!strn_cmp(cmd, "makeuid ", 8))
+      else if (verb == DG_CMD_MAKEUID)
         makeuid_var(go, sc, trig, type, cmd);
 
-      else if (!strn_cmp(cmd, "halt", 4))
+      else if (verb == DG_CMD_HALT)
         break;
 
-      else if (!strn_cmp(cmd, "dg_cast ", 8))
+      else if (verb == DG_CMD_DG_CAST)
         do_dg_cast(go, sc, trig, type, cmd);
 
-      else if (!strn_cmp(cmd, "dg_affect ", 10))
+      else if (verb == DG_CMD_DG_AFFECT)
         do_dg_affect(go, sc, trig, type, cmd);
 
-      else if (!strn_cmp(cmd, "global ", 7))
+      else if (verb == DG_CMD_GLOBAL)
         process_global(sc, trig, cmd, sc->context);
 
-      else if (!strn_cmp(cmd, "context ", 8))
+      else if (verb == DG_CMD_CONTEXT)
         process_context(sc, trig, cmd);
 
-      else if (!strn_cmp(cmd, "remote ", 7))
+      else if (verb == DG_CMD_REMOTE)
         process_remote(sc, trig, cmd);
 
-      else if (!strn_cmp(cmd, "rdelete ", 8))
+      else if (verb == DG_CMD_RDELETE)
         process_rdelete(sc, trig, cmd);
 
-      else if (!strn_cmp(cmd, "return ", 7))
+      else if (verb == DG_CMD_RETURN)
         ret_val = process_return(trig, cmd);
 
-      else if (!strn_cmp(cmd, "set ", 4))
+      else if (verb == DG_CMD_SET)
         process_set(sc, trig, cmd);
 
-      else if (!strn_cmp(cmd, "unset ", 6))
+      else if (verb == DG_CMD_UNSET)
         process_unset(sc, trig, cmd);
 
-      else if (!strn_cmp(cmd, "wait ", 5)) {
+      else if (verb == DG_CMD_WAIT) {
         process_wait(go, trig, type, cmd, cl);
         depth--;
         return ret_val;
       }
 
-      else if (!strn_cmp(cmd, "attach ", 7))
+      else if (verb == DG_CMD_ATTACH)
         process_attach(go, sc, trig, type, cmd);
 
-      else if (!strn_cmp(cmd, "detach ", 7))
+      else if (verb == DG_CMD_DETACH)
         process_detach(go, sc, trig, type, cmd);
 
       else {
@@ -2709,8 +2820,7 @@ int script_driver(void *go_adress, trig_data *trig, int type, int mode)
     case WLD_TRIGGER:    sc = SCRIPT((room_data *) go);    break;
   }
   if (sc)
-  free_varlist(GET_TRIG_VARS(trig));
-  GET_TRIG_VARS(trig) = NULL;
+    free_varlist(&GET_TRIG_VARS(trig));
   GET_TRIG_DEPTH(trig) = 0;
 
   depth--;
@@ -2761,33 +2871,57 @@ ACMD(do_tstat)
 }
 
 /* Scans for a case/default instance. Returns the line containg the correct
- * case instance, or the last line of the trigger if not found. */
+ * case instance, or the last line of the trigger if not found. Only the case
+ * values are compared here, the rest of the scan was done by scan_case() when
+ * the trigger was compiled. */
 static struct cmdlist_element *
 find_case(struct trig_data *trig, struct cmdlist_element *cl,
           void *go, struct script_data *sc, int type, char *cond)
 {
   char result[MAX_INPUT_LENGTH];
-  struct cmdlist_element *c;
-  char *p, *buf;
+  struct cmdlist_element *c = cl;
+  char *buf;
 
   eval_expr(cond, result, go, sc, trig, type);
 
+  while (c->branch_op == DG_BRANCH_TEST) {
+    c = c->branch;
+    buf = (char*)malloc(MAX_STRING_LENGTH);
+    eval_op("==", result, c->text + 5, buf, go, sc, trig);
+    if (*buf && *buf!='0') {
+      free(buf);
+      return c;
+    }
+    free(buf);
+  }
+  return c->branch;
+}
+
+/* Finds the line a switch, or a case that did not match, at cl would stop at
+ * without evaluating anything: the next case (op set to DG_BRANCH_TEST),
+ * default or done, or the last line of the trigger (DG_BRANCH_STOP). */
+static struct cmdlist_element *scan_case(struct cmdlist_element *cl, byte *op)
+{
+  struct cmdlist_element *c;
+  char *p;
+
+  *op = DG_BRANCH_STOP;
+
   if (!(cl->next))
     return cl;
 
   for (c = cl->next; c->next; c = c->next) {
-    for (p = c->cmd; *p && isspace(*p); p++);
+    p = c->text;
 
-    if (!strn_cmp("while ", p, 6) || !strn_cmp("switch", p, 6))
-      c = find_done(c);
-    else if (!strn_cmp("case ", p, 5)) {
-      buf = (char*)malloc(MAX_STRING_LENGTH);
-      eval_op("==", result, p + 5, buf, go, sc, trig);
-      if (*buf && *buf!='0') {
-        free(buf);
+    if (!strn_cmp("while ", p, 6) || !strn_cmp("switch", p, 6)) {
+      /* an unterminated inner block runs off the end of the trigger */
+      if (!(c = find_done(c)) || !c->next) {
+        for (c = cl; c->next; c = c->next);
         return c;
       }
-      free(buf);
+    } else if (!strn_cmp("case ", p, 5)) {
+      *op = DG_BRANCH_TEST;
+      return c;
     } else if (!strn_cmp("default", p, 7))
       return c;
     else if (!strn_cmp("done", p, 3))
@@ -2820,6 +2954,106 @@ static struct cmdlist_element *find_done(struct cmdlist_element *cl)
 }
 
 
+/* Classifies a trigger line the way script_driver() dispatches on it. */
+static int dg_line_kind(const char *p)
+{
+  if (*p == '*')
+    return DG_LINE_COMMENT;
+  else if (!strn_cmp(p, "if ", 3))
+    return DG_LINE_IF;
+  else if (!strn_cmp("elseif ", p, 7) || !strn_cmp("else", p, 4))
+    return DG_LINE_ELSE;
+  else if (!strn_cmp("while ", p, 6))
+    return DG_LINE_WHILE;
+  else if (!strn_cmp("switch ", p, 7))
+    return DG_LINE_SWITCH;
+  else if (!strn_cmp("end", p, 3))
+    return DG_LINE_END;
+  else if (!strn_cmp("done", p, 4))
+    return DG_LINE_DONE;
+  else if (!strn_cmp("break", p, 5))
+    return DG_LINE_BREAK;
+  else if (!strn_cmp("case", p, 4))
+    return DG_LINE_CASE;
+  return DG_LINE_COMMAND;
+}
+
+/* Returns the DG_CMD_ builtin that handles a substituted command line. */
+static int dg_command_verb(const char *cmd)
+{
+  if (!strn_cmp(cmd, "eval ", 5))         return DG_CMD_EVAL;
+  else if (!strn_cmp(cmd, "nop ", 4))     return DG_CMD_NOP;
+  else if (!strn_cmp(cmd, "extract ", 8)) return DG_CMD_EXTRACT;
+  else if (!strn_cmp(cmd, "dg_letter ", 10)) return DG_CMD_DG_LETTER;
+  else if (!strn_cmp(cmd, "makeuid ", 8)) return DG_CMD_MAKEUID;
+  else if (!strn_cmp(cmd, "halt", 4))     return DG_CMD_HALT;
+  else if (!strn_cmp(cmd, "dg_cast ", 8)) return DG_CMD_DG_CAST;
+  else if (!strn_cmp(cmd, "dg_affect ", 10)) return DG_CMD_DG_AFFECT;
+  else if (!strn_cmp(cmd, "global ", 7))  return DG_CMD_GLOBAL;
+  else if (!strn_cmp(cmd, "context ", 8)) return DG_CMD_CONTEXT;
+  else if (!strn_cmp(cmd, "remote ", 7))  return DG_CMD_REMOTE;
+  else if (!strn_cmp(cmd, "rdelete ", 8)) return DG_CMD_RDELETE;
+  else if (!strn_cmp(cmd, "return ", 7))  return DG_CMD_RETURN;
+  else if (!strn_cmp(cmd, "set ", 4))     return DG_CMD_SET;
+  else if (!strn_cmp(cmd, "unset ", 6))   return DG_CMD_UNSET;
+  else if (!strn_cmp(cmd, "wait ", 5))    return DG_CMD_WAIT;
+  else if (!strn_cmp(cmd, "attach ", 7))  return DG_CMD_ATTACH;
+  else if (!strn_cmp(cmd, "detach ", 7))  return DG_CMD_DETACH;
+  return DG_CMD_EXTERNAL;
+}
+
+/* Compiles the command list of a trigger prototype in place: each line gets
+ * its kind, its builtin verb when no variable can change it, the end, done,
+ * else and case lines it jumps to, and its variable segments. This is what
+ * script_driver() used to work out again every time a line ran. Structural
+ * errors like a missing 'end' are logged here, once, rather than each time
+ * the trigger runs. Live triggers share the prototype's command list. */
+void compile_trigger(trig_data *trig)
+{
+  struct cmdlist_element *cl;
+  char *p;
+  int i;
+
+  for (cl = trig->cmdlist; cl; cl = cl->next) {
+    for (p = cl->cmd; *p && isspace(*p); p++);
+    cl->text = p;
+    cl->kind = dg_line_kind(p);
+
+    /* builtin verbs are at most 10 characters */
+    for (i = 0; i < 10 && p[i] && p[i] != '%'; i++);
+    cl->verb = (i < 10 && p[i] == '%') ? DG_CMD_DYNAMIC : dg_command_verb(p);
+
+    compile_var_subst(cl);
+  }
+
+  for (cl = trig->cmdlist; cl; cl = cl->next) {
+    cl->jump = cl->branch = NULL;
+    cl->branch_op = DG_BRANCH_STOP;
+
+    switch (cl->kind) {
+      case DG_LINE_IF:
+        cl->branch = scan_else_end(trig, cl, &cl->branch_op);
+        break;
+      case DG_LINE_ELSE:
+        cl->jump = find_end(trig, cl);
+        if (!strn_cmp("elseif ", cl->text, 7))
+          cl->branch = scan_else_end(trig, cl, &cl->branch_op);
+        break;
+      case DG_LINE_WHILE:
+      case DG_LINE_BREAK:
+        cl->jump = find_done(cl);
+        break;
+      case DG_LINE_SWITCH:
+        cl->branch = scan_case(cl, &cl->branch_op);
+        break;
+      case DG_LINE_CASE:
+        if (!strn_cmp("case ", cl->text, 5))
+          cl->branch = scan_case(cl, &cl->branch_op);
+        break;
+    }
+  }
+}
+
 /* load in a character's saved variables */
 void read_saved_vars(struct char_data *ch)
 {
@@ -2838,7 +3072,7 @@ void read_saved_vars(struct char_data *ch)
   /* Create the space for the script structure which holds the vars. We need to
    * do this first, because later calls to 'remote' will need. A script already
    * assigned. */
-  CREATE(SCRIPT(ch), struct script_data, 1);
+  SCRIPT(ch) = create_script(ch, MOB_TRIGGER);
 
   /* find the file that holds the saved variables and open it*/
   get_filename(fn, sizeof(fn), SCRIPT_VARS_FILE, GET_NAME(ch));
@@ -2885,8 +3119,8 @@ void save_char_vars(struct char_data *ch)
   unlink(fn);
 
   /* make sure this char has global variables to save */
-  if (ch->script->global_vars == NULL) return;
-  vars = ch->script->global_vars;
+  if (ch->script->global_vars.head == NULL) return;
+  vars = ch->script->global_vars.head;
 
   file = fopen(fn,"wt");
   if (!file) {
@@ -2923,7 +3157,7 @@ void read_saved_vars_ascii(FILE *file, struct char_data *ch, int count)
   /* Create the space for the script structure which holds the vars. We need to
    * do this first, because later calls to 'remote' will need. A script already
    * assigned. */
-  CREATE(SCRIPT(ch), struct script_data, 1);
+  SCRIPT(ch) = create_script(ch, MOB_TRIGGER);
 
   /* walk through each line in the file parsing variables */
   for (i = 0; i < count; i++)
@@ -2954,18 +3188,18 @@ void save_char_vars_ascii(FILE *file, struct char_data *ch)
   if (IS_NPC(ch)) return;
 
   /* make sure this char has global variables to save */
-  if (ch->script->global_vars == NULL) return;
+  if (ch->script->global_vars.head == NULL) return;
 
   /* Note that currently, context will always be zero. This may change in the
    * future */
-  for (vars = ch->script->global_vars;vars;vars = vars->next)
+  for (vars = ch->script->global_vars.head;vars;vars = vars->next)
     if (*vars->name != '-')
       count++;
 
   if (count != 0) {
 	  fprintf(file, "Vars: %d\n", count);
 
-  for (vars = ch->script->global_vars;vars;vars = vars->next)
+  for (vars = ch->script->global_vars.head;vars;vars = vars->next)
     if (*vars->name != '-') /* don't save if it begins with - */
       fprintf(file, "%s %ld %s\n", vars->name, vars->context, vars->value);
   }
@@ -130,19 +130,96 @@
 
 #define SCRIPT_ERROR_CODE     -9999999   /* this shouldn't happen too often */
 
+/* Line kinds, as script_driver() dispatches on them. */
+#define DG_LINE_COMMAND         0            /* anything else: run it      */
+#define DG_LINE_COMMENT         1            /* '*'                        */
+#define DG_LINE_IF              2            /* 'if '                      */
+#define DG_LINE_ELSE            3            /* 'elseif ' or 'else'        */
+#define DG_LINE_WHILE           4            /* 'while '                   */
+#define DG_LINE_SWITCH          5            /* 'switch '                  */
+#define DG_LINE_END             6            /* 'end'                      */
+#define DG_LINE_DONE            7            /* 'done'                     */
+#define DG_LINE_BREAK           8            /* 'break'                    */
+#define DG_LINE_CASE            9            /* 'case'                     */
+
+/* Builtin commands, by the verb of the substituted line. */
+#define DG_CMD_EXTERNAL         0            /* passed to the interpreter  */
+#define DG_CMD_EVAL             1
+#define DG_CMD_NOP              2
+#define DG_CMD_EXTRACT          3
+#define DG_CMD_DG_LETTER        4
+#define DG_CMD_MAKEUID          5
+#define DG_CMD_HALT             6
+#define DG_CMD_DG_CAST          7
+#define DG_CMD_DG_AFFECT        8
+#define DG_CMD_GLOBAL           9
+#define DG_CMD_CONTEXT          10
+#define DG_CMD_REMOTE           11
+#define DG_CMD_RDELETE          12
+#define DG_CMD_RETURN           13
+#define DG_CMD_SET              14
+#define DG_CMD_UNSET            15
+#define DG_CMD_WAIT             16
+#define DG_CMD_ATTACH           17
+#define DG_CMD_DETACH           18
+#define DG_CMD_DYNAMIC          19           /* verb comes from a variable */
+
+/* What to do on reaching the next else/case candidate of a failed test. */
+#define DG_BRANCH_STOP          0            /* continue after it          */
+#define DG_BRANCH_ENTER         1            /* 'else': enter the block    */
+#define DG_BRANCH_TEST          2            /* 'elseif'/'case': test it   */
+
+/* How a line is variable substituted. */
+#define DG_SUBST_NONE           0            /* no '%' in the line         */
+#define DG_SUBST_SEGS           1            /* from the compiled segments */
+#define DG_SUBST_DYNAMIC        2            /* rescan with var_subst()    */
+
+/* A literal run or a %variable% of a compiled trigger line. */
+struct dg_subst_seg {
+  ush_int start;                        /* offset into the line text    */
+  ush_int len;                          /* length of the run            */
+  byte var;                             /* TRUE for a variable          */
+};
+
 /* one line of the trigger */
 struct cmdlist_element {
   char *cmd;				/* one line of a trigger */
   struct cmdlist_element *original;
   struct cmdlist_element *next;
+
+  /* filled in by compile_trigger() */
+  char *text;                           /* cmd past leading spaces      */
+  byte kind;                            /* DG_LINE_ type                */
+  byte verb;                            /* DG_CMD_ builtin              */
+  byte subst;                           /* DG_SUBST_ mode               */
+  byte branch_op;                       /* DG_BRANCH_ op for branch     */
+  struct cmdlist_element *jump;         /* matching end or done         */
+  struct cmdlist_element *branch;       /* next else/case candidate     */
+  struct dg_subst_seg *segs;            /* substitution segments        */
+  int num_segs;
 };
 
 struct trig_var_data {
   char *name;				/* name of variable  */
   char *value;				/* value of variable */
   long context;				/* 0: global context */
+  unsigned long hash;			/* var_hash() of name */
 
   struct trig_var_data *next;
+  struct trig_var_data *next_in_bucket;
+};
+
+/* Variable lists longer than this get a hash index over the names. */
+#define VAR_HASH_MIN            8
+
+/** A list of trigger variables, newest first. Once it grows past
+ * VAR_HASH_MIN the names are also hashed into buckets, each keeping the
+ * list order, so a lookup finds the same variable a walk of the list would. */
+struct trig_var_list {
+  struct trig_var_data *head;           /**< all variables, newest first    */
+  struct trig_var_data **buckets;       /**< hash chains, or NULL           */
+  int num_buckets;                      /**< power of two                   */
+  int count;                            /**< number of variables            */
 };
 
 /** structure for triggers */
@@ -160,7 +237,7 @@ struct trig_data {
     int loops;                          /**< loop iteration counter          */
     struct event *wait_event;           /**< event to pause the trigger  */
     ubyte purged;                       /**< trigger is set to be purged     */
-    struct trig_var_data *var_list;	    /**< list of local vars for trigger  */
+    struct trig_var_list var_list;	    /**< list of local vars for trigger  */
 
     struct trig_data *next;
     struct trig_data *next_in_world;    /**< next in the global trigger list */
@@ -170,11 +247,21 @@ struct trig_data {
 struct script_data {
   long types;                        /**< bitvector of trigger types */
   struct trig_data *trig_list;       /**< list of triggers           */
-  struct trig_var_data *global_vars; /**< list of global variables   */
+  struct trig_var_list global_vars; /**< list of global variables    */
   ubyte purged;                      /**< script is set to be purged */
   long context;                      /**< current context for statics */
 
   struct script_data *next;          /**< used for purged_scripts    */
+
+  int attach_type;                   /**< MOB_, OBJ_ or WLD_TRIGGER    */
+  void *attached;                    /**< mob or obj the script is on  */
+  room_vnum attached_room;           /**< vnum of the room it is on    */
+
+  bool rand_indexed;                 /**< in the random trigger index  */
+  zone_rnum rand_zone;               /**< zone bucket, NOWHERE = global */
+  unsigned long rand_pass;           /**< last random pass it ran in   */
+  struct script_data *rand_next;     /**< next in the same bucket      */
+  struct script_data *rand_prev;     /**< previous in the same bucket  */
 };
 
 /* The event data for the wait command */
@@ -293,6 +380,8 @@ void do_sstat_room(struct char_data * ch, room_data *r);
 void do_sstat_object(char_data *ch, obj_data *j);
 void do_sstat_character(char_data *ch, char_data *k);
 void add_trigger(struct script_data *sc, trig_data *t, int loc);
+void random_index_update(struct script_data *sc);
+void random_index_remove(struct script_data *sc);
 void script_vlog(const char *format, va_list args);
 void script_log(const char *format, ...) __attribute__ ((format (printf, 1, 2)));
 char *matching_quote(char *p);
@@ -306,6 +395,7 @@ int trig_is_attached(struct script_data *sc, int trig_num);
 /* To maintain strict-aliasing we'll have to do this trick with a union */
 /* Thanks to Chris Gilbert for reminding me that there are other options. */
 int script_driver(void *go_adress, trig_data *trig, int type, int mode);
+void compile_trigger(trig_data *trig);
 trig_rnum real_trigger(trig_vnum vnum);
 void process_eval(void *go, struct script_data *sc, trig_data *trig,
                  int type, char *cmd);
@@ -324,12 +414,19 @@ void dg_obj_trigger(char *line, struct obj_data *obj);
 void assign_triggers(void *i, int type);
 
 /* From dg_variables.c */
-void add_var(struct trig_var_data **var_list, const char *name, const char *value, long id);
+void add_var(struct trig_var_list *vars, const char *name, const char *value, long id);
+unsigned long var_hash(const char *name);
+struct trig_var_data *find_var(const struct trig_var_list *vars, const char *name);
+struct trig_var_data *find_var_in_context(const struct trig_var_list *vars,
+                const char *name, long context);
 int item_in_list(char *item, obj_data *list);
 char *skill_percent(struct char_data *ch, char *skill);
 int char_has_item(char *item, struct char_data *ch);
 void var_subst(void *go, struct script_data *sc, trig_data *trig,
                int type, char *line, char *buf);
+void compile_var_subst(struct cmdlist_element *cl);
+void var_subst_line(void *go, struct script_data *sc, trig_data *trig,
+               int type, struct cmdlist_element *cl, char *buf);
 int text_processed(char *field, char *subfield, struct trig_var_data *vd,
                    char *str, size_t slen);
 void find_replacement(void *go, struct script_data *sc, trig_data *trig,
@@ -337,10 +434,12 @@ void find_replacement(void *go, struct script_data *sc, trig_data *trig,
 
 /* From dg_handler.c */
 void free_var_el(struct trig_var_data *var);
-void free_varlist(struct trig_var_data *vd);
-int remove_var(struct trig_var_data **var_list, char *name);
+void free_varlist(struct trig_var_list *vars);
+int remove_var(struct trig_var_list *vars, char *name);
+void remove_var_el(struct trig_var_list *vars, struct trig_var_data *var);
 void free_trigger(trig_data *trig);
 void extract_trigger(struct trig_data *trig);
+struct script_data *create_script(void *thing, int type);
 void extract_script(void *thing, int type);
 void extract_script_mem(struct script_memory *sc);
 void free_proto_script(void *thing, int type);
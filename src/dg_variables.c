@@ -26,22 +26,88 @@
 #include "quest.h"
 #include "act.h"
 #include "genobj.h"
+#include "reactor.h"
 
 /* Utility functions */
 
+/* Hashes a variable name the way str_cmp() compares it, ignoring case. */
+unsigned long var_hash(const char *name)
+{
+  unsigned long h = 5381;
+
+  for (; *name; name++)
+    h = h * 33 + LOWER(*name);
+
+  return h;
+}
+
+/* Rebuilds the hash chains of a variable list with num_buckets buckets. Each
+ * chain is filled in list order, newest first. */
+static void index_var_list(struct trig_var_list *vars, int num_buckets)
+{
+  struct trig_var_data *vd, **p;
+
+  if (vars->buckets)
+    free(vars->buckets);
+  CREATE(vars->buckets, struct trig_var_data *, num_buckets);
+  vars->num_buckets = num_buckets;
+
+  for (vd = vars->head; vd; vd = vd->next) {
+    for (p = &vars->buckets[vd->hash & (num_buckets - 1)]; *p; p = &(*p)->next_in_bucket);
+    *p = vd;
+    vd->next_in_bucket = NULL;
+  }
+}
+
+/* Returns the newest variable called name whose context is any (any_context)
+ * or matches context, walking the hash chain when the list has one. */
+static struct trig_var_data *search_var(const struct trig_var_list *vars,
+                const char *name, bool any_context, long context)
+{
+  struct trig_var_data *vd;
+  unsigned long h = var_hash(name);
+
+  if (vars->buckets) {
+    for (vd = vars->buckets[h & (vars->num_buckets - 1)]; vd; vd = vd->next_in_bucket)
+      if (vd->hash == h && !str_cmp(vd->name, name) &&
+          (any_context || vd->context == 0 || vd->context == context))
+        return vd;
+    return NULL;
+  }
+
+  for (vd = vars->head; vd; vd = vd->next)
+    if (vd->hash == h && !str_cmp(vd->name, name) &&
+        (any_context || vd->context == 0 || vd->context == context))
+      return vd;
+  return NULL;
+}
+
+/* Finds a variable by name, whatever its context. */
+struct trig_var_data *find_var(const struct trig_var_list *vars, const char *name)
+{
+  return search_var(vars, name, TRUE, 0);
+}
+
+/* Finds a variable by name that is global (context 0) or in context. */
+struct trig_var_data *find_var_in_context(const struct trig_var_list *vars,
+                const char *name, long context)
+{
+  return search_var(vars, name, FALSE, context);
+}
+
 /* Thanks to James Long for his assistance in plugging the memory leak that
  * used to be here. - Welcor */
 /* Adds a variable with given name and value to trigger. */
-void add_var(struct trig_var_data **var_list, const char *name, const char *value, long id)
+void add_var(struct trig_var_list *vars, const char *name, const char *value, long id)
 {
-  struct trig_var_data *vd;
+  struct trig_var_data *vd, **bucket;
 
   if (strchr(name, '.')) {
     log("add_var() : Attempt to add illegal var: %s", name);
     return;
   }
 
-  for (vd = *var_list; vd && str_cmp(vd->name, name); vd = vd->next);
+  vd = find_var(vars, name);
 
   if (vd && (!vd->context || vd->context==id)) {
     free(vd->value);
@@ -53,12 +119,23 @@ void add_var(struct trig_var_data **var_list, const char *name, const char *valu
 
     CREATE(vd->name, char, strlen(name) + 1);
     strcpy(vd->name, name);                            /* strcpy: ok*/
+    vd->hash = var_hash(name);
 
     CREATE(vd->value, char, strlen(value) + 1);
 
-    vd->next = *var_list;
+    vd->next = vars->head;
     vd->context = id;
-    *var_list = vd;
+    vars->head = vd;
+    vars->count++;
+
+    if (vars->buckets && vars->count <= 2 * vars->num_buckets) {
+      bucket = &vars->buckets[vd->hash & (vars->num_buckets - 1)];
+      vd->next_in_bucket = *bucket;
+      *bucket = vd;
+    } else if (vars->buckets)
+      index_var_list(vars, 2 * vars->num_buckets);
+    else if (vars->count > VAR_HASH_MIN)
+      index_var_list(vars, 2 * VAR_HASH_MIN);
   }
 
   strcpy(vd->value, value);                            /* strcpy: ok*/
@@ -281,16 +358,11 @@ void find_replacement(void *go, struct script_data *sc, trig_data *trig,
 
   /* X.global() will have a NULL trig */
   if (trig)
-    for (vd = GET_TRIG_VARS(trig); vd; vd = vd->next)
-      if (!str_cmp(vd->name, var))
-        break;
+    vd = find_var(&GET_TRIG_VARS(trig), var);
 
   /* some evil waitstates could crash the mud if sent here with sc==NULL*/
   if (!vd && sc)
-    for (vd = sc->global_vars; vd; vd = vd->next)
-      if (!str_cmp(vd->name, var) &&
-          (vd->context==0 || vd->context==sc->context))
-        break;
+    vd = find_var_in_context(&sc->global_vars, var, sc->context);
 
   if (!*field) {
     if (vd)
@@ -419,9 +491,7 @@ void find_replacement(void *go, struct script_data *sc, trig_data *trig,
           script_log("Attempt to find global var. Apparently the void has no script.");
           return;
         }
-        for (vd = thescript->global_vars; vd ; vd = vd->next)
-          if (!str_cmp(vd->name, field))
-            break;
+        vd = find_var(&thescript->global_vars, field);
 
         if (vd)
           snprintf(str, slen, "%s", vd->value);
@@ -1113,9 +1183,7 @@ void find_replacement(void *go, struct script_data *sc, trig_data *trig,
             struct trig_var_data *remote_vd;
             strcpy(str, "0");
             if (SCRIPT(c)) {
-              for (remote_vd = SCRIPT(c)->global_vars; remote_vd; remote_vd = remote_vd->next) {
-                if (!str_cmp(remote_vd->name, subfield)) break;
-              }
+              remote_vd = find_var(&SCRIPT(c)->global_vars, subfield);
               if (remote_vd) strcpy(str, "1");
             }
           }
@@ -1169,9 +1237,7 @@ void find_replacement(void *go, struct script_data *sc, trig_data *trig,
 
       if (*str == '\x1') { /* no match found in switch */
         if (SCRIPT(c)) {
-          for (vd = (SCRIPT(c))->global_vars; vd; vd = vd->next)
-            if (!str_cmp(vd->name, field))
-              break;
+          vd = find_var(&(SCRIPT(c))->global_vars, field);
           if (vd)
             snprintf(str, slen, "%s", vd->value);
           else {
@@ -1372,9 +1438,7 @@ void find_replacement(void *go, struct script_data *sc, trig_data *trig,
 
       if (*str == '\x1') { /* no match in switch */
         if (SCRIPT(o)) { /* check for global var */
-          for (vd = (SCRIPT(o))->global_vars; vd; vd = vd->next)
-            if (!str_cmp(vd->name, field))
-              break;
+          vd = find_var(&(SCRIPT(o))->global_vars, field);
           if (vd)
             snprintf(str, slen, "%s", vd->value);
           else {
@@ -1399,9 +1463,7 @@ void find_replacement(void *go, struct script_data *sc, trig_data *trig,
           script_log("Trigger: %s, Vnum %d, type %d. Trying to access Global var list of void. Apparently this has not been set up!",
                      GET_TRIG_NAME(trig), GET_TRIG_VNUM(trig), type);
         } else {
-          for (vd = (SCRIPT(r))->global_vars; vd; vd = vd->next)
-            if (!str_cmp(vd->name, field))
-              break;
+          vd = find_var(&(SCRIPT(r))->global_vars, field);
           if (vd)
             snprintf(str, slen, "%s", vd->value);
           else
@@ -1611,9 +1673,7 @@ void find_replacement(void *go, struct script_data *sc, trig_data *trig,
       }
       else {
         if (SCRIPT(r)) { /* check for global var */
-          for (vd = (SCRIPT(r))->global_vars; vd; vd = vd->next)
-            if (!str_cmp(vd->name, field))
-              break;
+          vd = find_var(&(SCRIPT(r))->global_vars, field);
           if (vd)
             snprintf(str, slen, "%s", vd->value);
           else {
@@ -1638,17 +1698,80 @@ void find_replacement(void *go, struct script_data *sc, trig_data *trig,
  * %actor.gold(%actor.gold%)% will double the actors gold every time its called.
  * - Jamie Nelson */
 
+/* Subfield and paren state of var_subst(), carried from one variable of a
+ * line to the next exactly as the original single loop carried it. */
+struct subst_state {
+  char subfield[MAX_INPUT_LENGTH];
+  char *subfield_p;
+  int paren_count;
+};
+
+/* Substitutes the variable starting at p (just past its opening %) into
+ * repl_str. The variable is cut up in place. Returns the position just past
+ * its closing %. */
+static char *subst_var(void *go, struct script_data *sc, trig_data *trig,
+               int type, char *p, struct subst_state *st, char *repl_str, size_t slen)
+{
+  char *var, *field;
+  char tmp2[MAX_INPUT_LENGTH];
+  int dots = 0;
+
+  /* search until end of var or beginning of field */
+  for (var = p; *p && (*p != '%') && (*p != '.'); p++);
+
+  field = p;
+  if (*p == '.') {
+    *(p++) = '\0';
+    dots = 0;
+    for (field = p; *p && ((*p != '%')||(st->paren_count > 0) || (dots)); p++) {
+      if (dots > 0) {
+        *st->subfield_p = '\0';
+        find_replacement(go, sc, trig, type, var, field, st->subfield, repl_str, slen);
+        if (*repl_str) {
+          snprintf(tmp2, sizeof(tmp2), "eval tmpvr %s", repl_str); //temp var
+          process_eval(go, sc, trig, type, tmp2);
+          strcpy(var, "tmpvr");
+          field = p;
+          dots = 0;
+          continue;
+        }
+        dots = 0;
+      } else if (*p=='(') {
+        *p = '\0';
+        st->paren_count++;
+      } else if (*p==')') {
+        *p = '\0';
+        st->paren_count--;
+      } else if (st->paren_count > 0) {
+        *st->subfield_p++ = *p;
+      } else if (*p=='.') {
+        *p = '\0';
+        dots++;
+      }
+    } /* for (field.. */
+  } /* if *p == '.' */
+
+  *(p++) = '\0';
+  *st->subfield_p = '\0';
+
+  if (*st->subfield) {
+    var_subst(go, sc, trig, type, st->subfield, tmp2);
+    strcpy(st->subfield, tmp2);
+  }
+
+  find_replacement(go, sc, trig, type, var, field, st->subfield, repl_str, slen);
+
+  return p;
+}
+
 /* substitutes any variables into line and returns it as buf */
 void var_subst(void *go, struct script_data *sc, trig_data *trig,
                int type, char *line, char *buf)
 {
   char tmp[MAX_INPUT_LENGTH], repl_str[MAX_INPUT_LENGTH - 1];
-  char *var = NULL, *field = NULL, *p = NULL;
-  char tmp2[MAX_INPUT_LENGTH];
-  char *subfield_p, subfield[MAX_INPUT_LENGTH];
+  char *p = NULL;
+  struct subst_state st;
   int left, len;
-  int paren_count = 0;
-  int dots = 0;
 
   /* skip out if no %'s */
   if (!strchr(line, '%')) {
@@ -1656,10 +1779,11 @@ void var_subst(void *go, struct script_data *sc, trig_data *trig,
     return;
   }
   /*lets just empty these to start with*/
-  *repl_str = *tmp = *tmp2 = '\0';
+  *repl_str = *tmp = '\0';
 
   p = strcpy(tmp, line);
-  subfield_p = subfield;
+  st.subfield_p = st.subfield;
+  st.paren_count = 0;
 
   left = MAX_INPUT_LENGTH - 1;
 
@@ -1684,57 +1808,141 @@ void var_subst(void *go, struct script_data *sc, trig_data *trig,
 
     /* so it wasn't double %'s */
     else if (*p && (left > 0)) {
+      p = subst_var(go, sc, trig, type, p, &st, repl_str, sizeof(repl_str));
+
+      strncat(buf, repl_str, left);
+      len = strlen(repl_str);
+      buf += len;
+      left -= len;
+    } /* else if *p .. */
+  } /* while *p .. */
+  buf[sizeof(buf) - 1] = '\0';
+}
+
+/* Splits a trigger line into the literal runs and %variables% var_subst()
+ * would find in it, so the scan is not repeated every time the line runs.
+ * Lines whose scan depends on the values substituted (an unterminated
+ * variable, or a field chain on a variable name shorter than the temporary
+ * "tmpvr" that overwrites it) are left to var_subst(). */
+void compile_var_subst(struct cmdlist_element *cl)
+{
+  char *line = cl->text, *p, *var;
+  int num = 0, paren_count = 0, dots;
+  size_t size;
 
-      /* search until end of var or beginning of field */
-      for (var = p; *p && (*p != '%') && (*p != '.'); p++);
+  if (cl->segs)
+    free(cl->segs);
+  cl->segs = NULL;
+  cl->num_segs = 0;
 
-      field = p;
-      if (*p == '.') {
-        *(p++) = '\0';
-        dots = 0;
-        for (field = p; *p && ((*p != '%')||(paren_count > 0) || (dots)); p++) {
-          if (dots > 0) {
-            *subfield_p = '\0';
-            find_replacement(go, sc, trig, type, var, field, subfield, repl_str, sizeof(repl_str));
-            if (*repl_str) {
-              snprintf(tmp2, sizeof(tmp2), "eval tmpvr %s", repl_str); //temp var
-              process_eval(go, sc, trig, type, tmp2);
-              strcpy(var, "tmpvr");
-              field = p;
-              dots = 0;
-              continue;
-            }
-            dots = 0;
-          } else if (*p=='(') {
-            *p = '\0';
-            paren_count++;
-          } else if (*p==')') {
-            *p = '\0';
-            paren_count--;
-          } else if (paren_count > 0) {
-            *subfield_p++ = *p;
-          } else if (*p=='.') {
-            *p = '\0';
-            dots++;
-          }
-        } /* for (field.. */
-      } /* if *p == '.' */
-
-      *(p++) = '\0';
-      *subfield_p = '\0';
-
-      if (*subfield) {
-        var_subst(go, sc, trig, type, subfield, tmp2);
-        strcpy(subfield, tmp2);
+  if (!strchr(line, '%')) {
+    cl->subst = DG_SUBST_NONE;
+    return;
+  }
+  cl->subst = DG_SUBST_DYNAMIC;
+  if (strlen(line) >= MAX_INPUT_LENGTH)
+    return;
+
+  /* every run starts at a distinct character, so this is enough */
+  size = strlen(line) + 1;
+  CREATE(cl->segs, struct dg_subst_seg, size);
+
+  for (p = line; *p; ) {
+    for (var = p; *p && *p != '%'; p++);
+    if (p > var) {
+      cl->segs[num].start = var - line;
+      cl->segs[num].len = p - var;
+      cl->segs[num++].var = FALSE;
+    }
+    if (!*p || !*(++p))
+      break;
+
+    /* double % */
+    if (*p == '%') {
+      cl->segs[num].start = p - line;
+      cl->segs[num].len = 1;
+      cl->segs[num++].var = FALSE;
+      p++;
+      continue;
+    }
+
+    for (var = p; *p && (*p != '%') && (*p != '.'); p++);
+    if (*p == '.') {
+      p++;
+      dots = 0;
+      for (; *p && ((*p != '%') || (paren_count > 0) || dots); p++) {
+        if (dots > 0) {
+          if (p - var <= 5) {
+            free(cl->segs);
+            cl->segs = NULL;
+            return;
+          }
+          dots = 0;
+        } else if (*p == '(')
+          paren_count++;
+        else if (*p == ')')
+          paren_count--;
+        else if (paren_count > 0)
+          ;
+        else if (*p == '.')
+          dots++;
       }
+    }
+    if (!*p) { /* unterminated variable */
+      free(cl->segs);
+      cl->segs = NULL;
+      return;
+    }
+    cl->segs[num].start = var - line;
+    cl->segs[num].len = p - var;
+    cl->segs[num++].var = TRUE;
+    p++;
+  }
+
+  cl->num_segs = num;
+  cl->subst = DG_SUBST_SEGS;
+}
+
+/* Substitutes the variables of a compiled trigger line into buf, with the
+ * same result var_subst() gives for its text. */
+void var_subst_line(void *go, struct script_data *sc, trig_data *trig,
+               int type, struct cmdlist_element *cl, char *buf)
+{
+  char tmp[MAX_INPUT_LENGTH], repl_str[MAX_INPUT_LENGTH - 1];
+  struct dg_subst_seg *seg;
+  struct subst_state st;
+  int i, left, len;
+
+  if (cl->subst == DG_SUBST_NONE) {
+    strcpy(buf, cl->text);
+    return;
+  } else if (cl->subst == DG_SUBST_DYNAMIC) {
+    var_subst(go, sc, trig, type, cl->text, buf);
+    return;
+  }
+
+  *repl_str = '\0';
+  strcpy(tmp, cl->text);
+  st.subfield_p = st.subfield;
+  st.paren_count = 0;
+
+  *buf = '\0';
+  left = MAX_INPUT_LENGTH - 1;
 
-      find_replacement(go, sc, trig, type, var, field, subfield, repl_str, sizeof(repl_str));
+  for (i = 0, seg = cl->segs; i < cl->num_segs && left > 0; i++, seg++) {
+    if (!seg->var) {
+      len = MIN(seg->len, left);
+      memcpy(buf, cl->text + seg->start, len);
+      buf += len;
+      left -= len;
+      *buf = '\0';
+    } else {
+      subst_var(go, sc, trig, type, tmp + seg->start, &st, repl_str, sizeof(repl_str));
 
       strncat(buf, repl_str, left);
       len = strlen(repl_str);
       buf += len;
       left -= len;
-    } /* else if *p .. */
-  } /* while *p .. */
-  buf[sizeof(buf) - 1] = '\0';
+    }
+  }
 }
@@ -20,6 +20,7 @@
 #include "constants.h"
 #include "genzon.h" /* for zone_rnum real_zone_by_thing */
 #include "fight.h"  /* for die() */
+#include "graph.h"  /* for invalidate_path_cache() */
 
 /* Local functions, macros, defines and structs */
 
@@ -249,6 +250,7 @@ WCMD(do_wdoor)
                 free(newexit->keyword);
             free(newexit);
             rm->dir_option[dir] = NULL;
+            invalidate_path_cache();
         }
     }
 
@@ -256,6 +258,7 @@ WCMD(do_wdoor)
         if (!newexit) {
             CREATE(newexit, struct room_direction_data, 1);
             rm->dir_option[dir] = newexit;
+            invalidate_path_cache();
         }
 
         switch (fd) {
@@ -279,9 +282,10 @@ WCMD(do_wdoor)
             strcpy(newexit->keyword, value);
             break;
         case 5:  /* room        */
-            if ((to_room = real_room(atoi(value))) != NOWHERE)
+            if ((to_room = real_room(atoi(value))) != NOWHERE) {
                 newexit->to_room = to_room;
-            else
+                invalidate_path_cache();
+            } else
                 wld_log(room, "wdoor: invalid door target");
             break;
         }
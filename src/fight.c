@@ -25,6 +25,7 @@
 #include "fight.h"
 #include "shop.h"
 #include "quest.h"
+#include "keyword.h"
 
 
 /* locally defined global variables, used externally */
@@ -183,6 +184,7 @@ static void make_corpse(struct char_data *ch)
   corpse->item_number = NOTHING;
   IN_ROOM(corpse) = NOWHERE;
   corpse->name = strdup("corpse");
+  keyword_update_obj(corpse);
 
   snprintf(buf2, sizeof(buf2), "The corpse of %s is lying here.", GET_NAME(ch));
   corpse->description = strdup(buf2);
@@ -17,6 +17,7 @@
 #include "genzon.h"
 #include "dg_olc.h"
 #include "spells.h"
+#include "keyword.h"
 
 /* local functions */
 static void extract_mobile_all(mob_vnum vnum);
@@ -33,8 +34,10 @@ int add_mobile(struct char_data *mob, mob_vnum vnum)
 
     /* Now re-point all existing mobile strings to here. */
     for (live_mob = character_list; live_mob; live_mob = live_mob->next)
-      if (rnum == live_mob->nr)
+      if (rnum == live_mob->nr) {
         update_mobile_strings(live_mob, &mob_proto[rnum]);
+        keyword_update_char(live_mob);
+      }
 
     add_to_save_list(zone_table[real_zone_by_thing(vnum)].number, SL_MOB);
     log("GenOLC: add_mobile: Updated existing mobile #%d.", vnum);
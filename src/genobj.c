@@ -19,6 +19,7 @@
 #include "handler.h"
 #include "interpreter.h"
 #include "boards.h" /* for board_info */
+#include "keyword.h"
 
 
 /* local functions */
@@ -65,6 +66,7 @@ static int update_all_objects(struct obj_data *refobj)
 
     /* Copy game-time dependent variables over. */
     obj->script_id = swap.script_id;
+    obj->script = swap.script;
     IN_ROOM(obj) = swap.in_room;
     obj->carried_by = swap.carried_by;
     obj->worn_by = swap.worn_by;
@@ -72,8 +74,12 @@ static int update_all_objects(struct obj_data *refobj)
     obj->in_obj = swap.in_obj;
     obj->contains = swap.contains;
     obj->next_content = swap.next_content;
+    obj->prev_content = swap.prev_content;
     obj->next = swap.next;
+    obj->prev = swap.prev;
     obj->sitting_here = swap.sitting_here;
+    obj->keywords = swap.keywords;
+    keyword_update_obj(obj);
   }
 
   return count;
@@ -501,6 +507,7 @@ bool oset_alias(struct obj_data *obj, char * argument)
     free(obj->name);
 
   obj->name = strdup(argument);
+  keyword_update_obj(obj);
 
   return TRUE;
 }
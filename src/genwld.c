@@ -18,6 +18,7 @@
 #include "shop.h"
 #include "dg_olc.h"
 #include "mud_event.h"
+#include "graph.h"
 
 
 /* This function will copy the strings so be sure you free your own copies of
@@ -32,6 +33,9 @@ room_rnum add_room(struct room_data *room)
   if (room == NULL)
     return NOWHERE;
 
+  /* Exits or room numbers change either way. */
+  invalidate_path_cache();
+
   if ((i = real_room(room->number)) != NOWHERE) {
     if (SCRIPT(&world[i]))
       extract_script(&world[i], WLD_TRIGGER);
@@ -133,6 +137,7 @@ int delete_room(room_rnum rnum)
   room = &world[rnum];
 
   add_to_save_list(zone_table[room->zone].number, SL_WLD);
+  invalidate_path_cache();
 
   /* This is something you might want to read about in the logs. */
   log("GenOLC: delete_room: Deleting room #%d (%s).", room->number, room->name);
@@ -51,6 +51,7 @@ zone_rnum create_new_zone(zone_vnum vzone_num, room_vnum bottom, room_vnum top,
 {
   FILE *fp;
   struct zone_data *zone;
+  struct script_data *sc;
   int i, max_zone;
   zone_rnum rznum;
   char buf[MAX_STRING_LENGTH];
@@ -183,6 +184,8 @@ zone_rnum create_new_zone(zone_vnum vzone_num, room_vnum bottom, room_vnum top,
     int j, room;
     for (i = top_of_zone_table + 1; i > 0 && vzone_num < zone_table[i - 1].number; i--) {
       zone_table[i] = zone_table[i - 1];
+      for (sc = zone_table[i].random_scripts; sc; sc = sc->rand_next)
+        sc->rand_zone = i;
       for (j = zone_table[i].bot; j <= zone_table[i].top; j++)
         if ((room = real_room(j)) != NOWHERE)
           world[room].zone++;
@@ -202,6 +205,10 @@ rznum = i;
   zone->reset_mode = 2;
   zone->min_level = -1;
   zone->max_level = -1;
+  zone->num_players = 0;
+  zone->last_player = 0;
+  zone->random_scripts = NULL;
+  zone->path_cache = NULL;
 
   for (i=0; i<ZN_ARRAY_MAX; i++)  zone->zone_flags[i] = 0;
 
@@ -23,79 +23,494 @@
 #include "fight.h"
 
 /* local functions */
+static int usable_exit(room_rnum x, int y);
 static int VALID_EDGE(room_rnum x, int y);
-static void bfs_enqueue(room_rnum room, int dir);
-static void bfs_dequeue(void);
-static void bfs_clear_queue(void);
-static int find_first_step(room_rnum src, room_rnum target);
-
-struct bfs_queue_struct {
-  room_rnum room;
-  char dir;
-  struct bfs_queue_struct *next;
+static void bfs_prepare(void);
+static int path_cache_lookup(room_rnum src, room_rnum target);
+static void path_cache_store(room_rnum src, room_rnum target);
+static int bfs_search(room_rnum src, room_rnum target);
+static int bidir_search(room_rnum src, room_rnum target);
+static int regions_connected(room_rnum src, room_rnum target);
+
+/** Search state, sized to the world and reused by every search.  A room has
+ * been visited in the current search when its bfs_visited stamp equals
+ * bfs_generation, so nothing needs clearing between searches. bfs_parent and
+ * bfs_dir record how each visited room was reached, which is what lets a
+ * finished search fill in the next-hop cache for the whole path. */
+static unsigned int *bfs_visited = NULL;
+static unsigned int bfs_generation = 0;
+static room_rnum *bfs_parent = NULL;
+static sbyte *bfs_dir = NULL;
+static room_rnum bfs_rooms = 0;
+
+/** The search queue is a ring buffer of at least bfs_rooms slots; every room
+ * enters it at most once per search, so it can never overflow. */
+static room_rnum *bfs_queue = NULL;
+static unsigned int bfs_queue_mask = 0;
+
+/** The bidirectional search also grows a tree backwards from the target:
+ * bfs_next and bfs_next_dir give the step from a room towards the target. */
+static unsigned int *bfs_visited_back = NULL;
+static room_rnum *bfs_next = NULL;
+static sbyte *bfs_next_dir = NULL;
+static room_rnum *bfs_queue_back = NULL;
+
+/** Next-hop cache.  Each zone gets a small direct-mapped table, allocated on
+ * first use, of (from, to) -> first step answers for searches that started in
+ * that zone.  Bumping path_cache_epoch invalidates every table at once. */
+#define PATH_CACHE_SIZE 256   /**< Entries per zone, a power of two. */
+
+struct path_cache_entry {
+  room_rnum from;
+  room_rnum to;
+  unsigned int epoch;
+  sbyte dir;
 };
 
-static struct bfs_queue_struct *queue_head = 0, *queue_tail = 0;
+static unsigned int path_cache_epoch = 1;
+
+/** Zone graph, built at boot and again after exits change.
+ *
+ * rev_first/rev_exits list the exits leading into each room, which the
+ * backwards half of a bidirectional search needs.
+ *
+ * Each zone is split into regions: sets of its rooms joined by exits inside
+ * the zone, ignoring their direction.  region_reach is a bit matrix of which
+ * regions can reach which through exits between regions, ignoring doors and
+ * NOTRACK.  If the target's region is not reachable from the source's region
+ * then no path exists, and no search is needed. */
+struct rev_exit {
+  room_rnum from;
+  sbyte dir;
+};
+
+static unsigned int *rev_first = NULL;
+static struct rev_exit *rev_exits = NULL;
+static unsigned int *room_region = NULL;
+static unsigned char *region_reach = NULL;
+static unsigned int num_regions = 0;
+static room_rnum zone_graph_rooms = 0;
+static bool zone_graph_dirty = TRUE;
+
+/** Above this many regions the reachability matrix is not built (it needs
+ * regions^2 bits) and searches simply run to completion. */
+#define MAX_REACH_REGIONS 8192
 
 /* Utility macros */
-#define MARK(room)	(SET_BIT_AR(ROOM_FLAGS(room), ROOM_BFS_MARK))
-#define UNMARK(room)	(REMOVE_BIT_AR(ROOM_FLAGS(room), ROOM_BFS_MARK))
-#define IS_MARKED(room)	(ROOM_FLAGGED(room, ROOM_BFS_MARK))
+#define MARK(room)	(bfs_visited[(room)] = bfs_generation)
+#define IS_MARKED(room)	(bfs_visited[(room)] == bfs_generation)
+#define MARK_BACK(room)	(bfs_visited_back[(room)] = bfs_generation)
+#define IS_MARKED_BACK(room)	(bfs_visited_back[(room)] == bfs_generation)
 #define TOROOM(x, y)	(world[(x)].dir_option[(y)]->to_room)
 #define IS_CLOSED(x, y)	(EXIT_FLAGGED(world[(x)].dir_option[(y)], EX_CLOSED))
+#define PATH_CACHE_SLOT(f, t) ((((unsigned int)(f) * 31u) ^ (unsigned int)(t)) & (PATH_CACHE_SIZE - 1))
+#define REGION_REACHES(a, b) (region_reach[((size_t)(a) * num_regions + (b)) >> 3] & (1 << (((size_t)(a) * num_regions + (b)) & 7)))
 
-static int VALID_EDGE(room_rnum x, int y)
+static int usable_exit(room_rnum x, int y)
 {
   if (world[x].dir_option[y] == NULL || TOROOM(x, y) == NOWHERE)
     return 0;
   if (CONFIG_TRACK_T_DOORS == FALSE && IS_CLOSED(x, y))
     return 0;
-  if (ROOM_FLAGGED(TOROOM(x, y), ROOM_NOTRACK) || IS_MARKED(TOROOM(x, y)))
+  if (ROOM_FLAGGED(TOROOM(x, y), ROOM_NOTRACK))
     return 0;
 
   return 1;
 }
 
-static void bfs_enqueue(room_rnum room, int dir)
+/* The visited stamp is checked first: most exits lead somewhere already
+ * seen, and it saves reading the target room's flags. */
+static int VALID_EDGE(room_rnum x, int y)
 {
-  struct bfs_queue_struct *curr;
-
-  CREATE(curr, struct bfs_queue_struct, 1);
-  curr->room = room;
-  curr->dir = dir;
-  curr->next = 0;
-
-  if (queue_tail) {
-    queue_tail->next = curr;
-    queue_tail = curr;
-  } else
-    queue_head = queue_tail = curr;
+  if (world[x].dir_option[y] == NULL || TOROOM(x, y) == NOWHERE || IS_MARKED(TOROOM(x, y)))
+    return 0;
+
+  return (usable_exit(x, y));
 }
 
-static void bfs_dequeue(void)
+/* Make sure the search arrays cover the whole world and start a new search
+ * generation. */
+static void bfs_prepare(void)
 {
-  struct bfs_queue_struct *curr;
+  if (bfs_rooms != top_of_world + 1) {
+    unsigned int qsize = 1;
+
+    bfs_rooms = top_of_world + 1;
+    while (qsize < (unsigned int)bfs_rooms)
+      qsize <<= 1;
+    bfs_queue_mask = qsize - 1;
+
+    RECREATE(bfs_visited, unsigned int, bfs_rooms);
+    RECREATE(bfs_parent, room_rnum, bfs_rooms);
+    RECREATE(bfs_dir, sbyte, bfs_rooms);
+    RECREATE(bfs_queue, room_rnum, qsize);
+    RECREATE(bfs_visited_back, unsigned int, bfs_rooms);
+    RECREATE(bfs_next, room_rnum, bfs_rooms);
+    RECREATE(bfs_next_dir, sbyte, bfs_rooms);
+    RECREATE(bfs_queue_back, room_rnum, qsize);
+    bfs_generation = UINT_MAX;	/* Forces the clear below. */
+  }
 
-  curr = queue_head;
+  if (++bfs_generation == 0) {
+    /* New arrays, or the stamp wrapped and old stamps could look current. */
+    memset(bfs_visited, 0, sizeof(unsigned int) * bfs_rooms);
+    memset(bfs_visited_back, 0, sizeof(unsigned int) * bfs_rooms);
+    bfs_generation = 1;
+  }
+}
 
-  if (!(queue_head = queue_head->next))
-    queue_tail = 0;
-  free(curr);
+/** Forget every cached path.  Called whenever exits are created, removed or
+ * redirected, or rooms are added or deleted (which renumbers rnums). */
+void invalidate_path_cache(void)
+{
+  zone_graph_dirty = TRUE;
+
+  if (++path_cache_epoch == 0) {
+    zone_rnum z;
+
+    /* Wrapped: really clear the tables so no entry can match by accident. */
+    for (z = 0; z <= top_of_zone_table; z++)
+      if (zone_table[z].path_cache)
+        memset(zone_table[z].path_cache, 0, sizeof(struct path_cache_entry) * PATH_CACHE_SIZE);
+    path_cache_epoch = 1;
+  }
+}
+
+static void free_zone_graph(void)
+{
+  if (rev_first) free(rev_first);
+  if (rev_exits) free(rev_exits);
+  if (room_region) free(room_region);
+  if (region_reach) free(region_reach);
+  rev_first = NULL;
+  rev_exits = NULL;
+  room_region = NULL;
+  region_reach = NULL;
+  num_regions = 0;
+  zone_graph_rooms = 0;
+  zone_graph_dirty = TRUE;
 }
 
-static void bfs_clear_queue(void)
+/** Release the per-zone cache tables, the zone graph and the search arrays. */
+void free_path_cache(void)
 {
-  while (queue_head)
-    bfs_dequeue();
+  zone_rnum z;
+
+  for (z = 0; z <= top_of_zone_table; z++)
+    if (zone_table[z].path_cache) {
+      free(zone_table[z].path_cache);
+      zone_table[z].path_cache = NULL;
+    }
+
+  free_zone_graph();
+
+  if (bfs_visited) free(bfs_visited);
+  if (bfs_parent) free(bfs_parent);
+  if (bfs_dir) free(bfs_dir);
+  if (bfs_queue) free(bfs_queue);
+  if (bfs_visited_back) free(bfs_visited_back);
+  if (bfs_next) free(bfs_next);
+  if (bfs_next_dir) free(bfs_next_dir);
+  if (bfs_queue_back) free(bfs_queue_back);
+  bfs_visited = bfs_visited_back = NULL;
+  bfs_parent = bfs_next = bfs_queue = bfs_queue_back = NULL;
+  bfs_dir = bfs_next_dir = NULL;
+  bfs_rooms = 0;
+}
+
+/** Build the reverse exit lists, the zone regions and the region
+ * reachability matrix.  Run once at boot and again before the next
+ * bidirectional search after any exit changes. */
+void build_zone_graph(void)
+{
+  unsigned int nrooms = top_of_world + 1, i, j, head, tail, edges = 0, bytes;
+  unsigned int *reg_first, *reg_adj, *queue, *row_seen, a, b;
+  room_rnum r, to;
+  int dir;
+
+  free_zone_graph();
+  zone_graph_dirty = FALSE;
+  if (top_of_world == NOWHERE)
+    return;
+  zone_graph_rooms = nrooms;
+
+  /* Exits into each room, as compressed lists. */
+  CREATE(rev_first, unsigned int, nrooms + 1);
+  for (r = 0; r <= top_of_world; r++)
+    for (dir = 0; dir < NUM_OF_DIRS; dir++)
+      if (world[r].dir_option[dir] && (to = TOROOM(r, dir)) != NOWHERE && to <= top_of_world) {
+        rev_first[to + 1]++;
+        edges++;
+      }
+  for (i = 0; i < nrooms; i++)
+    rev_first[i + 1] += rev_first[i];
+  CREATE(rev_exits, struct rev_exit, edges ? edges : 1);
+  CREATE(queue, unsigned int, nrooms);
+  memcpy(queue, rev_first, sizeof(unsigned int) * nrooms);
+  for (r = 0; r <= top_of_world; r++)
+    for (dir = 0; dir < NUM_OF_DIRS; dir++)
+      if (world[r].dir_option[dir] && (to = TOROOM(r, dir)) != NOWHERE && to <= top_of_world) {
+        rev_exits[queue[to]].from = r;
+        rev_exits[queue[to]++].dir = dir;
+      }
+
+  /* Regions: flood each zone through its internal exits, both ways. */
+  CREATE(room_region, unsigned int, nrooms);
+  for (i = 0; i < nrooms; i++)
+    room_region[i] = UINT_MAX;
+  for (i = 0; i < nrooms; i++) {
+    if (room_region[i] != UINT_MAX)
+      continue;
+    room_region[i] = num_regions;
+    head = tail = 0;
+    queue[tail++] = i;
+    while (head < tail) {
+      r = queue[head++];
+      for (dir = 0; dir < NUM_OF_DIRS; dir++)
+        if (world[r].dir_option[dir] && (to = TOROOM(r, dir)) != NOWHERE && to <= top_of_world &&
+            world[to].zone == world[r].zone && room_region[to] == UINT_MAX) {
+          room_region[to] = num_regions;
+          queue[tail++] = to;
+        }
+      for (j = rev_first[r]; j < rev_first[r + 1]; j++)
+        if (world[(to = rev_exits[j].from)].zone == world[r].zone && room_region[to] == UINT_MAX) {
+          room_region[to] = num_regions;
+          queue[tail++] = to;
+        }
+    }
+    num_regions++;
+  }
+
+  if (num_regions > MAX_REACH_REGIONS) {
+    log("Zone graph: %u regions is too many for a reachability table.", num_regions);
+    free(queue);
+    return;
+  }
+
+  /* Region adjacency lists; duplicates are harmless for the flood below. */
+  CREATE(reg_first, unsigned int, num_regions + 1);
+  for (edges = 0, r = 0; r <= top_of_world; r++)
+    for (dir = 0; dir < NUM_OF_DIRS; dir++)
+      if (world[r].dir_option[dir] && (to = TOROOM(r, dir)) != NOWHERE && to <= top_of_world &&
+          room_region[to] != room_region[r]) {
+        reg_first[room_region[r] + 1]++;
+        edges++;
+      }
+  for (a = 0; a < num_regions; a++)
+    reg_first[a + 1] += reg_first[a];
+  CREATE(reg_adj, unsigned int, edges ? edges : 1);
+  RECREATE(queue, unsigned int, MAX(nrooms, num_regions));
+  memcpy(queue, reg_first, sizeof(unsigned int) * num_regions);
+  for (r = 0; r <= top_of_world; r++)
+    for (dir = 0; dir < NUM_OF_DIRS; dir++)
+      if (world[r].dir_option[dir] && (to = TOROOM(r, dir)) != NOWHERE && to <= top_of_world &&
+          room_region[to] != room_region[r])
+        reg_adj[queue[room_region[r]]++] = room_region[to];
+
+  /* Flood from every region to fill in its row of the matrix. */
+  bytes = (unsigned int)(((size_t)num_regions * num_regions + 7) / 8);
+  CREATE(region_reach, unsigned char, bytes);
+  CREATE(row_seen, unsigned int, num_regions);
+  for (a = 0; a < num_regions; a++) {
+    head = tail = 0;
+    queue[tail++] = a;
+    row_seen[a] = a + 1;
+    while (head < tail) {
+      b = queue[head++];
+      i = a * num_regions + b;
+      region_reach[i >> 3] |= (1 << (i & 7));
+      for (j = reg_first[b]; j < reg_first[b + 1]; j++)
+        if (row_seen[reg_adj[j]] != a + 1) {
+          row_seen[reg_adj[j]] = a + 1;
+          queue[tail++] = reg_adj[j];
+        }
+    }
+  }
+
+  free(row_seen);
+  free(reg_first);
+  free(reg_adj);
+  free(queue);
+}
+
+/* FALSE only if the zone graph proves target cannot be reached from src. */
+static int regions_connected(room_rnum src, room_rnum target)
+{
+  if (zone_graph_dirty || zone_graph_rooms != top_of_world + 1)
+    build_zone_graph();
+  if (!region_reach)
+    return TRUE;
+
+  return (REGION_REACHES(room_region[src], room_region[target]) ? TRUE : FALSE);
+}
+
+/* Cached answers are only trustworthy when door state does not matter, since
+ * doors open and close all the time without touching the exits themselves. */
+#define PATH_CACHE_USABLE	(CONFIG_TRACK_CACHE && CONFIG_TRACK_T_DOORS)
+
+static int path_cache_lookup(room_rnum src, room_rnum target)
+{
+  struct path_cache_entry *e;
+  zone_rnum z = world[src].zone;
+
+  if (!PATH_CACHE_USABLE || z == NOWHERE || !zone_table[z].path_cache)
+    return BFS_ERROR;
+
+  e = &zone_table[z].path_cache[PATH_CACHE_SLOT(src, target)];
+  if (e->epoch != path_cache_epoch || e->from != src || e->to != target)
+    return BFS_ERROR;
+
+  return e->dir;
+}
+
+/* The search just reached target: walk the parent links back to the source
+ * and remember the next hop from every room on the way.  Any suffix of a
+ * shortest path is itself a shortest path, so a hunter following the trail
+ * gets cache hits for the rest of the trip. */
+static void path_cache_store(room_rnum src, room_rnum target)
+{
+  struct path_cache_entry *e;
+  room_rnum room, prev;
+  zone_rnum z;
+
+  if (!PATH_CACHE_USABLE)
+    return;
+
+  for (room = target; room != src; room = prev) {
+    prev = bfs_parent[room];
+    if ((z = world[prev].zone) == NOWHERE)
+      continue;
+    if (!zone_table[z].path_cache)
+      CREATE(zone_table[z].path_cache, struct path_cache_entry, PATH_CACHE_SIZE);
+    e = &zone_table[z].path_cache[PATH_CACHE_SLOT(prev, target)];
+    e->from = prev;
+    e->to = target;
+    e->dir = bfs_dir[room];
+    e->epoch = path_cache_epoch;
+  }
+}
+
+/* Plain breadth-first search.  Returns TRUE with bfs_parent and bfs_dir
+ * describing a shortest path if target can be reached from src. */
+static int bfs_search(room_rnum src, room_rnum target)
+{
+  int curr_dir;
+  room_rnum curr_room, next_room;
+  unsigned int head = 0, tail = 0;
+
+  MARK(src);
+  bfs_queue[tail++ & bfs_queue_mask] = src;
+
+  while (head != tail) {
+    curr_room = bfs_queue[head++ & bfs_queue_mask];
+
+    for (curr_dir = 0; curr_dir < DIR_COUNT; curr_dir++) {
+      if (!VALID_EDGE(curr_room, curr_dir))
+        continue;
+      next_room = TOROOM(curr_room, curr_dir);
+      MARK(next_room);
+      bfs_parent[next_room] = curr_room;
+      bfs_dir[next_room] = curr_dir;
+
+      if (next_room == target)
+        return TRUE;
+      bfs_queue[tail++ & bfs_queue_mask] = next_room;
+    }
+  }
+
+  return FALSE;
+}
+
+/* Bidirectional breadth-first search.  One tree grows from src along exits,
+ * the other from target against them, a whole level at a time, always on the
+ * side with the smaller frontier.  A room is only ever claimed by one tree,
+ * so the first exit found joining the two lies on a shortest path.  Either
+ * frontier running dry means there is no path, so a target walled into a
+ * small pocket is given up on after searching only the pocket.
+ *
+ * On success the backwards half of the path is copied into bfs_parent and
+ * bfs_dir, leaving the same kind of result bfs_search() does. */
+static int bidir_search(room_rnum src, room_rnum target)
+{
+  unsigned int fhead = 0, ftail = 0, bhead = 0, btail = 0, level_end, i;
+  room_rnum curr_room, next_room, meet_from = NOWHERE, meet_to = NOWHERE;
+  int curr_dir, meet_dir = 0;
+
+  if (!regions_connected(src, target))
+    return FALSE;
+
+  MARK(src);
+  MARK_BACK(target);
+  bfs_queue[ftail++ & bfs_queue_mask] = src;
+  bfs_queue_back[btail++ & bfs_queue_mask] = target;
+
+  while (meet_from == NOWHERE && fhead != ftail && bhead != btail) {
+    if (ftail - fhead <= btail - bhead) {
+      /* One full level forwards. */
+      for (level_end = ftail; fhead != level_end && meet_from == NOWHERE; ) {
+        curr_room = bfs_queue[fhead++ & bfs_queue_mask];
+        for (curr_dir = 0; curr_dir < DIR_COUNT; curr_dir++) {
+          if (!VALID_EDGE(curr_room, curr_dir))
+            continue;
+          next_room = TOROOM(curr_room, curr_dir);
+          if (IS_MARKED_BACK(next_room)) {
+            meet_from = curr_room;
+            meet_to = next_room;
+            meet_dir = curr_dir;
+            break;
+          }
+          MARK(next_room);
+          bfs_parent[next_room] = curr_room;
+          bfs_dir[next_room] = curr_dir;
+          bfs_queue[ftail++ & bfs_queue_mask] = next_room;
+        }
+      }
+    } else {
+      /* One full level backwards, over the exits leading in. */
+      for (level_end = btail; bhead != level_end && meet_from == NOWHERE; ) {
+        curr_room = bfs_queue_back[bhead++ & bfs_queue_mask];
+        for (i = rev_first[curr_room]; i < rev_first[curr_room + 1]; i++) {
+          next_room = rev_exits[i].from;
+          curr_dir = rev_exits[i].dir;
+          if (curr_dir >= DIR_COUNT || IS_MARKED_BACK(next_room) || !usable_exit(next_room, curr_dir))
+            continue;
+          if (IS_MARKED(next_room)) {
+            meet_from = next_room;
+            meet_to = curr_room;
+            meet_dir = curr_dir;
+            break;
+          }
+          MARK_BACK(next_room);
+          bfs_next[next_room] = curr_room;
+          bfs_next_dir[next_room] = curr_dir;
+          bfs_queue_back[btail++ & bfs_queue_mask] = next_room;
+        }
+      }
+    }
+  }
+
+  if (meet_from == NOWHERE)
+    return FALSE;
+
+  /* Splice: meet_from is in the forward tree, meet_to in the backward one. */
+  bfs_parent[meet_to] = meet_from;
+  bfs_dir[meet_to] = meet_dir;
+  for (curr_room = meet_to; curr_room != target; curr_room = next_room) {
+    next_room = bfs_next[curr_room];
+    bfs_parent[next_room] = curr_room;
+    bfs_dir[next_room] = bfs_next_dir[curr_room];
+  }
+
+  return TRUE;
 }
 
 /* find_first_step: given a source room and a target room, find the first step
  * on the shortest path from the source to the target. Intended usage: in
  * mobile_activity, give a mob a dir to go if they're tracking another mob or a
  * PC.  Or, a 'track' skill for PCs. */
-static int find_first_step(room_rnum src, room_rnum target)
+int find_first_step(room_rnum src, room_rnum target)
 {
-  int curr_dir;
+  int curr_dir, found;
   room_rnum curr_room;
 
   if (src == NOWHERE || target == NOWHERE || src > top_of_world || target > top_of_world) {
@@ -105,36 +520,24 @@ static int find_first_step(room_rnum src, room_rnum target)
   if (src == target)
     return (BFS_ALREADY_THERE);
 
-  /* clear marks first, some OLC systems will save the mark. */
-  for (curr_room = 0; curr_room <= top_of_world; curr_room++)
-    UNMARK(curr_room);
+  if ((curr_dir = path_cache_lookup(src, target)) >= 0)
+    return (curr_dir);
 
-  MARK(src);
+  bfs_prepare();
+  if (CONFIG_TRACK_SEARCH == TRACK_SEARCH_BIDIR)
+    found = bidir_search(src, target);
+  else
+    found = bfs_search(src, target);
 
-  /* first, enqueue the first steps, saving which direction we're going. */
-  for (curr_dir = 0; curr_dir < DIR_COUNT; curr_dir++)
-    if (VALID_EDGE(src, curr_dir)) {
-      MARK(TOROOM(src, curr_dir));
-      bfs_enqueue(TOROOM(src, curr_dir), curr_dir);
-    }
+  if (!found)
+    return (BFS_NO_PATH);
 
-  /* now, do the classic BFS. */
-  while (queue_head) {
-    if (queue_head->room == target) {
-      curr_dir = queue_head->dir;
-      bfs_clear_queue();
-      return (curr_dir);
-    } else {
-      for (curr_dir = 0; curr_dir < DIR_COUNT; curr_dir++)
-	if (VALID_EDGE(queue_head->room, curr_dir)) {
-	  MARK(TOROOM(queue_head->room, curr_dir));
-	  bfs_enqueue(TOROOM(queue_head->room, curr_dir), queue_head->dir);
-	}
-      bfs_dequeue();
-    }
-  }
+  path_cache_store(src, target);
 
-  return (BFS_NO_PATH);
+  /* Walk back to the room one step away from the source. */
+  for (curr_room = target; bfs_parent[curr_room] != src; curr_room = bfs_parent[curr_room])
+    ;
+  return (bfs_dir[curr_room]);
 }
 
 /* Functions and Commands which use the above functions. */
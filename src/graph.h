@@ -16,5 +16,14 @@
 
 ACMD(do_track);
 void hunt_victim(struct char_data *ch);
+int find_first_step(room_rnum src, room_rnum target);
+void invalidate_path_cache(void);
+void free_path_cache(void);
+void build_zone_graph(void);
+
+/* Search modes for find_first_step, see track_search_mode in config.c. */
+#define TRACK_SEARCH_BFS   0  /**< Breadth-first over every reachable room */
+#define TRACK_SEARCH_BIDIR 1  /**< Bidirectional, checked against the zone graph */
+#define NUM_TRACK_SEARCH   2
 
 #endif /* _GRAPH_H_*/
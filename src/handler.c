@@ -24,14 +24,20 @@
 #include "fight.h"
 #include "quest.h"
 #include "mud_event.h"
+#include "reactor.h"
+#include "keyword.h"
 
 /* local file scope variables */
 static int extractions_pending = 0;
+/** Characters extract_char() has marked, in the order it marked them. */
+static struct char_data **pending_extractions = NULL;
+static int max_pending_extractions = 0;
 
 /* local file scope functions */
 static int apply_ac(struct char_data *ch, int eq_pos);
 static void update_object(struct obj_data *obj, int use);
 static void affect_modify_ar(struct char_data * ch, byte loc, sbyte mod, int bitv[], bool add);
+static void zone_player_left(zone_rnum zone);
 
 char *fname(const char *namelist)
 {
@@ -368,8 +374,6 @@ void affect_join(struct char_data *ch, struct affected_type *af,
 /* move a player out of a room */
 void char_from_room(struct char_data *ch)
 {
-  struct char_data *temp;
-
   if (ch == NULL || IN_ROOM(ch) == NOWHERE) {
     log("SYSERR: NULL character or NOWHERE in %s, char_from_room", __FILE__);
     exit(1);
@@ -385,9 +389,48 @@ void char_from_room(struct char_data *ch)
       if (GET_OBJ_VAL(GET_EQ(ch, WEAR_LIGHT), 2))	/* Light is ON */
 	world[IN_ROOM(ch)].light--;
 
-  REMOVE_FROM_LIST(ch, world[IN_ROOM(ch)].people, next_in_room);
+  if (ch->char_specials.zone_counted) {
+    zone_player_left(world[IN_ROOM(ch)].zone);
+    ch->char_specials.zone_counted = FALSE;
+  }
+
+  REMOVE_FROM_DLIST(ch, world[IN_ROOM(ch)].people, next_in_room, prev_in_room);
   IN_ROOM(ch) = NOWHERE;
-  ch->next_in_room = NULL;
+
+  if (SCRIPT(ch))
+    random_index_update(SCRIPT(ch));
+}
+
+/* A player has left the zone, or stopped counting as one. */
+static void zone_player_left(zone_rnum zone)
+{
+  if (--zone_table[zone].num_players == 0)
+    zone_table[zone].last_player = pulse;
+}
+
+/* Keep a zone's num_players right when a character in it may have started or
+ * stopped counting as a player: someone connected, who is not an immortal
+ * with nohassle on.  Call this after ch->desc, level or nohassle change. */
+void update_zone_players(struct char_data *ch)
+{
+  bool counts;
+
+  if (IN_ROOM(ch) == NOWHERE)
+    return;
+
+  counts = (ch->desc != NULL);
+  if (!IS_NPC(ch) && GET_LEVEL(ch) >= LVL_IMMORT && PRF_FLAGGED(ch, PRF_NOHASSLE))
+    counts = FALSE;
+
+  if (counts == ch->char_specials.zone_counted)
+    return;
+
+  if (counts)
+    zone_table[world[IN_ROOM(ch)].zone].num_players++;
+  else
+    zone_player_left(world[IN_ROOM(ch)].zone);
+
+  ch->char_specials.zone_counted = counts;
 }
 
 /* place a character in a room */
@@ -397,10 +440,14 @@ void char_to_room(struct char_data *ch, room_rnum room)
     log("SYSERR: Illegal value(s) passed to char_to_room. (Room: %d/%d Ch: %p",
 		room, top_of_world, (void *)ch);
   else {
-    ch->next_in_room = world[room].people;
-    world[room].people = ch;
+    ADD_TO_DLIST(ch, world[room].people, next_in_room, prev_in_room);
     IN_ROOM(ch) = room;
 
+    update_zone_players(ch);
+
+    if (SCRIPT(ch))
+      random_index_update(SCRIPT(ch));
+
     autoquest_trigger_check(ch, 0, 0, AQ_ROOM_FIND);
     autoquest_trigger_check(ch, 0, 0, AQ_MOB_FIND);
 
@@ -421,8 +468,7 @@ void char_to_room(struct char_data *ch, room_rnum room)
 void obj_to_char(struct obj_data *object, struct char_data *ch)
 {
   if (object && ch) {
-    object->next_content = ch->carrying;
-    ch->carrying = object;
+    ADD_TO_DLIST(object, ch->carrying, next_content, prev_content);
     object->carried_by = ch;
     IN_ROOM(object) = NOWHERE;
     IS_CARRYING_W(ch) += GET_OBJ_WEIGHT(object);
@@ -440,13 +486,11 @@ void obj_to_char(struct obj_data *object, struct char_data *ch)
 /* take an object from a char */
 void obj_from_char(struct obj_data *object)
 {
-  struct obj_data *temp;
-
   if (object == NULL) {
     log("SYSERR: NULL object passed to obj_from_char.");
     return;
   }
-  REMOVE_FROM_LIST(object, object->carried_by->carrying, next_content);
+  REMOVE_FROM_DLIST(object, object->carried_by->carrying, next_content, prev_content);
 
   /* set flag for crash-save system, but not on mobs! */
   if (!IS_NPC(object->carried_by))
@@ -455,7 +499,6 @@ void obj_from_char(struct obj_data *object)
   IS_CARRYING_W(object->carried_by) -= GET_OBJ_WEIGHT(object);
   IS_CARRYING_N(object->carried_by)--;
   object->carried_by = NULL;
-  object->next_content = NULL;
 }
 
 /* Return the effect of a piece of armor in position eq_pos */
@@ -676,8 +719,7 @@ void obj_to_room(struct obj_data *object, room_rnum room)
     log("SYSERR: Illegal value(s) passed to obj_to_room. (Room #%d/%d, obj %p)",
 	room, top_of_world, (void *)object);
   else {
-    object->next_content = world[room].contents;
-    world[room].contents = object;
+    ADD_TO_DLIST(object, world[room].contents, next_content, prev_content);
     IN_ROOM(object) = room;
     object->carried_by = NULL;
     if (ROOM_FLAGGED(room, ROOM_HOUSE))
@@ -688,7 +730,6 @@ void obj_to_room(struct obj_data *object, room_rnum room)
 /* Take an object from a room */
 void obj_from_room(struct obj_data *object)
 {
-  struct obj_data *temp;
   struct char_data *t, *tempch;
 
   if (!object || IN_ROOM(object) == NOWHERE) {
@@ -706,12 +747,11 @@ void obj_from_room(struct obj_data *object)
     }
   }
 
-  REMOVE_FROM_LIST(object, world[IN_ROOM(object)].contents, next_content);
+  REMOVE_FROM_DLIST(object, world[IN_ROOM(object)].contents, next_content, prev_content);
 
   if (ROOM_FLAGGED(IN_ROOM(object), ROOM_HOUSE))
     SET_BIT_AR(ROOM_FLAGS(IN_ROOM(object)), ROOM_HOUSE_CRASH);
   IN_ROOM(object) = NOWHERE;
-  object->next_content = NULL;
 }
 
 /* put an object in an object (quaint)  */
@@ -725,8 +765,7 @@ void obj_to_obj(struct obj_data *obj, struct obj_data *obj_to)
     return;
   }
 
-  obj->next_content = obj_to->contains;
-  obj_to->contains = obj;
+  ADD_TO_DLIST(obj, obj_to->contains, next_content, prev_content);
   obj->in_obj = obj_to;
 
   /* Add weight to container, unless unlimited. */
@@ -751,7 +790,7 @@ void obj_from_obj(struct obj_data *obj)
     return;
   }
   obj_from = obj->in_obj;
-  REMOVE_FROM_LIST(obj, obj_from->contains, next_content);
+  REMOVE_FROM_DLIST(obj, obj_from->contains, next_content, prev_content);
 
   /* Subtract weight from containers container unless unlimited. */
   if (GET_OBJ_VAL(obj->in_obj, 0) > 0) {
@@ -764,7 +803,6 @@ void obj_from_obj(struct obj_data *obj)
       IS_CARRYING_W(temp->carried_by) -= GET_OBJ_WEIGHT(obj);
   }
   obj->in_obj = NULL;
-  obj->next_content = NULL;
 }
 
 /* Set all carried_by to point to new owner */
@@ -781,7 +819,6 @@ void object_list_new_owner(struct obj_data *list, struct char_data *ch)
 void extract_obj(struct obj_data *obj)
 {
   struct char_data *ch, *next = NULL;
-  struct obj_data *temp;
 
   if (obj->worn_by != NULL)
     if (unequip_char(obj->worn_by, obj->worn_on) != obj)
@@ -808,7 +845,8 @@ void extract_obj(struct obj_data *obj)
   while (obj->contains)
     extract_obj(obj->contains);
 
-  REMOVE_FROM_LIST(obj, object_list, next);
+  REMOVE_FROM_DLIST(obj, object_list, next, prev);
+  keyword_remove_obj(obj);
 
   if (GET_OBJ_RNUM(obj) != NOTHING)
     (obj_index[GET_OBJ_RNUM(obj)].number)--;
@@ -884,6 +922,9 @@ void extract_char_final(struct char_data *ch)
     exit(1);
   }
 
+  /* extract_pending_chars() has just taken it off character_list. */
+  keyword_remove_char(ch);
+
   /* We're booting the character of someone who has switched so first we need
    * to stuff them back into their own body.  This will set ch->desc we're
    * checking below this loop to the proper value. */
@@ -911,8 +952,10 @@ void extract_char_final(struct char_data *ch)
       for (d = descriptor_list; d; d = d->next) {
         if (d == ch->desc)
           continue;
-        if (d->character && GET_IDNUM(ch) == GET_IDNUM(d->character))
+        if (d->character && GET_IDNUM(ch) == GET_IDNUM(d->character)) {
           STATE(d) = CON_CLOSE;
+          reactor_wake(d);
+        }
       }
       STATE(ch->desc) = CON_MENU;
       write_to_output(ch->desc, "%s", CONFIG_MENU);
@@ -999,52 +1042,46 @@ void extract_char(struct char_data *ch)
   char_from_furniture(ch);
   clear_char_event_list(ch);
 
-  if (IS_NPC(ch) && !MOB_FLAGGED(ch, MOB_NOTDEADYET)) {
+  if (IS_NPC(ch) && !MOB_FLAGGED(ch, MOB_NOTDEADYET))
     SET_BIT_AR(MOB_FLAGS(ch), MOB_NOTDEADYET);
-    ++extractions_pending;
-  }
-  else if (!IS_NPC(ch) && !PLR_FLAGGED(ch, PLR_NOTDEADYET)) {
+  else if (!IS_NPC(ch) && !PLR_FLAGGED(ch, PLR_NOTDEADYET))
     SET_BIT_AR(PLR_FLAGS(ch), PLR_NOTDEADYET);
-    ++extractions_pending;
+  else
+    return;
+
+  if (extractions_pending >= max_pending_extractions) {
+    max_pending_extractions = MAX(32, max_pending_extractions * 2);
+    RECREATE(pending_extractions, struct char_data *, max_pending_extractions);
   }
+  pending_extractions[extractions_pending++] = ch;
 }
 
 /* I'm not particularly pleased with the MOB/PLR hoops that have to be jumped
- * through but it hardly calls for a completely new variable. Ideally it would
- * be its own list, but that would change the '->next' pointer, potentially
- * confusing some code. -gg This doesn't handle recursive extractions. */
+ * through but it hardly calls for a completely new variable. -gg
+ * extract_char() keeps the characters it marks in pending_extractions, so only
+ * they are visited here, and character_list is doubly linked so each comes off
+ * it without a search.  Anyone extracted while this runs is handled in the same
+ * pass. */
 void extract_pending_chars(void)
 {
-  struct char_data *vict, *next_vict, *prev_vict;
-
-  if (extractions_pending < 0)
-    log("SYSERR: Negative (%d) extractions pending.", extractions_pending);
+  struct char_data *vict;
+  int i;
 
-  for (vict = character_list, prev_vict = NULL; vict && extractions_pending; vict = next_vict) {
-    next_vict = vict->next;
+  for (i = 0; i < extractions_pending; i++) {
+    vict = pending_extractions[i];
 
     if (MOB_FLAGGED(vict, MOB_NOTDEADYET))
       REMOVE_BIT_AR(MOB_FLAGS(vict), MOB_NOTDEADYET);
     else if (PLR_FLAGGED(vict, PLR_NOTDEADYET))
       REMOVE_BIT_AR(PLR_FLAGS(vict), PLR_NOTDEADYET);
-    else {
-      /* Last non-free'd character to continue chain from. */
-      prev_vict = vict;
-      continue;
-    }
+    else
+      continue;	/* someone cleared the mark; leave it be */
 
+    /* Off the list first: an NPC is freed by extract_char_final(). */
+    REMOVE_FROM_DLIST(vict, character_list, next, prev);
     extract_char_final(vict);
-    extractions_pending--;
-
-    if (prev_vict)
-      prev_vict->next = next_vict;
-    else
-      character_list = next_vict;
   }
 
-  if (extractions_pending > 0)
-    log("SYSERR: Couldn't find %d extractions as counted.", extractions_pending);
-
   extractions_pending = 0;
 }
 
@@ -1052,15 +1089,17 @@ void extract_pending_chars(void)
  * which incorporate the actual player-data */
 struct char_data *get_player_vis(struct char_data *ch, char *name, int *number, int inroom)
 {
-  struct char_data *i;
-  int num;
+  struct char_data *i, **found;
+  int num, j, count;
 
   if (!number) {
     number = &num;
     num = get_number(&name);
   }
 
-  for (i = character_list; i; i = i->next) {
+  found = keyword_find_chars(name, &count);
+  for (j = 0; j < count; j++) {
+    i = found[j];
     if (IS_NPC(i))
       continue;
     if (inroom == FIND_CHAR_ROOM && IN_ROOM(i) != IN_ROOM(ch))
@@ -1106,8 +1145,8 @@ struct char_data *get_char_room_vis(struct char_data *ch, char *name, int *numbe
 
 struct char_data *get_char_world_vis(struct char_data *ch, char *name, int *number)
 {
-  struct char_data *i;
-  int num;
+  struct char_data *i, **found;
+  int num, j, count;
 
   if (!number) {
     number = &num;
@@ -1120,7 +1159,9 @@ struct char_data *get_char_world_vis(struct char_data *ch, char *name, int *numb
   if (*number == 0)
     return get_player_vis(ch, name, NULL, 0);
 
-  for (i = character_list; i && *number; i = i->next) {
+  found = keyword_find_chars(name, &count);
+  for (j = 0; j < count && *number; j++) {
+    i = found[j];
     if (IN_ROOM(ch) == IN_ROOM(i))
       continue;
     if (!isname(name, i->player.name))
@@ -1170,8 +1211,8 @@ struct obj_data *get_obj_in_list_vis(struct char_data *ch, char *name, int *numb
 /* search the entire world for an object, and return a pointer  */
 struct obj_data *get_obj_vis(struct char_data *ch, char *name, int *number)
 {
-  struct obj_data *i;
-  int num;
+  struct obj_data *i, **found;
+  int num, j, count;
 
   if (!number) {
     number = &num;
@@ -1189,12 +1230,13 @@ struct obj_data *get_obj_vis(struct char_data *ch, char *name, int *number)
   if ((i = get_obj_in_list_vis(ch, name, number, world[IN_ROOM(ch)].contents)) != NULL)
     return (i);
 
-  /* ok.. no luck yet. scan the entire obj list   */
-  for (i = object_list; i && *number; i = i->next)
-    if (isname(name, i->name))
-      if (CAN_SEE_OBJ(ch, i))
+  /* ok.. no luck yet. scan everything in the world by that name */
+  found = keyword_find_objs(name, &count);
+  for (j = 0; j < count && *number; j++)
+    if (isname(name, found[j]->name))
+      if (CAN_SEE_OBJ(ch, found[j]))
 	if (--(*number) == 0)
-	  return (i);
+	  return (found[j]);
 
   return (NULL);
 }
@@ -1318,6 +1360,7 @@ struct obj_data *create_money(int amount)
 
   new_descr->next = NULL;
   obj->ex_description = new_descr;
+  keyword_update_obj(obj);
 
   GET_OBJ_TYPE(obj) = ITEM_MONEY;
   for(y = 0; y < TW_ARRAY_MAX; y++)
@@ -53,6 +53,7 @@ struct char_data *get_char_num(mob_rnum nr);
 
 void	char_from_room(struct char_data *ch);
 void	char_to_room(struct char_data *ch, room_rnum room);
+void	update_zone_players(struct char_data *ch);
 void	extract_char(struct char_data *ch);
 void	extract_char_final(struct char_data *ch);
 void	extract_pending_chars(void);
@@ -100,6 +101,8 @@ void forget(struct char_data *ch, struct char_data *victim);
 void remember(struct char_data *ch, struct char_data *victim);
 void mobile_activity(void);
 void clearMemory(struct char_data *ch);
+extern long mobiles_acted;
+extern long mobiles_skipped;
 
 
 /* For new last command: */
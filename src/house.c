@@ -19,6 +19,7 @@
 #include "house.h"
 #include "constants.h"
 #include "modify.h"
+#include "savequeue.h"
 
 /* local (file scope only) globals */
 static struct house_control_rec house_control[MAX_HOUSES];
@@ -64,6 +65,7 @@ static int House_load(room_vnum vnum)
     return (0);
   if (!House_get_filename(vnum, filename, sizeof(filename)))
     return (0);
+  savequeue_wait(filename);
   if (!(fl = fopen(filename, "r")))	/* no file found */
     return (0);
 
@@ -128,17 +130,15 @@ void House_crashsave(room_vnum vnum)
     return;
   if (!House_get_filename(vnum, buf, sizeof(buf)))
     return;
-  if (!(fp = fopen(buf, "wb"))) {
-    perror("SYSERR: Error saving house file");
+  if (!(fp = savequeue_open(buf)))
     return;
-  }
   if (!House_save(world[rnum].contents, fp)) {
-    fclose(fp);
+    savequeue_abort(fp);
     return;
   }
-  fclose(fp);
   House_restore_weight(world[rnum].contents);
-  REMOVE_BIT_AR(ROOM_FLAGS(rnum), ROOM_HOUSE_CRASH);
+  if (savequeue_close(fp) == 0)
+    REMOVE_BIT_AR(ROOM_FLAGS(rnum), ROOM_HOUSE_CRASH);
 }
 
 /* Delete a house save file */
@@ -149,6 +149,7 @@ static void House_delete_file(room_vnum vnum)
 
   if (!House_get_filename(vnum, filename, sizeof(filename)))
     return;
+  savequeue_wait(filename);
   if (!(fl = fopen(filename, "rb"))) {
     if (errno != ENOENT)
       log("SYSERR: Error deleting house file #%d. (1): %s", vnum, strerror(errno));
@@ -170,6 +171,7 @@ static void House_listrent(struct char_data *ch, room_vnum vnum)
 
   if (!House_get_filename(vnum, filename, sizeof(filename)))
     return;
+  savequeue_wait(filename);
   if (!(fl = fopen(filename, "rb"))) {
     send_to_char(ch, "No objects on file for house #%d.\r\n", vnum);
     return;
@@ -563,6 +565,26 @@ void House_save_all(void)
 	House_crashsave(house_control[i].vnum);
 }
 
+/* Crash-save up to max houses that need it, starting with house number *pos,
+ * for autosave_pulse().  *pos is left at the next house to look at.  Returns
+ * the number saved, or -1 if there were no houses left to look at. */
+int House_save_some(int *pos, int max)
+{
+  room_rnum real_house;
+  int saved = 0;
+
+  if (*pos >= num_of_houses)
+    return (-1);
+
+  for (; *pos < num_of_houses && saved < max; (*pos)++)
+    if ((real_house = real_room(house_control[*pos].vnum)) != NOWHERE &&
+        ROOM_FLAGGED(real_house, ROOM_HOUSE_CRASH)) {
+      House_crashsave(house_control[*pos].vnum);
+      saved++;
+    }
+  return (saved);
+}
+
 /* note: arg passed must be house vnum, so there. */
 int House_can_enter(struct char_data *ch, room_vnum house)
 {
@@ -664,6 +686,7 @@ static int ascii_convert_house(struct char_data *ch, obj_vnum vnum)
 	int i, j=0;
 
   House_get_filename(vnum, infile, sizeof(infile));
+  savequeue_wait(infile);
 
 	CREATE(outfile, char, strlen(infile)+7);
 	sprintf(outfile, "%s.ascii", infile);
@@ -37,15 +37,44 @@
 #include "prefedit.h"
 #include "ibt.h"
 #include "mud_event.h"
+#include "reactor.h"
+#include "keyword.h"
 
 /* local (file scope) functions */
 static int perform_dupe_check(struct descriptor_data *d);
 static struct alias_data *find_alias(struct alias_data *alias_list, char *str);
-static void perform_complex_alias(struct txt_q *input_q, char *orig, struct alias_data *a);
+static int perform_complex_alias(struct input_ring *input_q, char *orig, struct alias_data *a);
 static int _parse_name(char *arg, char *name);
 static bool perform_new_char_dupe_check(struct descriptor_data *d);
 /* sort_commands utility */
 static int sort_commands_helper(const void *a, const void *b);
+/* command trie utilities */
+static struct cmd_trie_node *trie_child(struct cmd_trie_node *node, char letter, bool create);
+static void trie_add_command(int cmd);
+static void trie_free_node(struct cmd_trie_node *node);
+
+/** One step of a command trie node's level ladder: the first command, in
+ * complete_cmd_info order, open to characters of at least 'level'. */
+struct cmd_trie_step {
+  int level;
+  int cmd;
+};
+
+/** A node of the command trie.  The path down from the root spells a prefix,
+ * and the node knows which command that prefix runs at every level: for
+ * real commands and for socials, a ladder of steps with falling levels, so
+ * the first step a character qualifies for is the one a linear scan of
+ * complete_cmd_info would have stopped at. */
+struct cmd_trie_node {
+  char letter;                        /**< Last letter of this prefix */
+  struct cmd_trie_node *children;     /**< Longer prefixes */
+  struct cmd_trie_node *next;         /**< Sibling, same length prefix */
+  int exact;                          /**< First command with exactly this name, or -1 */
+  struct cmd_trie_step *steps[2];     /**< 0: real commands, 1: socials */
+  int num_steps[2];                   /**< Entries in each ladder */
+};
+
+static struct cmd_trie_node *cmd_trie = NULL;
 
 /* globals defined here, used here and elsewhere */
 int *cmd_sort_info = NULL;
@@ -517,30 +546,20 @@ void command_interpreter(struct char_data *ch, char *argument)
        return;
    }
 
-  for (length = strlen(arg), cmd = 0; *complete_cmd_info[cmd].command != '\n'; cmd++)
-    if(complete_cmd_info[cmd].command_pointer != do_action &&
-       !strncmp(complete_cmd_info[cmd].command, arg, length))
-      if (GET_LEVEL(ch) >= complete_cmd_info[cmd].minimum_level)
-        break;
-
-  /* it's not a 'real' command, so it's a social */
-
-  if(*complete_cmd_info[cmd].command == '\n')
-    for (length = strlen(arg), cmd = 0; *complete_cmd_info[cmd].command != '\n'; cmd++)
-      if (complete_cmd_info[cmd].command_pointer == do_action &&
-          !strncmp(complete_cmd_info[cmd].command, arg, length))
-        if (GET_LEVEL(ch) >= complete_cmd_info[cmd].minimum_level)
-          break;
-
-  if (*complete_cmd_info[cmd].command == '\n') {
+  /* A real command if there is one, otherwise it's a social. */
+  if ((cmd = lookup_command(arg, GET_LEVEL(ch))) < 0) {
     int found = 0;
     send_to_char(ch, "%s", CONFIG_HUH);
 
-    for (cmd = 0; *cmd_info[cmd].command != '\n'; cmd++)
+    for (length = strlen(arg), cmd = 0; *cmd_info[cmd].command != '\n'; cmd++)
     {
       if (*arg != *cmd_info[cmd].command || cmd_info[cmd].minimum_level > GET_LEVEL(ch))
         continue;
 
+      /* Names that differ in length by more than 2 can't be within 2 edits. */
+      if (abs((int) strlen(cmd_info[cmd].command) - length) > 2)
+        continue;
+
       /* Only apply levenshtein counts if the command is not a trigger command. */
       if ( (levenshtein_distance(arg, cmd_info[cmd].command) <= 2) &&
            (cmd_info[cmd].minimum_level >= 0) )
@@ -672,9 +691,9 @@ ACMD(do_alias)
  * commands. */
 #define NUM_TOKENS       9
 
-static void perform_complex_alias(struct txt_q *input_q, char *orig, struct alias_data *a)
+static int perform_complex_alias(struct input_ring *input_q, char *orig, struct alias_data *a)
 {
-  struct txt_q temp_queue;
+  static struct input_ring temp_queue;	/* static: a whole ring is large */
   char *tokens[NUM_TOKENS], *temp, *write_point;
   char buf2[MAX_RAW_INPUT_LENGTH], buf[MAX_RAW_INPUT_LENGTH];	/* raw? */
   int num_of_tokens = 0, num;
@@ -689,7 +708,7 @@ static void perform_complex_alias(struct txt_q *input_q, char *orig, struct alia
 
   /* initialize */
   write_point = buf;
-  temp_queue.head = temp_queue.tail = NULL;
+  temp_queue.head = temp_queue.used = temp_queue.lines = 0;
 
   /* now parse the alias */
   for (temp = a->replacement; *temp; temp++) {
@@ -718,12 +737,7 @@ static void perform_complex_alias(struct txt_q *input_q, char *orig, struct alia
   write_to_q(buf, &temp_queue, 1);
 
   /* push our temp_queue on to the _front_ of the input queue */
-  if (input_q->head == NULL)
-    *input_q = temp_queue;
-  else {
-    temp_queue.tail->next = input_q->head;
-    input_q->head = temp_queue.head;
-  }
+  return (prepend_to_q(input_q, &temp_queue));
 }
 
 /* Given a character and a string, perform alias replacement on it.
@@ -758,10 +772,13 @@ int perform_alias(struct descriptor_data *d, char *orig, size_t maxlen)
   if (a->type == ALIAS_SIMPLE) {
     strlcpy(orig, a->replacement, maxlen);
     return (0);
-  } else {
-    perform_complex_alias(&d->input, ptr, a);
+  } else if (perform_complex_alias(&d->input, ptr, a))
     return (1);
-  }
+
+  /* No room left in the input queue for the expansion. */
+  send_to_char(d->character, "Too many commands are waiting to run that alias.\r\n");
+  *orig = '\0';
+  return (0);
 }
 
 /* Various other parsing utilities. */
@@ -964,14 +981,122 @@ void half_chop(char *string, char *arg1, char *arg2)
 
 /* Used in specprocs, mostly.  (Exactly) matches "command" to cmd number */
 int find_command(const char *command)
+{
+  struct cmd_trie_node *node = cmd_trie;
+
+  for (; node && *command; command++)
+    node = trie_child(node, *command, FALSE);
+
+  return (node ? node->exact : -1);
+}
+
+/* The command that 'arg', or any abbreviation of it, runs for a character of
+ * 'level': the first one in complete_cmd_info that starts with 'arg' and
+ * that they may use, preferring real commands over socials.  Returns -1 if
+ * there is none. */
+int lookup_command(const char *arg, int level)
+{
+  struct cmd_trie_node *node = cmd_trie;
+  int kind, i;
+
+  for (; node && *arg; arg++)
+    node = trie_child(node, *arg, FALSE);
+
+  if (!node)
+    return (-1);
+
+  for (kind = 0; kind < 2; kind++)
+    for (i = 0; i < node->num_steps[kind]; i++)
+      if (level >= node->steps[kind][i].level)
+        return (node->steps[kind][i].cmd);
+
+  return (-1);
+}
+
+/* Find the child of 'node' for 'letter', adding it if asked to. */
+static struct cmd_trie_node *trie_child(struct cmd_trie_node *node, char letter, bool create)
+{
+  struct cmd_trie_node *child;
+
+  for (child = node->children; child; child = child->next)
+    if (child->letter == letter)
+      return (child);
+
+  if (!create)
+    return (NULL);
+
+  CREATE(child, struct cmd_trie_node, 1);
+  child->letter = letter;
+  child->exact = -1;
+  child->next = node->children;
+  node->children = child;
+
+  return (child);
+}
+
+/* Enter a command into the trie under every prefix of its name, including
+ * the empty one.  Commands must be added in complete_cmd_info order: one
+ * only earns a step on a ladder if it is open to lower levels than every
+ * command already there, as otherwise a scan would never stop at it. */
+static void trie_add_command(int cmd)
+{
+  struct cmd_trie_node *node = cmd_trie;
+  const char *name = complete_cmd_info[cmd].command;
+  int kind = (complete_cmd_info[cmd].command_pointer == do_action);
+  int level = complete_cmd_info[cmd].minimum_level, n;
+
+  for (;;) {
+    n = node->num_steps[kind];
+    if (!n || level < node->steps[kind][n - 1].level) {
+      RECREATE(node->steps[kind], struct cmd_trie_step, n + 1);
+      node->steps[kind][n].level = level;
+      node->steps[kind][n].cmd = cmd;
+      node->num_steps[kind]++;
+    }
+    if (!*name)
+      break;
+    node = trie_child(node, *name++, TRUE);
+  }
+
+  if (node->exact < 0)
+    node->exact = cmd;
+}
+
+/* Index complete_cmd_info by prefix.  Called whenever the command list is
+ * (re)built, so socials changed in aedit are picked up. */
+void build_command_trie(void)
 {
   int cmd;
 
+  free_command_trie();
+
+  CREATE(cmd_trie, struct cmd_trie_node, 1);
+  cmd_trie->exact = -1;
+
   for (cmd = 0; *complete_cmd_info[cmd].command != '\n'; cmd++)
-    if (!strcmp(complete_cmd_info[cmd].command, command))
-      return (cmd);
+    trie_add_command(cmd);
+}
 
-  return (-1);
+static void trie_free_node(struct cmd_trie_node *node)
+{
+  struct cmd_trie_node *child, *next;
+
+  for (child = node->children; child; child = next) {
+    next = child->next;
+    trie_free_node(child);
+  }
+  if (node->steps[0])
+    free(node->steps[0]);
+  if (node->steps[1])
+    free(node->steps[1]);
+  free(node);
+}
+
+void free_command_trie(void)
+{
+  if (cmd_trie)
+    trie_free_node(cmd_trie);
+  cmd_trie = NULL;
 }
 
 int special(struct char_data *ch, int cmd, char *arg)
@@ -1056,13 +1181,16 @@ static int perform_dupe_check(struct descriptor_data *d)
 
       write_to_output(d, "\r\nMultiple login detected -- disconnecting.\r\n");
       STATE(k) = CON_CLOSE;
+      reactor_wake(k);
       pref_temp=GET_PREF(k->character);
       if (!target) {
 	target = k->original;
 	mode = UNSWITCH;
       }
-      if (k->character)
+      if (k->character) {
 	k->character->desc = NULL;
+	update_zone_players(k->character);
+      }
       k->character = NULL;
       k->original = NULL;
     } else if (k->character && GET_IDNUM(k->character) == id && k->original) {
@@ -1079,10 +1207,12 @@ static int perform_dupe_check(struct descriptor_data *d)
 	mode = USURP;
       }
       k->character->desc = NULL;
+      update_zone_players(k->character);
       k->character = NULL;
       k->original = NULL;
       write_to_output(k, "\r\nMultiple login detected -- disconnecting.\r\n");
       STATE(k) = CON_CLOSE;
+      reactor_wake(k);
     }
   }
 
@@ -1142,6 +1272,7 @@ static int perform_dupe_check(struct descriptor_data *d)
   free_char(d->character); /* get rid of the old char */
   d->character = target;
   d->character->desc = d;
+  update_zone_players(d->character);
   d->original = NULL;
   d->character->char_specials.timer = 0;
   REMOVE_BIT_AR(PLR_FLAGS(d->character), PLR_MAILING);
@@ -1202,6 +1333,7 @@ static bool perform_new_char_dupe_check(struct descriptor_data *d)
         k->original = NULL;
         write_to_output(k, "\r\nMultiple login detected -- disconnecting.\r\n");
         STATE(k) = CON_CLOSE;
+        reactor_wake(k);
 
         mudlog(NRM, LVL_GOD, TRUE, "Multiple logins detected in char creation for %s.", GET_NAME(d->character));
 
@@ -1213,6 +1345,7 @@ static bool perform_new_char_dupe_check(struct descriptor_data *d)
         k->original = NULL;
         write_to_output(k, "\r\nMultiple login detected -- disconnecting.\r\n");
         STATE(k) = CON_CLOSE;
+        reactor_wake(k);
 
         d->character->desc = NULL;
         d->character = NULL;
@@ -1236,6 +1369,7 @@ int enter_player_game (struct descriptor_data *d)
   int load_result;
   room_vnum load_room;
 
+  load_char_deferred(d->character);
   reset_char(d->character);
 
   if (PLR_FLAGGED(d->character, PLR_INVSTART))
@@ -1268,8 +1402,8 @@ int enter_player_game (struct descriptor_data *d)
   if (!SCRIPT(d->character))
     read_saved_vars(d->character);
 
-  d->character->next = character_list;
-  character_list = d->character;
+  ADD_TO_DLIST(d->character, character_list, next, prev);
+  keyword_add_char(d->character);
   char_to_room(d->character, load_room);
   load_result = Crash_load(d->character);
 
@@ -1382,7 +1516,7 @@ void nanny(struct descriptor_data *d, char *arg)
           write_to_output(d, "Invalid name, please try another.\r\nName: ");
           return;
       }
-      if ((player_i = load_char(tmp_name, d->character)) > -1) {
+      if ((player_i = load_char_lazy(tmp_name, d->character)) > -1) {
         GET_PFILEPOS(d->character) = player_i;
 
         if (PLR_FLAGGED(d->character, PLR_DELETED)) {
@@ -1445,7 +1579,7 @@ void nanny(struct descriptor_data *d, char *arg)
 
   case CON_NAME_CNFRM:		/* wait for conf. of new name    */
     if (UPPER(*arg) == 'Y') {
-      if (isbanned(d->host) >= BAN_NEW) {
+      if (isbanned(d->host, &d->addr) >= BAN_NEW) {
 	mudlog(NRM, LVL_GOD, TRUE, "Request for new char %s denied from [%s] (siteban)", GET_PC_NAME(d->character), d->host);
 	write_to_output(d, "Sorry, new characters are not allowed from your site!\r\n");
 	STATE(d) = CON_CLOSE;
@@ -1506,7 +1640,7 @@ void nanny(struct descriptor_data *d, char *arg)
       GET_BAD_PWS(d->character) = 0;
       d->bad_pws = 0;
 
-      if (isbanned(d->host) == BAN_SELECT &&
+      if (isbanned(d->host, &d->addr) == BAN_SELECT &&
 	  !PLR_FLAGGED(d->character, PLR_SITEOK)) {
 	write_to_output(d, "Sorry, this char has not been cleared for login from your site!\r\n");
 	STATE(d) = CON_CLOSE;
@@ -0,0 +1,338 @@
+/**
+* @file keyword.c
+* Index of the keywords carried by live characters and objects.
+*
+* Part of the core altMUD source code distribution, which is a derivative
+* of, and continuation of, CircleMUD.
+*
+* All rights reserved.  See license for complete information.
+*
+* World wide lookups by name used to walk the whole character_list or
+* object_list, calling isname() on everything in the game.  Every live
+* character and object now has its keywords filed in a prefix trie, one for
+* characters and one for objects, so a lookup only visits the things that
+* have a keyword starting with the name asked for.  isname() matches
+* abbreviations, which is why this is a trie and not a hash: everything
+* under the node for "sw" is a candidate for "sw".
+*
+* The trie only narrows the search.  Callers still run isname() (or whatever
+* test they used before) on each candidate, and candidates come back in
+* list order, so "2.guard" still means the second match the old list walk
+* would have found.  Both lists only ever grow at the head, so each thing is
+* stamped with a sequence number when it is linked in and list order is
+* simply newest first.
+*/
+
+#include "conf.h"
+#include "sysdep.h"
+#include "structs.h"
+#include "utils.h"
+#include "pool.h"
+#include "keyword.h"
+
+/** One letter of a keyword.  Nodes are freed as soon as nothing is filed
+ * at or below them. */
+struct keyword_node {
+  struct keyword_node *parent;   /**< NULL for the root */
+  struct keyword_node *children; /**< First node one letter further on */
+  struct keyword_node *next;     /**< Next child of the same parent */
+  struct keyword_post *posts;    /**< Keywords that end at this node */
+  int count;                     /**< Keywords at or below this node */
+  char letter;                   /**< Lower case */
+};
+
+/** One keyword of one character or object. */
+struct keyword_post {
+  struct keyword_node *node;     /**< Where the keyword ends */
+  struct keyword_post *prev;     /**< Other keywords ending at the node */
+  struct keyword_post *next;
+  struct keyword_post *next_in_set; /**< Next keyword of the same thing */
+  struct keyword_set *set;       /**< The thing this keyword belongs to */
+};
+
+/** Everything filed for one character or object; ch->keywords/obj->keywords
+ * point here for as long as it is on character_list or object_list. */
+struct keyword_set {
+  void *thing;                   /**< The char_data or obj_data */
+  long seq;                      /**< Higher is nearer the head of the list */
+  struct keyword_post *posts;    /**< Its keywords */
+};
+
+/** A trie, and the buffer its lookups are collected into. */
+struct keyword_index {
+  struct keyword_node root;
+  struct keyword_set **found;
+  int max_found;
+};
+
+#define KEYWORD_SEPARATOR(c)  ((c) == ' ' || (c) == '\t')	/* as isname() */
+
+/* file scope variables */
+static struct keyword_index char_keywords;
+static struct keyword_index obj_keywords;
+static struct mem_pool *node_pool = NULL;
+static struct mem_pool *post_pool = NULL;
+static struct mem_pool *set_pool = NULL;
+static long keyword_seq = 0;  /**< Last sequence number handed out */
+
+/* local functions */
+static void file_keyword(struct keyword_index *idx, struct keyword_set *set, const char *word, size_t len);
+static void file_keywords(struct keyword_index *idx, struct keyword_set *set, const char *names);
+static void unfile_keywords(struct keyword_set *set);
+static struct keyword_set *add_thing(struct keyword_index *idx, void *thing, const char *names);
+static void remove_thing(struct keyword_set **setp);
+static void collect_subtree(struct keyword_index *idx, struct keyword_node *node, int *num);
+static int newest_first(const void *a, const void *b);
+static int find_things(struct keyword_index *idx, const char *name);
+
+/* File one keyword of 'set', creating the path to it as needed. */
+static void file_keyword(struct keyword_index *idx, struct keyword_set *set, const char *word, size_t len)
+{
+  struct keyword_node *node = &idx->root, *child;
+  struct keyword_post *post;
+  size_t i;
+
+  node->count++;
+  for (i = 0; i < len; i++) {
+    for (child = node->children; child; child = child->next)
+      if (child->letter == LOWER(word[i]))
+        break;
+
+    if (!child) {
+      POOL_CREATE(child, node_pool, struct keyword_node);
+      child->letter = LOWER(word[i]);
+      child->parent = node;
+      child->next = node->children;
+      node->children = child;
+    }
+    node = child;
+    node->count++;
+  }
+
+  POOL_CREATE(post, post_pool, struct keyword_post);
+  post->node = node;
+  post->set = set;
+  post->next = node->posts;
+  if (node->posts)
+    node->posts->prev = post;
+  node->posts = post;
+  post->next_in_set = set->posts;
+  set->posts = post;
+}
+
+/* File every word of a keyword list, split the way isname() splits it. */
+static void file_keywords(struct keyword_index *idx, struct keyword_set *set, const char *names)
+{
+  const char *word;
+
+  if (!names)
+    return;
+
+  while (*names) {
+    for (; KEYWORD_SEPARATOR(*names); names++)
+      ;
+    for (word = names; *names && !KEYWORD_SEPARATOR(*names); names++)
+      ;
+    if (names > word)
+      file_keyword(idx, set, word, names - word);
+  }
+}
+
+/* Take every keyword of 'set' back out, pruning nodes left empty. */
+static void unfile_keywords(struct keyword_set *set)
+{
+  struct keyword_post *post;
+  struct keyword_node *node, *parent, **prev;
+
+  while ((post = set->posts) != NULL) {
+    set->posts = post->next_in_set;
+
+    if (post->prev)
+      post->prev->next = post->next;
+    else
+      post->node->posts = post->next;
+    if (post->next)
+      post->next->prev = post->prev;
+
+    for (node = post->node; node; node = parent) {
+      parent = node->parent;
+      if (--node->count > 0 || !parent)
+        continue;
+      /* Nothing filed here or below; anything below is already gone. */
+      for (prev = &parent->children; *prev != node; prev = &(*prev)->next)
+        ;
+      *prev = node->next;
+      pool_free(node_pool, node);
+    }
+    pool_free(post_pool, post);
+  }
+}
+
+static struct keyword_set *add_thing(struct keyword_index *idx, void *thing, const char *names)
+{
+  struct keyword_set *set;
+
+  POOL_CREATE(set, set_pool, struct keyword_set);
+  set->thing = thing;
+  set->seq = ++keyword_seq;
+  file_keywords(idx, set, names);
+
+  return (set);
+}
+
+static void remove_thing(struct keyword_set **setp)
+{
+  if (!*setp)
+    return;
+
+  unfile_keywords(*setp);
+  pool_free(set_pool, *setp);
+  *setp = NULL;
+}
+
+/* Add everything filed at or below 'node' to idx->found. */
+static void collect_subtree(struct keyword_index *idx, struct keyword_node *node, int *num)
+{
+  struct keyword_post *post;
+  struct keyword_node *child;
+
+  for (post = node->posts; post; post = post->next) {
+    if (*num >= idx->max_found) {
+      idx->max_found = MAX(64, idx->max_found * 2);
+      RECREATE(idx->found, struct keyword_set *, idx->max_found);
+    }
+    idx->found[(*num)++] = post->set;
+  }
+
+  for (child = node->children; child; child = child->next)
+    collect_subtree(idx, child, num);
+}
+
+static int newest_first(const void *a, const void *b)
+{
+  const struct keyword_set *sa = *(struct keyword_set * const *) a;
+  const struct keyword_set *sb = *(struct keyword_set * const *) b;
+
+  return (sa->seq < sb->seq) - (sa->seq > sb->seq);
+}
+
+/* Leave every thing with a keyword that 'name' abbreviates in idx->found,
+ * once each and in list order, and return how many there are.  A name with
+ * spaces in it can only match a keyword list equal to it, so its first word
+ * is enough to find the candidates. */
+static int find_things(struct keyword_index *idx, const char *name)
+{
+  struct keyword_node *node = &idx->root;
+  int num = 0, i, j;
+
+  for (; KEYWORD_SEPARATOR(*name); name++)
+    ;
+  if (!*name)
+    return (0);
+
+  for (; *name && !KEYWORD_SEPARATOR(*name) && node; name++)
+    for (node = node->children; node; node = node->next)
+      if (node->letter == LOWER(*name))
+        break;
+
+  if (!node)
+    return (0);
+
+  collect_subtree(idx, node, &num);
+  if (num > 1)
+    qsort(idx->found, num, sizeof(struct keyword_set *), newest_first);
+
+  /* A thing with two keywords matching the prefix was collected twice. */
+  for (i = j = 0; i < num; i++)
+    if (j == 0 || idx->found[j - 1] != idx->found[i])
+      idx->found[j++] = idx->found[i];
+
+  return (j);
+}
+
+/** Files a character that has just been put on character_list. */
+void keyword_add_char(struct char_data *ch)
+{
+  remove_thing(&ch->keywords);
+  ch->keywords = add_thing(&char_keywords, ch, ch->player.name);
+}
+
+/** Drops a character leaving character_list.  Harmless if it is not
+ * filed. */
+void keyword_remove_char(struct char_data *ch)
+{
+  remove_thing(&ch->keywords);
+}
+
+/** Refiles a character after ch->player.name has changed.  Does nothing for
+ * a character that is not in the game. */
+void keyword_update_char(struct char_data *ch)
+{
+  if (!ch->keywords)
+    return;
+
+  unfile_keywords(ch->keywords);
+  file_keywords(&char_keywords, ch->keywords, ch->player.name);
+}
+
+/** Files an object that has just been put on object_list. */
+void keyword_add_obj(struct obj_data *obj)
+{
+  remove_thing(&obj->keywords);
+  obj->keywords = add_thing(&obj_keywords, obj, obj->name);
+}
+
+/** Drops an object leaving object_list.  Harmless if it is not filed. */
+void keyword_remove_obj(struct obj_data *obj)
+{
+  remove_thing(&obj->keywords);
+}
+
+/** Refiles an object after obj->name has changed.  Does nothing for an
+ * object that is not in the game. */
+void keyword_update_obj(struct obj_data *obj)
+{
+  if (!obj->keywords)
+    return;
+
+  unfile_keywords(obj->keywords);
+  file_keywords(&obj_keywords, obj->keywords, obj->name);
+}
+
+/** Returns the characters that may answer to 'name', in character_list
+ * order, with the number of them in *count.  Every one still needs checking
+ * with isname(); characters that cannot match are never returned.  The array
+ * is reused by the next call, so do not look anything else up while walking
+ * it. */
+struct char_data **keyword_find_chars(const char *name, int *count)
+{
+  static struct char_data **chars = NULL;
+  static int max_chars = 0;
+  int i;
+
+  if ((*count = find_things(&char_keywords, name)) > max_chars) {
+    max_chars = char_keywords.max_found;
+    RECREATE(chars, struct char_data *, max_chars);
+  }
+  for (i = 0; i < *count; i++)
+    chars[i] = (struct char_data *) char_keywords.found[i]->thing;
+
+  return (chars);
+}
+
+/** As keyword_find_chars(), for objects on object_list. */
+struct obj_data **keyword_find_objs(const char *name, int *count)
+{
+  static struct obj_data **objs = NULL;
+  static int max_objs = 0;
+  int i;
+
+  if ((*count = find_things(&obj_keywords, name)) > max_objs) {
+    max_objs = obj_keywords.max_found;
+    RECREATE(objs, struct obj_data *, max_objs);
+  }
+  for (i = 0; i < *count; i++)
+    objs[i] = (struct obj_data *) obj_keywords.found[i]->thing;
+
+  return (objs);
+}
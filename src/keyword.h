@@ -0,0 +1,23 @@
+/**
+* @file keyword.h
+* Index of the keywords carried by live characters and objects.
+*
+* Part of the core altMUD source code distribution, which is a derivative
+* of, and continuation of, CircleMUD.
+*
+* All rights reserved.  See license for complete information.
+*/
+#ifndef _KEYWORD_H_
+#define _KEYWORD_H_
+
+/* Functions in keyword.c */
+void keyword_add_char(struct char_data *ch);
+void keyword_remove_char(struct char_data *ch);
+void keyword_update_char(struct char_data *ch);
+void keyword_add_obj(struct obj_data *obj);
+void keyword_remove_obj(struct obj_data *obj);
+void keyword_update_obj(struct obj_data *obj);
+struct char_data **keyword_find_chars(const char *name, int *count);
+struct obj_data **keyword_find_objs(const char *name, int *count);
+
+#endif /* _KEYWORD_H_ */
@@ -22,6 +22,7 @@
 #include "fight.h"
 #include "screen.h"
 #include "mud_event.h"
+#include "reactor.h"
 
 /* local file scope function prototypes */
 static int graf(int grafage, int p0, int p1, int p2, int p3, int p4, int p5, int p6);
@@ -398,12 +399,14 @@ static void check_idling(struct char_data *ch)
       char_to_room(ch, 3);
       if (ch->desc) {
 	STATE(ch->desc) = CON_DISCONNECT;
+	reactor_wake(ch->desc);
 	/*
 	 * For the 'if (d->character)' test in close_socket().
 	 * -gg 3/1/98 (Happy anniversary.)
 	 */
 	ch->desc->character = NULL;
 	ch->desc = NULL;
+	update_zone_players(ch);
       }
       if (CONFIG_FREE_RENT)
 	Crash_rentsave(ch, 0);
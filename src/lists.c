@@ -11,11 +11,15 @@
 #include "utils.h"
 #include "db.h"
 #include "dg_event.h"
+#include "pool.h"
 
 static struct iterator_data Iterator;
 static bool loop = FALSE;
 static struct list_data *pLastList = NULL;
 
+/* List items come and go with every event, so they come from a pool */
+static struct mem_pool *item_pool = NULL;
+
 /* Global lists */
 struct list_data * global_lists = NULL;
 struct list_data * group_list   = NULL;
@@ -45,7 +49,7 @@ static struct item_data * create_item(void)
 {
   struct item_data *pNewItem;
 
-  CREATE(pNewItem, struct item_data, 1);
+  POOL_CREATE(pNewItem, item_pool, struct item_data);
 
   pNewItem->pNextItem = NULL;
   pNewItem->pPrevItem = NULL;
@@ -129,7 +133,7 @@ void remove_from_list(void * pContent, struct list_data * pList)
     pList->pFirstItem = NULL;
     pList->pLastItem  = NULL;
   }
-  free(pRemovedItem);
+  pool_free(item_pool, pRemovedItem);
 }
 
 /** Merges an iterator with a list
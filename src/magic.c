@@ -22,6 +22,7 @@
 #include "class.h"
 #include "fight.h"
 #include "mud_event.h"
+#include "keyword.h"
 
 
 /* local file scope function prototypes */
@@ -770,6 +771,7 @@ void mag_summons(int level, struct char_data *ch, struct obj_data *obj,
       /* Don't mess up the prototype; use new string copies. */
       mob->player.name = strdup(GET_NAME(ch));
       mob->player.short_descr = strdup(GET_NAME(ch));
+      keyword_update_char(mob);
     }
     act(mag_summon_msgs[msg], FALSE, ch, 0, mob, TO_ROOM);
     load_mtrigger(mob);
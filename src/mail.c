@@ -19,6 +19,43 @@
 #include "handler.h"
 #include "mail.h"
 #include "modify.h"
+#include "keyword.h"
+#include "savequeue.h"
+
+/* The mail file is a log.  A letter is appended when it is sent, and when
+ * it is received a tombstone naming it is appended rather than the file
+ * being rewritten without it:
+ *	### <recipient> <sender> <time>		a letter, followed by its body~
+ *	### DEL <recipient> <offset>		the letter at <offset> is gone
+ * scan_file() reads the log once at boot into an index of each player's
+ * letters, oldest first, so has_mail() never touches the disk and
+ * read_delete() reads just the one letter.  Once enough of the file is
+ * dead, compact_mail_file() writes out the letters still waiting. */
+
+/* Kinds of record in the mail file */
+#define MAIL_REC_NONE     0	/* end of file, or a malformed record */
+#define MAIL_REC_LETTER   1
+#define MAIL_REC_DELETED  2
+
+#define MAIL_HASH_SIZE    1024
+
+/* One letter waiting in the mail file. */
+struct mail_entry {
+  long offset;			/* where its record starts */
+  long size;			/* bytes in its record */
+  struct mail_entry *next;
+};
+
+/* Everything waiting for one player. */
+struct mail_box {
+  long recipient;
+  struct mail_entry *first, *last;
+  struct mail_box *next;	/* next in the same bucket */
+};
+
+static struct mail_box *mail_boxes[MAIL_HASH_SIZE];
+static int live_letters = 0, dead_records = 0;
+static long live_bytes = 0, dead_bytes = 0;
 
 /* local (file scope) function prototypes */
 static void postmaster_send_mail(struct char_data *ch, struct char_data *mailman, int cmd, char *arg);
@@ -26,8 +63,10 @@ static void postmaster_check_mail(struct char_data *ch, struct char_data *mailma
 static void postmaster_receive_mail(struct char_data *ch, struct char_data *mailman, int cmd, char *arg);
 static int mail_recip_ok(const char *name);
 static void write_mail_record(FILE *mail_file, struct mail_t *record);
-static void free_mail_record(struct mail_t *record);
-static struct mail_t *read_mail_record(FILE *mail_file);
+static int read_mail_record(FILE *mail_file, struct mail_t *record, long *offset);
+static struct mail_box *find_mail_box(long recipient, bool create);
+static void add_mail_entry(long recipient, long offset, long size);
+static long remove_mail_entry(long recipient, long offset);
 
 static int mail_recip_ok(const char *name)
 {
@@ -40,37 +79,34 @@ static int mail_recip_ok(const char *name)
   return ret;
 }
 
-static void free_mail_record(struct mail_t *record)
-{
-	if (record->body)
-		free(record->body);
-  free(record);
-}
-
-static struct mail_t *read_mail_record(FILE *mail_file)
+/* Read the next record.  For a letter, fills in record, body and all; for a
+ * tombstone, record->recipient and *offset name the letter it deletes. */
+static int read_mail_record(FILE *mail_file, struct mail_t *record, long *offset)
 {
   char line[READ_SIZE];
   long sender, recipient;
   time_t sent_time;
-  struct mail_t *record;
 
   if (!get_line(mail_file, line))
-  	return NULL;
+  	return MAIL_REC_NONE;
+
+  if (sscanf(line, "### DEL %ld %ld", &recipient, offset) == 2) {
+    record->recipient = recipient;
+    return MAIL_REC_DELETED;
+  }
 
   if (sscanf(line, "### %ld %ld %ld", &recipient, &sender, (long *)&sent_time) != 3) {
   	log("Mail system - fatal error - malformed mail header");
   	log("Line was: %s", line);
-  	return NULL;
+  	return MAIL_REC_NONE;
   }
 
-  CREATE(record, struct mail_t, 1);
-
   record->recipient = recipient;
   record->sender = sender;
   record->sent_time = sent_time;
   record->body = fread_string(mail_file, "read mail record");
 
-  return record;
+  return MAIL_REC_LETTER;
 }
 
 static void write_mail_record(FILE *mail_file, struct mail_t *record)
@@ -80,36 +116,130 @@ static void write_mail_record(FILE *mail_file, struct mail_t *record)
                      record->recipient,
                      record->sender,
                      (long)record->sent_time,
-                     record->body );
+                     record->body ? record->body : "");
+}
+
+static struct mail_box *find_mail_box(long recipient, bool create)
+{
+  struct mail_box *box;
+  int bucket = (unsigned long) recipient % MAIL_HASH_SIZE;
+
+  for (box = mail_boxes[bucket]; box; box = box->next)
+    if (box->recipient == recipient)
+      return (box);
+
+  if (!create)
+    return (NULL);
+
+  CREATE(box, struct mail_box, 1);
+  box->recipient = recipient;
+  box->next = mail_boxes[bucket];
+  mail_boxes[bucket] = box;
+  return (box);
+}
+
+static void add_mail_entry(long recipient, long offset, long size)
+{
+  struct mail_box *box = find_mail_box(recipient, TRUE);
+  struct mail_entry *entry;
+
+  CREATE(entry, struct mail_entry, 1);
+  entry->offset = offset;
+  entry->size = size;
+  if (box->last)
+    box->last->next = entry;
+  else
+    box->first = entry;
+  box->last = entry;
+
+  live_letters++;
+  live_bytes += size;
+}
+
+/* Take the letter at offset out of the index, and the box too if that was
+ * the last one.  Returns the size of its record, or -1 if it isn't there. */
+static long remove_mail_entry(long recipient, long offset)
+{
+  struct mail_box *box, **pbox;
+  struct mail_entry *entry, *prev = NULL;
+  long size;
+  int bucket = (unsigned long) recipient % MAIL_HASH_SIZE;
+
+  for (pbox = &mail_boxes[bucket]; (box = *pbox) != NULL; pbox = &box->next)
+    if (box->recipient == recipient)
+      break;
+  if (!box)
+    return (-1);
+
+  for (entry = box->first; entry && entry->offset != offset; entry = entry->next)
+    prev = entry;
+  if (!entry)
+    return (-1);
+
+  if (prev)
+    prev->next = entry->next;
+  else
+    box->first = entry->next;
+  if (box->last == entry)
+    box->last = prev;
+  if (!box->first) {
+    *pbox = box->next;
+    free(box);
+  }
+
+  size = entry->size;
+  free(entry);
+  live_letters--;
+  live_bytes -= size;
+  return (size);
 }
 
 /* int scan_file(none)
  * Returns false if mail file is corrupted or true if everything correct.
  *
- * This is called once during boot-up.  It scans through the mail file
- * and indexes all entries currently in the mail file. */
+ * This is called once during boot-up.  It reads through the mail file and
+ * indexes the letters still waiting in it. */
 int scan_file(void)
 {
   FILE *mail_file;
-  int count = 0;
-  struct mail_t *record;
+  struct mail_t record;
+  long offset, deleted, size;
+  int kind, clean;
 
+  savequeue_wait(MAIL_FILE);
   if (!(mail_file = fopen(MAIL_FILE, "r"))) {
     log("   Mail file non-existant... creating new file.");
     touch(MAIL_FILE);
     return TRUE;
   }
 
-  record = read_mail_record(mail_file);
-
-  while (record) {
-    free_mail_record(record);
-    record = read_mail_record(mail_file);
-    count++;
+  for (;;) {
+    offset = ftell(mail_file);
+    if ((kind = read_mail_record(mail_file, &record, &deleted)) == MAIL_REC_NONE)
+      break;
+    size = ftell(mail_file) - offset;
+
+    if (kind == MAIL_REC_LETTER) {
+      if (record.body)
+        free(record.body);
+      add_mail_entry(record.recipient, offset, size);
+    } else {
+      if ((deleted = remove_mail_entry(record.recipient, deleted)) < 0)
+        log("SYSERR: Mail file deletes a letter it doesn't have at %ld.", offset);
+      else
+        dead_bytes += deleted;
+      dead_records++;
+      dead_bytes += size;
+    }
   }
 
+  /* Don't compact away whatever follows a record that couldn't be read. */
+  clean = feof(mail_file);
   fclose(mail_file);
- 	log("   Mail file read -- %d messages.", count);
+ 	log("   Mail file read -- %d messages.", live_letters);
+
+  if (dead_records && clean)
+    compact_mail_file();
  	return TRUE;
 }
 
@@ -120,27 +250,7 @@ int scan_file(void)
  * A simple little function which tells you if the player has mail or not. */
 int has_mail(long recipient)
 {
-  FILE *mail_file;
-  struct mail_t *record;
-
-  if (!(mail_file = fopen(MAIL_FILE, "r"))) {
-    perror("read_delete: Mail file not accessible.");
-    return FALSE;
-  }
-
-  record = read_mail_record(mail_file);
-
-  while (record) {
-  	if (record->recipient == recipient) {
-  		free_mail_record(record);
-  		fclose(mail_file);
-  		return TRUE;
-    }
-    free_mail_record(record);
-    record = read_mail_record(mail_file);
-  }
-  fclose(mail_file);
-  return FALSE;
+  return (find_mail_box(recipient, FALSE) != NULL);
 }
 
 /* void store_mail(long #1, long #2, char * #3)
@@ -154,22 +264,29 @@ int has_mail(long recipient)
 void store_mail(long to, long from, char *message_pointer)
 {
   FILE *mail_file;
-  struct mail_t *record;
+  struct mail_t record;
+  long offset, size;
 
+  savequeue_wait(MAIL_FILE);
   if (!(mail_file = fopen(MAIL_FILE, "a"))) {
     perror("store_mail: Mail file not accessible.");
     return;
   }
-  CREATE(record, struct mail_t, 1);
-
-  record->recipient = to;
-  record->sender = from;
-  record->sent_time = time(0);
-  record->body = message_pointer;
-
-  write_mail_record(mail_file, record);
-  free(record); /* don't free the body */
-  fclose(mail_file);
+  fseek(mail_file, 0, SEEK_END);
+  offset = ftell(mail_file);
+
+  record.recipient = to;
+  record.sender = from;
+  record.sent_time = time(0);
+  record.body = message_pointer;
+
+  write_mail_record(mail_file, &record);
+  size = ftell(mail_file) - offset;
+  if (fclose(mail_file)) {
+    perror("store_mail: Mail file not written.");
+    return;
+  }
+  add_mail_entry(to, offset, size);
 }
 
 /* char *read_delete(long #1)
@@ -177,46 +294,44 @@ void store_mail(long to, long from, char *message_pointer)
  * Returns the message text of the mail received.
  *
  * Retrieves one messsage for a player. The mail is then discarded from
- * the file. Expects mail to exist. */
+ * the index and a tombstone for it appended to the file. Expects mail to
+ * exist. */
 char *read_delete(long recipient)
 {
-  FILE *mail_file, *new_file;
-  struct mail_t *record, *record_to_keep = NULL;
+  FILE *mail_file;
+  struct mail_box *box;
+  struct mail_t record;
+  long offset, size, deleted;
   char buf[MAX_STRING_LENGTH];
 
-  if (!(mail_file = fopen(MAIL_FILE, "r"))) {
-    perror("read_delete: Mail file not accessible.");
-    return strdup("Mail system malfunction - please report this");
-  }
+  if (!(box = find_mail_box(recipient, FALSE)))
+    return strdup("Mail system error - please report");
+  offset = box->first->offset;
+  /* Whatever happens below, this letter is gone from the index, or the
+   * postmaster would hand it out forever. */
+  size = remove_mail_entry(recipient, offset);
 
-  if (!(new_file = fopen(MAIL_FILE_TMP, "w"))) {
-    perror("read_delete: new Mail file not accessible.");
-    fclose(mail_file);
+  savequeue_wait(MAIL_FILE);
+  if (!(mail_file = fopen(MAIL_FILE, "r+"))) {
+    perror("read_delete: Mail file not accessible.");
     return strdup("Mail system malfunction - please report this");
   }
 
-  record = read_mail_record(mail_file);
-
-  while (record) {
-  	if (!record_to_keep && record->recipient == recipient) {
-  		record_to_keep = record;
-  		record = read_mail_record(mail_file);
-  		continue; /* don't write and free this one just yet */
-    }
-    write_mail_record(new_file, record);
-    free_mail_record(record);
-    record = read_mail_record(mail_file);
-  }
-
-  if (!record_to_keep)
-  	sprintf(buf, "Mail system error - please report");
-  else {
+  record.body = NULL;
+  if (fseek(mail_file, offset, SEEK_SET) ||
+      read_mail_record(mail_file, &record, &deleted) != MAIL_REC_LETTER ||
+      record.recipient != recipient) {
+    if (record.body)
+      free(record.body);
+    log("SYSERR: Mail file has no letter for %ld at %ld.", recipient, offset);
+    sprintf(buf, "Mail system error - please report");
+  } else {
     char timestr[25], *from, *to;
 
-    strftime(timestr, sizeof(timestr), "%c", localtime(&(record_to_keep->sent_time)));
+    strftime(timestr, sizeof(timestr), "%c", localtime(&(record.sent_time)));
 
-    from = get_name_by_id(record_to_keep->sender);
-    to = get_name_by_id(record_to_keep->recipient);
+    from = get_name_by_id(record.sender);
+    to = get_name_by_id(record.recipient);
 
  		snprintf(buf, sizeof(buf),
              " * * * * altMUD Mail System * * * *\r\n"
@@ -229,19 +344,105 @@ char *read_delete(long recipient)
              timestr,
              to ? to : "Unknown",
              from ? from : "Unknown",
-             record_to_keep->body ? record_to_keep->body : "No message" );
+             record.body ? record.body : "No message" );
 
-    free_mail_record(record_to_keep);
-  }
-  fclose(mail_file);
-  fclose(new_file);
+    if (record.body)
+      free(record.body);
 
-  remove(MAIL_FILE);
-  rename(MAIL_FILE_TMP, MAIL_FILE);
+    fseek(mail_file, 0, SEEK_END);
+    deleted = ftell(mail_file);
+    fprintf(mail_file, "### DEL %ld %ld\n", recipient, offset);
+    dead_records++;
+    dead_bytes += size + ftell(mail_file) - deleted;
+  }
+  if (fclose(mail_file))
+    perror("read_delete: Mail file not written.");
 
   return strdup(buf);
 }
 
+static int compare_entries(const void *a, const void *b)
+{
+  long x = (*(struct mail_entry * const *) a)->offset;
+  long y = (*(struct mail_entry * const *) b)->offset;
+
+  return (x < y ? -1 : (x > y));
+}
+
+/* void compact_mail_file(none)
+ *
+ * Writes the mail file out again with only the letters still waiting in it,
+ * in the order they were sent, and points the index at their new places.
+ * The index must never point into a file that isn't there yet, so the new
+ * file is written, synced and renamed into place before this returns, and
+ * the index is only changed once all of that has worked. */
+void compact_mail_file(void)
+{
+  FILE *mail_file, *new_file;
+  struct mail_entry **entries, *entry;
+  struct mail_box *box;
+  long *offsets, pos = 0, reclaimed = dead_bytes;
+  char *record = NULL;
+  int i, n = 0;
+
+  savequeue_wait(MAIL_FILE);
+  if (!(mail_file = fopen(MAIL_FILE, "r"))) {
+    perror("compact_mail_file: Mail file not accessible.");
+    return;
+  }
+  if (!(new_file = savequeue_open_now(MAIL_FILE))) {
+    perror("compact_mail_file: new Mail file not accessible.");
+    fclose(mail_file);
+    return;
+  }
+
+  CREATE(entries, struct mail_entry *, MAX(live_letters, 1));
+  CREATE(offsets, long, MAX(live_letters, 1));
+  for (i = 0; i < MAIL_HASH_SIZE; i++)
+    for (box = mail_boxes[i]; box; box = box->next)
+      for (entry = box->first; entry; entry = entry->next)
+        entries[n++] = entry;
+  qsort(entries, n, sizeof(struct mail_entry *), compare_entries);
+
+  /* Each letter is copied a byte for byte; its size was measured when it
+   * was read or written. */
+  for (i = 0; i < n; i++) {
+    RECREATE(record, char, entries[i]->size);
+    if (fseek(mail_file, entries[i]->offset, SEEK_SET) ||
+        fread(record, 1, entries[i]->size, mail_file) != (size_t) entries[i]->size ||
+        fwrite(record, 1, entries[i]->size, new_file) != (size_t) entries[i]->size)
+      break;
+    offsets[i] = pos;
+    pos += entries[i]->size;
+  }
+  fclose(mail_file);
+  if (record)
+    free(record);
+
+  if (i < n) {
+    log("SYSERR: Couldn't compact mail file: letter at %ld unreadable.", entries[i]->offset);
+    savequeue_abort(new_file);
+  } else if (savequeue_close(new_file) < 0)
+    log("SYSERR: Couldn't compact mail file: new file not written.");
+  else {
+    for (i = 0; i < n; i++)
+      entries[i]->offset = offsets[i];
+    dead_bytes = 0;
+    dead_records = 0;
+    log("Mail file compacted: %d letters kept, %ld bytes reclaimed.", n, reclaimed);
+  }
+  free(entries);
+  free(offsets);
+}
+
+/* Called every PULSE_MAILCOMPACT.  Compacts the mail file once at least
+ * half of it is letters already received. */
+void mail_compact_pulse(void)
+{
+  if (!no_mail && dead_bytes >= MAX(live_bytes, MAIL_COMPACT_MIN))
+    compact_mail_file();
+}
+
 /* spec_proc for a postmaster using the above routines.  By Jeremy Elson */
 SPECIAL(postmaster)
 {
@@ -341,6 +542,7 @@ static void postmaster_receive_mail(struct char_data *ch, struct char_data *mail
     obj = create_obj();
     obj->item_number = 1;
     obj->name = strdup("mail paper letter");
+    keyword_update_obj(obj);
     obj->short_description = strdup("a piece of mail");
     obj->description = strdup("Someone has left a piece of mail here.");
 
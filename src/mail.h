@@ -24,6 +24,9 @@
 /* Maximum size of mail in bytes (arbitrary)	*/
 #define MAX_MAIL_SIZE 8192
 
+/* bytes of received letters the mail file may hold before it is compacted */
+#define MAIL_COMPACT_MIN (64 * 1024)
+
 /* size of mail file allocation blocks		*/
 #define BLOCK_SIZE 100
 
@@ -41,6 +44,8 @@ int	scan_file(void);
 int	has_mail(long recipient);
 void	store_mail(long to, long from, char *message_pointer);
 char	*read_delete(long recipient);
+void	compact_mail_file(void);
+void	mail_compact_pulse(void);
 void    notify_if_playing(struct char_data *from, int recipient_id);
 
 struct mail_t {
@@ -23,8 +23,31 @@
 #include "fight.h"
 
 
+/* A zone goes dormant this long after its last player leaves. */
+#define ZONE_DORMANT_DELAY    (5 * 60 RL_SEC)
+/* Mobiles in a dormant zone act only on every this many mobile pulses. */
+#define DORMANT_MOBILE_RATE   6
+
+/* Mobiles handled and skipped since the last usage report. */
+long mobiles_acted = 0;
+long mobiles_skipped = 0;
+
 /* local file scope only function prototypes */
 static bool aggressive_mob_on_a_leash(struct char_data *slave, struct char_data *master, struct char_data *attack);
+static bool zone_is_dormant(zone_rnum zone);
+
+/* A zone is dormant once no player has been in it for ZONE_DORMANT_DELAY,
+ * unless it has been flagged to always stay active. */
+static bool zone_is_dormant(zone_rnum zone)
+{
+  if (zone_table[zone].num_players > 0)
+    return (FALSE);
+
+  if (ZONE_FLAGGED(zone, ZONE_ALWAYSACTIVE))
+    return (FALSE);
+
+  return (pulse - zone_table[zone].last_player >= ZONE_DORMANT_DELAY);
+}
 
 void mobile_activity(void)
 {
@@ -32,6 +55,10 @@ void mobile_activity(void)
   struct obj_data *obj, *best_obj;
   int door, found, max;
   memory_rec *names;
+  zone_rnum zone;
+  static unsigned int mobile_pulse = 0;
+
+  mobile_pulse++;
 
   for (ch = character_list; ch; ch = next_ch) {
     next_ch = ch->next;
@@ -39,6 +66,18 @@ void mobile_activity(void)
     if (!IS_MOB(ch))
       continue;
 
+    /* Mobiles in zones nobody has visited lately only act now and then.  The
+     * zone number staggers which zones get their turn on a given pulse.  Mobs
+     * that are fighting or hunting someone are always given their turn. */
+    if (IN_ROOM(ch) != NOWHERE && !FIGHTING(ch) && !HUNTING(ch)) {
+      zone = world[IN_ROOM(ch)].zone;
+      if (zone_is_dormant(zone) && (mobile_pulse + zone) % DORMANT_MOBILE_RATE) {
+        mobiles_skipped++;
+        continue;
+      }
+    }
+    mobiles_acted++;
+
     /* Examine call for special procedure */
     if (MOB_FLAGGED(ch, MOB_SPEC) && !no_specials) {
       if (mob_index[GET_MOB_RNUM(ch)].func == NULL) {
@@ -14,10 +14,14 @@
 #include "constants.h"
 #include "comm.h"  /* For access to the game pulse */
 #include "mud_event.h"
+#include "pool.h"
 
 /* Global List */
 struct list_data * world_events = NULL;
 
+/* Mud events are created and freed constantly, so they come from a pool */
+static struct mem_pool *mud_event_pool = NULL;
+
 /* The mud_event_index[] is merely a tool for organizing events, and giving
  * them a "const char *" name to help in potential debugging */
 struct mud_event_list mud_event_index[] = {
@@ -133,7 +137,7 @@ struct mud_event_data *new_mud_event(event_id iId, void *pStruct, char *sVariabl
   struct mud_event_data *pMudEvent;
   char *varString;
 
-  CREATE(pMudEvent, struct mud_event_data, 1);
+  POOL_CREATE(pMudEvent, mud_event_pool, struct mud_event_data);
   varString = (sVariables != NULL) ? strdup(sVariables) : NULL;
 
   pMudEvent->iId         = iId;
@@ -182,7 +186,7 @@ void free_mud_event(struct mud_event_data *pMudEvent)
     free(pMudEvent->sVariables);
 
   pMudEvent->pEvent->event_obj = NULL;
-  free(pMudEvent);
+  pool_free(mud_event_pool, pMudEvent);
 }
 
 struct mud_event_data * char_has_mud_event(struct char_data * ch, event_id iId)
@@ -23,6 +23,7 @@
 #include "improved-edit.h"
 #include "constants.h"
 #include "dg_scripts.h"
+#include "graph.h"
 
 /* Local, filescope function prototypes */
 /* Utility function for buildwalk */
@@ -269,6 +270,7 @@ ACMD(do_dig)
   W_EXIT(IN_ROOM(ch), dir)->general_description = NULL;
   W_EXIT(IN_ROOM(ch), dir)->keyword = NULL;
   W_EXIT(IN_ROOM(ch), dir)->to_room = rrnum;
+  invalidate_path_cache();
   add_to_save_list(zone_table[world[IN_ROOM(ch)].zone].number, SL_WLD);
 
   send_to_char(ch, "You make an exit %s to room %d (%s).\r\n",
@@ -355,6 +357,7 @@ int buildwalk(struct char_data *ch, int dir)
       EXIT(ch, dir)->to_room = rnum;
       CREATE(world[rnum].dir_option[rev_dir[dir]], struct room_direction_data, 1);
       world[rnum].dir_option[rev_dir[dir]]->to_room = IN_ROOM(ch);
+      invalidate_path_cache();
 
       /* Report room creation to user */
       send_to_char(ch, "%sRoom #%d created by BuildWalk.%s\r\n", yel, vnum, nrm);
@@ -22,6 +22,8 @@
 #include "config.h"
 #include "modify.h"
 #include "genolc.h" /* for strip_cr and sprintascii */
+#include "keyword.h"
+#include "savequeue.h"
 
 /* these factors should be unique integers */
 #define RENT_FACTOR    1
@@ -56,14 +58,16 @@ int objsave_save_obj_record(struct obj_data *obj, FILE *fp, int locate)
   int counter2;
   struct extra_descr_data *ex_desc;
   char buf1[MAX_STRING_LENGTH +1];
-  struct obj_data *temp = NULL;
+  struct obj_data *temp;
+  static struct obj_data blank;
 
-  if (GET_OBJ_VNUM(obj) != NOTHING)
-    temp=read_object(GET_OBJ_VNUM(obj), VIRTUAL);
-  else {
-    temp = create_obj();
-    temp->item_number = NOWHERE;
-  }
+  /* Compare against the prototype itself rather than a loaded copy of it:
+   * loading and extracting a copy for every object saved runs its triggers
+   * through the script checks in dg_handler.c, which walk the whole world. */
+  if (VALID_OBJ_RNUM(obj))
+    temp = &obj_proto[GET_OBJ_RNUM(obj)];
+  else
+    temp = &blank;
 
   if (obj->action_description) {
 
@@ -155,8 +159,6 @@ int objsave_save_obj_record(struct obj_data *obj, FILE *fp, int locate)
 
   fprintf(fp, "\n");
 
-  extract_obj(temp);
-
   return 1;
 }
 
@@ -265,6 +267,7 @@ int Crash_delete_file(char *name)
 
   if (!get_filename(filename, sizeof(filename), CRASH_FILE, name))
     return FALSE;
+  savequeue_wait(filename);
 
   if (!(fl = fopen(filename, "r"))) {
     if (errno != ENOENT)  /* if it fails but NOT because of no file */
@@ -290,6 +293,7 @@ int Crash_delete_crashfile(struct char_data *ch)
 
   if (!get_filename(filename, sizeof(filename), CRASH_FILE, GET_NAME(ch)))
     return FALSE;
+  savequeue_wait(filename);
 
   if (!(fl = fopen(filename, "r"))) {
     if (errno != ENOENT)  /* if it fails, NOT because of no file */
@@ -319,6 +323,7 @@ int Crash_clean_file(char *name)
 
   if (!get_filename(filename, sizeof(filename), CRASH_FILE, name))
     return FALSE;
+  savequeue_wait(filename);
 
   /* Open so that permission problems will be flagged now, at boot time. */
   if (!(fl = fopen(filename, "r"))) {
@@ -385,6 +390,7 @@ void Crash_listrent(struct char_data *ch, char *name)
 
   if (!get_filename(filename, sizeof(filename), CRASH_FILE, name))
     return;
+  savequeue_wait(filename);
 
   if (!(fl = fopen(filename, "r"))) {
     send_to_char(ch, "%s has no rent file.\r\n", name);
@@ -566,30 +572,32 @@ void Crash_crashsave(struct char_data *ch)
   if (!get_filename(buf, sizeof(buf), CRASH_FILE, GET_NAME(ch)))
     return;
 
-  if (!(fp = fopen(buf, "w")))
+  if (!(fp = savequeue_open(buf)))
     return;
 
-  if (!objsave_write_rentcode(fp, RENT_CRASH, 0, ch))
-  	return;
+  if (!objsave_write_rentcode(fp, RENT_CRASH, 0, ch)) {
+    savequeue_abort(fp);
+    return;
+  }
 
   for (j = 0; j < NUM_WEARS; j++)
     if (GET_EQ(ch, j)) {
       if (!Crash_save(GET_EQ(ch, j), fp, j + 1)) {
-        fclose(fp);
+        savequeue_abort(fp);
         return;
       }
       Crash_restore_weight(GET_EQ(ch, j));
     }
 
   if (!Crash_save(ch->carrying, fp, 0)) {
-    fclose(fp);
+    savequeue_abort(fp);
     return;
   }
   Crash_restore_weight(ch->carrying);
 
   fprintf(fp, "$~\n");
-  fclose(fp);
-  REMOVE_BIT_AR(PLR_FLAGS(ch), PLR_CRASH);
+  if (savequeue_close(fp) == 0)
+    REMOVE_BIT_AR(PLR_FLAGS(ch), PLR_CRASH);
 }
 
 void Crash_idlesave(struct char_data *ch)
@@ -605,7 +613,7 @@ void Crash_idlesave(struct char_data *ch)
   if (!get_filename(buf, sizeof(buf), CRASH_FILE, GET_NAME(ch)))
     return;
 
-  if (!(fp = fopen(buf, "w")))
+  if (!(fp = savequeue_open(buf)))
     return;
 
   Crash_extract_norent_eq(ch);
@@ -637,19 +645,21 @@ void Crash_idlesave(struct char_data *ch)
   if (ch->carrying == NULL) {
     for (j = 0; j < NUM_WEARS && GET_EQ(ch, j) == NULL; j++) /* Nothing */ ;
     if (j == NUM_WEARS) {  /* No equipment or inventory. */
-      fclose(fp);
+      savequeue_abort(fp);
       Crash_delete_file(GET_NAME(ch));
       return;
     }
   }
 
-  if (!objsave_write_rentcode(fp, RENT_TIMEDOUT, cost, ch))
-  	return;
+  if (!objsave_write_rentcode(fp, RENT_TIMEDOUT, cost, ch)) {
+    savequeue_abort(fp);
+    return;
+  }
 
   for (j = 0; j < NUM_WEARS; j++) {
     if (GET_EQ(ch, j)) {
       if (!Crash_save(GET_EQ(ch, j), fp, j + 1)) {
-        fclose(fp);
+        savequeue_abort(fp);
         return;
       }
       Crash_restore_weight(GET_EQ(ch, j));
@@ -657,11 +667,11 @@ void Crash_idlesave(struct char_data *ch)
     }
   }
   if (!Crash_save(ch->carrying, fp, 0)) {
-    fclose(fp);
+    savequeue_abort(fp);
     return;
   }
   fprintf(fp, "$~\n");
-  fclose(fp);
+  savequeue_close(fp);
 
   Crash_extract_objs(ch->carrying);
 }
@@ -678,19 +688,21 @@ void Crash_rentsave(struct char_data *ch, int cost)
   if (!get_filename(buf, sizeof(buf), CRASH_FILE, GET_NAME(ch)))
     return;
 
-  if (!(fp = fopen(buf, "w")))
+  if (!(fp = savequeue_open(buf)))
     return;
 
   Crash_extract_norent_eq(ch);
   Crash_extract_norents(ch->carrying);
 
-  if (!objsave_write_rentcode(fp, RENT_RENTED, cost, ch))
-  	return;
+  if (!objsave_write_rentcode(fp, RENT_RENTED, cost, ch)) {
+    savequeue_abort(fp);
+    return;
+  }
 
   for (j = 0; j < NUM_WEARS; j++)
     if (GET_EQ(ch, j)) {
       if (!Crash_save(GET_EQ(ch,j), fp, j + 1)) {
-        fclose(fp);
+        savequeue_abort(fp);
         return;
       }
       Crash_restore_weight(GET_EQ(ch, j));
@@ -698,11 +710,11 @@ void Crash_rentsave(struct char_data *ch, int cost)
 
     }
   if (!Crash_save(ch->carrying, fp, 0)) {
-    fclose(fp);
+    savequeue_abort(fp);
     return;
   }
   fprintf(fp, "$~\n");
-  fclose(fp);
+  savequeue_close(fp);
 
   Crash_extract_objs(ch->carrying);
 }
@@ -737,7 +749,7 @@ static void Crash_cryosave(struct char_data *ch, int cost)
   if (!get_filename(buf, sizeof(buf), CRASH_FILE, GET_NAME(ch)))
     return;
 
-  if (!(fp = fopen(buf, "w")))
+  if (!(fp = savequeue_open(buf)))
     return;
 
   Crash_extract_norent_eq(ch);
@@ -745,24 +757,26 @@ static void Crash_cryosave(struct char_data *ch, int cost)
 
   GET_GOLD(ch) = MAX(0, GET_GOLD(ch) - cost);
 
-  if (!objsave_write_rentcode(fp, RENT_CRYO, 0, ch))
-  	return;
+  if (!objsave_write_rentcode(fp, RENT_CRYO, 0, ch)) {
+    savequeue_abort(fp);
+    return;
+  }
 
   for (j = 0; j < NUM_WEARS; j++)
     if (GET_EQ(ch, j)) {
       if (!Crash_save(GET_EQ(ch, j), fp, j + 1)) {
-        fclose(fp);
+        savequeue_abort(fp);
         return;
       }
       Crash_restore_weight(GET_EQ(ch, j));
       Crash_extract_objs(GET_EQ(ch, j));
     }
   if (!Crash_save(ch->carrying, fp, 0)) {
-    fclose(fp);
+    savequeue_abort(fp);
     return;
   }
   fprintf(fp, "$~\n");
-  fclose(fp);
+  savequeue_close(fp);
 
   Crash_extract_objs(ch->carrying);
   SET_BIT_AR(PLR_FLAGS(ch), PLR_CRYO);
@@ -974,6 +988,30 @@ void Crash_save_all(void)
   }
 }
 
+/* Crash-save up to max players who need it and have not been saved in
+ * autosave round 'round' yet, for autosave_pulse().  Returns the number
+ * saved, so anything less than max means the round is done with players. */
+int Crash_save_some(int round, int max)
+{
+  struct descriptor_data *d;
+  int saved = 0;
+
+  for (d = descriptor_list; d && saved < max; d = d->next) {
+    if (STATE(d) != CON_PLAYING || IS_NPC(d->character))
+      continue;
+    if (!PLR_FLAGGED(d->character, PLR_CRASH) ||
+        d->character->player_specials->autosave_round == round)
+      continue;
+
+    d->character->player_specials->autosave_round = round;
+    Crash_crashsave(d->character);
+    save_char(d->character);
+    REMOVE_BIT_AR(PLR_FLAGS(d->character), PLR_CRASH);
+    saved++;
+  }
+  return (saved);
+}
+
 /* Parses the object records stored in fl, and returns the first object in a
  * linked list, which also handles location if worn. This list can then be
  * handled by house code, listrent code, autoeq code, etc. */
@@ -1125,8 +1163,10 @@ obj_save_data *objsave_parse_objects(FILE *fl)
         current->locate = num;
       break;
     case 'N':
-      if (!strcmp(tag, "Name"))
+      if (!strcmp(tag, "Name")) {
         temp->name = strdup(line);
+        keyword_update_obj(temp);
+      }
       break;
     case 'P':
       if (!strcmp(tag, "Perm")) {
@@ -1190,6 +1230,7 @@ static int Crash_load_objs(struct char_data *ch) {
 
   if (!get_filename(filename, sizeof(filename), CRASH_FILE, GET_NAME(ch)))
     return 1;
+  savequeue_wait(filename);
 
   for (i = 0; i < MAX_BAG_ROWS; i++)
     cont_row[i] = NULL;
@@ -0,0 +1,214 @@
+/**
+* @file pfbinary.c
+* Reading and writing the pieces of a binary player file.
+*
+* Part of the core altMUD source code distribution, which is a derivative
+* of, and continuation of, CircleMUD.
+*
+* All rights reserved.  See license for complete information.
+*
+* These are shared by the game (players.c) and the pfconv utility, so the
+* two cannot drift apart.  Nothing here touches the game's own state.
+*/
+
+#include "conf.h"
+#include "sysdep.h"
+#include "structs.h"
+#include "utils.h"
+#include "pfbinary.h"
+
+void pfb_put(struct pfb_buf *b, const void *p, size_t n)
+{
+  if (b->len + n > b->size) {
+    b->size = b->size * 2 > b->len + n ? b->size * 2 : b->len + n + 1024;
+    RECREATE(b->data, unsigned char, b->size);
+  }
+  memcpy(b->data + b->len, p, n);
+  b->len += n;
+}
+
+void pfb_put_u16(struct pfb_buf *b, unsigned int v)
+{
+  unsigned char c[2];
+
+  c[0] = v & 0xFF;
+  c[1] = (v >> 8) & 0xFF;
+  pfb_put(b, c, 2);
+}
+
+void pfb_put_u32(struct pfb_buf *b, unsigned long v)
+{
+  unsigned char c[4];
+
+  c[0] = v & 0xFF;
+  c[1] = (v >> 8) & 0xFF;
+  c[2] = (v >> 16) & 0xFF;
+  c[3] = (v >> 24) & 0xFF;
+  pfb_put(b, c, 4);
+}
+
+void pfb_put_long(struct pfb_buf *b, long v)
+{
+  pfb_put_u32(b, (unsigned long) v);
+  pfb_put_u32(b, (unsigned long) ((v >> 16) >> 16));
+}
+
+void pfb_put_str(struct pfb_buf *b, const char *s)
+{
+  size_t n = s ? strlen(s) : 0;
+
+  if (n > 0xFFFF)
+    n = 0xFFFF;
+  pfb_put_u16(b, n);
+  pfb_put(b, s, n);
+}
+
+/* Start a stats field. */
+void pfb_field(struct pfb_buf *b, const char *tag, int type)
+{
+  unsigned char c = type;
+
+  pfb_put(b, tag, 4);
+  pfb_put(b, &c, 1);
+}
+
+void pfb_int(struct pfb_buf *b, const char *tag, int v)
+{
+  pfb_field(b, tag, PFB_TYPE_INT);
+  pfb_put_u32(b, (unsigned long) v);
+}
+
+void pfb_long(struct pfb_buf *b, const char *tag, long v)
+{
+  pfb_field(b, tag, PFB_TYPE_LONG);
+  pfb_put_long(b, v);
+}
+
+void pfb_str(struct pfb_buf *b, const char *tag, const char *s)
+{
+  pfb_field(b, tag, PFB_TYPE_STR);
+  pfb_put_str(b, s);
+}
+
+void pfb_pair(struct pfb_buf *b, const char *tag, int v1, int v2)
+{
+  pfb_field(b, tag, PFB_TYPE_PAIR);
+  pfb_put_u32(b, (unsigned long) v1);
+  pfb_put_u32(b, (unsigned long) v2);
+}
+
+void pfb_flags(struct pfb_buf *b, const char *tag, const int *flags)
+{
+  int i;
+
+  pfb_field(b, tag, PFB_TYPE_FLAGS);
+  for (i = 0; i < 4; i++)
+    pfb_put_u32(b, (unsigned long) flags[i]);
+}
+
+/* Start a section; returns where its payload starts, for pfb_end(). */
+size_t pfb_begin(struct pfb_buf *b, int id)
+{
+  pfb_put_u32(b, id);
+  pfb_put_u32(b, 0);
+  return (b->len);
+}
+
+/* Fill in the length of the section started at 'start'. */
+void pfb_end(struct pfb_buf *b, size_t start)
+{
+  unsigned long n = b->len - start;
+  unsigned char *c = b->data + start - 4;
+
+  c[0] = n & 0xFF;
+  c[1] = (n >> 8) & 0xFF;
+  c[2] = (n >> 16) & 0xFF;
+  c[3] = (n >> 24) & 0xFF;
+}
+
+unsigned long pfb_u32(const unsigned char *c)
+{
+  return ((unsigned long) c[0] | (unsigned long) c[1] << 8 |
+          (unsigned long) c[2] << 16 | (unsigned long) c[3] << 24);
+}
+
+/* Point at the next n bytes of b, or NULL and mark b bad if there are not
+ * that many left. */
+const unsigned char *pfb_get(struct pfb_buf *b, size_t n)
+{
+  const unsigned char *c;
+
+  if (b->bad || n > b->len - b->pos) {
+    b->bad = TRUE;
+    return (NULL);
+  }
+  c = b->data + b->pos;
+  b->pos += n;
+  return (c);
+}
+
+int pfb_get_u8(struct pfb_buf *b)
+{
+  const unsigned char *c = pfb_get(b, 1);
+
+  return (c ? *c : 0);
+}
+
+unsigned int pfb_get_u16(struct pfb_buf *b)
+{
+  const unsigned char *c = pfb_get(b, 2);
+
+  return (c ? c[0] | c[1] << 8 : 0);
+}
+
+unsigned long pfb_get_u32(struct pfb_buf *b)
+{
+  const unsigned char *c = pfb_get(b, 4);
+
+  return (c ? pfb_u32(c) : 0);
+}
+
+long pfb_get_i32(struct pfb_buf *b)
+{
+  unsigned long v = pfb_get_u32(b);
+
+  return ((v & 0x80000000UL) ? -(long) (~v & 0x7FFFFFFFUL) - 1 : (long) v);
+}
+
+long pfb_get_long(struct pfb_buf *b)
+{
+  unsigned long lo = pfb_get_u32(b);
+  long hi = pfb_get_i32(b);
+
+  return ((long) ((((unsigned long) hi << 16) << 16) | lo));
+}
+
+/* A string from b, in freshly allocated memory. */
+char *pfb_get_str(struct pfb_buf *b)
+{
+  size_t n = pfb_get_u16(b);
+  const unsigned char *c = pfb_get(b, n);
+  char *s;
+
+  CREATE(s, char, n + 1);
+  if (c)
+    memcpy(s, c, n);
+  s[n] = '\0';
+  return (s);
+}
+
+/* Read the next section's payload, 'len' bytes, from fl into b, ready for
+ * the pfb_get functions.  FALSE if the file ends first. */
+int pfb_read_section(FILE *fl, struct pfb_buf *b, size_t len)
+{
+  b->len = b->pos = 0;
+  b->bad = FALSE;
+  if (len > b->size) {
+    b->size = len;
+    RECREATE(b->data, unsigned char, b->size);
+  }
+  if (fread(b->data, 1, len, fl) != len)
+    return (FALSE);
+  b->len = len;
+  return (TRUE);
+}
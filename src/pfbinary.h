@@ -0,0 +1,95 @@
+/**
+* @file pfbinary.h
+* Layout of the binary player file.
+*
+* Part of the core altMUD source code distribution, which is a derivative
+* of, and continuation of, CircleMUD.
+*
+* All rights reserved.  See license for complete information.
+*
+* A binary pfile is PFB_MAGIC and a 32-bit version number, followed by
+* sections.  Every section is a 32-bit id and a 32-bit length, then that
+* many bytes of payload, and an empty PFB_END section closes the file.
+* Readers skip any section they do not know, so new sections can be added
+* without a new version number.  Numbers are little endian; a string is a
+* 16-bit length and that many bytes, with no terminating NUL.
+*
+* The stats section is a run of fields, each one the four letter tag the
+* ASCII pfile uses for it, a PFB_TYPE_ byte and the value.  The rest are:
+*   skills   count(16), then skill(16) and level(16) for each
+*   affects  count(16), then spell, duration, modifier, location and four
+*            bitvector words, all 32 bits, for each
+*   aliases  count(16), then alias(str), replacement(str) and type(32)
+*   quests   count(32), then a vnum(32) for each completed quest
+*   vars     count(16) and that many trigger vnums(32), then count(16) and
+*            name(str), context(64) and value(str) for each global variable
+*/
+#ifndef _PFBINARY_H_
+#define _PFBINARY_H_
+
+/** The high bit and the line endings catch a pfile mangled in transfer. */
+#define PFB_MAGIC         "\211APF\r\n\032\n"
+#define PFB_MAGIC_LEN     8
+#define PFB_VERSION       1
+
+/* Section ids */
+#define PFB_END           0
+#define PFB_STATS         1
+#define PFB_SKILLS        2
+#define PFB_AFFECTS       3
+#define PFB_ALIASES       4
+#define PFB_QUESTS        5
+#define PFB_VARS          6
+
+/** Sections load_char_lazy() leaves on disk for load_char_deferred(). */
+#define PFB_DEFERRABLE    ((1 << PFB_ALIASES) | (1 << PFB_QUESTS))
+
+/* Types of the fields in the stats section */
+#define PFB_TYPE_INT      1   /**< 32 bits */
+#define PFB_TYPE_LONG     2   /**< 64 bits */
+#define PFB_TYPE_STR      3
+#define PFB_TYPE_PAIR     4   /**< Two 32-bit numbers, as in "Hit : 20/20" */
+#define PFB_TYPE_FLAGS    5   /**< Four 32-bit words, as in "Act : a 0 0 0" */
+
+/** A four letter tag as the 32-bit number it is read back as. */
+#define PFB_TAG(a, b, c, d) \
+  ((unsigned long) (a) | (unsigned long) (b) << 8 | \
+   (unsigned long) (c) << 16 | (unsigned long) (d) << 24)
+
+/* A binary pfile being put together, or one section of one being read. */
+struct pfb_buf {
+  unsigned char *data;
+  size_t len;   /* bytes in data */
+  size_t size;  /* bytes allocated */
+  size_t pos;   /* read position */
+  int bad;      /* a read ran off the end */
+};
+
+/* Writing: each appends to b, growing it as needed. */
+void pfb_put(struct pfb_buf *b, const void *p, size_t n);
+void pfb_put_u16(struct pfb_buf *b, unsigned int v);
+void pfb_put_u32(struct pfb_buf *b, unsigned long v);
+void pfb_put_long(struct pfb_buf *b, long v);
+void pfb_put_str(struct pfb_buf *b, const char *s);
+void pfb_field(struct pfb_buf *b, const char *tag, int type);
+void pfb_int(struct pfb_buf *b, const char *tag, int v);
+void pfb_long(struct pfb_buf *b, const char *tag, long v);
+void pfb_str(struct pfb_buf *b, const char *tag, const char *s);
+void pfb_pair(struct pfb_buf *b, const char *tag, int v1, int v2);
+void pfb_flags(struct pfb_buf *b, const char *tag, const int *flags);
+size_t pfb_begin(struct pfb_buf *b, int id);
+void pfb_end(struct pfb_buf *b, size_t start);
+
+/* Reading: each takes from b's read position, and gives 0 and marks b bad
+ * once it runs off the end. */
+unsigned long pfb_u32(const unsigned char *c);
+int pfb_read_section(FILE *fl, struct pfb_buf *b, size_t len);
+const unsigned char *pfb_get(struct pfb_buf *b, size_t n);
+int pfb_get_u8(struct pfb_buf *b);
+unsigned int pfb_get_u16(struct pfb_buf *b);
+unsigned long pfb_get_u32(struct pfb_buf *b);
+long pfb_get_i32(struct pfb_buf *b);
+long pfb_get_long(struct pfb_buf *b);
+char *pfb_get_str(struct pfb_buf *b);
+
+#endif /* _PFBINARY_H_ */
@@ -22,6 +22,8 @@
 #include "config.h" /* for pclean_criteria[] */
 #include "dg_scripts.h" /* To enable saving of player variables to disk */
 #include "quest.h"
+#include "pfbinary.h"
+#include "savequeue.h"
 
 #define LOAD_HIT	0
 #define LOAD_MANA	1
@@ -42,6 +44,27 @@ static void load_quests(FILE *fl, struct char_data *ch);
 static void load_HMVS(struct char_data *ch, const char *line, int mode);
 static void write_aliases_ascii(FILE *file, struct char_data *ch);
 static void read_aliases_ascii(FILE *file, struct char_data *ch, int count);
+static unsigned long ptable_name_hash(const char *name);
+static void ptable_insert(int *hash, unsigned long key, int pos, bool by_id);
+static void build_ptable_lookup(void);
+static int load_pfile(const char *name, struct char_data *ch, int defer);
+static void read_ascii_pfile(FILE *fl, struct char_data *ch, const char *name);
+static int write_ascii_pfile(const char *filename, struct char_data *ch, struct affected_type *tmp_aff);
+static int read_binary_header(FILE *fl, const char *filename);
+static int read_binary_sections(FILE *fl, struct char_data *ch, int wanted, const char *name);
+static int write_binary_pfile(const char *filename, struct char_data *ch, struct affected_type *tmp_aff);
+
+/* Open addressed hash indexes over player_table, by name and by id.  Each
+ * slot holds a table position or -1.  Entries are checked against the table
+ * on lookup, so one left behind by a rename or a reused position is only
+ * skipped over; the indexes are rebuilt whenever positions shift or they
+ * fill up.  Where the table holds a key twice, the lower position wins, as
+ * it did for the old linear scans. */
+static int *ptable_by_name = NULL;
+static int *ptable_by_id = NULL;
+static int ptable_hash_size = 0;   /* slots in each index, a power of two */
+static int ptable_name_used = 0;   /* slots taken in ptable_by_name */
+static int ptable_id_used = 0;     /* slots taken in ptable_by_id */
 
 /* New version to build player index for ASCII Player Files. Generate index
  * table for the player file. */
@@ -83,6 +106,7 @@ void build_player_index(void)
 
   fclose(plr_index);
   top_of_p_file = top_of_p_table = i - 1;
+  build_ptable_lookup();
 }
 
 /* Create a new entry in the in-memory index table for the player file. If the
@@ -111,6 +135,9 @@ int create_entry(char *name)
   /* clear the bitflag in case we have garbage data */
   player_table[pos].flags = 0;
 
+  /* The id is indexed once init_char() hands one out. */
+  index_player_name(pos);
+
   return (pos);
 }
 
@@ -147,6 +174,9 @@ static void remove_player_from_index(int pos)
     free(player_table);
     player_table = NULL;
   }
+
+  /* Everyone past 'pos' moved down one. */
+  build_ptable_lookup();
 }
 
 /* This function necessary to save a seperate ASCII player index */
@@ -188,63 +218,190 @@ void free_player_index(void)
   free(player_table);
   player_table = NULL;
   top_of_p_table = 0;
+
+  if (ptable_by_name)
+    free(ptable_by_name);
+  if (ptable_by_id)
+    free(ptable_by_id);
+  ptable_by_name = ptable_by_id = NULL;
+  ptable_hash_size = ptable_name_used = ptable_id_used = 0;
 }
 
-long get_ptable_by_name(const char *name)
+/* Case insensitive, so it agrees with str_cmp(). */
+static unsigned long ptable_name_hash(const char *name)
+{
+  unsigned long hash = 5381;
+
+  for (; *name; name++)
+    hash = hash * 33 + LOWER(*name);
+
+  return (hash);
+}
+
+/* Put table position 'pos' into an index under 'key', unless a lower
+ * position is already there for the same name or id. */
+static void ptable_insert(int *hash, unsigned long key, int pos, bool by_id)
+{
+  int slot, mask = ptable_hash_size - 1;
+
+  for (slot = key & mask; hash[slot] != -1; slot = (slot + 1) & mask) {
+    if (by_id ? PT_IDNUM(hash[slot]) != PT_IDNUM(pos) : str_cmp(PT_PNAME(hash[slot]), PT_PNAME(pos)))
+      continue;
+    hash[slot] = MIN(hash[slot], pos);
+    return;
+  }
+  hash[slot] = pos;
+  if (by_id)
+    ptable_id_used++;
+  else
+    ptable_name_used++;
+}
+
+/* (Re)build both indexes from scratch, sized for the table to double. */
+static void build_ptable_lookup(void)
 {
   int i;
 
-  for (i = 0; i <= top_of_p_table; i++)
-    if (!str_cmp(player_table[i].name, name))
-      return (i);
+  if (ptable_by_name)
+    free(ptable_by_name);
+  if (ptable_by_id)
+    free(ptable_by_id);
+
+  for (ptable_hash_size = 64; ptable_hash_size < 4 * (top_of_p_table + 1); ptable_hash_size *= 2)
+    ;
+  CREATE(ptable_by_name, int, ptable_hash_size);
+  CREATE(ptable_by_id, int, ptable_hash_size);
+  for (i = 0; i < ptable_hash_size; i++)
+    ptable_by_name[i] = ptable_by_id[i] = -1;
+  ptable_name_used = ptable_id_used = 0;
+
+  for (i = 0; i <= top_of_p_table; i++) {
+    ptable_insert(ptable_by_name, ptable_name_hash(PT_PNAME(i)), i, FALSE);
+    ptable_insert(ptable_by_id, PT_IDNUM(i), i, TRUE);
+  }
+}
+
+/* Index the name at 'pos', after create_entry() or a rename. */
+void index_player_name(int pos)
+{
+  if (!ptable_by_name || 2 * (ptable_name_used + 1) > ptable_hash_size)
+    build_ptable_lookup();	/* keeps either index at most half full */
+  else
+    ptable_insert(ptable_by_name, ptable_name_hash(PT_PNAME(pos)), pos, FALSE);
+}
+
+/* Index the id at 'pos', once one has been handed out. */
+void index_player_id(int pos)
+{
+  if (!ptable_by_id || 2 * (ptable_id_used + 1) > ptable_hash_size)
+    build_ptable_lookup();
+  else
+    ptable_insert(ptable_by_id, PT_IDNUM(pos), pos, TRUE);
+}
+
+long get_ptable_by_name(const char *name)
+{
+  int slot, mask = ptable_hash_size - 1;
+
+  if (!ptable_by_name)
+    return (-1);
+
+  for (slot = ptable_name_hash(name) & mask; ptable_by_name[slot] != -1; slot = (slot + 1) & mask)
+    if (!str_cmp(PT_PNAME(ptable_by_name[slot]), name))
+      return (ptable_by_name[slot]);
 
   return (-1);
 }
 
-long get_id_by_name(const char *name)
+long get_ptable_by_id(long id)
 {
-  int i;
+  int slot, mask = ptable_hash_size - 1;
 
-  for (i = 0; i <= top_of_p_table; i++)
-    if (!str_cmp(player_table[i].name, name))
-      return (player_table[i].id);
+  if (!ptable_by_id)
+    return (-1);
+
+  for (slot = (unsigned long) id & mask; ptable_by_id[slot] != -1; slot = (slot + 1) & mask)
+    if (PT_IDNUM(ptable_by_id[slot]) == id)
+      return (ptable_by_id[slot]);
 
   return (-1);
 }
 
-char *get_name_by_id(long id)
+long get_id_by_name(const char *name)
 {
-  int i;
+  long pos = get_ptable_by_name(name);
 
-  for (i = 0; i <= top_of_p_table; i++)
-    if (player_table[i].id == id)
-      return (player_table[i].name);
+  return (pos < 0 ? -1 : PT_IDNUM(pos));
+}
 
-  return (NULL);
+char *get_name_by_id(long id)
+{
+  long pos = get_ptable_by_id(id);
+
+  return (pos < 0 ? NULL : PT_PNAME(pos));
 }
 
 /* Stuff related to the save/load player system. */
-/* New load_char reads ASCII Player Files. Load a char, TRUE if loaded, FALSE
- * if not. */
+/* Load a char from its ASCII or binary player file.  Returns the char's
+ * position in the player table, or -1 if it could not be loaded. */
 int load_char(const char *name, struct char_data *ch)
 {
-  int id, i;
+  return (load_pfile(name, ch, 0));
+}
+
+/* As load_char(), but the aliases and completed quests of a binary pfile
+ * stay on disk until load_char_deferred() is called.  For the login prompt,
+ * where most of what is loaded is thrown away again on a bad password or a
+ * reconnect. */
+int load_char_lazy(const char *name, struct char_data *ch)
+{
+  return (load_pfile(name, ch, PFB_DEFERRABLE));
+}
+
+/* Read whatever load_char_lazy() left on disk.  Does nothing if it left
+ * nothing, so it is safe to call on any player. */
+void load_char_deferred(struct char_data *ch)
+{
+  FILE *fl;
+  char filename[40];
+  int wanted;
+
+  if (IS_NPC(ch) || !(wanted = ch->player_specials->deferred_sections))
+    return;
+  ch->player_specials->deferred_sections = 0;
+
+  if (!get_filename(filename, sizeof(filename), PLR_FILE, GET_NAME(ch)))
+    return;
+  savequeue_wait(filename);
+  if (!(fl = fopen(filename, "rb"))) {
+    mudlog(NRM, LVL_GOD, TRUE, "SYSERR: Couldn't reopen player file %s", filename);
+    return;
+  }
+  if (read_binary_header(fl, filename) > 0)
+    read_binary_sections(fl, ch, wanted, GET_NAME(ch));
+  fclose(fl);
+}
+
+static int load_pfile(const char *name, struct char_data *ch, int defer)
+{
+  int id, i, binary;
   FILE *fl;
   char filename[40];
-  char buf[128], buf2[128], line[MAX_INPUT_LENGTH + 1], tag[6];
-  char f1[128], f2[128], f3[128], f4[128];
-  trig_data *t = NULL;
-  trig_rnum t_rnum = NOTHING;
 
   if ((id = get_ptable_by_name(name)) < 0)
     return (-1);
   else {
     if (!get_filename(filename, sizeof(filename), PLR_FILE, player_table[id].name))
       return (-1);
-    if (!(fl = fopen(filename, "r"))) {
+    savequeue_wait(filename);
+    if (!(fl = fopen(filename, "rb"))) {
       mudlog(NRM, LVL_GOD, TRUE, "SYSERR: Couldn't open player file %s", filename);
       return (-1);
     }
+    if ((binary = read_binary_header(fl, filename)) < 0) {
+      fclose(fl);
+      return (-1);
+    }
 
     /* Character initializations. Necessary to keep some things straight. */
     ch->affected = NULL;
@@ -307,6 +464,37 @@ int load_char(const char *name, struct char_data *ch)
       PLR_FLAGS(ch)[i] = PFDEF_PLRFLAGS;
     for (i = 0; i < PR_ARRAY_MAX; i++)
       PRF_FLAGS(ch)[i] = PFDEF_PREFFLAGS;
+    ch->player_specials->deferred_sections = 0;
+
+    if (binary)
+      ch->player_specials->deferred_sections = read_binary_sections(fl, ch, ~defer, name) & defer;
+    else {
+      rewind(fl);
+      read_ascii_pfile(fl, ch, name);
+    }
+  }
+
+  affect_total(ch);
+
+  /* initialization for imms */
+  if (GET_LEVEL(ch) >= LVL_IMMORT) {
+    for (i = 1; i <= MAX_SKILLS; i++)
+      GET_SKILL(ch, i) = 100;
+    GET_COND(ch, HUNGER) = -1;
+    GET_COND(ch, THIRST) = -1;
+    GET_COND(ch, DRUNK) = -1;
+  }
+  fclose(fl);
+  return(id);
+}
+
+/* The tag switch of the ASCII player file. */
+static void read_ascii_pfile(FILE *fl, struct char_data *ch, const char *name)
+{
+  char buf[128], buf2[128], line[MAX_INPUT_LENGTH + 1], tag[6];
+  char f1[128], f2[128], f3[128], f4[128];
+  trig_data *t = NULL;
+  trig_rnum t_rnum = NOTHING;
 
     while (get_line(fl, line)) {
       tag_argument(line, tag);
@@ -455,7 +643,7 @@ int load_char(const char *name, struct char_data *ch)
           if ((t_rnum = real_trigger(atoi(line))) != NOTHING) {
             t = read_trigger(t_rnum);
           if (!SCRIPT(ch))
-            CREATE(SCRIPT(ch), struct script_data, 1);
+            SCRIPT(ch) = create_script(ch, MOB_TRIGGER);
           add_trigger(SCRIPT(ch), t, -1);
           }
          }
@@ -475,36 +663,23 @@ int load_char(const char *name, struct char_data *ch)
 	sprintf(buf, "SYSERR: Unknown tag %s in pfile %s", tag, name);
       }
     }
-  }
-
-  affect_total(ch);
-
-  /* initialization for imms */
-  if (GET_LEVEL(ch) >= LVL_IMMORT) {
-    for (i = 1; i <= MAX_SKILLS; i++)
-      GET_SKILL(ch, i) = 100;
-    GET_COND(ch, HUNGER) = -1;
-    GET_COND(ch, THIRST) = -1;
-    GET_COND(ch, DRUNK) = -1;
-  }
-  fclose(fl);
-  return(id);
 }
 
 /* Write the vital data of a player to the player file. */
 /* This is the ASCII Player Files save routine. */
 void save_char(struct char_data * ch)
 {
-  FILE *fl;
-  char filename[40], buf[MAX_STRING_LENGTH], bits[127], bits2[127], bits3[127], bits4[127];
-  int i, j, id, save_index = FALSE;
+  char filename[40];
+  int i, j, id, save_index = FALSE, saved;
   struct affected_type *aff, tmp_aff[MAX_AFFECT];
   struct obj_data *char_eq[NUM_WEARS];
-  trig_data *t;
 
   if (IS_NPC(ch) || GET_PFILEPOS(ch) < 0)
     return;
 
+  /* Anything still on disk has to be read before the file is replaced. */
+  load_char_deferred(ch);
+
   /* If ch->desc is not null, then update session data before saving. */
   if (ch->desc) {
     if (*ch->desc->host) {
@@ -525,10 +700,6 @@ void save_char(struct char_data * ch)
 
   if (!get_filename(filename, sizeof(filename), PLR_FILE, GET_NAME(ch)))
     return;
-  if (!(fl = fopen(filename, "w"))) {
-    mudlog(NRM, LVL_GOD, TRUE, "SYSERR: Couldn't open player file %s for write", filename);
-    return;
-  }
 
   /* Unaffect everything a character can be affected by. */
   for (i = 0; i < NUM_WEARS; i++) {
@@ -567,6 +738,78 @@ void save_char(struct char_data * ch)
   ch->aff_abils = ch->real_abils;
   /* end char_to_store code */
 
+  if (CONFIG_BINARY_PFILES)
+    saved = write_binary_pfile(filename, ch, tmp_aff);
+  else
+    saved = write_ascii_pfile(filename, ch, tmp_aff);
+
+  /* More char_to_store code to add spell and eq affections back in. */
+  for (i = 0; i < MAX_AFFECT; i++) {
+    if (tmp_aff[i].spell)
+      affect_to_char(ch, &tmp_aff[i]);
+  }
+
+  for (i = 0; i < NUM_WEARS; i++) {
+    if (char_eq[i])
+#ifndef NO_EXTRANEOUS_TRIGGERS
+        if (wear_otrigger(char_eq[i], ch, i))
+#endif
+    equip_char(ch, char_eq[i], i);
+#ifndef NO_EXTRANEOUS_TRIGGERS
+          else
+          obj_to_char(char_eq[i], ch);
+#endif
+  }
+  /* end char_to_store code */
+
+  if (!saved)
+    return;
+
+  if ((id = get_ptable_by_name(GET_NAME(ch))) < 0)
+    return;
+
+  /* update the player in the player index */
+  if (player_table[id].level != GET_LEVEL(ch)) {
+    save_index = TRUE;
+    player_table[id].level = GET_LEVEL(ch);
+  }
+  if (player_table[id].last != ch->player.time.logon) {
+    save_index = TRUE;
+    player_table[id].last = ch->player.time.logon;
+  }
+  i = player_table[id].flags;
+  if (PLR_FLAGGED(ch, PLR_DELETED))
+    SET_BIT(player_table[id].flags, PINDEX_DELETED);
+  else
+    REMOVE_BIT(player_table[id].flags, PINDEX_DELETED);
+  if (PLR_FLAGGED(ch, PLR_NODELETE) || PLR_FLAGGED(ch, PLR_CRYO))
+    SET_BIT(player_table[id].flags, PINDEX_NODELETE);
+  else
+    REMOVE_BIT(player_table[id].flags, PINDEX_NODELETE);
+
+  if (PLR_FLAGGED(ch, PLR_FROZEN) || PLR_FLAGGED(ch, PLR_NOWIZLIST))
+    SET_BIT(player_table[id].flags, PINDEX_NOWIZLIST);
+  else
+    REMOVE_BIT(player_table[id].flags, PINDEX_NOWIZLIST);
+
+  if (player_table[id].flags != i || save_index)
+    save_player_index();
+}
+
+/* Write the ASCII player file, with one tag per line, through savequeue.c so
+ * a crash or a full disk halfway through leaves the old file intact.  The
+ * affects the char had on have been taken off and are in tmp_aff. */
+static int write_ascii_pfile(const char *filename, struct char_data *ch, struct affected_type *tmp_aff)
+{
+  FILE *fl;
+  char buf[MAX_STRING_LENGTH], bits[127], bits2[127], bits3[127], bits4[127];
+  struct affected_type *aff;
+  trig_data *t;
+  int i;
+
+  if (!(fl = savequeue_open(filename)))
+    return (FALSE);
+
   if (GET_NAME(ch))				fprintf(fl, "Name: %s\n", GET_NAME(ch));
   if (GET_PASSWD(ch))				fprintf(fl, "Pass: %s\n", GET_PASSWD(ch));
   if (GET_TITLE(ch))				fprintf(fl, "Titl: %s\n", GET_TITLE(ch));
@@ -696,56 +939,7 @@ void save_char(struct char_data * ch)
   write_aliases_ascii(fl, ch);
   save_char_vars_ascii(fl, ch);
 
-  fclose(fl);
-
-  /* More char_to_store code to add spell and eq affections back in. */
-  for (i = 0; i < MAX_AFFECT; i++) {
-    if (tmp_aff[i].spell)
-      affect_to_char(ch, &tmp_aff[i]);
-  }
-
-  for (i = 0; i < NUM_WEARS; i++) {
-    if (char_eq[i])
-#ifndef NO_EXTRANEOUS_TRIGGERS
-        if (wear_otrigger(char_eq[i], ch, i))
-#endif
-    equip_char(ch, char_eq[i], i);
-#ifndef NO_EXTRANEOUS_TRIGGERS
-          else
-          obj_to_char(char_eq[i], ch);
-#endif
-  }
-  /* end char_to_store code */
-
-  if ((id = get_ptable_by_name(GET_NAME(ch))) < 0)
-    return;
-
-  /* update the player in the player index */
-  if (player_table[id].level != GET_LEVEL(ch)) {
-    save_index = TRUE;
-    player_table[id].level = GET_LEVEL(ch);
-  }
-  if (player_table[id].last != ch->player.time.logon) {
-    save_index = TRUE;
-    player_table[id].last = ch->player.time.logon;
-  }
-  i = player_table[id].flags;
-  if (PLR_FLAGGED(ch, PLR_DELETED))
-    SET_BIT(player_table[id].flags, PINDEX_DELETED);
-  else
-    REMOVE_BIT(player_table[id].flags, PINDEX_DELETED);
-  if (PLR_FLAGGED(ch, PLR_NODELETE) || PLR_FLAGGED(ch, PLR_CRYO))
-    SET_BIT(player_table[id].flags, PINDEX_NODELETE);
-  else
-    REMOVE_BIT(player_table[id].flags, PINDEX_NODELETE);
-
-  if (PLR_FLAGGED(ch, PLR_FROZEN) || PLR_FLAGGED(ch, PLR_NOWIZLIST))
-    SET_BIT(player_table[id].flags, PINDEX_NOWIZLIST);
-  else
-    REMOVE_BIT(player_table[id].flags, PINDEX_NOWIZLIST);
-
-  if (player_table[id].flags != i || save_index)
-    save_player_index();
+  return (savequeue_close(fl) == 0);
 }
 
 /* Separate a 4-character id tag from the data it precedes */
@@ -780,8 +974,10 @@ void remove_player(int pfilepos)
 
   /* Unlink all player-owned files */
   for (i = 0; i < MAX_FILES; i++) {
-    if (get_filename(filename, sizeof(filename), i, player_table[pfilepos].name))
+    if (get_filename(filename, sizeof(filename), i, player_table[pfilepos].name)) {
+      savequeue_wait(filename);
       unlink(filename);
+    }
   }
 
   strftime(timestr, sizeof(timestr), "%c", localtime(&(player_table[pfilepos].last)));
@@ -983,3 +1179,478 @@ static void read_aliases_ascii(FILE *file, struct char_data *ch, int count)
     }
   }
 }
+
+/* Binary player files.  See pfbinary.h for the layout; the encoding itself
+ * is in pfbinary.c, shared with util/pfconv.c. */
+
+/* Check for the binary pfile header.  1 if fl is a binary pfile and is now
+ * positioned at its first section, 0 if it is not one, -1 if it is one that
+ * cannot be read. */
+static int read_binary_header(FILE *fl, const char *filename)
+{
+  unsigned char head[PFB_MAGIC_LEN + 4];
+
+  if (fread(head, 1, sizeof(head), fl) != sizeof(head) ||
+      memcmp(head, PFB_MAGIC, PFB_MAGIC_LEN))
+    return (0);
+
+  if (pfb_u32(head + PFB_MAGIC_LEN) > PFB_VERSION) {
+    mudlog(NRM, LVL_GOD, TRUE, "SYSERR: Player file %s is version %lu, newer than this server's %d",
+      filename, pfb_u32(head + PFB_MAGIC_LEN), PFB_VERSION);
+    return (-1);
+  }
+  return (1);
+}
+
+static void read_binary_stats(struct pfb_buf *b, struct char_data *ch, const char *name)
+{
+  unsigned long tag;
+  long num[4];
+  char *str;
+  int type, i;
+
+  while (b->pos < b->len && !b->bad) {
+    tag = pfb_get_u32(b);
+    type = pfb_get_u8(b);
+
+    if (type == PFB_TYPE_STR) {
+      str = pfb_get_str(b);
+      switch (tag) {
+      case PFB_TAG('N','a','m','e'):	GET_PC_NAME(ch)		= str; break;
+      case PFB_TAG('T','i','t','l'):	GET_TITLE(ch)		= str; break;
+      case PFB_TAG('D','e','s','c'):	ch->player.description	= str; break;
+      case PFB_TAG('P','f','I','n'):	POOFIN(ch)		= str; break;
+      case PFB_TAG('P','f','O','t'):	POOFOUT(ch)		= str; break;
+      case PFB_TAG('H','o','s','t'):
+        if (GET_HOST(ch))
+          free(GET_HOST(ch));
+        GET_HOST(ch) = str;
+        break;
+      case PFB_TAG('P','a','s','s'):
+        strlcpy(GET_PASSWD(ch), str, MAX_PWD_LENGTH + 1);
+        /* fall through */
+      default:
+        free(str);
+      }
+      continue;
+    }
+
+    num[0] = num[1] = num[2] = num[3] = 0;
+    switch (type) {
+    case PFB_TYPE_INT:
+      num[0] = pfb_get_i32(b);
+      break;
+    case PFB_TYPE_LONG:
+      num[0] = pfb_get_long(b);
+      break;
+    case PFB_TYPE_PAIR:
+      num[0] = pfb_get_i32(b);
+      num[1] = pfb_get_i32(b);
+      break;
+    case PFB_TYPE_FLAGS:
+      for (i = 0; i < 4; i++)
+        num[i] = (long) pfb_get_u32(b);
+      break;
+    default:
+      /* No way to know how long it is, so nothing after it can be read. */
+      log("SYSERR: Unknown field type %d in pfile %s", type, name);
+      return;
+    }
+
+    switch (tag) {
+    case PFB_TAG('A','c',' ',' '):	GET_AC(ch)		= num[0]; break;
+    case PFB_TAG('A','c','t',' '):
+      for (i = 0; i < 4 && i < PM_ARRAY_MAX; i++)
+        PLR_FLAGS(ch)[i] = num[i];
+      break;
+    case PFB_TAG('A','f','f',' '):
+      for (i = 0; i < 4 && i < AF_ARRAY_MAX; i++)
+        AFF_FLAGS(ch)[i] = num[i];
+      break;
+    case PFB_TAG('A','l','i','n'):	GET_ALIGNMENT(ch)	= num[0]; break;
+    case PFB_TAG('B','a','d','p'):	GET_BAD_PWS(ch)		= num[0]; break;
+    case PFB_TAG('B','a','n','k'):	GET_BANK_GOLD(ch)	= num[0]; break;
+    case PFB_TAG('B','r','t','h'):	ch->player.time.birth	= num[0]; break;
+    case PFB_TAG('C','h','a',' '):	ch->real_abils.cha	= num[0]; break;
+    case PFB_TAG('C','l','a','s'):	GET_CLASS(ch)		= num[0]; break;
+    case PFB_TAG('C','o','n',' '):	ch->real_abils.con	= num[0]; break;
+    case PFB_TAG('D','e','x',' '):	ch->real_abils.dex	= num[0]; break;
+    case PFB_TAG('D','r','n','k'):	GET_COND(ch, DRUNK)	= num[0]; break;
+    case PFB_TAG('D','r','o','l'):	GET_DAMROLL(ch)		= num[0]; break;
+    case PFB_TAG('E','x','p',' '):	GET_EXP(ch)		= num[0]; break;
+    case PFB_TAG('F','r','e','z'):	GET_FREEZE_LEV(ch)	= num[0]; break;
+    case PFB_TAG('G','o','l','d'):	GET_GOLD(ch)		= num[0]; break;
+    case PFB_TAG('H','i','t',' '):
+      GET_HIT(ch) = num[0];
+      GET_MAX_HIT(ch) = num[1];
+      break;
+    case PFB_TAG('H','i','t','e'):	GET_HEIGHT(ch)		= num[0]; break;
+    case PFB_TAG('H','r','o','l'):	GET_HITROLL(ch)		= num[0]; break;
+    case PFB_TAG('H','u','n','g'):	GET_COND(ch, HUNGER)	= num[0]; break;
+    case PFB_TAG('I','d',' ',' '):	GET_IDNUM(ch)		= num[0]; break;
+    case PFB_TAG('I','n','t',' '):	ch->real_abils.intel	= num[0]; break;
+    case PFB_TAG('I','n','v','s'):	GET_INVIS_LEV(ch)	= num[0]; break;
+    case PFB_TAG('L','a','s','t'):	ch->player.time.logon	= num[0]; break;
+    case PFB_TAG('L','e','r','n'):	GET_PRACTICES(ch)	= num[0]; break;
+    case PFB_TAG('L','e','v','l'):	GET_LEVEL(ch)		= num[0]; break;
+    case PFB_TAG('L','m','o','t'):	GET_LAST_MOTD(ch)	= num[0]; break;
+    case PFB_TAG('L','n','e','w'):	GET_LAST_NEWS(ch)	= num[0]; break;
+    case PFB_TAG('M','a','n','a'):
+      GET_MANA(ch) = num[0];
+      GET_MAX_MANA(ch) = num[1];
+      break;
+    case PFB_TAG('M','o','v','e'):
+      GET_MOVE(ch) = num[0];
+      GET_MAX_MOVE(ch) = num[1];
+      break;
+    case PFB_TAG('O','l','c',' '):	GET_OLC_ZONE(ch)	= num[0]; break;
+    case PFB_TAG('P','a','g','e'):	GET_PAGE_LENGTH(ch)	= num[0]; break;
+    case PFB_TAG('P','l','y','d'):	ch->player.time.played	= num[0]; break;
+    case PFB_TAG('P','r','e','f'):
+      for (i = 0; i < 4 && i < PR_ARRAY_MAX; i++)
+        PRF_FLAGS(ch)[i] = num[i];
+      break;
+    case PFB_TAG('Q','s','t','p'):	GET_QUESTPOINTS(ch)	= num[0]; break;
+    case PFB_TAG('Q','c','u','r'):	GET_QUEST(ch)		= num[0]; break;
+    case PFB_TAG('Q','c','n','t'):	GET_QUEST_COUNTER(ch)	= num[0]; break;
+    case PFB_TAG('R','o','o','m'):	GET_LOADROOM(ch)	= num[0]; break;
+    case PFB_TAG('S','e','x',' '):	GET_SEX(ch)		= num[0]; break;
+    case PFB_TAG('S','c','r','W'):	GET_SCREEN_WIDTH(ch)	= num[0]; break;
+    case PFB_TAG('S','t','r',' '):
+      ch->real_abils.str = num[0];
+      ch->real_abils.str_add = num[1];
+      break;
+    case PFB_TAG('S','t','u','n'):
+      GET_STUN(ch) = num[0];
+      GET_MAX_STUN(ch) = num[1];
+      break;
+    case PFB_TAG('T','h','i','r'):	GET_COND(ch, THIRST)	= num[0]; break;
+    case PFB_TAG('T','h','r','1'):	GET_SAVE(ch, 0)		= num[0]; break;
+    case PFB_TAG('T','h','r','2'):	GET_SAVE(ch, 1)		= num[0]; break;
+    case PFB_TAG('T','h','r','3'):	GET_SAVE(ch, 2)		= num[0]; break;
+    case PFB_TAG('T','h','r','4'):	GET_SAVE(ch, 3)		= num[0]; break;
+    case PFB_TAG('T','h','r','5'):	GET_SAVE(ch, 4)		= num[0]; break;
+    case PFB_TAG('W','a','t','e'):	GET_WEIGHT(ch)		= num[0]; break;
+    case PFB_TAG('W','i','m','p'):	GET_WIMP_LEV(ch)	= num[0]; break;
+    case PFB_TAG('W','i','s',' '):	ch->real_abils.wis	= num[0]; break;
+    }
+  }
+}
+
+static void read_binary_skills(struct pfb_buf *b, struct char_data *ch)
+{
+  unsigned int count = pfb_get_u16(b), skill, level;
+
+  while (count-- > 0 && !b->bad) {
+    skill = pfb_get_u16(b);
+    level = pfb_get_u16(b);
+    if (skill > 0 && skill <= MAX_SKILLS)
+      GET_SKILL(ch, skill) = level;
+  }
+}
+
+static void read_binary_affects(struct pfb_buf *b, struct char_data *ch)
+{
+  unsigned int count = pfb_get_u16(b);
+  struct affected_type af;
+  int i;
+
+  while (count-- > 0 && !b->bad) {
+    new_affect(&af);
+    af.spell = pfb_get_i32(b);
+    af.duration = pfb_get_i32(b);
+    af.modifier = pfb_get_i32(b);
+    af.location = pfb_get_i32(b);
+    for (i = 0; i < 4; i++)
+      if (i < AF_ARRAY_MAX)
+        af.bitvector[i] = pfb_get_u32(b);
+      else
+        pfb_get_u32(b);
+    if (af.spell > 0 && !b->bad)
+      affect_to_char(ch, &af);
+  }
+}
+
+/* Aliases are kept in the order they were saved in. */
+static void read_binary_aliases(struct pfb_buf *b, struct char_data *ch)
+{
+  unsigned int count = pfb_get_u16(b);
+  struct alias_data *a, **tail;
+
+  for (tail = &GET_ALIASES(ch); *tail; tail = &(*tail)->next)
+    ;
+
+  while (count-- > 0 && !b->bad) {
+    CREATE(a, struct alias_data, 1);
+    a->alias = pfb_get_str(b);
+    a->replacement = pfb_get_str(b);
+    a->type = pfb_get_i32(b);
+    *tail = a;
+    tail = &a->next;
+  }
+}
+
+static void read_binary_quests(struct pfb_buf *b, struct char_data *ch)
+{
+  unsigned long count = pfb_get_u32(b);
+
+  /* Every vnum is four bytes, so this is a bound on a damaged count too. */
+  if (count == 0 || count > (b->len - b->pos) / 4)
+    return;
+
+  RECREATE(ch->player_specials->saved.completed_quests, qst_vnum, GET_NUM_QUESTS(ch) + count);
+  while (count-- > 0)
+    ch->player_specials->saved.completed_quests[GET_NUM_QUESTS(ch)++] = pfb_get_i32(b);
+}
+
+static void read_binary_vars(struct pfb_buf *b, struct char_data *ch)
+{
+  unsigned int count = pfb_get_u16(b);
+  trig_rnum t_rnum;
+  char *name, *value;
+  long context;
+
+  while (count-- > 0 && !b->bad) {
+    t_rnum = real_trigger(pfb_get_i32(b));
+    if (CONFIG_SCRIPT_PLAYERS && t_rnum != NOTHING) {
+      if (!SCRIPT(ch))
+        SCRIPT(ch) = create_script(ch, MOB_TRIGGER);
+      add_trigger(SCRIPT(ch), read_trigger(t_rnum), -1);
+    }
+  }
+
+  count = pfb_get_u16(b);
+  while (count-- > 0 && !b->bad) {
+    name = pfb_get_str(b);
+    context = pfb_get_long(b);
+    value = pfb_get_str(b);
+    if (!b->bad) {
+      if (!SCRIPT(ch))
+        SCRIPT(ch) = create_script(ch, MOB_TRIGGER);
+      add_var(&(SCRIPT(ch)->global_vars), name, value, context);
+    }
+    free(name);
+    free(value);
+  }
+}
+
+/* Read the sections of a binary pfile that are in 'wanted' (a mask of
+ * 1 << section id), up to the end section.  Returns the mask of the sections
+ * passed over. */
+static int read_binary_sections(FILE *fl, struct char_data *ch, int wanted, const char *name)
+{
+  static struct pfb_buf b;
+  unsigned char head[8];
+  unsigned long id, len;
+  int skipped = 0;
+
+  for (;;) {
+    if (fread(head, 1, sizeof(head), fl) != sizeof(head)) {
+      log("SYSERR: Binary pfile for %s ends without an end section", name);
+      break;
+    }
+    if ((id = pfb_u32(head)) == PFB_END)
+      break;
+    len = pfb_u32(head + 4);
+
+    if (id >= 8 * sizeof(int) - 1 || !(wanted & (1 << id))) {
+      if (id < 8 * sizeof(int) - 1)
+        skipped |= 1 << id;
+      if (fseek(fl, len, SEEK_CUR) < 0)
+        break;
+      continue;
+    }
+
+    if (!pfb_read_section(fl, &b, len)) {
+      log("SYSERR: Binary pfile for %s is cut short", name);
+      break;
+    }
+
+    switch (id) {
+    case PFB_STATS:	read_binary_stats(&b, ch, name);	break;
+    case PFB_SKILLS:	read_binary_skills(&b, ch);		break;
+    case PFB_AFFECTS:	read_binary_affects(&b, ch);		break;
+    case PFB_ALIASES:	read_binary_aliases(&b, ch);		break;
+    case PFB_QUESTS:	read_binary_quests(&b, ch);		break;
+    case PFB_VARS:	read_binary_vars(&b, ch);		break;
+    }
+    if (b.bad)
+      log("SYSERR: Section %lu of the binary pfile for %s is cut short", id, name);
+  }
+  return (skipped);
+}
+
+/* Write the binary player file.  Fields at their pfdefaults.h value are left
+ * out, as they are from the ASCII file. */
+static int write_binary_pfile(const char *filename, struct char_data *ch, struct affected_type *tmp_aff)
+{
+  static struct pfb_buf b;
+  struct alias_data *a;
+  struct trig_var_data *vars;
+  trig_data *t;
+  size_t sec, at;
+  FILE *fl;
+  int i, count;
+
+  b.len = 0;
+  pfb_put(&b, PFB_MAGIC, PFB_MAGIC_LEN);
+  pfb_put_u32(&b, PFB_VERSION);
+
+  sec = pfb_begin(&b, PFB_STATS);
+  if (GET_NAME(ch))				pfb_str(&b, "Name", GET_NAME(ch));
+  pfb_str(&b, "Pass", GET_PASSWD(ch));
+  if (GET_TITLE(ch))				pfb_str(&b, "Titl", GET_TITLE(ch));
+  if (ch->player.description && *ch->player.description)
+    pfb_str(&b, "Desc", ch->player.description);
+  if (POOFIN(ch))				pfb_str(&b, "PfIn", POOFIN(ch));
+  if (POOFOUT(ch))				pfb_str(&b, "PfOt", POOFOUT(ch));
+  if (GET_SEX(ch)	   != PFDEF_SEX)	pfb_int(&b, "Sex ", GET_SEX(ch));
+  if (GET_CLASS(ch)	   != PFDEF_CLASS)	pfb_int(&b, "Clas", GET_CLASS(ch));
+  if (GET_LEVEL(ch)	   != PFDEF_LEVEL)	pfb_int(&b, "Levl", GET_LEVEL(ch));
+
+  pfb_long(&b, "Id  ", GET_IDNUM(ch));
+  pfb_long(&b, "Brth", (long)ch->player.time.birth);
+  pfb_int(&b, "Plyd", ch->player.time.played);
+  pfb_long(&b, "Last", (long)ch->player.time.logon);
+
+  if (GET_LAST_MOTD(ch)	   != PFDEF_LASTMOTD)	pfb_int(&b, "Lmot", (int)GET_LAST_MOTD(ch));
+  if (GET_LAST_NEWS(ch)	   != PFDEF_LASTNEWS)	pfb_int(&b, "Lnew", (int)GET_LAST_NEWS(ch));
+
+  if (GET_HOST(ch))				pfb_str(&b, "Host", GET_HOST(ch));
+  if (GET_HEIGHT(ch)	   != PFDEF_HEIGHT)	pfb_int(&b, "Hite", GET_HEIGHT(ch));
+  if (GET_WEIGHT(ch)	   != PFDEF_WEIGHT)	pfb_int(&b, "Wate", GET_WEIGHT(ch));
+  if (GET_ALIGNMENT(ch)	   != PFDEF_ALIGNMENT)	pfb_int(&b, "Alin", GET_ALIGNMENT(ch));
+
+  pfb_flags(&b, "Act ", PLR_FLAGS(ch));
+  pfb_flags(&b, "Aff ", AFF_FLAGS(ch));
+  pfb_flags(&b, "Pref", PRF_FLAGS(ch));
+
+  if (GET_SAVE(ch, 0)	   != PFDEF_SAVETHROW)	pfb_int(&b, "Thr1", GET_SAVE(ch, 0));
+  if (GET_SAVE(ch, 1)	   != PFDEF_SAVETHROW)	pfb_int(&b, "Thr2", GET_SAVE(ch, 1));
+  if (GET_SAVE(ch, 2)	   != PFDEF_SAVETHROW)	pfb_int(&b, "Thr3", GET_SAVE(ch, 2));
+  if (GET_SAVE(ch, 3)	   != PFDEF_SAVETHROW)	pfb_int(&b, "Thr4", GET_SAVE(ch, 3));
+  if (GET_SAVE(ch, 4)	   != PFDEF_SAVETHROW)	pfb_int(&b, "Thr5", GET_SAVE(ch, 4));
+
+  if (GET_WIMP_LEV(ch)	   != PFDEF_WIMPLEV)	pfb_int(&b, "Wimp", GET_WIMP_LEV(ch));
+  if (GET_FREEZE_LEV(ch)   != PFDEF_FREEZELEV)	pfb_int(&b, "Frez", GET_FREEZE_LEV(ch));
+  if (GET_INVIS_LEV(ch)	   != PFDEF_INVISLEV)	pfb_int(&b, "Invs", GET_INVIS_LEV(ch));
+  if (GET_LOADROOM(ch)	   != PFDEF_LOADROOM)	pfb_int(&b, "Room", GET_LOADROOM(ch));
+
+  if (GET_BAD_PWS(ch)	   != PFDEF_BADPWS)	pfb_int(&b, "Badp", GET_BAD_PWS(ch));
+  if (GET_PRACTICES(ch)	   != PFDEF_PRACTICES)	pfb_int(&b, "Lern", GET_PRACTICES(ch));
+
+  if (GET_COND(ch, HUNGER) != PFDEF_HUNGER && GET_LEVEL(ch) < LVL_IMMORT) pfb_int(&b, "Hung", GET_COND(ch, HUNGER));
+  if (GET_COND(ch, THIRST) != PFDEF_THIRST && GET_LEVEL(ch) < LVL_IMMORT) pfb_int(&b, "Thir", GET_COND(ch, THIRST));
+  if (GET_COND(ch, DRUNK)  != PFDEF_DRUNK  && GET_LEVEL(ch) < LVL_IMMORT) pfb_int(&b, "Drnk", GET_COND(ch, DRUNK));
+
+  if (GET_HIT(ch)	   != PFDEF_HIT  || GET_MAX_HIT(ch)  != PFDEF_MAXHIT)  pfb_pair(&b, "Hit ", GET_HIT(ch),  GET_MAX_HIT(ch));
+  if (GET_MANA(ch)	   != PFDEF_MANA || GET_MAX_MANA(ch) != PFDEF_MAXMANA) pfb_pair(&b, "Mana", GET_MANA(ch), GET_MAX_MANA(ch));
+  if (GET_MOVE(ch)	   != PFDEF_MOVE || GET_MAX_MOVE(ch) != PFDEF_MAXMOVE) pfb_pair(&b, "Move", GET_MOVE(ch), GET_MAX_MOVE(ch));
+  if (GET_STUN(ch)	   != PFDEF_STUN || GET_MAX_STUN(ch) != PFDEF_MAXSTUN) pfb_pair(&b, "Stun", GET_STUN(ch), GET_MAX_STUN(ch));
+  if (GET_STR(ch)	   != PFDEF_STR  || GET_ADD(ch)      != PFDEF_STRADD)  pfb_pair(&b, "Str ", GET_STR(ch),  GET_ADD(ch));
+
+  if (GET_INT(ch)	   != PFDEF_INT)	pfb_int(&b, "Int ", GET_INT(ch));
+  if (GET_WIS(ch)	   != PFDEF_WIS)	pfb_int(&b, "Wis ", GET_WIS(ch));
+  if (GET_DEX(ch)	   != PFDEF_DEX)	pfb_int(&b, "Dex ", GET_DEX(ch));
+  if (GET_CON(ch)	   != PFDEF_CON)	pfb_int(&b, "Con ", GET_CON(ch));
+  if (GET_CHA(ch)	   != PFDEF_CHA)	pfb_int(&b, "Cha ", GET_CHA(ch));
+
+  if (GET_AC(ch)	   != PFDEF_AC)		pfb_int(&b, "Ac  ", GET_AC(ch));
+  if (GET_GOLD(ch)	   != PFDEF_GOLD)	pfb_int(&b, "Gold", GET_GOLD(ch));
+  if (GET_BANK_GOLD(ch)	   != PFDEF_BANK)	pfb_int(&b, "Bank", GET_BANK_GOLD(ch));
+  if (GET_EXP(ch)	   != PFDEF_EXP)	pfb_int(&b, "Exp ", GET_EXP(ch));
+  if (GET_HITROLL(ch)	   != PFDEF_HITROLL)	pfb_int(&b, "Hrol", GET_HITROLL(ch));
+  if (GET_DAMROLL(ch)	   != PFDEF_DAMROLL)	pfb_int(&b, "Drol", GET_DAMROLL(ch));
+  if (GET_OLC_ZONE(ch)	   != PFDEF_OLC)	pfb_int(&b, "Olc ", GET_OLC_ZONE(ch));
+  if (GET_PAGE_LENGTH(ch)  != PFDEF_PAGELENGTH)	pfb_int(&b, "Page", GET_PAGE_LENGTH(ch));
+  if (GET_SCREEN_WIDTH(ch) != PFDEF_SCREENWIDTH) pfb_int(&b, "ScrW", GET_SCREEN_WIDTH(ch));
+  if (GET_QUESTPOINTS(ch)  != PFDEF_QUESTPOINTS) pfb_int(&b, "Qstp", GET_QUESTPOINTS(ch));
+  if (GET_QUEST_COUNTER(ch)!= PFDEF_QUESTCOUNT)	pfb_int(&b, "Qcnt", GET_QUEST_COUNTER(ch));
+  if (GET_QUEST(ch)	   != PFDEF_CURRQUEST)	pfb_int(&b, "Qcur", GET_QUEST(ch));
+  pfb_end(&b, sec);
+
+  if (GET_LEVEL(ch) < LVL_IMMORT) {
+    sec = pfb_begin(&b, PFB_SKILLS);
+    at = b.len;
+    pfb_put_u16(&b, 0);
+    for (count = 0, i = 1; i <= MAX_SKILLS; i++)
+      if (GET_SKILL(ch, i)) {
+        pfb_put_u16(&b, i);
+        pfb_put_u16(&b, GET_SKILL(ch, i));
+        count++;
+      }
+    b.data[at] = count & 0xFF;
+    b.data[at + 1] = (count >> 8) & 0xFF;
+    pfb_end(&b, sec);
+  }
+
+  if (tmp_aff[0].spell > 0) {
+    for (count = 0, i = 0; i < MAX_AFFECT; i++)
+      if (tmp_aff[i].spell)
+        count++;
+    sec = pfb_begin(&b, PFB_AFFECTS);
+    pfb_put_u16(&b, count);
+    for (i = 0; i < MAX_AFFECT; i++)
+      if (tmp_aff[i].spell) {
+        pfb_put_u32(&b, (unsigned long) tmp_aff[i].spell);
+        pfb_put_u32(&b, (unsigned long) tmp_aff[i].duration);
+        pfb_put_u32(&b, (unsigned long) tmp_aff[i].modifier);
+        pfb_put_u32(&b, (unsigned long) tmp_aff[i].location);
+        pfb_put_u32(&b, (unsigned long) tmp_aff[i].bitvector[0]);
+        pfb_put_u32(&b, (unsigned long) tmp_aff[i].bitvector[1]);
+        pfb_put_u32(&b, (unsigned long) tmp_aff[i].bitvector[2]);
+        pfb_put_u32(&b, (unsigned long) tmp_aff[i].bitvector[3]);
+      }
+    pfb_end(&b, sec);
+  }
+
+  if (GET_ALIASES(ch)) {
+    for (count = 0, a = GET_ALIASES(ch); a; a = a->next)
+      count++;
+    sec = pfb_begin(&b, PFB_ALIASES);
+    pfb_put_u16(&b, count);
+    for (a = GET_ALIASES(ch); a; a = a->next) {
+      pfb_put_str(&b, a->alias);
+      pfb_put_str(&b, a->replacement);
+      pfb_put_u32(&b, (unsigned long) a->type);
+    }
+    pfb_end(&b, sec);
+  }
+
+  if (GET_NUM_QUESTS(ch) > 0) {
+    sec = pfb_begin(&b, PFB_QUESTS);
+    pfb_put_u32(&b, GET_NUM_QUESTS(ch));
+    for (i = 0; i < GET_NUM_QUESTS(ch); i++)
+      pfb_put_u32(&b, (unsigned long) ch->player_specials->saved.completed_quests[i]);
+    pfb_end(&b, sec);
+  }
+
+  if (SCRIPT(ch)) {
+    sec = pfb_begin(&b, PFB_VARS);
+    for (count = 0, t = TRIGGERS(SCRIPT(ch)); t; t = t->next)
+      count++;
+    pfb_put_u16(&b, count);
+    for (t = TRIGGERS(SCRIPT(ch)); t; t = t->next)
+      pfb_put_u32(&b, (unsigned long) GET_TRIG_VNUM(t));
+
+    /* Variables starting with '-' are not saved, as in the ASCII file. */
+    for (count = 0, vars = SCRIPT(ch)->global_vars.head; vars; vars = vars->next)
+      if (*vars->name != '-')
+        count++;
+    pfb_put_u16(&b, count);
+    for (vars = SCRIPT(ch)->global_vars.head; vars; vars = vars->next)
+      if (*vars->name != '-') {
+        pfb_put_str(&b, vars->name);
+        pfb_put_long(&b, vars->context);
+        pfb_put_str(&b, vars->value);
+      }
+    pfb_end(&b, sec);
+  }
+
+  pfb_end(&b, pfb_begin(&b, PFB_END));
+
+  if (!(fl = savequeue_open(filename)))
+    return (FALSE);
+  fwrite(b.data, 1, b.len, fl);
+  return (savequeue_close(fl) == 0);
+}
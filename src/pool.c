@@ -0,0 +1,156 @@
+/**
+* @file pool.c
+* Fixed-size object pools for short lived, frequently allocated structures.
+*
+* Part of the core altMUD source code distribution, which is a derivative
+* of, and continuation of, CircleMUD.
+*
+* All rights reserved.  See license for complete information.
+*
+* The event path creates and destroys an event, a queue element, a mud event
+* and a list item for nearly everything it schedules.  Rather than take a
+* malloc/free pair for each one, those structures come from the pools below.
+* Each pool carves objects out of POOL_SLAB_OBJECTS sized slabs and threads
+* released objects onto a free list for reuse.
+*/
+
+#include "conf.h"
+#include "sysdep.h"
+#include "structs.h"
+#include "utils.h"
+#include "pool.h"
+
+/** A released object, reused to link the free list. */
+struct pool_free {
+  struct pool_free *next;
+};
+
+/** Header of a slab; the objects follow it. */
+struct pool_slab {
+  struct pool_slab *next;
+};
+
+/** Objects and slab headers are padded to this for alignment. */
+#define POOL_ALIGN  (sizeof(double) > sizeof(void *) ? sizeof(double) : sizeof(void *))
+#define POOL_ROUND(x)  (((x) + POOL_ALIGN - 1) & ~(POOL_ALIGN - 1))
+
+/* file scope variables */
+static struct mem_pool *pool_list = NULL; /**< Registry of every pool */
+
+/** Create an empty pool and add it to the registry.
+ * @param name A name for the pool, shown by 'show pools'.
+ * @param obj_size The size of the objects it hands out.
+ * @retval mem_pool * The new pool. */
+struct mem_pool *pool_create(const char *name, size_t obj_size)
+{
+  struct mem_pool *pool;
+
+  CREATE(pool, struct mem_pool, 1);
+  pool->name = name;
+  pool->obj_size = POOL_ROUND(MAX(obj_size, sizeof(struct pool_free)));
+
+  pool->next = pool_list;
+  pool_list = pool;
+
+  return (pool);
+}
+
+/** Get a zeroed object from a pool, growing it by a slab if need be.
+ * @param pool The pool to allocate from.
+ * @retval void * The object. */
+void *pool_alloc(struct mem_pool *pool)
+{
+  struct pool_slab *slab;
+  void *obj;
+
+  if (pool->free_list) {
+    obj = pool->free_list;
+    pool->free_list = pool->free_list->next;
+    pool->recycled++;
+  } else {
+    if (pool->fresh_left == 0) {
+      slab = (struct pool_slab *) malloc(POOL_ROUND(sizeof(struct pool_slab)) + pool->obj_size * POOL_SLAB_OBJECTS);
+      if (slab == NULL) {
+        perror("SYSERR: pool_alloc failed");
+        abort();
+      }
+      slab->next = pool->slabs;
+      pool->slabs = slab;
+      pool->num_slabs++;
+      pool->fresh = (char *) slab + POOL_ROUND(sizeof(struct pool_slab));
+      pool->fresh_left = POOL_SLAB_OBJECTS;
+    }
+    obj = pool->fresh;
+    pool->fresh += pool->obj_size;
+    pool->fresh_left--;
+  }
+
+  memset(obj, 0, pool->obj_size);
+
+  pool->allocs++;
+  if (++pool->live > pool->peak)
+    pool->peak = pool->live;
+
+  return (obj);
+}
+
+/** Return an object to the pool it came from.
+ * @param pool The pool obj was allocated from.
+ * @param obj The object; NULL is ignored. */
+void pool_free(struct mem_pool *pool, void *obj)
+{
+  struct pool_free *f = (struct pool_free *) obj;
+
+  if (obj == NULL)
+    return;
+
+  f->next = pool->free_list;
+  pool->free_list = f;
+  pool->live--;
+}
+
+/** Release every pool and all of their slabs. Only safe at shutdown, once
+ * nothing will touch a pooled object again. */
+void free_pools(void)
+{
+  struct mem_pool *pool;
+  struct pool_slab *slab;
+
+  while ((pool = pool_list) != NULL) {
+    pool_list = pool->next;
+    while ((slab = pool->slabs) != NULL) {
+      pool->slabs = slab->next;
+      free(slab);
+    }
+    free(pool);
+  }
+}
+
+/** Print a table of pool statistics.
+ * @param buf Where to print.
+ * @param len Size of buf.
+ * @retval size_t Length of the text printed. */
+size_t print_pool_stats(char *buf, size_t len)
+{
+  struct mem_pool *pool;
+  size_t i = 0;
+  int nlen;
+
+  nlen = snprintf(buf, len, "%-24s %5s %8s %8s %10s %10s %6s\r\n"
+      "------------------------ ----- -------- -------- ---------- ---------- ------\r\n",
+      "Pool", "Size", "Live", "Peak", "Allocs", "Recycled", "Slabs");
+  if (nlen < 0 || (size_t) nlen >= len)
+    return (0);
+  i += nlen;
+
+  for (pool = pool_list; pool; pool = pool->next) {
+    nlen = snprintf(buf + i, len - i, "%-24s %5d %8ld %8ld %10ld %10ld %6ld\r\n",
+        pool->name, (int) pool->obj_size, pool->live, pool->peak,
+        pool->allocs, pool->recycled, pool->num_slabs);
+    if (nlen < 0 || i + nlen >= len)
+      break;
+    i += nlen;
+  }
+
+  return (i);
+}
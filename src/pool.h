@@ -0,0 +1,49 @@
+/**
+* @file pool.h
+* Fixed-size object pools for short lived, frequently allocated structures.
+*
+* Part of the core altMUD source code distribution, which is a derivative
+* of, and continuation of, CircleMUD.
+*
+* All rights reserved.  See license for complete information.
+*/
+#ifndef _POOL_H_
+#define _POOL_H_
+
+/** Number of objects carved out of each slab a pool allocates. */
+#define POOL_SLAB_OBJECTS  256
+
+/** A pool of equally sized objects. Objects are handed out from slabs and
+ * kept on a free list when released, so they are never returned to malloc
+ * until the pools are destroyed at shutdown. */
+struct mem_pool {
+  const char *name;             /**< Shown by 'show pools' */
+  size_t obj_size;              /**< Size of each object, rounded for alignment */
+  struct pool_free *free_list;  /**< Objects released back to the pool */
+  struct pool_slab *slabs;      /**< Every slab this pool owns */
+  char *fresh;                  /**< Next never used object in the newest slab */
+  int fresh_left;               /**< Never used objects left in the newest slab */
+  long num_slabs;               /**< Number of slabs allocated */
+  long live;                    /**< Objects currently handed out */
+  long peak;                    /**< Most objects ever handed out at once */
+  long allocs;                  /**< Total allocations */
+  long recycled;                /**< Allocations satisfied from the free list */
+  struct mem_pool *next;        /**< Next pool in the registry */
+};
+
+/** Allocate a zeroed object of 'type' from 'pool', creating the pool on first
+ * use. Mirrors CREATE(), but for a single object. */
+#define POOL_CREATE(result, pool, type) do {\
+  if (!(pool))\
+    (pool) = pool_create(#type, sizeof(type));\
+  (result) = (type *) pool_alloc(pool);\
+} while(0)
+
+/* Functions in pool.c */
+struct mem_pool *pool_create(const char *name, size_t obj_size);
+void *pool_alloc(struct mem_pool *pool);
+void pool_free(struct mem_pool *pool, void *obj);
+void free_pools(void);
+size_t print_pool_stats(char *buf, size_t len);
+
+#endif /* _POOL_H_ */
@@ -12,6 +12,9 @@
 #endif
 #include <sys/types.h>
 #include "protocol.h"
+#ifdef USING_MCCP
+#include <zlib.h>
+#endif
 
 /******************************************************************************
  The following section is for Diku/Merc derivatives.  Replace as needed.
@@ -40,7 +43,7 @@ static void Write( descriptor_t *apDescriptor, const char *apData )
 {
    if ( apDescriptor != NULL)
    {
-      if ( apDescriptor->pProtocol->WriteOOB > 0 || *(apDescriptor->output) == '\0' )
+      if ( apDescriptor->pProtocol->WriteOOB > 0 || apDescriptor->output.bytes == 0 )
       {
          apDescriptor->pProtocol->WriteOOB = 2;
       }
@@ -59,26 +62,200 @@ static void InfoMessage( descriptor_t *apDescriptor, const char *apData )
    Write( apDescriptor, apData );
 }
 
+#ifdef USING_MCCP
+
+#define MCCP_CHUNK 4096 /* Room added to pMCCPBuf per deflate() call */
+
+/* Appends raw bytes to the queue of output waiting for the socket. */
+static void QueueOutput( protocol_t *apProtocol, const char *apData, int aSize )
+{
+   if ( apProtocol->MCCPBufLen + aSize > apProtocol->MCCPBufSize )
+   {
+      apProtocol->MCCPBufSize = apProtocol->MCCPBufLen + aSize + MCCP_CHUNK;
+      apProtocol->pMCCPBuf = (char *) realloc( apProtocol->pMCCPBuf, apProtocol->MCCPBufSize );
+   }
+   memcpy( apProtocol->pMCCPBuf + apProtocol->MCCPBufLen, apData, aSize );
+   apProtocol->MCCPBufLen += aSize;
+}
+
+/* Runs data through the MCCP2 stream, queueing whatever comes out. */
+static bool_t CompressData( protocol_t *apProtocol, const char *apData, int aSize, int aFlush )
+{
+   z_stream *pZ = apProtocol->pOutZ;
+   int Before = apProtocol->MCCPBufLen;
+
+   pZ->next_in = (Bytef *) apData;
+   pZ->avail_in = aSize;
+
+   do
+   {
+      if ( apProtocol->MCCPBufLen + MCCP_CHUNK > apProtocol->MCCPBufSize )
+      {
+         apProtocol->MCCPBufSize = apProtocol->MCCPBufLen + MCCP_CHUNK * 2;
+         apProtocol->pMCCPBuf = (char *) realloc( apProtocol->pMCCPBuf, apProtocol->MCCPBufSize );
+      }
+      pZ->next_out = (Bytef *) apProtocol->pMCCPBuf + apProtocol->MCCPBufLen;
+      pZ->avail_out = MCCP_CHUNK;
+
+      if ( deflate( pZ, aFlush ) == Z_STREAM_ERROR )
+         return false;
+
+      apProtocol->MCCPBufLen += MCCP_CHUNK - pZ->avail_out;
+   } while ( pZ->avail_out == 0 );
+
+   apProtocol->MCCPRawOut += aSize;
+   apProtocol->MCCPZipOut += apProtocol->MCCPBufLen - Before;
+   return true;
+}
+
+static void DecompressEnd( protocol_t *apProtocol )
+{
+   if ( apProtocol->pInZ != NULL )
+   {
+      inflateEnd( apProtocol->pInZ );
+      free( apProtocol->pInZ );
+      apProtocol->pInZ = NULL;
+   }
+   free( apProtocol->pInflateBuf );
+   apProtocol->pInflateBuf = NULL;
+   apProtocol->InflateBufLen = 0;
+   apProtocol->bInflatePending = false;
+}
+
+#endif /* USING_MCCP */
+
 static void CompressStart( descriptor_t *apDescriptor )
 {
-   /* If your mud uses MCCP (Mud Client Compression Protocol), you need to
-    * call whatever function normally starts compression from here - the
-    * ReportBug() call should then be deleted.
-    *
-    * Otherwise you can just ignore this function.
+#ifdef USING_MCCP
+   static const char StartMCCP[] = { (char)IAC, (char)SB, TELOPT_MCCP, (char)IAC, (char)SE };
+   protocol_t *pProtocol = apDescriptor->pProtocol;
+   z_stream *pZ;
+
+   if ( pProtocol->pOutZ != NULL )
+      return; /* Already compressing */
+
+   pZ = (z_stream *) calloc( 1, sizeof(z_stream) );
+   if ( deflateInit( pZ, Z_DEFAULT_COMPRESSION ) != Z_OK )
+   {
+      ReportBug( "CompressStart: deflateInit() failed, not compressing.\n" );
+      free( pZ );
+      return;
+   }
+
+   /* The marker skips the output buffer, so text already queued there goes
+    * out after it, compressed, and still reaches the client in order.
     */
-   ReportBug( "CompressStart() in protocol.c is being called, but it doesn't do anything!\n" );
+   QueueOutput( pProtocol, StartMCCP, sizeof(StartMCCP) );
+   pProtocol->pOutZ = pZ;
+#endif /* USING_MCCP */
 }
 
 static void CompressEnd( descriptor_t *apDescriptor )
 {
-   /* If your mud uses MCCP (Mud Client Compression Protocol), you need to
-    * call whatever function normally starts compression from here - the
-    * ReportBug() call should then be deleted.
-    *
-    * Otherwise you can just ignore this function.
-    */
-   ReportBug( "CompressEnd() in protocol.c is being called, but it doesn't do anything!\n" );
+#ifdef USING_MCCP
+   protocol_t *pProtocol = apDescriptor->pProtocol;
+
+   if ( pProtocol->pOutZ == NULL )
+      return;
+
+   /* Finish the stream so the client knows to expect plain text again. */
+   if ( !CompressData( pProtocol, "", 0, Z_FINISH ) )
+      ReportBug( "CompressEnd: deflate() failed to finish the stream.\n" );
+   deflateEnd( pProtocol->pOutZ );
+   free( pProtocol->pOutZ );
+   pProtocol->pOutZ = NULL;
+
+   ProtocolFlush( apDescriptor );
+#endif /* USING_MCCP */
+}
+
+int ProtocolWrite( descriptor_t *apDescriptor, const char *apData )
+{
+   struct iovec Iov;
+
+   Iov.iov_base = (char *) apData;
+   Iov.iov_len = strlen(apData);
+
+   return ProtocolWritev( apDescriptor, &Iov, 1 );
+}
+
+int ProtocolWritev( descriptor_t *apDescriptor, struct iovec *apIov, int aCount )
+{
+#ifdef USING_MCCP
+   protocol_t *pProtocol = apDescriptor->pProtocol;
+   int Size = 0, Pending, i;
+
+   if ( pProtocol->pOutZ != NULL || pProtocol->MCCPBufLen > 0 )
+   {
+      /* Whatever is already queued has to reach the client first. */
+      if ( (Pending = ProtocolFlush(apDescriptor)) != 0 )
+         return Pending < 0 ? -1 : 0;
+
+      if ( pProtocol->pOutZ != NULL )
+      {
+         /* One flush for the lot, so the pieces compress as a whole. */
+         for ( i = 0; i < aCount; ++i )
+         {
+            if ( !CompressData( pProtocol, apIov[i].iov_base, apIov[i].iov_len,
+               i == aCount - 1 ? Z_SYNC_FLUSH : Z_NO_FLUSH ) )
+            {
+               ReportBug( "ProtocolWrite: deflate() failed.\n" );
+               return -1;
+            }
+            Size += apIov[i].iov_len;
+         }
+
+         /* The text has been consumed even if some of it is still queued. */
+         return ProtocolFlush(apDescriptor) < 0 ? -1 : Size;
+      }
+   }
+#endif /* USING_MCCP */
+
+   return write_iov_to_descriptor( apDescriptor->descriptor, apIov, aCount );
+}
+
+int ProtocolFlush( descriptor_t *apDescriptor )
+{
+   protocol_t *pProtocol = apDescriptor->pProtocol;
+   int Written;
+
+   if ( pProtocol->MCCPBufLen == 0 )
+      return 0;
+
+   Written = write_bytes_to_descriptor( apDescriptor->descriptor,
+      pProtocol->pMCCPBuf, pProtocol->MCCPBufLen );
+   if ( Written < 0 )
+      return -1;
+
+   pProtocol->MCCPBufLen -= Written;
+   if ( Written > 0 && pProtocol->MCCPBufLen > 0 )
+      memmove( pProtocol->pMCCPBuf, pProtocol->pMCCPBuf + Written, pProtocol->MCCPBufLen );
+
+   return pProtocol->MCCPBufLen;
+}
+
+const char *ProtocolCompressStats( descriptor_t *apDescriptor )
+{
+   static char Buffer[128];
+   protocol_t *pProtocol = apDescriptor ? apDescriptor->pProtocol : NULL;
+   int Length = 0;
+
+   *Buffer = '\0';
+
+   if ( pProtocol == NULL )
+      return Buffer;
+
+   if ( pProtocol->MCCPRawOut > 0 )
+      Length += snprintf( Buffer, sizeof(Buffer), "out %lu->%lu bytes (%lu%% saved)",
+         pProtocol->MCCPRawOut, pProtocol->MCCPZipOut,
+         pProtocol->MCCPZipOut >= pProtocol->MCCPRawOut ? 0 :
+         100 - pProtocol->MCCPZipOut * 100 / pProtocol->MCCPRawOut );
+
+   if ( pProtocol->MCCPRawIn > 0 && Length < (int)sizeof(Buffer) )
+      snprintf( Buffer + Length, sizeof(Buffer) - Length, "%sin %lu->%lu bytes",
+         Length ? ", " : "", pProtocol->MCCPZipIn, pProtocol->MCCPRawIn );
+
+   return Buffer;
 }
 
 /******************************************************************************
@@ -214,6 +391,7 @@ static time_t s_Uptime  = 0;
 static void Negotiate            ( descriptor_t *apDescriptor );
 static void PerformHandshake     ( descriptor_t *apDescriptor, char aCmd, char aProtocol );
 static void PerformSubnegotiation( descriptor_t *apDescriptor, char aCmd, char *apData, int aSize );
+static ssize_t ParseInput         ( descriptor_t *apDescriptor, char *apData, int aSize, char *apOut );
 
 static void ParseMSDP            ( descriptor_t *apDescriptor, const char *apData );
 static void ExecuteMSDPPair      ( descriptor_t *apDescriptor, const char *apVariable, const char *apValue );
@@ -306,12 +484,25 @@ protocol_t *ProtocolCreate( void )
    pProtocol->bMSP = false;
    pProtocol->bMXP = false;
    pProtocol->bMCCP = false;
+   pProtocol->bMCCP3 = false;
    pProtocol->b256Support = eUNKNOWN;
    pProtocol->ScreenWidth = 0;
    pProtocol->ScreenHeight = 0;
    pProtocol->pMXPVersion = AllocString("Unknown");
    pProtocol->pLastTTYPE = NULL;
    pProtocol->pVariables = (MSDP_t **) malloc(sizeof(MSDP_t*)*eMSDP_MAX);
+   pProtocol->pOutZ = NULL;
+   pProtocol->pInZ = NULL;
+   pProtocol->pInflateBuf = NULL;
+   pProtocol->InflateBufLen = 0;
+   pProtocol->bInflatePending = false;
+   pProtocol->pMCCPBuf = NULL;
+   pProtocol->MCCPBufLen = 0;
+   pProtocol->MCCPBufSize = 0;
+   pProtocol->MCCPRawOut = 0;
+   pProtocol->MCCPZipOut = 0;
+   pProtocol->MCCPZipIn = 0;
+   pProtocol->MCCPRawIn = 0;
 
    for ( i = eMSDP_NONE+1; i < eMSDP_MAX; ++i )
    {
@@ -354,10 +545,123 @@ void ProtocolDestroy( protocol_t *apProtocol )
    if (apProtocol->pLastTTYPE) /* Isn't saved over copyover so may still be NULL */
      free(apProtocol->pLastTTYPE);
    free(apProtocol->pMXPVersion);
+#ifdef USING_MCCP
+   if (apProtocol->pOutZ)
+   {
+     deflateEnd(apProtocol->pOutZ);
+     free(apProtocol->pOutZ);
+   }
+   DecompressEnd(apProtocol);
+#endif /* USING_MCCP */
+   if (apProtocol->pMCCPBuf)
+     free(apProtocol->pMCCPBuf);
    free(apProtocol);
 }
 
+#ifdef USING_MCCP
+/* Inflates MCCP3 input from the client and parses the result.  If the client
+ * ends its stream part way through, the rest of the data is plain telnet.
+ * Input that would inflate past the space left in apOut is held back, and
+ * goes in ahead of apData on the next call.
+ */
+static ssize_t DecompressInput( descriptor_t *apDescriptor, char *apData, int aSize, char *apOut )
+{
+   static char Buffer[MAX_PROTOCOL_BUFFER+1];
+   protocol_t *pProtocol = apDescriptor->pProtocol;
+   z_stream *pZ = pProtocol->pInZ;
+   int Space = MAX_PROTOCOL_BUFFER - 1 - strlen(apOut);
+   int Length, Used, Result;
+   ssize_t Parsed, Rest;
+   char *pHeld = NULL;
+
+   if ( Space <= 0 )
+   {
+      ReportBug("ProtocolInput: Too much incoming data to store in the buffer.\n");
+      return (-1);
+   }
+
+   if ( pProtocol->InflateBufLen > 0 )
+   {
+      pHeld = (char *) malloc( pProtocol->InflateBufLen + aSize );
+      memcpy( pHeld, pProtocol->pInflateBuf, pProtocol->InflateBufLen );
+      memcpy( pHeld + pProtocol->InflateBufLen, apData, aSize );
+      aSize += pProtocol->InflateBufLen;
+      apData = pHeld;
+      free( pProtocol->pInflateBuf );
+      pProtocol->pInflateBuf = NULL;
+      pProtocol->InflateBufLen = 0;
+   }
+
+   pZ->next_in = (Bytef *) apData;
+   pZ->avail_in = aSize;
+   pZ->next_out = (Bytef *) Buffer;
+   pZ->avail_out = Space;
+
+   Result = inflate( pZ, Z_SYNC_FLUSH );
+   if ( Result != Z_OK && Result != Z_STREAM_END && Result != Z_BUF_ERROR )
+   {
+      ReportBug("ProtocolInput: MCCP3 input stream is corrupt.\n");
+      free( pHeld );
+      return (-1);
+   }
+
+   Length = Space - pZ->avail_out;
+   Used = aSize - pZ->avail_in;
+   Buffer[Length] = '\0';
+   pProtocol->MCCPZipIn += Used;
+   pProtocol->MCCPRawIn += Length;
+
+   /* The input buffer is full.  Whatever inflate() hasn't given us yet,
+    * whether still compressed or inside zlib, waits until the game has taken
+    * some lines out of it. */
+   if ( Result != Z_STREAM_END && pZ->avail_out == 0 )
+   {
+      pProtocol->bInflatePending = true;
+      if ( pZ->avail_in > 0 )
+      {
+         pProtocol->pInflateBuf = (char *) malloc( pZ->avail_in );
+         memcpy( pProtocol->pInflateBuf, pZ->next_in, pZ->avail_in );
+         pProtocol->InflateBufLen = pZ->avail_in;
+      }
+   }
+   else
+      pProtocol->bInflatePending = false;
+
+   if ( (Parsed = ParseInput( apDescriptor, Buffer, Length, apOut )) >= 0 && Result == Z_STREAM_END )
+   {
+      DecompressEnd( pProtocol );
+      if ( Used < aSize )
+      {
+         Rest = ParseInput( apDescriptor, apData + Used, aSize - Used, apOut );
+         Parsed = ( Rest < 0 ? -1 : Parsed + Rest );
+      }
+   }
+
+   free( pHeld );
+   return (Parsed);
+}
+#endif /* USING_MCCP */
+
 ssize_t ProtocolInput( descriptor_t *apDescriptor, char *apData, int aSize, char *apOut )
+{
+#ifdef USING_MCCP
+   if ( apDescriptor != NULL && apDescriptor->pProtocol->pInZ != NULL )
+      return DecompressInput( apDescriptor, apData, aSize, apOut );
+#endif /* USING_MCCP */
+
+   return ParseInput( apDescriptor, apData, aSize, apOut );
+}
+
+bool_t ProtocolInputPending( descriptor_t *apDescriptor )
+{
+#ifdef USING_MCCP
+   return ( apDescriptor->pProtocol != NULL && apDescriptor->pProtocol->bInflatePending );
+#else
+   return false;
+#endif /* USING_MCCP */
+}
+
+static ssize_t ParseInput( descriptor_t *apDescriptor, char *apData, int aSize, char *apOut )
 {
    static char CmdBuf[MAX_PROTOCOL_BUFFER+1];
    static char IacBuf[MAX_PROTOCOL_BUFFER+1];
@@ -393,6 +697,30 @@ ssize_t ProtocolInput( descriptor_t *apDescriptor, char *apData, int aSize, char
             Index++;
             pProtocol->bIACMode = false;
             IacBuf[IacIndex] = '\0';
+#ifdef USING_MCCP
+            if ( IacIndex == 1 && IacBuf[0] == (char)TELOPT_MCCP3 &&
+               pProtocol->bMCCP3 && pProtocol->pInZ == NULL )
+            {
+               ssize_t Rest;
+
+               /* Everything the client sends from here on is compressed. */
+               pProtocol->pInZ = (z_stream *) calloc( 1, sizeof(z_stream) );
+               if ( inflateInit( pProtocol->pInZ ) != Z_OK )
+               {
+                  ReportBug("ProtocolInput: inflateInit() failed for MCCP3.\n");
+                  free( pProtocol->pInZ );
+                  pProtocol->pInZ = NULL;
+                  return (-1);
+               }
+
+               CmdBuf[CmdIndex] = '\0';
+               strcat( apOut, CmdBuf );
+               if ( Index + 1 >= aSize )
+                  return (CmdIndex);
+               Rest = ProtocolInput( apDescriptor, &apData[Index+1], aSize-Index-1, apOut );
+               return ( Rest < 0 ? -1 : CmdIndex + Rest );
+            }
+#endif /* USING_MCCP */
             if ( IacIndex >= 2 )
                PerformSubnegotiation( apDescriptor, IacBuf[0], &IacBuf[1], IacIndex-1 );
             IacIndex = 0;
@@ -863,6 +1191,37 @@ const char *ProtocolOutput( descriptor_t *apDescriptor, const char *apData, int
    return Result;
 }
 
+unsigned long ProtocolOutputKey( descriptor_t *apDescriptor )
+{
+   protocol_t *pProtocol = apDescriptor ? apDescriptor->pProtocol : NULL;
+   unsigned long Key = 1, Hash = 2166136261UL;
+   const char *pVersion;
+
+   if ( pProtocol == NULL )
+      return 0;
+
+   /* Everything ProtocolOutput() and ColourRGB() look at */
+   if ( pProtocol->pVariables[eMSDP_ANSI_COLORS]->ValueInt &&
+      (!apDescriptor->character || clr(apDescriptor->character, C_CMP)) )
+      Key |= 1 << 1;
+   if ( pProtocol->pVariables[eMSDP_XTERM_256_COLORS]->ValueInt )
+      Key |= 1 << 2;
+   if ( pProtocol->pVariables[eMSDP_MXP]->ValueInt )
+      Key |= 1 << 3;
+   if ( pProtocol->bBlockMXP )
+      Key |= 1 << 4;
+   if ( pProtocol->pVariables[eMSDP_UTF_8]->ValueInt )
+      Key |= 1 << 5;
+   if ( pProtocol->bMSP || pProtocol->pVariables[eMSDP_SOUND]->ValueInt )
+      Key |= 1 << 6;
+
+   /* The MXP version only matters to \t[x tags, which are rare; hash it. */
+   for ( pVersion = pProtocol->pMXPVersion; pVersion && *pVersion; ++pVersion )
+      Hash = (Hash ^ (unsigned char)*pVersion) * 16777619UL;
+
+   return Key | (Hash << 7);
+}
+
 /* Some clients (such as GMud) don't properly handle negotiation, and simply
  * display every printable character to the screen.  However TTYPE isn't a
  * printable character, so we negotiate for it first, and only negotiate for
@@ -910,6 +1269,20 @@ const char *CopyoverGet( descriptor_t *apDescriptor )
          *pBuffer++ = 'c';
          CompressEnd(apDescriptor);
       }
+#ifdef USING_MCCP
+      if ( pProtocol->bMCCP3 )
+      {
+         /* The inflate state can't be carried across the exec, so ask the
+          * client to finish its stream now and offer MCCP3 again afterwards.
+          */
+         static const char WontMCCP3[] = { (char)IAC, (char)WONT, TELOPT_MCCP3, '\0' };
+
+         *pBuffer++ = 'z';
+         ProtocolWrite(apDescriptor, WontMCCP3);
+         DecompressEnd(pProtocol);
+         pProtocol->bMCCP3 = false;
+      }
+#endif /* USING_MCCP */
       if ( pProtocol->pVariables[eMSDP_XTERM_256_COLORS]->ValueInt )
          *pBuffer++ = 'C';
       if ( pProtocol->bCHARSET )
@@ -961,6 +1334,14 @@ void CopyoverSet( descriptor_t *apDescriptor, const char *apData )
                pProtocol->bMCCP = true;
                CompressStart(apDescriptor);
                break;
+#ifdef USING_MCCP
+            case 'z':
+            {
+               static const char WillMCCP3[] = { (char)IAC, (char)WILL, TELOPT_MCCP3, '\0' };
+               Write(apDescriptor, WillMCCP3);
+               break;
+            }
+#endif /* USING_MCCP */
             case 'C':
                pProtocol->pVariables[eMSDP_XTERM_256_COLORS]->ValueInt = 1;
                break;
@@ -1502,6 +1883,7 @@ static void Negotiate( descriptor_t *apDescriptor )
 
 #ifdef USING_MCCP
       const char WillMCCP       [] = { (char)IAC, (char)WILL, TELOPT_MCCP,      '\0' };
+      const char WillMCCP3      [] = { (char)IAC, (char)WILL, TELOPT_MCCP3,     '\0' };
 #endif // USING_MCCP
 
       /* Request the client type if TTYPE is supported. */
@@ -1528,6 +1910,7 @@ static void Negotiate( descriptor_t *apDescriptor )
 
 #ifdef USING_MCCP
       Write(apDescriptor, WillMCCP);
+      Write(apDescriptor, WillMCCP3);
 #endif // USING_MCCP
    }
 }
@@ -1614,6 +1997,14 @@ static void PerformHandshake( descriptor_t *apDescriptor, char aCmd, char aProto
          }
          break;
 
+      case (char)TELOPT_MCCP3:
+         /* The client starts compressing with IAC SB MCCP3 IAC SE. */
+         if ( aCmd == (char)DO )
+            pProtocol->bMCCP3 = true;
+         else if ( aCmd == (char)DONT )
+            pProtocol->bMCCP3 = false;
+         break;
+
       case (char)TELOPT_MSP:
          if ( aCmd == (char)DO )
             pProtocol->bMSP = true;
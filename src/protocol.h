@@ -12,15 +12,21 @@
 #define MUD_NAME "altMUD"
 
 typedef struct descriptor_data descriptor_t;
+struct iovec;
 
 /******************************************************************************
- If your mud supports MCCP (compression), uncomment the next line.
+ If your mud supports MCCP (compression), uncomment the next line.  It is
+ switched on automatically when configure finds zlib.
  ******************************************************************************/
 
 /*
 #define USING_MCCP
 */
 
+#if defined(HAVE_ZLIB) && !defined(USING_MCCP)
+#define USING_MCCP
+#endif
+
 /******************************************************************************
  If your offer a Mudlet GUI for autoinstallation, put the path/filename here.
  ******************************************************************************/
@@ -37,7 +43,7 @@ typedef struct descriptor_data descriptor_t;
 
 #define MAX_PROTOCOL_BUFFER            MAX_RAW_INPUT_LENGTH
 #define MAX_VARIABLE_LENGTH            4096
-#define MAX_OUTPUT_BUFFER              LARGE_BUFSIZE
+#define MAX_OUTPUT_BUFFER              MAX_STRING_LENGTH
 #define MAX_MSSP_BUFFER                4096
 
 #define SEND                           1
@@ -48,6 +54,7 @@ typedef struct descriptor_data descriptor_t;
 #define TELOPT_MSDP                    69
 #define TELOPT_MSSP                    70
 #define TELOPT_MCCP                    86 /* This is MCCP version 2 */
+#define TELOPT_MCCP3                   87 /* Compression of client input */
 #define TELOPT_MSP                     90
 #define TELOPT_MXP                     91
 #define TELOPT_ATCP                    200
@@ -211,12 +218,25 @@ typedef struct
    bool_t    bMSP;             /* The client supports MSP */
    bool_t    bMXP;             /* The client supports MXP */
    bool_t    bMCCP;            /* The client supports MCCP */
+   bool_t    bMCCP3;           /* The client supports MCCP3 */
    support_t b256Support;      /* The client supports XTerm 256 colors */
    int       ScreenWidth;      /* The client's screen width */
    int       ScreenHeight;     /* The client's screen height */
    char     *pMXPVersion;      /* The version of MXP supported */
    char     *pLastTTYPE;       /* Used for the cyclic TTYPE check */
    MSDP_t  **pVariables;       /* The MSDP variables */
+   struct z_stream_s *pOutZ;   /* MCCP2 output stream, if compressing */
+   struct z_stream_s *pInZ;    /* MCCP3 input stream, if decompressing */
+   char     *pInflateBuf;      /* Compressed input that didn't fit yet */
+   int       InflateBufLen;    /* Bytes waiting in pInflateBuf */
+   bool_t    bInflatePending;  /* inflate() has more input to give */
+   char     *pMCCPBuf;         /* Compressed output the socket hasn't taken */
+   int       MCCPBufLen;       /* Bytes waiting in pMCCPBuf */
+   int       MCCPBufSize;      /* Allocated size of pMCCPBuf */
+   unsigned long MCCPRawOut;   /* Output bytes before compression */
+   unsigned long MCCPZipOut;   /* Output bytes after compression */
+   unsigned long MCCPZipIn;    /* Input bytes before decompression */
+   unsigned long MCCPRawIn;    /* Input bytes after decompression */
 } protocol_t;
 
 /******************************************************************************
@@ -261,6 +281,14 @@ extern const char * RGBthree;
 
 ssize_t ProtocolInput( descriptor_t *apDescriptor, char *apData, int aSize, char *apOut );
 
+/* Function: ProtocolInputPending
+ *
+ * Returns true if MCCP3 input is still waiting to be inflated because the
+ * input buffer filled up.  Once there is room again, call ProtocolInput()
+ * with no new data to carry on; don't read the socket until this is false.
+ */
+bool_t ProtocolInputPending( descriptor_t *apDescriptor );
+
 /* Function: ProtocolOutput
  *
  * This function takes a string, applies colour codes to it, and returns the
@@ -322,6 +350,51 @@ ssize_t ProtocolInput( descriptor_t *apDescriptor, char *apData, int aSize, char
  */
 const char *ProtocolOutput( descriptor_t *apDescriptor, const char *apData, int *apLength );
 
+/* Function: ProtocolOutputKey
+ *
+ * Returns a key that is the same for two descriptors only if ProtocolOutput()
+ * would turn any text into the same thing for both of them, so text sent to
+ * many players at once need only go through ProtocolOutput() once per key.
+ *
+ * Text with no tab and no "!!" in it comes out of ProtocolOutput() as it went
+ * in, whatever the key, unless it is too long for the output buffer.
+ */
+unsigned long ProtocolOutputKey( descriptor_t *apDescriptor );
+
+/* Function: ProtocolWrite
+ *
+ * Sends text to the client, through the MCCP stream if compression has been
+ * negotiated.  Use this instead of write_to_descriptor() whenever you have a
+ * descriptor, or compressed and uncompressed data will get mixed up.
+ *
+ * Returns -1 on a fatal error, 0 if the socket couldn't take anything, or the
+ * number of characters of the text that were consumed.  Compressed bytes the
+ * socket won't take yet are kept, and go out ahead of the next write.
+ */
+int ProtocolWrite( descriptor_t *apDescriptor, const char *apData );
+
+/* Function: ProtocolWritev
+ *
+ * The same as ProtocolWrite(), but for text gathered from several buffers,
+ * which are sent with a single writev() when possible.  The iovec array may
+ * be changed.
+ */
+int ProtocolWritev( descriptor_t *apDescriptor, struct iovec *apIov, int aCount );
+
+/* Function: ProtocolFlush
+ *
+ * Tries to send compressed output left over from an earlier ProtocolWrite().
+ * Returns -1 on a fatal error, otherwise the number of bytes still waiting.
+ */
+int ProtocolFlush( descriptor_t *apDescriptor );
+
+/* Function: ProtocolCompressStats
+ *
+ * Returns a one-line summary of how much MCCP has saved for this descriptor,
+ * or an empty string if it has never compressed anything.
+ */
+const char *ProtocolCompressStats( descriptor_t *apDescriptor );
+
 /******************************************************************************
  Copyover save/load functions.
  ******************************************************************************/
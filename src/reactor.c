@@ -0,0 +1,475 @@
+/**
+* @file reactor.c
+* Descriptor readiness tracking for the main game loop.
+*
+* Part of the core altMUD source code distribution, which is a derivative
+* of, and continuation of, CircleMUD.
+*
+* All rights reserved.  See license for complete information.
+*
+* game_loop() used to rebuild three fd_sets from the whole descriptor_list
+* every pass and then walk the list once per stage.  The reactor keeps the
+* sockets registered with the kernel instead (epoll on Linux, poll(2) on other
+* UNIX systems, select(2) everywhere else) and hands the game loop an "active
+* set": only descriptors that became ready, or that still have queued input,
+* pending output, a wait state or a missing prompt, are visited in a pass.
+*/
+
+#include "conf.h"
+#include "sysdep.h"
+#include "structs.h"
+#include "utils.h"
+#include "reactor.h"
+
+#ifndef INVALID_SOCKET
+#define INVALID_SOCKET (-1)
+#endif
+
+/* file scope variables */
+static socket_t reactor_mother = INVALID_SOCKET; /**< listening socket */
+static int num_registered = 0;       /**< descriptors known to the backend */
+static struct descriptor_data **active = NULL; /**< descriptors with work */
+static int num_active = 0;           /**< used slots in active[] */
+static int max_active = 0;           /**< allocated slots in active[] */
+
+/* Convert a select() style timeout to poll()/epoll_wait() milliseconds. */
+static int timeout_ms(struct timeval *timeout)
+{
+  if (timeout == NULL)
+    return (-1);
+
+  return (timeout->tv_sec * 1000 + (timeout->tv_usec + 999) / 1000);
+}
+
+/** Mark a descriptor's readiness and put it in the active set. */
+static void mark_ready(struct descriptor_data *d, int bits)
+{
+  d->ready |= bits;
+  reactor_wake(d);
+}
+
+#if defined(CIRCLE_REACTOR_EPOLL)
+/***************************************************************************
+ * epoll(7) backend: the kernel only reports descriptors that are ready.
+ **************************************************************************/
+static int epoll_fd = -1;
+static struct epoll_event *ep_events = NULL;
+static int max_ep_events = 0;
+
+static void backend_init(void)
+{
+  struct epoll_event ev;
+
+  if ((epoll_fd = epoll_create1(EPOLL_CLOEXEC)) < 0) {
+    perror("SYSERR: epoll_create1");
+    exit(1);
+  }
+
+  max_ep_events = 64;
+  CREATE(ep_events, struct epoll_event, max_ep_events);
+
+  memset(&ev, 0, sizeof(ev));
+  ev.events = EPOLLIN;
+  ev.data.ptr = NULL;  /* NULL marks the mother descriptor */
+  if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, reactor_mother, &ev) < 0) {
+    perror("SYSERR: epoll_ctl (mother)");
+    exit(1);
+  }
+}
+
+static void backend_destroy(void)
+{
+  if (epoll_fd >= 0)
+    close(epoll_fd);
+  epoll_fd = -1;
+
+  if (ep_events)
+    free(ep_events);
+  ep_events = NULL;
+  max_ep_events = 0;
+}
+
+static int backend_add(struct descriptor_data *d)
+{
+  struct epoll_event ev;
+
+  memset(&ev, 0, sizeof(ev));
+  ev.events = EPOLLIN | EPOLLPRI;
+  ev.data.ptr = d;
+  if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, d->descriptor, &ev) < 0) {
+    perror("SYSERR: epoll_ctl (add)");
+    return (-1);
+  }
+
+  /* Make sure a single epoll_wait() can report every socket at once. */
+  if (num_registered + 2 > max_ep_events) {
+    max_ep_events *= 2;
+    RECREATE(ep_events, struct epoll_event, max_ep_events);
+  }
+  d->reactor_slot = 0;
+  return (0);
+}
+
+static void backend_remove(struct descriptor_data *d)
+{
+  struct epoll_event ev;  /* pre-2.6.9 kernels want a non-NULL event */
+
+  if (epoll_ctl(epoll_fd, EPOLL_CTL_DEL, d->descriptor, &ev) < 0)
+    perror("SYSERR: epoll_ctl (del)");
+}
+
+static void backend_want_write(struct descriptor_data *d, bool want)
+{
+  struct epoll_event ev;
+
+  memset(&ev, 0, sizeof(ev));
+  ev.events = EPOLLIN | EPOLLPRI | (want ? EPOLLOUT : 0);
+  ev.data.ptr = d;
+  if (epoll_ctl(epoll_fd, EPOLL_CTL_MOD, d->descriptor, &ev) < 0)
+    perror("SYSERR: epoll_ctl (mod)");
+}
+
+static int backend_poll(struct timeval *timeout, bool *mother_ready)
+{
+  struct descriptor_data *d;
+  int i, n, bits;
+
+  if ((n = epoll_wait(epoll_fd, ep_events, max_ep_events, timeout_ms(timeout))) < 0)
+    return (-1);
+
+  for (i = 0; i < n; i++) {
+    if ((d = (struct descriptor_data *) ep_events[i].data.ptr) == NULL) {
+      *mother_ready = TRUE;
+      continue;
+    }
+    bits = 0;
+    /* A hangup is reported as input so process_input() sees the EOF. */
+    if (ep_events[i].events & (EPOLLIN | EPOLLHUP))
+      bits |= RDY_READ;
+    if (ep_events[i].events & EPOLLOUT)
+      bits |= RDY_WRITE;
+    if (ep_events[i].events & (EPOLLPRI | EPOLLERR))
+      bits |= RDY_EXCEPT;
+    mark_ready(d, bits);
+  }
+  return (n);
+}
+
+#else
+/***************************************************************************
+ * poll(2) and select(2) backends: a compact array of registered sockets,
+ * slot 0 being the mother descriptor.
+ **************************************************************************/
+#if defined(CIRCLE_REACTOR_POLL)
+typedef struct pollfd reactor_fd;
+# define RF_IN   POLLIN
+# define RF_OUT  POLLOUT
+# define RF_PRI  POLLPRI
+# define RF_ERR  (POLLERR | POLLNVAL)
+# define RF_HUP  POLLHUP
+#else
+typedef struct {
+  socket_t fd;
+  short events;
+  short revents;
+} reactor_fd;
+# define RF_IN   (1 << 0)
+# define RF_OUT  (1 << 1)
+# define RF_PRI  (1 << 2)
+# define RF_ERR  0
+# define RF_HUP  0
+#endif
+
+static reactor_fd *fds = NULL;
+static struct descriptor_data **fd_descs = NULL;
+static int num_fds = 0, max_fds = 0;
+
+static void backend_init(void)
+{
+  max_fds = 64;
+  CREATE(fds, reactor_fd, max_fds);
+  CREATE(fd_descs, struct descriptor_data *, max_fds);
+
+  fds[0].fd = reactor_mother;
+  fds[0].events = RF_IN;
+  fd_descs[0] = NULL;
+  num_fds = 1;
+}
+
+static void backend_destroy(void)
+{
+  if (fds)
+    free(fds);
+  if (fd_descs)
+    free(fd_descs);
+  fds = NULL;
+  fd_descs = NULL;
+  num_fds = max_fds = 0;
+}
+
+static int backend_add(struct descriptor_data *d)
+{
+#if !defined(CIRCLE_REACTOR_POLL) && !defined(CIRCLE_WINDOWS)
+  if (d->descriptor >= FD_SETSIZE) {
+    log("SYSERR: descriptor %d exceeds FD_SETSIZE (%d).", (int) d->descriptor, FD_SETSIZE);
+    return (-1);
+  }
+#endif
+
+  if (num_fds == max_fds) {
+    max_fds *= 2;
+    RECREATE(fds, reactor_fd, max_fds);
+    RECREATE(fd_descs, struct descriptor_data *, max_fds);
+  }
+
+  fds[num_fds].fd = d->descriptor;
+  fds[num_fds].events = RF_IN | RF_PRI;
+  fds[num_fds].revents = 0;
+  fd_descs[num_fds] = d;
+  d->reactor_slot = num_fds++;
+  return (0);
+}
+
+static void backend_remove(struct descriptor_data *d)
+{
+  int slot = d->reactor_slot, last = num_fds - 1;
+
+  /* Move the last socket into the hole to keep the array compact. */
+  if (slot != last) {
+    fds[slot] = fds[last];
+    fd_descs[slot] = fd_descs[last];
+    fd_descs[slot]->reactor_slot = slot;
+  }
+  num_fds--;
+}
+
+static void backend_want_write(struct descriptor_data *d, bool want)
+{
+  if (want)
+    fds[d->reactor_slot].events |= RF_OUT;
+  else
+    fds[d->reactor_slot].events &= ~RF_OUT;
+}
+
+#if defined(CIRCLE_REACTOR_POLL)
+static int backend_wait(struct timeval *timeout)
+{
+  return (poll(fds, num_fds, timeout_ms(timeout)));
+}
+#else
+static int backend_wait(struct timeval *timeout)
+{
+  fd_set input_set, output_set, exc_set;
+  socket_t maxdesc = 0;
+  int i, n;
+
+  FD_ZERO(&input_set);
+  FD_ZERO(&output_set);
+  FD_ZERO(&exc_set);
+
+  for (i = 0; i < num_fds; i++) {
+#ifndef CIRCLE_WINDOWS
+    if (fds[i].fd > maxdesc)
+      maxdesc = fds[i].fd;
+#endif
+    FD_SET(fds[i].fd, &input_set);
+    if (fds[i].events & RF_PRI)
+      FD_SET(fds[i].fd, &exc_set);
+    if (fds[i].events & RF_OUT)
+      FD_SET(fds[i].fd, &output_set);
+  }
+
+  if ((n = select(maxdesc + 1, &input_set, &output_set, &exc_set, timeout)) <= 0)
+    return (n);
+
+  for (i = 0; i < num_fds; i++) {
+    fds[i].revents = 0;
+    if (FD_ISSET(fds[i].fd, &input_set))
+      fds[i].revents |= RF_IN;
+    if (FD_ISSET(fds[i].fd, &output_set))
+      fds[i].revents |= RF_OUT;
+    if (FD_ISSET(fds[i].fd, &exc_set))
+      fds[i].revents |= RF_PRI;
+  }
+  return (n);
+}
+#endif
+
+static int backend_poll(struct timeval *timeout, bool *mother_ready)
+{
+  int i, n, bits;
+
+  if ((n = backend_wait(timeout)) <= 0)
+    return (n);
+
+  if (fds[0].revents & RF_IN)
+    *mother_ready = TRUE;
+
+  for (i = 1; i < num_fds; i++) {
+    if (!fds[i].revents)
+      continue;
+    bits = 0;
+    if (fds[i].revents & (RF_IN | RF_HUP))
+      bits |= RDY_READ;
+    if (fds[i].revents & RF_OUT)
+      bits |= RDY_WRITE;
+    if (fds[i].revents & (RF_PRI | RF_ERR))
+      bits |= RDY_EXCEPT;
+    fds[i].revents = 0;
+    mark_ready(fd_descs[i], bits);
+  }
+  return (n);
+}
+#endif /* CIRCLE_REACTOR_EPOLL */
+
+/***************************************************************************
+ * Public interface
+ **************************************************************************/
+/** Set up the reactor and register the mother (listening) descriptor.
+ * @param mother The socket new connections are accepted from. */
+void reactor_init(socket_t mother)
+{
+  reactor_mother = mother;
+  num_registered = 0;
+  backend_init();
+  log("Descriptor reactor using %s.", reactor_backend());
+}
+
+/** Release everything held by the reactor. */
+void reactor_destroy(void)
+{
+  backend_destroy();
+  if (active)
+    free(active);
+  active = NULL;
+  num_active = max_active = 0;
+}
+
+/** Register a freshly initialized descriptor for readiness notification.
+ * @param d The descriptor to watch.
+ * @retval int 0 on success, -1 if the backend refused the socket. */
+int reactor_add(struct descriptor_data *d)
+{
+  d->ready = 0;
+  d->active_slot = 0;
+  d->want_write = FALSE;
+  d->reactor_slot = -1;
+
+  if (backend_add(d) < 0)
+    return (-1);
+
+  num_registered++;
+  /* New descriptors owe their greeting, so start them off active. */
+  reactor_wake(d);
+  return (0);
+}
+
+/** Forget a descriptor; must be called before its socket is closed.
+ * @param d The descriptor to unregister. */
+void reactor_remove(struct descriptor_data *d)
+{
+  if (d->active_slot) {
+    active[d->active_slot - 1] = NULL;
+    d->active_slot = 0;
+  }
+
+  if (d->reactor_slot < 0)
+    return;
+
+  backend_remove(d);
+  d->reactor_slot = -1;
+  num_registered--;
+}
+
+/** Ask to be told when a descriptor's send buffer drains.
+ * @param d The descriptor whose output is blocked (or unblocked).
+ * @param want TRUE to watch for writability, FALSE to stop. */
+void reactor_want_write(struct descriptor_data *d, bool want)
+{
+  if (d->reactor_slot < 0 || d->want_write == want)
+    return;
+
+  d->want_write = want;
+  backend_want_write(d, want);
+}
+
+/** Wait for readiness on any registered socket.  Ready descriptors get their
+ * RDY_x bits set and are added to the active set.
+ * @param timeout How long to wait; NULL blocks, a zeroed timeval polls.
+ * @param mother_ready Set TRUE if a new connection is waiting.
+ * @retval int Number of ready sockets, or -1 on error (errno is kept). */
+int reactor_poll(struct timeval *timeout, bool *mother_ready)
+{
+  *mother_ready = FALSE;
+  return (backend_poll(timeout, mother_ready));
+}
+
+/** Put a descriptor in this pass's active set, if it is not there already.
+ * Anything that gives a descriptor work outside of its own input (output,
+ * wait states, being disconnected) should wake it.
+ * @param d The descriptor to visit. */
+void reactor_wake(struct descriptor_data *d)
+{
+  if (!d || d->active_slot || d->reactor_slot < 0)
+    return;
+
+  if (num_active == max_active) {
+    max_active = MAX(32, max_active * 2);
+    RECREATE(active, struct descriptor_data *, max_active);
+  }
+  active[num_active++] = d;
+  d->active_slot = num_active;
+}
+
+/** @retval int The number of slots in the active set, some may be NULL. */
+int reactor_active_count(void)
+{
+  return (num_active);
+}
+
+/** @param i Index into the active set.
+ * @retval descriptor_data * The descriptor, or NULL if it has been removed. */
+struct descriptor_data *reactor_active(int i)
+{
+  return (active[i]);
+}
+
+/** End of a game loop pass: clear readiness and drop idle descriptors from
+ * the active set.
+ * @param has_work Returns non-zero if the descriptor must be visited again
+ * next pass even without new readiness. */
+void reactor_settle(int (*has_work)(struct descriptor_data *d))
+{
+  struct descriptor_data *d;
+  int i, j;
+
+  for (i = j = 0; i < num_active; i++) {
+    if ((d = active[i]) == NULL)
+      continue;
+    d->ready = 0;
+    if (has_work(d)) {
+      active[j++] = d;
+      d->active_slot = j;
+    } else
+      d->active_slot = 0;
+  }
+  num_active = j;
+}
+
+/** @retval int The number of registered descriptors. */
+int reactor_count(void)
+{
+  return (num_registered);
+}
+
+/** @retval char * Name of the compiled in readiness backend. */
+const char *reactor_backend(void)
+{
+#if defined(CIRCLE_REACTOR_EPOLL)
+  return "epoll";
+#elif defined(CIRCLE_REACTOR_POLL)
+  return "poll";
+#else
+  return "select";
+#endif
+}
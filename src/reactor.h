@@ -0,0 +1,32 @@
+/**
+* @file reactor.h
+* Descriptor readiness tracking for the main game loop.
+*
+* Part of the core altMUD source code distribution, which is a derivative
+* of, and continuation of, CircleMUD.
+*
+* All rights reserved.  See license for complete information.
+*/
+#ifndef _REACTOR_H_
+#define _REACTOR_H_
+
+/* Readiness bits stored in descriptor_data.ready after reactor_poll(). */
+#define RDY_READ      (1 << 0)  /**< Input (or EOF) is waiting to be read. */
+#define RDY_WRITE     (1 << 1)  /**< Kernel send buffer has room again. */
+#define RDY_EXCEPT    (1 << 2)  /**< Out of band data or socket error. */
+
+/* Functions in reactor.c */
+void reactor_init(socket_t mother);
+void reactor_destroy(void);
+int  reactor_add(struct descriptor_data *d);
+void reactor_remove(struct descriptor_data *d);
+void reactor_want_write(struct descriptor_data *d, bool want);
+int  reactor_poll(struct timeval *timeout, bool *mother_ready);
+void reactor_wake(struct descriptor_data *d);
+int  reactor_active_count(void);
+struct descriptor_data *reactor_active(int i);
+void reactor_settle(int (*has_work)(struct descriptor_data *d));
+int  reactor_count(void);
+const char *reactor_backend(void);
+
+#endif /* _REACTOR_H_ */
@@ -0,0 +1,493 @@
+/**
+* @file resolver.c
+* Host name lookups for new connections, off the game loop.
+*
+* Part of the core altMUD source code distribution, which is a derivative
+* of, and continuation of, CircleMUD.
+*
+* All rights reserved.  See license for complete information.
+*
+* new_descriptor() used to call gethostbyaddr() itself, so a slow or dead
+* name server stopped the whole game for as long as it took to give up, once
+* for every new connection.  Now a connection starts out with its numeric
+* address as d->host and resolver_lookup() hands the address to a small pool
+* of threads.  resolver_pulse() picks up their answers every pulse, gives
+* each waiting descriptor its name, and redoes the site ban and 'recent'
+* bookkeeping that was done against the number in the meantime.
+*
+* Answers, including "no name", are cached by address for a while, and an
+* address already being looked up is not looked up twice.
+*
+* Without threads (see CIRCLE_RESOLVER_THREAD in sysdep.h) the lookup is
+* still made from the game loop, but through the cache.
+*/
+
+#include "conf.h"
+#include "sysdep.h"
+#include "structs.h"
+#include "utils.h"
+#include "comm.h"
+#include "db.h"
+#include "ban.h"
+#include "act.h"
+#include "resolver.h"
+#include "reactor.h"
+
+#ifdef CIRCLE_RESOLVER_THREAD
+#include <pthread.h>
+#endif
+
+#define HOST_HASH_SIZE   256    /**< Buckets in the cache */
+#define HOST_PENDING     0      /**< Being looked up */
+#define HOST_FOUND       1      /**< name is good until expires */
+#define HOST_UNKNOWN     2      /**< No name until expires */
+
+/** What is known about one address.  Only the game loop uses the cache. */
+struct host_entry {
+  struct in_addr addr;
+  char name[HOST_LENGTH + 1];
+  int state;                    /**< HOST_x */
+  time_t expires;
+  struct host_entry *next;      /**< Next in the same bucket */
+};
+
+/** An address for the resolver threads, and what they found. */
+struct resolve_job {
+  struct in_addr addr;
+  char name[HOST_LENGTH + 1];
+  int found;
+  struct resolve_job *next;
+};
+
+/** Counters for 'show resolver'.  Times are in microseconds. */
+static struct {
+  unsigned long lookups;        /**< Connections that wanted a name */
+  unsigned long hits;           /**< Answered from the cache */
+  unsigned long shared;         /**< Waited on a lookup already going */
+  unsigned long resolved;       /**< Lookups that found a name */
+  unsigned long failed;         /**< Lookups that found none */
+  unsigned long usec;           /**< Time spent in lookups */
+  unsigned long max_usec;
+  unsigned long late;           /**< Names given to descriptors after connecting */
+  unsigned long denied;         /**< Connections closed once the name was known */
+  int entries;                  /**< Addresses in the cache */
+  int pending;                  /**< Lookups not back yet */
+  int peak_pending;
+} stats;
+
+static struct host_entry *host_cache[HOST_HASH_SIZE];
+static resolver_backend backend = NULL;
+
+#ifdef CIRCLE_RESOLVER_THREAD
+static pthread_mutex_t job_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t job_work = PTHREAD_COND_INITIALIZER;
+static int resolvers_running = 0;
+static bool resolvers_stop = FALSE;
+static struct resolve_job *job_head = NULL, *job_tail = NULL;
+static struct resolve_job *job_done = NULL;  /**< Answers for the game loop */
+
+#define LOCK()    pthread_mutex_lock(&job_lock)
+#define UNLOCK()  pthread_mutex_unlock(&job_lock)
+#else
+#define LOCK()
+#define UNLOCK()
+#endif
+
+static unsigned long usec_since(struct timeval *start)
+{
+  struct timeval now;
+  long usec;
+
+  gettimeofday(&now, NULL);
+  usec = (now.tv_sec - start->tv_sec) * 1000000L + (now.tv_usec - start->tv_usec);
+  return (usec > 0 ? usec : 0);
+}
+
+/** The default backend: ask the system's resolver. */
+static int lookup_host(struct in_addr addr, char *name, size_t len)
+{
+#ifdef CIRCLE_RESOLVER_THREAD
+  struct sockaddr_in sa;
+
+  memset(&sa, 0, sizeof(sa));
+  sa.sin_family = AF_INET;
+  sa.sin_addr = addr;
+  return (getnameinfo((struct sockaddr *) &sa, sizeof(sa), name, len, NULL, 0, NI_NAMEREQD) == 0);
+#else
+  struct hostent *from;
+
+  if (!(from = gethostbyaddr((char *) &addr, sizeof(addr), AF_INET)))
+    return (FALSE);
+  snprintf(name, len, "%s", from->h_name);
+  return (TRUE);
+#endif
+}
+
+/** Look up one address, timing it. */
+static void resolve(struct resolve_job *job, resolver_backend lookup)
+{
+  struct timeval start;
+  unsigned long usec;
+
+  gettimeofday(&start, NULL);
+  *job->name = '\0';
+  job->found = lookup(job->addr, job->name, sizeof(job->name));
+  job->name[HOST_LENGTH] = '\0';
+  if (!*job->name)
+    job->found = FALSE;
+  usec = usec_since(&start);
+
+  LOCK();
+  stats.usec += usec;
+  stats.max_usec = MAX(stats.max_usec, usec);
+  UNLOCK();
+}
+
+static int host_hash(struct in_addr addr)
+{
+  return ((unsigned int) (addr.s_addr * 2654435761U) >> 24) % HOST_HASH_SIZE;
+}
+
+static struct host_entry *find_host(struct in_addr addr)
+{
+  struct host_entry *h;
+
+  for (h = host_cache[host_hash(addr)]; h; h = h->next)
+    if (h->addr.s_addr == addr.s_addr)
+      return (h);
+  return (NULL);
+}
+
+static struct host_entry *add_host(struct in_addr addr)
+{
+  struct host_entry *h;
+  int bucket = host_hash(addr);
+
+  CREATE(h, struct host_entry, 1);
+  h->addr = addr;
+  h->state = HOST_PENDING;
+  h->next = host_cache[bucket];
+  host_cache[bucket] = h;
+  stats.entries++;
+  return (h);
+}
+
+/** Drop the answers that have gone stale. */
+static void expire_hosts(void)
+{
+  struct host_entry *h, **prev;
+  time_t now = time(0);
+  int i;
+
+  for (i = 0; i < HOST_HASH_SIZE; i++)
+    for (prev = &host_cache[i]; (h = *prev) != NULL; )
+      if (h->state != HOST_PENDING && h->expires <= now) {
+        *prev = h->next;
+        free(h);
+        stats.entries--;
+      } else
+        prev = &h->next;
+}
+
+/** Remember the answer for an address. */
+static void set_host(struct host_entry *h, int found, const char *name)
+{
+  if (found) {
+    h->state = HOST_FOUND;
+    strcpy(h->name, name);	/* strcpy: OK (both HOST_LENGTH+1) */
+    h->expires = time(0) + RESOLVER_CACHE_TTL;
+    stats.resolved++;
+  } else {
+    h->state = HOST_UNKNOWN;
+    *h->name = '\0';
+    h->expires = time(0) + RESOLVER_FAIL_TTL;
+    stats.failed++;
+  }
+}
+
+static void deny(struct descriptor_data *d, const char *msg)
+{
+  if (msg)
+    write_to_output(d, "%s", msg);
+  STATE(d) = CON_CLOSE;
+  reactor_wake(d);
+  stats.denied++;
+}
+
+/** The name for d has come in after it connected: use it, and redo what has
+ * already been checked or recorded against its numeric address. */
+static void host_resolved(struct descriptor_data *d, const char *name)
+{
+  struct char_data *ch = d->original ? d->original : d->character;
+  char oldhost[HOST_LENGTH + 1];
+  int ban;
+
+  d->resolving = FALSE;
+  stats.late++;
+
+  strcpy(oldhost, d->host);	/* strcpy: OK (both HOST_LENGTH+1) */
+  strncpy(d->host, name, HOST_LENGTH);	/* strncpy: OK (d->host:HOST_LENGTH+1) */
+  d->host[HOST_LENGTH] = '\0';
+
+  if (ch && GET_HOST(ch) && !strcmp(GET_HOST(ch), oldhost)) {
+    free(GET_HOST(ch));
+    GET_HOST(ch) = strdup(d->host);
+  }
+
+  ban = isbanned(d->host, &d->addr);
+  if (ban == BAN_ALL) {
+    mudlog(CMP, LVL_GOD, TRUE, "Connection attempt denied from [%s]", d->host);
+    deny(d, NULL);
+    return;
+  }
+
+  switch (STATE(d)) {
+  case CON_GET_PROTOCOL:
+  case CON_GET_NAME:
+  case CON_NAME_CNFRM:
+  case CON_PASSWORD:
+    /* Nothing but the full ban has been checked yet. */
+    break;
+
+  case CON_NEWPASSWD:
+  case CON_CNFPASSWD:
+  case CON_QSEX:
+  case CON_QCLASS:
+    if (ban >= BAN_NEW) {
+      mudlog(NRM, LVL_GOD, TRUE, "Request for new char %s denied from [%s] (siteban)", GET_PC_NAME(d->character), d->host);
+      deny(d, "Sorry, new characters are not allowed from your site!\r\n");
+    }
+    break;
+
+  default:
+    if (!ch || IS_NPC(ch))
+      break;
+    UpdateRecentHost(GET_NAME(ch), oldhost, d->host);
+    if (ban == BAN_SELECT && !PLR_FLAGGED(ch, PLR_SITEOK)) {
+      mudlog(NRM, LVL_GOD, TRUE, "Connection attempt for %s denied from %s", GET_NAME(ch), d->host);
+      deny(d, "Sorry, this char has not been cleared for login from your site!\r\n");
+    }
+    break;
+  }
+}
+
+#ifdef CIRCLE_RESOLVER_THREAD
+static void *resolver_thread(void *unused)
+{
+  struct resolve_job *job;
+  resolver_backend lookup;
+
+  LOCK();
+  for (;;) {
+    while (!job_head && !resolvers_stop)
+      pthread_cond_wait(&job_work, &job_lock);
+    if (resolvers_stop)
+      break;
+    job = job_head;
+    if ((job_head = job->next) == NULL)
+      job_tail = NULL;
+    lookup = backend;
+    UNLOCK();
+
+    resolve(job, lookup);
+
+    LOCK();
+    job->next = job_done;
+    job_done = job;
+  }
+  resolvers_running--;
+  UNLOCK();
+
+  return (NULL);
+}
+#endif
+
+/** Start the resolver threads.  Until then names are looked up directly. */
+void resolver_init(void)
+{
+#ifdef CIRCLE_RESOLVER_THREAD
+  sigset_t all, old;
+  pthread_t thread;
+  int i, err = 0;
+
+  log("Starting %d host name resolver threads.", RESOLVER_THREADS);
+
+  LOCK();
+  if (!backend)
+    backend = lookup_host;
+  UNLOCK();
+
+  /* The resolvers have no business handling the game's signals. */
+  sigfillset(&all);
+  pthread_sigmask(SIG_SETMASK, &all, &old);
+  for (i = 0; i < RESOLVER_THREADS; i++) {
+    if ((err = pthread_create(&thread, NULL, resolver_thread, NULL)) != 0)
+      break;
+    pthread_detach(thread);
+    LOCK();
+    resolvers_running++;
+    UNLOCK();
+  }
+  pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+  if (err)
+    log("SYSERR: Couldn't start a host name resolver thread%s: %s",
+        i ? "" : ", resolving from the game loop", strerror(err));
+#endif
+}
+
+/** Stop the resolver threads.  One stuck in a lookup is left to finish it
+ * on its own; nothing it touches is freed. */
+void resolver_shutdown(void)
+{
+#ifdef CIRCLE_RESOLVER_THREAD
+  LOCK();
+  resolvers_stop = TRUE;
+  pthread_cond_broadcast(&job_work);
+  UNLOCK();
+#endif
+}
+
+/** Look names up with something other than the system's resolver, such as
+ * a stub for testing.  NULL goes back to the system's resolver. */
+void resolver_set_backend(resolver_backend lookup)
+{
+  LOCK();
+  backend = lookup ? lookup : lookup_host;
+  UNLOCK();
+}
+
+/** Find the host name for a new connection.  d->host and d->addr must hold
+ * its numeric address.  d->host is replaced now if the name is cached or
+ * there are no resolver threads, or else by resolver_pulse() once a thread
+ * has it. */
+void resolver_lookup(struct descriptor_data *d)
+{
+  struct host_entry *h;
+  struct resolve_job *job;
+  resolver_backend lookup;
+  bool threaded = FALSE;
+
+  stats.lookups++;
+
+  if ((h = find_host(d->addr)) == NULL)
+    h = add_host(d->addr);
+  else if (h->state == HOST_PENDING) {
+    stats.shared++;
+    d->resolving = TRUE;
+    return;
+  } else if (h->expires > time(0)) {
+    stats.hits++;
+    if (h->state == HOST_FOUND)
+      strcpy(d->host, h->name);	/* strcpy: OK (both HOST_LENGTH+1) */
+    return;
+  } else
+    h->state = HOST_PENDING;	/* Stale, look it up again. */
+
+  CREATE(job, struct resolve_job, 1);
+  job->addr = d->addr;
+
+#ifdef CIRCLE_RESOLVER_THREAD
+  LOCK();
+  if (resolvers_running > 0) {
+    threaded = TRUE;
+    if (job_tail)
+      job_tail->next = job;
+    else
+      job_head = job;
+    job_tail = job;
+    pthread_cond_signal(&job_work);
+  }
+  UNLOCK();
+#endif
+
+  if (threaded) {
+    d->resolving = TRUE;
+    stats.pending++;
+    stats.peak_pending = MAX(stats.peak_pending, stats.pending);
+    return;
+  }
+
+  LOCK();
+  lookup = backend ? backend : lookup_host;
+  UNLOCK();
+  resolve(job, lookup);
+  set_host(h, job->found, job->name);
+  if (job->found)
+    strcpy(d->host, job->name);	/* strcpy: OK (both HOST_LENGTH+1) */
+  free(job);
+}
+
+/** Called every pulse: hand out the names the resolver threads have found
+ * and forget the stale ones. */
+void resolver_pulse(void)
+{
+  static time_t last_expired = 0;
+  struct resolve_job *job, *next;
+  struct descriptor_data *d;
+  struct host_entry *h;
+
+#ifdef CIRCLE_RESOLVER_THREAD
+  LOCK();
+  job = job_done;
+  job_done = NULL;
+  UNLOCK();
+#else
+  job = NULL;
+#endif
+
+  for (; job; job = next) {
+    next = job->next;
+    stats.pending--;
+
+    if ((h = find_host(job->addr)) == NULL)
+      h = add_host(job->addr);
+    set_host(h, job->found, job->name);
+
+    for (d = descriptor_list; d; d = d->next)
+      if (d->resolving && d->addr.s_addr == job->addr.s_addr) {
+        if (job->found)
+          host_resolved(d, job->name);
+        else
+          d->resolving = FALSE;
+      }
+    free(job);
+  }
+
+  if (time(0) - last_expired >= 60) {
+    last_expired = time(0);
+    expire_hosts();
+  }
+}
+
+/** Describe the resolver for 'show resolver'. */
+size_t print_resolver_stats(char *buf, size_t len)
+{
+  unsigned long done;
+  int nlen;
+
+  LOCK();
+  done = stats.resolved + stats.failed;
+  nlen = snprintf(buf, len,
+      "Names are looked up by : %s\r\n"
+      "Connections            : %lu, %lu answered from the cache, %lu joined a lookup\r\n"
+      "Lookups                : %lu named, %lu with no name, %d waiting, %d at most\r\n"
+      "Lookup time            : %.1f ms average, %.1f ms longest\r\n"
+      "Named after connecting : %lu, %lu of them closed by a site ban\r\n"
+      "Cached addresses       : %d\r\n",
+#ifdef CIRCLE_RESOLVER_THREAD
+      resolvers_running > 0 ? "the resolver threads" : "the game loop",
+#else
+      "the game loop",
+#endif
+      stats.lookups, stats.hits, stats.shared,
+      stats.resolved, stats.failed, stats.pending, stats.peak_pending,
+      done ? stats.usec / 1000.0 / done : 0.0, stats.max_usec / 1000.0,
+      stats.late, stats.denied,
+      stats.entries);
+  UNLOCK();
+
+  if (nlen < 0)
+    return (0);
+  return (MIN((size_t) nlen, len - 1));
+}
@@ -0,0 +1,32 @@
+/**
+* @file resolver.h
+* Host name lookups for new connections, off the game loop.
+*
+* Part of the core altMUD source code distribution, which is a derivative
+* of, and continuation of, CircleMUD.
+*
+* All rights reserved.  See license for complete information.
+*/
+#ifndef _RESOLVER_H_
+#define _RESOLVER_H_
+
+/** Threads looking up host names at once. */
+#define RESOLVER_THREADS    2
+/** Seconds a host name is remembered for. */
+#define RESOLVER_CACHE_TTL  (30 * 60)
+/** Seconds an address with no name is remembered for. */
+#define RESOLVER_FAIL_TTL   (5 * 60)
+
+/** Looks up the name of addr into name, returning TRUE if it has one.  The
+ * backend is called from the resolver threads, so it must be thread safe. */
+typedef int (*resolver_backend)(struct in_addr addr, char *name, size_t len);
+
+/* Functions in resolver.c */
+void resolver_init(void);
+void resolver_shutdown(void);
+void resolver_set_backend(resolver_backend lookup);
+void resolver_lookup(struct descriptor_data *d);
+void resolver_pulse(void);
+size_t print_resolver_stats(char *buf, size_t len);
+
+#endif /* _RESOLVER_H_ */
@@ -0,0 +1,612 @@
+/**
+* @file savequeue.c
+* Background writes of player, crash and house files, and the autosave round.
+*
+* Part of the core altMUD source code distribution, which is a derivative
+* of, and continuation of, CircleMUD.
+*
+* All rights reserved.  See license for complete information.
+*
+* Player, crash and house files used to be written with stdio straight from
+* the game loop, and every CONFIG_AUTOSAVE_TIME minutes heartbeat() saved
+* every flagged player and house within a single pulse.  Now the game loop
+* only formats a file into memory: savequeue_open() hands out an
+* open_memstream() FILE and savequeue_close() queues what was written to it.
+* A writer thread then writes "<file>.tmp", fsync()s it and renames it over
+* the old file.  Anything that reads or removes one of these files calls
+* savequeue_wait() first, so it never sees one older than the last save.
+*
+* An autosave round is spread over as many pulses as it takes, saving at
+* most AUTOSAVE_PER_PULSE players and houses per pulse.
+*
+* Without threads (see CIRCLE_SAVE_THREAD in sysdep.h), or before
+* savequeue_init(), the same calls write the temporary file from the game
+* loop and rename it on the spot.  savequeue_open_now() always works that
+* way, and syncs the file before the rename, for the few callers that must
+* know the new file has landed before they go on.
+*/
+
+#include "conf.h"
+#include "sysdep.h"
+#include "structs.h"
+#include "utils.h"
+#include "comm.h"
+#include "db.h"
+#include "house.h"
+#include "savequeue.h"
+
+#ifdef CIRCLE_SAVE_THREAD
+#include <pthread.h>
+#endif
+
+#ifdef CIRCLE_WINDOWS
+#define fsync(fd)  _commit(fd)
+#endif
+
+/** A file being written by the game loop, or waiting for the writer. */
+struct save_job {
+  char *filename;         /**< The file to replace */
+  FILE *fl;               /**< What the game loop writes to until it closes */
+  char *data;             /**< The new contents, for the writer thread */
+  size_t len;             /**< Bytes in data */
+  bool queued;            /**< Goes to the writer thread, not a .tmp file */
+  bool sync;              /**< From savequeue_open_now() */
+  struct save_job *next;
+};
+
+/** A write the writer thread could not finish, for the game loop to log. */
+struct save_error {
+  char *filename;
+  const char *step;       /**< The call that failed */
+  int err;                /**< Its errno */
+  struct save_error *next;
+};
+
+/** Counters for 'show saves'.  Times are in microseconds. */
+static struct {
+  unsigned long queued;         /**< Files handed to the writer thread */
+  unsigned long coalesced;      /**< Queued files replaced by a newer save */
+  unsigned long written;        /**< Files written */
+  unsigned long failed;         /**< Saves that left the old file in place */
+  unsigned long formatted;      /**< Bytes formatted by the game loop */
+  unsigned long bytes;          /**< Bytes written */
+  unsigned long write_usec;     /**< Writing, syncing and renaming */
+  unsigned long max_write_usec;
+  unsigned long waits;          /**< Reads that waited for a queued write */
+  int depth;                    /**< Files queued right now */
+  int peak_depth;
+
+  unsigned long rounds;         /**< Autosave rounds finished */
+  unsigned long pulses;         /**< Pulses an autosave round worked in */
+  unsigned long pulse_usec;     /**< Game loop time spent on them */
+  unsigned long max_pulse_usec;
+  int last_players, last_houses, last_pulses;
+  unsigned long last_usec, last_bytes;
+} stats;
+
+static struct save_job *open_jobs = NULL;   /**< Files the game loop has open */
+
+/* The autosave round in progress */
+static bool autosave_running = FALSE;
+static int autosave_round = 0;      /**< Compared with player_specials */
+static int autosave_house = 0;      /**< Next house to look at */
+static int round_players, round_houses, round_pulses;
+static unsigned long round_usec, round_formatted;
+
+#ifdef CIRCLE_SAVE_THREAD
+static pthread_mutex_t queue_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t queue_work = PTHREAD_COND_INITIALIZER;  /**< Writer waits */
+static pthread_cond_t queue_done = PTHREAD_COND_INITIALIZER;  /**< Game loop waits */
+static pthread_t writer;
+static bool writer_running = FALSE;
+static bool writer_stop = FALSE;
+static struct save_job *job_head = NULL, *job_tail = NULL;
+static struct save_job *in_flight = NULL;   /**< Being written right now */
+static struct save_error *errors = NULL;
+
+#define LOCK()    pthread_mutex_lock(&queue_lock)
+#define UNLOCK()  pthread_mutex_unlock(&queue_lock)
+#else
+#define LOCK()
+#define UNLOCK()
+#endif
+
+static unsigned long usec_since(struct timeval *start)
+{
+  struct timeval now;
+  long usec;
+
+  gettimeofday(&now, NULL);
+  usec = (now.tv_sec - start->tv_sec) * 1000000L + (now.tv_usec - start->tv_usec);
+  return (usec > 0 ? usec : 0);
+}
+
+static void free_job(struct save_job *job)
+{
+  if (job->data)
+    free(job->data);
+  free(job->filename);
+  free(job);
+}
+
+/** Take the job for fl off the list of open files. */
+static struct save_job *take_job(FILE *fl)
+{
+  struct save_job *job, **prev;
+
+  for (prev = &open_jobs; (job = *prev) != NULL; prev = &job->next)
+    if (job->fl == fl) {
+      *prev = job->next;
+      job->next = NULL;
+      return (job);
+    }
+
+  log("SYSERR: savequeue was handed a file it did not open.");
+  return (NULL);
+}
+
+#ifdef CIRCLE_SAVE_THREAD
+/** Write len bytes of data to filename through a temporary file.  Returns 0,
+ * or the errno of the call that failed, which is named in *step. */
+static int write_file(const char *filename, const char *data, size_t len, const char **step)
+{
+  char tempname[MAX_INPUT_LENGTH];
+  ssize_t n;
+  int fd, err = 0;
+
+  snprintf(tempname, sizeof(tempname), "%s.tmp", filename);
+  if ((fd = open(tempname, O_WRONLY | O_CREAT | O_TRUNC, 0666)) < 0) {
+    *step = "open";
+    return (errno);
+  }
+
+  while (len > 0 && !err) {
+    if ((n = write(fd, data, len)) > 0) {
+      data += n;
+      len -= n;
+    } else if (n == 0 || errno != EINTR) {
+      *step = "write";
+      err = n ? errno : EIO;
+    }
+  }
+
+  if (!err && fsync(fd) < 0) {
+    *step = "fsync";
+    err = errno;
+  }
+  if (close(fd) < 0 && !err) {
+    *step = "close";
+    err = errno;
+  }
+  if (!err && rename(tempname, filename) < 0) {
+    *step = "rename";
+    err = errno;
+  }
+
+  if (err)
+    unlink(tempname);
+  return (err);
+}
+
+static void *writer_thread(void *unused)
+{
+  struct save_job *job;
+  struct save_error *e;
+  struct timeval start;
+  const char *step = NULL;
+  unsigned long usec;
+  int err;
+
+  LOCK();
+  for (;;) {
+    while (!job_head && !writer_stop)
+      pthread_cond_wait(&queue_work, &queue_lock);
+    if ((job = job_head) == NULL)
+      break;
+    if ((job_head = job->next) == NULL)
+      job_tail = NULL;
+    in_flight = job;
+    stats.depth--;
+    UNLOCK();
+
+    gettimeofday(&start, NULL);
+    err = write_file(job->filename, job->data, job->len, &step);
+    usec = usec_since(&start);
+
+    LOCK();
+    in_flight = NULL;
+    stats.write_usec += usec;
+    stats.max_write_usec = MAX(stats.max_write_usec, usec);
+    if (err) {
+      stats.failed++;
+      CREATE(e, struct save_error, 1);
+      e->filename = job->filename;
+      job->filename = NULL;
+      e->step = step;
+      e->err = err;
+      e->next = errors;
+      errors = e;
+    } else {
+      stats.written++;
+      stats.bytes += job->len;
+    }
+    if (job->filename)
+      free(job->filename);
+    free(job->data);
+    free(job);
+    pthread_cond_broadcast(&queue_done);
+  }
+  UNLOCK();
+
+  return (NULL);
+}
+
+/** Hand a closed job to the writer, replacing the contents of any save of
+ * the same file that is still waiting. */
+static void enqueue(struct save_job *job)
+{
+  struct save_job *q;
+
+  LOCK();
+  stats.queued++;
+  stats.formatted += job->len;
+
+  for (q = job_head; q; q = q->next)
+    if (!strcmp(q->filename, job->filename))
+      break;
+
+  if (q) {
+    free(q->data);
+    q->data = job->data;
+    q->len = job->len;
+    job->data = NULL;
+    free_job(job);
+    stats.coalesced++;
+  } else {
+    if (job_tail)
+      job_tail->next = job;
+    else
+      job_head = job;
+    job_tail = job;
+    stats.depth++;
+    stats.peak_depth = MAX(stats.peak_depth, stats.depth);
+    pthread_cond_signal(&queue_work);
+  }
+  UNLOCK();
+}
+
+/** Is a write of filename queued or in progress?  The lock must be held. */
+static bool is_pending(const char *filename)
+{
+  struct save_job *q;
+
+  if (in_flight && !strcmp(in_flight->filename, filename))
+    return (TRUE);
+  for (q = job_head; q; q = q->next)
+    if (!strcmp(q->filename, filename))
+      return (TRUE);
+  return (FALSE);
+}
+#endif
+
+/** Log the writes the writer thread could not finish. */
+static void log_errors(void)
+{
+#ifdef CIRCLE_SAVE_THREAD
+  struct save_error *e, *next;
+
+  LOCK();
+  e = errors;
+  errors = NULL;
+  UNLOCK();
+
+  for (; e; e = next) {
+    next = e->next;
+    mudlog(BRF, LVL_GOD, TRUE, "SYSERR: Couldn't save %s, %s() failed: %s",
+           e->filename, e->step, strerror(e->err));
+    free(e->filename);
+    free(e);
+  }
+#endif
+}
+
+/** Start the writer thread.  Saves made before this are written directly. */
+void savequeue_init(void)
+{
+#ifdef CIRCLE_SAVE_THREAD
+  sigset_t all, old;
+  int err;
+
+  log("Starting the file writer thread.");
+
+  /* The writer has no business handling the game's signals. */
+  sigfillset(&all);
+  pthread_sigmask(SIG_SETMASK, &all, &old);
+  err = pthread_create(&writer, NULL, writer_thread, NULL);
+  pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+  if (err)
+    log("SYSERR: Couldn't start the file writer thread, saving from the game loop: %s", strerror(err));
+  else
+    writer_running = TRUE;
+#endif
+}
+
+/** Write out everything still queued and stop the writer thread. */
+void savequeue_shutdown(void)
+{
+#ifdef CIRCLE_SAVE_THREAD
+  if (!writer_running)
+    return;
+
+  LOCK();
+  writer_stop = TRUE;
+  pthread_cond_signal(&queue_work);
+  UNLOCK();
+
+  pthread_join(writer, NULL);
+  writer_running = FALSE;
+  log_errors();
+#endif
+}
+
+static FILE *open_job(const char *filename, bool sync)
+{
+  struct save_job *job;
+  char tempname[MAX_INPUT_LENGTH];
+
+  CREATE(job, struct save_job, 1);
+  job->filename = strdup(filename);
+  job->sync = sync;
+
+#ifdef CIRCLE_SAVE_THREAD
+  if (writer_running && !sync) {
+    job->queued = TRUE;
+    job->fl = open_memstream(&job->data, &job->len);
+  } else
+#endif
+  {
+    snprintf(tempname, sizeof(tempname), "%s.tmp", filename);
+    job->fl = fopen(tempname, "wb");
+  }
+
+  if (!job->fl) {
+    mudlog(BRF, LVL_GOD, TRUE, "SYSERR: Couldn't open %s for write: %s", filename, strerror(errno));
+    free_job(job);
+    return (NULL);
+  }
+
+  job->next = open_jobs;
+  open_jobs = job;
+  return (job->fl);
+}
+
+/** Open filename to be replaced.  Write to the FILE returned, then hand it to
+ * savequeue_close() to replace the file, or savequeue_abort() to keep the
+ * old one.  Returns NULL, having logged why, if it cannot be written. */
+FILE *savequeue_open(const char *filename)
+{
+  return (open_job(filename, FALSE));
+}
+
+/** As savequeue_open(), but the file is written from the game loop, and
+ * savequeue_close() returns 0 only once it has been synced to disk and
+ * renamed into place.  For callers that change their own state to match the
+ * new file, which must not happen while it could still be lost. */
+FILE *savequeue_open_now(const char *filename)
+{
+  savequeue_wait(filename);
+  return (open_job(filename, TRUE));
+}
+
+/** Close a file from savequeue_open() and replace the old file with it,
+ * now or from the writer thread.  Returns 0, or -1 if it could not be
+ * written, which has been logged and leaves the old file in place.  For a
+ * file from savequeue_open_now(), 0 means the new file is on disk. */
+int savequeue_close(FILE *fl)
+{
+  struct save_job *job;
+  char tempname[MAX_INPUT_LENGTH];
+  long len;
+  int err;
+
+  if ((job = take_job(fl)) == NULL)
+    return (-1);
+
+  len = ftell(fl);
+  err = ferror(fl);
+  if (!err && job->sync && (fflush(fl) || fsync(fileno(fl)) < 0))
+    err = errno;
+  if (fclose(fl) || err) {
+    mudlog(BRF, LVL_GOD, TRUE, "SYSERR: Couldn't write %s: %s", job->filename, strerror(errno));
+    if (!job->queued) {
+      snprintf(tempname, sizeof(tempname), "%s.tmp", job->filename);
+      unlink(tempname);
+    }
+    free_job(job);
+    LOCK();
+    stats.failed++;
+    UNLOCK();
+    return (-1);
+  }
+
+#ifdef CIRCLE_SAVE_THREAD
+  if (job->queued) {
+    enqueue(job);
+    return (0);
+  }
+#endif
+
+  snprintf(tempname, sizeof(tempname), "%s.tmp", job->filename);
+#ifdef CIRCLE_WINDOWS
+  /* Windows will not rename over an existing file. */
+  remove(job->filename);
+#endif
+  if (rename(tempname, job->filename) < 0) {
+    mudlog(BRF, LVL_GOD, TRUE, "SYSERR: Couldn't rename %s to %s: %s", tempname, job->filename, strerror(errno));
+    unlink(tempname);
+    free_job(job);
+    LOCK();
+    stats.failed++;
+    UNLOCK();
+    return (-1);
+  }
+
+  LOCK();
+  stats.written++;
+  stats.formatted += len;
+  stats.bytes += len;
+  UNLOCK();
+  free_job(job);
+  return (0);
+}
+
+/** Close a file from savequeue_open() and keep the old one. */
+void savequeue_abort(FILE *fl)
+{
+  struct save_job *job;
+  char tempname[MAX_INPUT_LENGTH];
+
+  if ((job = take_job(fl)) == NULL)
+    return;
+
+  fclose(fl);
+  if (!job->queued) {
+    snprintf(tempname, sizeof(tempname), "%s.tmp", job->filename);
+    unlink(tempname);
+  }
+  free_job(job);
+}
+
+/** Wait until any queued save of filename has been written.  Call this
+ * before reading, renaming or removing a file that is saved through here. */
+void savequeue_wait(const char *filename)
+{
+#ifdef CIRCLE_SAVE_THREAD
+  bool waited = FALSE;
+
+  if (!writer_running)
+    return;
+
+  LOCK();
+  while (is_pending(filename)) {
+    waited = TRUE;
+    pthread_cond_wait(&queue_done, &queue_lock);
+  }
+  if (waited)
+    stats.waits++;
+  UNLOCK();
+#endif
+}
+
+/** Wait until every queued save has been written. */
+void savequeue_flush(void)
+{
+#ifdef CIRCLE_SAVE_THREAD
+  if (!writer_running)
+    return;
+
+  LOCK();
+  while (job_head || in_flight)
+    pthread_cond_wait(&queue_done, &queue_lock);
+  UNLOCK();
+  log_errors();
+#endif
+}
+
+/** Start an autosave round, unless the last one has not finished yet. */
+void autosave_start(void)
+{
+  if (autosave_running)
+    return;
+
+  autosave_running = TRUE;
+  autosave_round++;
+  autosave_house = 0;
+  round_players = round_houses = round_pulses = 0;
+  round_usec = 0;
+  LOCK();
+  round_formatted = stats.formatted;
+  UNLOCK();
+}
+
+/** Called every pulse: report failed writes, and save the next few players
+ * and houses of the autosave round in progress. */
+void autosave_pulse(void)
+{
+  struct timeval start;
+  unsigned long usec;
+  int players, houses = 0;
+
+  log_errors();
+
+  if (!autosave_running)
+    return;
+
+  gettimeofday(&start, NULL);
+  players = Crash_save_some(autosave_round, AUTOSAVE_PER_PULSE);
+  if (players < AUTOSAVE_PER_PULSE &&
+      (houses = House_save_some(&autosave_house, AUTOSAVE_PER_PULSE - players)) < 0) {
+    autosave_running = FALSE;
+    houses = 0;
+  }
+  usec = usec_since(&start);
+
+  round_players += players;
+  round_houses += houses;
+  round_pulses++;
+  round_usec += usec;
+
+  LOCK();
+  stats.pulses++;
+  stats.pulse_usec += usec;
+  stats.max_pulse_usec = MAX(stats.max_pulse_usec, usec);
+  if (!autosave_running) {
+    stats.rounds++;
+    stats.last_players = round_players;
+    stats.last_houses = round_houses;
+    stats.last_pulses = round_pulses;
+    stats.last_usec = round_usec;
+    stats.last_bytes = stats.formatted - round_formatted;
+  }
+  UNLOCK();
+}
+
+/** Describe the file writer and autosave for 'show saves'. */
+size_t print_save_stats(char *buf, size_t len)
+{
+  int nlen;
+
+  LOCK();
+  nlen = snprintf(buf, len,
+      "Files are written by   : %s\r\n"
+      "Queued for the writer  : %d now, %d at most\r\n"
+      "Saves queued           : %lu, %lu replaced a save still waiting\r\n"
+      "Formatted in memory    : %lu KB\r\n"
+      "Files written          : %lu, %lu KB, %lu failed\r\n"
+      "Writer time            : %lu ms, longest file %.1f ms\r\n"
+      "Reads that waited      : %lu\r\n"
+      "Autosave rounds        : %lu, over %lu pulses\r\n"
+      "Autosave game loop time: %lu ms, longest pulse %.1f ms\r\n"
+      "Last round             : %d players and %d houses in %d pulses, %.1f ms, %lu KB\r\n",
+#ifdef CIRCLE_SAVE_THREAD
+      writer_running ? "the writer thread" : "the game loop",
+#else
+      "the game loop",
+#endif
+      stats.depth, stats.peak_depth,
+      stats.queued, stats.coalesced,
+      stats.formatted / 1024,
+      stats.written, stats.bytes / 1024, stats.failed,
+      stats.write_usec / 1000, stats.max_write_usec / 1000.0,
+      stats.waits,
+      stats.rounds, stats.pulses,
+      stats.pulse_usec / 1000, stats.max_pulse_usec / 1000.0,
+      stats.last_players, stats.last_houses, stats.last_pulses,
+      stats.last_usec / 1000.0, stats.last_bytes / 1024);
+  UNLOCK();
+
+  if (nlen < 0)
+    return (0);
+  return (MIN((size_t) nlen, len - 1));
+}
@@ -0,0 +1,29 @@
+/**
+* @file savequeue.h
+* Background writes of player, crash and house files, and the autosave round.
+*
+* Part of the core altMUD source code distribution, which is a derivative
+* of, and continuation of, CircleMUD.
+*
+* All rights reserved.  See license for complete information.
+*/
+#ifndef _SAVEQUEUE_H_
+#define _SAVEQUEUE_H_
+
+/** Most players, and then houses, an autosave round saves in one pulse. */
+#define AUTOSAVE_PER_PULSE  8
+
+/* Functions in savequeue.c */
+void savequeue_init(void);
+void savequeue_shutdown(void);
+FILE *savequeue_open(const char *filename);
+FILE *savequeue_open_now(const char *filename);
+int savequeue_close(FILE *fl);
+void savequeue_abort(FILE *fl);
+void savequeue_wait(const char *filename);
+void savequeue_flush(void);
+void autosave_start(void);
+void autosave_pulse(void);
+size_t print_save_stats(char *buf, size_t len);
+
+#endif /* _SAVEQUEUE_H_ */
@@ -699,18 +699,19 @@ static struct obj_data *slide_obj(struct obj_data *obj, struct char_data *keeper
     return (&obj_proto[temp]);
   }
   SHOP_SORT(shop_nr)++;
-  loop = keeper->carrying;
   obj_to_char(obj, keeper);
-  keeper->carrying = loop;
-  while (loop) {
+
+  /* Move it along to sit behind the first one like it, if there is one. */
+  for (loop = obj->next_content; loop; loop = loop->next_content)
     if (same_obj(obj, loop)) {
+      REMOVE_FROM_DLIST(obj, keeper->carrying, next_content, prev_content);
+      obj->prev_content = loop;
       obj->next_content = loop->next_content;
+      if (loop->next_content)
+        loop->next_content->prev_content = obj;
       loop->next_content = obj;
-      return (obj);
+      break;
     }
-    loop = loop->next_content;
-  }
-  keeper->carrying = obj;
   return (obj);
 }
 
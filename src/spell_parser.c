@@ -19,6 +19,7 @@
 #include "db.h"
 #include "dg_scripts.h"
 #include "fight.h"  /* for hit() */
+#include "reactor.h"
 
 #define SINFO spell_info[spellnum]
 
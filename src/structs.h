@@ -98,8 +98,9 @@
 #define ZONE_NOBUILD      4  /**< Building is not allowed in the zone */
 #define ZONE_NOASTRAL     5  /**< No teleportation magic will work to or from this zone */
 #define ZONE_WORLDMAP     6 /**< Whole zone uses the WORLDMAP by default */
+#define ZONE_ALWAYSACTIVE 7  /**< Mobiles keep acting even when no players are in the zone */
 /** The total number of Zone Flags */
-#define NUM_ZONE_FLAGS    7
+#define NUM_ZONE_FLAGS    8
 
 /* Exit info: used in room_data.dir_option.exit_info */
 #define EX_ISDOOR    (1 << 0) /**< Exit is a door */
@@ -125,6 +126,7 @@
 /* char and mob-related defines */
 
 /* History */
+#define HIST_NONE     -1 /**< No history, for broadcast_to() */
 #define HIST_ALL       0 /**< Index to history of all channels */
 #define HIST_SAY       1 /**< Index to history of all 'say' */
 #define HIST_GOSSIP    2 /**< Index to history of all 'gossip' */
@@ -589,6 +591,8 @@
 /** Controls when to save the current ingame MUD time to disk.
  * This should be set >= SECS_PER_MUD_HOUR */
 #define PULSE_TIMESAVE	(30 * 60 RL_SEC)
+/** How often to check whether the mail file is due to be compacted. */
+#define PULSE_MAILCOMPACT (5 * 60 RL_SEC)
 /* Variables for the output buffering system */
 #define MAX_SOCK_BUF       (24 * 1024) /**< Size of kernel's sock buf   */
 #define MAX_PROMPT_LENGTH  96          /**< Max length of prompt        */
@@ -596,10 +600,24 @@
 #define SMALL_BUFSIZE      1024        /**< Static output buffer size   */
 /** Max amount of output that can be buffered */
 #define LARGE_BUFSIZE      (MAX_SOCK_BUF - GARBAGE_SPACE - MAX_PROMPT_LENGTH)
+#define OUT_BLOCK_SIZE     2048        /**< Text held by one output block */
+#define MAX_OUTPUT_IOV     64          /**< Most blocks sent per writev() */
+/** Most output a descriptor may have queued before it overflows */
+#define MAX_OUTPUT_QUEUE   (16 * MAX_SOCK_BUF)
+/** Past this much queued output a descriptor is backed up: channel chatter
+ * sent to it is dropped and repeated lines are counted, not queued */
+#define OUTPUT_SOFT_LIMIT  (2 * MAX_SOCK_BUF)
+/** Once this much output is queued mud-wide, backed up descriptors are held
+ * at OUTPUT_SOFT_LIMIT instead of MAX_OUTPUT_QUEUE */
+#define MAX_OUTPUT_TOTAL   (256 * MAX_SOCK_BUF)
 
 #define MAX_STRING_LENGTH     49152  /**< Max length of string, as defined */
 #define MAX_INPUT_LENGTH      512    /**< Max length per *line* of input */
 #define MAX_RAW_INPUT_LENGTH  (12 * 1024) /**< Max size of *raw* input */
+#define INPUT_RING_SIZE       MAX_RAW_INPUT_LENGTH /**< Bytes of queued input lines */
+/** Most lines a player may have waiting before further input is dropped as a
+ * flood.  Doesn't apply while writing with the string editor. */
+#define INPUT_FLOOD_LINES     100
 #define MAX_MESSAGES          60     /**< Max Different attack message types */
 #define MAX_NAME_LENGTH       20     /**< Max PC/NPC name length */
 #define MAX_PWD_LENGTH        30     /**< Max PC password length */
@@ -727,10 +745,14 @@ struct obj_data
   struct script_data *script;           /**< script info for the object */
 
   struct obj_data *next_content;  /**< For 'contains' lists   */
+  struct obj_data *prev_content;  /**< Previous in the same 'contains' list */
   struct obj_data *next;          /**< For the object list */
+  struct obj_data *prev;          /**< Previous in the object list */
   struct char_data *sitting_here; /**< For furniture, who is sitting in it */
 
   struct list_data *events;      /**< Used for object events */
+
+  struct keyword_set *keywords;  /**< Filing in the keyword index while on object_list */
 };
 
 /** Instance info for an object that gets saved to disk.
@@ -940,6 +962,7 @@ struct char_special_data
   int carry_weight; /**< Carried weight */
   byte carry_items; /**< Number of items carried */
   int timer;        /**< Timer for update */
+  bool zone_counted; /**< Counted in its zone's num_players */
 
   struct char_special_data_saved saved; /**< Constants saved for PCs. */
 };
@@ -985,6 +1008,8 @@ struct player_special_data
   int last_olc_mode;     /**< ? Currently Unused ? */
   char *host;            /**< Resolved hostname, or ip, for player. */
   int buildwalk_sector;  /**< Default sector type for buildwalk */
+  int deferred_sections; /**< Binary pfile sections load_char_lazy() left on disk */
+  int autosave_round;    /**< Last autosave round this player was saved in */
 };
 
 /** Special data used by NPCs, not PCs */
@@ -1047,7 +1072,9 @@ struct char_data
   struct script_memory *memory;         /**< for mob memory triggers */
 
   struct char_data *next_in_room;  /**< Next PC in the room */
+  struct char_data *prev_in_room;  /**< Previous PC in the room */
   struct char_data *next;          /**< Next char_data in the room */
+  struct char_data *prev;          /**< Previous char_data in character_list */
   struct char_data *next_fighting; /**< Next in line to fight */
 
   struct follow_type *followers; /**< List of characters following */
@@ -1058,6 +1085,8 @@ struct char_data
   long pref; /**< unique session id */
 
   struct list_data * events;
+
+  struct keyword_set *keywords;  /**< Filing in the keyword index while on character_list */
 };
 
 /** descriptor-related structures */
@@ -1068,11 +1097,39 @@ struct txt_block
   struct txt_block *next; /**< ? */
 };
 
-/** ? */
-struct txt_q
+/** A block of text waiting to be sent to a descriptor. Blocks come from a
+ * pool and are chained, so queued output never has to be copied to grow. */
+struct out_block
+{
+  struct out_block *next;     /**< Next block in the chain */
+  int len;                    /**< Bytes of text in this block */
+  char text[OUT_BLOCK_SIZE];  /**< The text itself, not NUL terminated */
+};
+
+/** A descriptor's queued output, sent with writev() straight from the
+ * blocks. */
+struct out_queue
 {
-  struct txt_block *head; /**< ? */
-  struct txt_block *tail; /**< ? */
+  struct out_block *head;  /**< Oldest block, partly sent if head_off > 0 */
+  struct out_block *tail;  /**< Newest block, where new text is appended */
+  int head_off;            /**< Bytes at the start of head already sent */
+  size_t bytes;            /**< Unsent bytes in the whole queue */
+  unsigned long last_hash; /**< Hash of the last line queued while backed up */
+  int last_len;            /**< Length of that line, 0 if there is none */
+  int repeats;             /**< Times that line came again and was counted */
+  long dropped;            /**< Low priority lines refused while backed up */
+};
+
+/** A descriptor's unprocessed input lines, kept in a fixed ring so that
+ * queueing a command never allocates.  Each line is a two byte header (its
+ * length, with the top bit set for alias expansions) followed by the text
+ * without a terminating NUL; either may wrap around the end of buf. */
+struct input_ring
+{
+  char buf[INPUT_RING_SIZE]; /**< The queued lines */
+  int head;                  /**< Offset of the oldest line's header */
+  int used;                  /**< Bytes of buf in use */
+  int lines;                 /**< Number of lines queued */
 };
 
 /** Master structure players. Holds the real players connection to the mud.
@@ -1082,6 +1139,8 @@ struct descriptor_data
 {
   socket_t descriptor;      /**< file descriptor for socket */
   char host[HOST_LENGTH+1]; /**< hostname */
+  struct in_addr addr;      /**< Peer address, for the resolver */
+  bool resolving;           /**< host is numeric until the resolver answers */
   byte bad_pws;             /**< number of bad pw attemps this login */
   byte idle_tics;           /**< tics idle at password prompt		*/
   int connected;            /**< mode of 'connectedness'		*/
@@ -1098,14 +1157,12 @@ struct descriptor_data
   int has_prompt;           /**< is the user at a prompt?             */
   char inbuf[MAX_RAW_INPUT_LENGTH];  /**< buffer for raw input		*/
   char last_input[MAX_INPUT_LENGTH]; /**< the last input			*/
-  char small_outbuf[SMALL_BUFSIZE];  /**< standard output buffer		*/
-  char *output;             /**< ptr to the current output buffer	*/
+  struct out_queue output;  /**< output waiting to be sent		*/
+  bool output_overflow;     /**< output was dropped since the last flush */
   char **history;           /**< History of commands, for ! mostly.	*/
   int history_pos;          /**< Circular array position.		*/
-  int bufptr;               /**< ptr to end of current output		*/
-  int bufspace;             /**< space left in the output buffer	*/
-  struct txt_block *large_outbuf; /**< ptr to large buffer, if we need it */
-  struct txt_q input;       /**< q of unprocessed input		*/
+  struct input_ring input;  /**< q of unprocessed input		*/
+  bool input_flooded;       /**< input was dropped since the q was empty */
   struct char_data *character; /**< linked to char			*/
   struct char_data *original;  /**< original char if switched		*/
   struct descriptor_data *snooping; /**< Who is this char snooping	*/
@@ -1115,6 +1172,11 @@ struct descriptor_data
   protocol_t *pProtocol;    /**< Kavir plugin */
 
   struct list_data * events;
+
+  int ready;                /**< RDY_x bits from the last reactor_poll() */
+  int reactor_slot;         /**< Reactor backend slot, -1 if unregistered */
+  int active_slot;          /**< 1 + index in the reactor active set, or 0 */
+  bool want_write;          /**< Output blocked until the socket drains */
 };
 
 /* other miscellaneous structures */
@@ -1313,6 +1375,8 @@ struct game_data
   int dts_are_dumps; /**< Should items in dt's be junked?   */
   int load_into_inventory; /**< Objects load in immortals inventory. */
   int track_through_doors; /**< Track through doors while closed?    */
+  int track_path_cache; /**< Cache next-hop answers for tracking?   */
+  int track_search_mode; /**< TRACK_SEARCH_BFS or TRACK_SEARCH_BIDIR */
   int no_mort_to_immort; /**< Prevent mortals leveling to imms?    */
   int disp_closed_doors; /**< Display closed doors in autoexit?    */
   int diagonal_dirs; /**< Are there 6 or 10 directions? */
@@ -1337,6 +1401,7 @@ struct crash_save_data
   int autosave_time; /**< if auto_save=TRUE, how often?         */
   int crash_file_timeout; /**< Life of crashfiles and idlesaves.     */
   int rent_file_timeout; /**< Lifetime of normal rent files in days */
+  int binary_pfiles; /**< Save player files in the binary format?  */
 };
 
 /** Important room numbers. This structure stores vnums, not real array
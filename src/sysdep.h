@@ -225,6 +225,12 @@ struct in_addr {
 
 #ifdef HAVE_SYS_UIO_H
 # include <sys/uio.h>
+#else
+/* Output is queued as iovecs even where writev() itself is missing. */
+struct iovec {
+  void *iov_base;
+  size_t iov_len;
+};
 #endif
 
 #ifdef HAVE_SYS_STAT_H
@@ -309,6 +315,32 @@ struct in_addr {
   typedef int			socket_t;
 #endif
 
+/* Readiness backend for the descriptor reactor (reactor.c).  Linux gets
+ * epoll(7), other UNIX systems poll(2), and everything else falls back to
+ * select(2).  Define CIRCLE_NO_EPOLL to force the poll(2) backend. */
+#if defined(CIRCLE_UNIX) && defined(__linux__) && !defined(CIRCLE_NO_EPOLL)
+# define CIRCLE_REACTOR_EPOLL
+# include <sys/epoll.h>
+#elif defined(CIRCLE_UNIX)
+# define CIRCLE_REACTOR_POLL
+# include <poll.h>
+#endif
+
+/* Player, crash and house files are written by a background thread
+ * (savequeue.c) where POSIX threads and open_memstream() are available.
+ * Define CIRCLE_NO_SAVE_THREAD to write them from the game loop instead. */
+#if defined(HAVE_PTHREAD) && defined(HAVE_OPEN_MEMSTREAM) && !defined(CIRCLE_NO_SAVE_THREAD)
+# define CIRCLE_SAVE_THREAD
+#endif
+
+/* Host names of new connections are looked up by a pool of threads
+ * (resolver.c) where POSIX threads and the thread safe getnameinfo() are
+ * available.  Define CIRCLE_NO_RESOLVER_THREAD to look them up from the game
+ * loop instead, as new_descriptor() always used to. */
+#if defined(HAVE_PTHREAD) && defined(HAVE_GETNAMEINFO) && !defined(CIRCLE_NO_RESOLVER_THREAD)
+# define CIRCLE_RESOLVER_THREAD
+#endif
+
 #if defined(__cplusplus)	/* C++ */
 #define cpp_extern	extern
 #else				/* C */
@@ -0,0 +1,539 @@
+/* ************************************************************************
+*  file:  pfconv.c                                         Part of altMUD *
+*  Usage: convert player files between the ASCII and binary formats       *
+*  All Rights Reserved                                                    *
+************************************************************************* */
+
+/* pfconv -b file...   converts ASCII player files to the binary format
+ * pfconv -a file...   converts binary player files back to ASCII
+ *
+ * Files are converted in place, through a temporary file that is renamed
+ * over the original, and files already in the wanted format are left as
+ * they are.  The game reads either format, so this is only needed to
+ * convert everything at once, or to get a binary pfile into a text editor.
+ * See pfbinary.h for the binary layout. */
+
+#include "conf.h"
+#include "sysdep.h"
+
+#include "structs.h"
+#include "utils.h"
+#include "pfbinary.h"
+
+#define MAX_LINE        (MAX_STRING_LENGTH)
+
+/* pfbinary.c's CREATE() reports through the game's log function. */
+void basic_mud_log(const char *format, ...)
+{
+  va_list args;
+
+  va_start(args, format);
+  vfprintf(stderr, format, args);
+  va_end(args);
+  fputc('\n', stderr);
+}
+
+/* How each ASCII tag is stored in the binary stats section. */
+static const struct {
+  const char *tag;
+  int type;
+} stat_tags[] = {
+  { "Ac  ", PFB_TYPE_INT },   { "Act ", PFB_TYPE_FLAGS }, { "Aff ", PFB_TYPE_FLAGS },
+  { "Alin", PFB_TYPE_INT },   { "Badp", PFB_TYPE_INT },   { "Bank", PFB_TYPE_INT },
+  { "Brth", PFB_TYPE_LONG },  { "Cha ", PFB_TYPE_INT },   { "Clas", PFB_TYPE_INT },
+  { "Con ", PFB_TYPE_INT },   { "Dex ", PFB_TYPE_INT },   { "Drnk", PFB_TYPE_INT },
+  { "Drol", PFB_TYPE_INT },   { "Exp ", PFB_TYPE_INT },   { "Frez", PFB_TYPE_INT },
+  { "Gold", PFB_TYPE_INT },   { "Hit ", PFB_TYPE_PAIR },  { "Hite", PFB_TYPE_INT },
+  { "Host", PFB_TYPE_STR },   { "Hrol", PFB_TYPE_INT },   { "Hung", PFB_TYPE_INT },
+  { "Id  ", PFB_TYPE_LONG },  { "Int ", PFB_TYPE_INT },   { "Invs", PFB_TYPE_INT },
+  { "Last", PFB_TYPE_LONG },  { "Lern", PFB_TYPE_INT },   { "Levl", PFB_TYPE_INT },
+  { "Lmot", PFB_TYPE_INT },   { "Lnew", PFB_TYPE_INT },   { "Mana", PFB_TYPE_PAIR },
+  { "Move", PFB_TYPE_PAIR },  { "Name", PFB_TYPE_STR },   { "Olc ", PFB_TYPE_INT },
+  { "Page", PFB_TYPE_INT },   { "Pass", PFB_TYPE_STR },   { "Plyd", PFB_TYPE_INT },
+  { "PfIn", PFB_TYPE_STR },   { "PfOt", PFB_TYPE_STR },   { "Pref", PFB_TYPE_FLAGS },
+  { "Qstp", PFB_TYPE_INT },   { "Qcur", PFB_TYPE_INT },   { "Qcnt", PFB_TYPE_INT },
+  { "Room", PFB_TYPE_INT },   { "Sex ", PFB_TYPE_INT },   { "ScrW", PFB_TYPE_INT },
+  { "Str ", PFB_TYPE_PAIR },  { "Stun", PFB_TYPE_PAIR },  { "Thir", PFB_TYPE_INT },
+  { "Thr1", PFB_TYPE_INT },   { "Thr2", PFB_TYPE_INT },   { "Thr3", PFB_TYPE_INT },
+  { "Thr4", PFB_TYPE_INT },   { "Thr5", PFB_TYPE_INT },   { "Titl", PFB_TYPE_STR },
+  { "Wate", PFB_TYPE_INT },   { "Wimp", PFB_TYPE_INT },   { "Wis ", PFB_TYPE_INT },
+  { NULL, 0 }
+};
+
+static void put_section(struct pfb_buf *out, int id, struct pfb_buf *payload)
+{
+  size_t start = pfb_begin(out, id);
+
+  pfb_put(out, payload->data, payload->len);
+  pfb_end(out, start);
+}
+
+/* As the game's asciiflag_conv(). */
+static unsigned long pf_asciiflag_conv(const char *flag)
+{
+  unsigned long flags = 0;
+  int is_num = TRUE;
+  const char *p;
+
+  for (p = flag; *p; p++) {
+    if (islower(*p))
+      flags |= 1UL << (*p - 'a');
+    else if (isupper(*p))
+      flags |= 1UL << (26 + (*p - 'A'));
+
+    if (!isdigit(*p) && (*p != '-' || p != flag))
+      is_num = FALSE;
+  }
+
+  if (is_num)
+    flags = atol(flag);
+
+  return (flags);
+}
+
+/* As the game's sprintascii(). */
+static const char *pf_sprintascii(char *out, unsigned long bits)
+{
+  const char *flags = "abcdefghijklmnopqrstuvwxyzABCDEF";
+  int i, j = 0;
+
+  for (i = 0; flags[i] != '\0'; i++)
+    if (bits & (1UL << i))
+      out[j++] = flags[i];
+
+  if (j == 0)
+    out[j++] = '0';
+  out[j] = '\0';
+  return (out);
+}
+
+/* As the game's get_line(): the next line that is not blank or a comment. */
+static int pf_get_line(FILE *fl, char *buf)
+{
+  int sl;
+
+  do {
+    if (!fgets(buf, MAX_LINE, fl))
+      return (0);
+  } while (*buf == '*' || *buf == '\n' || *buf == '\r');
+
+  sl = strlen(buf);
+  while (sl > 0 && (buf[sl - 1] == '\n' || buf[sl - 1] == '\r'))
+    buf[--sl] = '\0';
+  return (1);
+}
+
+/* As the game's fread_string(): text up to a '~', with "\r\n" line ends. */
+static void read_tilde_string(FILE *fl, struct pfb_buf *b)
+{
+  char line[MAX_LINE], *p;
+  size_t sl;
+
+  b->len = 0;
+  while (fgets(line, sizeof(line), fl)) {
+    if ((p = strchr(line, '~')) != NULL) {
+      pfb_put(b, line, p - line);
+      break;
+    }
+    sl = strlen(line);
+    while (sl > 0 && (line[sl - 1] == '\n' || line[sl - 1] == '\r'))
+      sl--;
+    pfb_put(b, line, sl);
+    pfb_put(b, "\r\n", 2);
+  }
+  pfb_put(b, "", 1);
+}
+
+static int ascii_to_binary(FILE *fl, struct pfb_buf *out, const char *filename)
+{
+  static struct pfb_buf stats, skills, affects, aliases, quests, trigs, vars, sec, desc;
+  char line[MAX_LINE], tag[5], *value, f[4][MAX_LINE], rbuf[MAX_LINE], tbuf[MAX_LINE];
+  int nskills = 0, naffects = 0, naliases = 0, nquests = 0, ntrigs = 0, nvars = 0;
+  int i, n, type, num[8], has_skills = FALSE;
+  unsigned char type_byte;
+  long context;
+
+  stats.len = skills.len = affects.len = aliases.len = quests.len = 0;
+  trigs.len = vars.len = 0;
+
+  while (pf_get_line(fl, line)) {
+    /* As the game's tag_argument(). */
+    snprintf(tag, sizeof(tag), "%-4.4s", line);
+    for (value = line + strlen(tag); *value == ':' || *value == ' '; value++)
+      ;
+
+    if (!strcmp(tag, "Desc")) {
+      read_tilde_string(fl, &desc);
+      type_byte = PFB_TYPE_STR;
+      pfb_put(&stats, "Desc", 4);
+      pfb_put(&stats, &type_byte, 1);
+      pfb_put_str(&stats, (char *) desc.data);
+    } else if (!strcmp(tag, "Skil")) {
+      has_skills = TRUE;
+      while (pf_get_line(fl, line) && sscanf(line, "%d %d", &num[0], &num[1]) == 2 && num[0] != 0) {
+        pfb_put_u16(&skills, num[0]);
+        pfb_put_u16(&skills, num[1]);
+        nskills++;
+      }
+    } else if (!strcmp(tag, "Affs")) {
+      while (pf_get_line(fl, line)) {
+        memset(num, 0, sizeof(num));
+        n = sscanf(line, "%d %d %d %d %d %d %d %d", &num[0], &num[1], &num[2], &num[3],
+                   &num[4], &num[5], &num[6], &num[7]);
+        if (num[0] <= 0)
+          break;
+        if (n == 5) {   /* Old 32-bit affects, as load_affects() reads them */
+          i = num[4];
+          num[4] = num[5] = num[6] = num[7] = 0;
+          if (i > 0 && i <= NUM_AFF_FLAGS)
+            num[4 + Q_FIELD(i)] |= Q_BIT(i);
+        }
+        for (i = 0; i < 8; i++)
+          pfb_put_u32(&affects, (unsigned long) num[i]);
+        naffects++;
+      }
+    } else if (!strcmp(tag, "Qest")) {
+      while (pf_get_line(fl, line) && (n = atoi(line)) != NOTHING) {
+        pfb_put_u32(&quests, (unsigned long) n);
+        nquests++;
+      }
+    } else if (!strcmp(tag, "Alis")) {
+      /* As read_aliases_ascii(): a space before the alias is dropped, one
+       * before the replacement is kept or added. */
+      for (n = atoi(value); n > 0; n--) {
+        rbuf[0] = ' ';
+        if (!pf_get_line(fl, line) || !pf_get_line(fl, rbuf + 1) || !pf_get_line(fl, tbuf))
+          break;
+        if (!*line || !rbuf[1] || !*tbuf)
+          continue;
+        pfb_put_str(&aliases, *line == ' ' ? line + 1 : line);
+        pfb_put_str(&aliases, rbuf[1] == ' ' ? rbuf + 1 : rbuf);
+        pfb_put_u32(&aliases, (unsigned long) atoi(tbuf));
+        naliases++;
+      }
+    } else if (!strcmp(tag, "Trig")) {
+      pfb_put_u32(&trigs, (unsigned long) atoi(value));
+      ntrigs++;
+    } else if (!strcmp(tag, "Vars")) {
+      for (n = atoi(value); n > 0 && pf_get_line(fl, line); n--) {
+        if (sscanf(line, "%s %ld", f[0], &context) != 2)
+          continue;
+        for (value = line; *value && !isspace(*value); value++)
+          ;
+        for (; isspace(*value); value++)
+          ;
+        for (; *value && !isspace(*value); value++)
+          ;
+        for (; isspace(*value); value++)
+          ;
+        pfb_put_str(&vars, f[0]);
+        pfb_put_long(&vars, context);
+        pfb_put_str(&vars, value);
+        nvars++;
+      }
+    } else {
+      if (!strcmp(tag, "Qpnt"))   /* Old name of Qstp */
+        strcpy(tag, "Qstp");
+      for (i = 0; stat_tags[i].tag && strcmp(stat_tags[i].tag, tag); i++)
+        ;
+      if (!stat_tags[i].tag) {
+        fprintf(stderr, "%s: dropping unknown tag '%s'\n", filename, tag);
+        continue;
+      }
+      pfb_put(&stats, tag, 4);
+      type_byte = type = stat_tags[i].type;
+      pfb_put(&stats, &type_byte, 1);
+
+      switch (type) {
+      case PFB_TYPE_INT:
+        pfb_put_u32(&stats, (unsigned long) atoi(value));
+        break;
+      case PFB_TYPE_LONG:
+        pfb_put_long(&stats, atol(value));
+        break;
+      case PFB_TYPE_STR:
+        pfb_put_str(&stats, value);
+        break;
+      case PFB_TYPE_PAIR:
+        num[0] = num[1] = 0;
+        sscanf(value, "%d/%d", &num[0], &num[1]);
+        pfb_put_u32(&stats, (unsigned long) num[0]);
+        pfb_put_u32(&stats, (unsigned long) num[1]);
+        break;
+      case PFB_TYPE_FLAGS:
+        if (sscanf(value, "%s %s %s %s", f[0], f[1], f[2], f[3]) == 4) {
+          for (i = 0; i < 4; i++)
+            pfb_put_u32(&stats, pf_asciiflag_conv(f[i]));
+        } else {
+          pfb_put_u32(&stats, pf_asciiflag_conv(value));
+          for (i = 1; i < 4; i++)
+            pfb_put_u32(&stats, 0);
+        }
+        break;
+      }
+    }
+  }
+
+  out->len = 0;
+  pfb_put(out, PFB_MAGIC, PFB_MAGIC_LEN);
+  pfb_put_u32(out, PFB_VERSION);
+  put_section(out, PFB_STATS, &stats);
+
+#define COUNTED_SECTION(id, count, bits, payload) do { \
+    sec.len = 0; \
+    if ((bits) == 16) \
+      pfb_put_u16(&sec, count); \
+    else \
+      pfb_put_u32(&sec, count); \
+    pfb_put(&sec, (payload)->data, (payload)->len); \
+    put_section(out, id, &sec); \
+  } while (0)
+
+  /* Immortals save no skills, and the game tells them apart that way. */
+  if (has_skills)
+    COUNTED_SECTION(PFB_SKILLS, nskills, 16, &skills);
+  if (naffects)
+    COUNTED_SECTION(PFB_AFFECTS, naffects, 16, &affects);
+  if (naliases)
+    COUNTED_SECTION(PFB_ALIASES, naliases, 16, &aliases);
+  if (nquests)
+    COUNTED_SECTION(PFB_QUESTS, nquests, 32, &quests);
+  if (ntrigs || nvars) {
+    sec.len = 0;
+    pfb_put_u16(&sec, ntrigs);
+    pfb_put(&sec, trigs.data, trigs.len);
+    pfb_put_u16(&sec, nvars);
+    pfb_put(&sec, vars.data, vars.len);
+    put_section(out, PFB_VARS, &sec);
+  }
+#undef COUNTED_SECTION
+
+  pfb_put_u32(out, PFB_END);
+  pfb_put_u32(out, 0);
+  return (TRUE);
+}
+
+static void write_stats(FILE *out, struct pfb_buf *b)
+{
+  char tag[5], bits[4][40];
+  char *str;
+  const char *s;
+  int type;
+  long n1, n2;
+
+  while (b->pos < b->len && !b->bad) {
+    memcpy(tag, pfb_get(b, 4) ? b->data + b->pos - 4 : (const unsigned char *) "    ", 4);
+    tag[4] = '\0';
+    switch ((type = pfb_get_u8(b))) {
+    case PFB_TYPE_INT:
+      fprintf(out, "%s: %ld\n", tag, pfb_get_i32(b));
+      break;
+    case PFB_TYPE_LONG:
+      fprintf(out, "%s: %ld\n", tag, pfb_get_long(b));
+      break;
+    case PFB_TYPE_PAIR:
+      n1 = pfb_get_i32(b);
+      n2 = pfb_get_i32(b);
+      fprintf(out, "%s: %ld/%ld\n", tag, n1, n2);
+      break;
+    case PFB_TYPE_FLAGS:
+      pf_sprintascii(bits[0], pfb_get_u32(b));
+      pf_sprintascii(bits[1], pfb_get_u32(b));
+      pf_sprintascii(bits[2], pfb_get_u32(b));
+      pf_sprintascii(bits[3], pfb_get_u32(b));
+      fprintf(out, "%s: %s %s %s %s\n", tag, bits[0], bits[1], bits[2], bits[3]);
+      break;
+    case PFB_TYPE_STR:
+      str = pfb_get_str(b);
+      if (!strcmp(tag, "Desc")) {
+        fprintf(out, "Desc:\n");
+        for (s = str; *s; s++)
+          if (*s != '\r')
+            fputc(*s, out);
+        fprintf(out, "~\n");
+      } else
+        fprintf(out, "%s: %s\n", tag, str);
+      free(str);
+      break;
+    default:
+      b->bad = TRUE;
+    }
+  }
+}
+
+static int binary_to_ascii(FILE *fl, FILE *out, const char *filename)
+{
+  static struct pfb_buf sections[PFB_VARS + 1];
+  struct pfb_buf *b;
+  unsigned char head[8];
+  unsigned long id, len, count;
+  char *s1, *s2;
+  int i, n[8];
+
+  for (i = 0; i <= PFB_VARS; i++)
+    sections[i].len = sections[i].pos = sections[i].bad = 0;
+
+  /* The header has been read already. */
+  for (;;) {
+    if (fread(head, 1, sizeof(head), fl) != sizeof(head)) {
+      fprintf(stderr, "%s: no end section\n", filename);
+      return (FALSE);
+    }
+    if ((id = pfb_u32(head)) == PFB_END)
+      break;
+    len = pfb_u32(head + 4);
+    if (id > PFB_VARS) {
+      fprintf(stderr, "%s: dropping unknown section %lu\n", filename, id);
+      fseek(fl, len, SEEK_CUR);
+      continue;
+    }
+    if (!pfb_read_section(fl, &sections[id], len)) {
+      fprintf(stderr, "%s: cut short\n", filename);
+      return (FALSE);
+    }
+  }
+
+  write_stats(out, &sections[PFB_STATS]);
+
+  b = &sections[PFB_QUESTS];
+  if (b->len && (count = pfb_get_u32(b)) > 0) {
+    fprintf(out, "Qest:\n");
+    while (count-- > 0)
+      fprintf(out, "%ld\n", pfb_get_i32(b));
+    fprintf(out, "%d\n", NOTHING);
+  }
+
+  b = &sections[PFB_VARS];
+  if (b->len)
+    for (count = pfb_get_u16(b); count > 0 && !b->bad; count--)
+      fprintf(out, "Trig: %ld\n", pfb_get_i32(b));
+
+  b = &sections[PFB_SKILLS];
+  if (b->len) {
+    fprintf(out, "Skil:\n");
+    for (count = pfb_get_u16(b); count > 0 && !b->bad; count--) {
+      n[0] = pfb_get_u16(b);
+      n[1] = pfb_get_u16(b);
+      fprintf(out, "%d %d\n", n[0], n[1]);
+    }
+    fprintf(out, "0 0\n");
+  }
+
+  b = &sections[PFB_AFFECTS];
+  if (b->len) {
+    fprintf(out, "Affs:\n");
+    for (count = pfb_get_u16(b); count > 0 && !b->bad; count--) {
+      for (i = 0; i < 8; i++)
+        n[i] = pfb_get_i32(b);
+      fprintf(out, "%d %d %d %d %d %d %d %d\n", n[0], n[1], n[2], n[3], n[4], n[5], n[6], n[7]);
+    }
+    fprintf(out, "0 0 0 0 0 0 0 0\n");
+  }
+
+  b = &sections[PFB_ALIASES];
+  if (b->len && (count = pfb_get_u16(b)) > 0) {
+    fprintf(out, "Alis: %lu\n", count);
+    for (; count > 0 && !b->bad; count--) {
+      s1 = pfb_get_str(b);
+      s2 = pfb_get_str(b);
+      fprintf(out, " %s\n%s\n", s1, s2);
+      fprintf(out, "%ld\n", pfb_get_i32(b));
+      free(s1);
+      free(s2);
+    }
+  }
+
+  b = &sections[PFB_VARS];
+  if (b->len && (count = pfb_get_u16(b)) > 0) {
+    fprintf(out, "Vars: %lu\n", count);
+    for (; count > 0 && !b->bad; count--) {
+      s1 = pfb_get_str(b);
+      fprintf(out, "%s %ld ", s1, pfb_get_long(b));
+      s2 = pfb_get_str(b);
+      fprintf(out, "%s\n", s2);
+      free(s1);
+      free(s2);
+    }
+  }
+
+  for (i = 0; i <= PFB_VARS; i++)
+    if (sections[i].bad) {
+      fprintf(stderr, "%s: section %d is cut short\n", filename, i);
+      return (FALSE);
+    }
+  return (TRUE);
+}
+
+/* Convert one file in place; 1 if converted, 0 if left alone, -1 on error. */
+static int convert(const char *filename, int to_binary)
+{
+  static struct pfb_buf out;
+  unsigned char head[PFB_MAGIC_LEN + 4];
+  char tempname[1024];
+  FILE *fl, *tmp;
+  int is_binary, ok;
+
+  if (!(fl = fopen(filename, "rb"))) {
+    perror(filename);
+    return (-1);
+  }
+  is_binary = (fread(head, 1, sizeof(head), fl) == sizeof(head) &&
+               !memcmp(head, PFB_MAGIC, PFB_MAGIC_LEN));
+  if (is_binary == to_binary) {
+    fclose(fl);
+    return (0);
+  }
+  if (is_binary && pfb_u32(head + PFB_MAGIC_LEN) > PFB_VERSION) {
+    fprintf(stderr, "%s: version %lu is newer than this converter's %d\n",
+            filename, pfb_u32(head + PFB_MAGIC_LEN), PFB_VERSION);
+    fclose(fl);
+    return (-1);
+  }
+
+  snprintf(tempname, sizeof(tempname), "%s.tmp", filename);
+  if (!(tmp = fopen(tempname, "wb"))) {
+    perror(tempname);
+    fclose(fl);
+    return (-1);
+  }
+
+  if (to_binary) {
+    rewind(fl);
+    if ((ok = ascii_to_binary(fl, &out, filename)) != 0)
+      ok = (fwrite(out.data, 1, out.len, tmp) == out.len);
+  } else
+    ok = binary_to_ascii(fl, tmp, filename);
+
+  fclose(fl);
+  ok = (fclose(tmp) == 0) && ok;
+  if (!ok || rename(tempname, filename) < 0) {
+    if (ok)
+      perror(filename);
+    unlink(tempname);
+    return (-1);
+  }
+  return (1);
+}
+
+int main(int argc, char **argv)
+{
+  int i, to_binary, converted = 0, errors = 0, result;
+
+  if (argc < 3 || (strcmp(argv[1], "-a") && strcmp(argv[1], "-b"))) {
+    fprintf(stderr, "Usage: %s -b|-a <pfile> [<pfile> ...]\n"
+                    "  -b  convert ASCII player files to the binary format\n"
+                    "  -a  convert binary player files to ASCII\n", argv[0]);
+    return (1);
+  }
+  to_binary = (argv[1][1] == 'b');
+
+  for (i = 2; i < argc; i++) {
+    if ((result = convert(argv[i], to_binary)) < 0)
+      errors++;
+    else
+      converted += result;
+  }
+  printf("%d of %d player files converted to %s, %d errors.\n",
+         converted, argc - 2, to_binary ? "binary" : "ASCII", errors);
+  return (errors ? 1 : 0);
+}
@@ -139,6 +139,47 @@ void prune_crlf(char *txt)
     txt[i--] = '\0';
 }
 
+/** The reference count kept in front of a shared string's text. */
+struct shared_str {
+  int refs;
+};
+#define SHARED_STR(str)  ((struct shared_str *) (str) - 1)
+
+/** Makes a copy of a string that can be handed to any number of holders
+ * without copying it again; each lets go of it with release_str().
+ * @param str The string to copy.
+ * @retval char * The shared copy, held once. */
+char *share_str(const char *str)
+{
+  struct shared_str *shared;
+  size_t len = strlen(str);
+
+  shared = (struct shared_str *) malloc(sizeof(struct shared_str) + len + 1);
+  if (!shared) {
+    perror("SYSERR: malloc failure");
+    abort();
+  }
+  shared->refs = 1;
+  return (memcpy(shared + 1, str, len + 1));
+}
+
+/** Takes another hold on a string from share_str().
+ * @param str The shared string.
+ * @retval char * The same string. */
+char *hold_str(char *str)
+{
+  SHARED_STR(str)->refs++;
+  return (str);
+}
+
+/** Lets go of a string from share_str(), freeing it with the last hold.
+ * @param str The shared string, or NULL. */
+void release_str(char *str)
+{
+  if (str && --SHARED_STR(str)->refs <= 0)
+    free(SHARED_STR(str));
+}
+
 #ifndef str_cmp
 /** a portable, case-insensitive version of strcmp(). Returns: 0 if equal, > 0
  * if arg1 > arg2, or < 0 if arg1 < arg2. Scan until strings are found
@@ -57,6 +57,9 @@ int levenshtein_distance(const char *s1, const char *s2);
 struct time_info_data *real_time_passed(time_t t2, time_t t1);
 struct time_info_data *mud_time_passed(time_t t2, time_t t1);
 void prune_crlf(char *txt);
+char *share_str(const char *str);
+char *hold_str(char *str);
+void release_str(char *str);
 void column_list(struct char_data *ch, int num_cols, const char **list, int list_length, bool show_nums);
 int get_flag_by_name(const char *flag_list[], char *flag_name);
 int file_head( FILE *file, char *buf, size_t bufsize, int lines_to_read );
@@ -115,6 +118,7 @@ bool	circle_follow(struct char_data *ch, struct char_data *victim);
 /* in act.informative.c */
 void	look_at_room(struct char_data *ch, int mode);
 void  add_history(struct char_data *ch, char *msg, int type);
+void  add_history_line(struct char_data *ch, char *line, int type);
 
 /* in act.movmement.c */
 int	do_simple_move(struct char_data *ch, int dir, int following);
@@ -299,6 +303,46 @@ do                                                              \
       (link)->next->prev        = (link)->prev;                 \
 } while(0)
 
+/* Put 'item' at the head of a double-linked list that keeps no last pointer,
+ * such as a room's people or a character's inventory.
+ * @param item  Pointer to item to add to the list.
+ * @param head  Pointer to the head of the linked list.
+ * @param next  The variable name pointing to the next in the list.
+ * @param prev  The variable name pointing to the previous in the list.
+ * */
+#define ADD_TO_DLIST(item, head, next, prev)                    \
+do                                                              \
+{                                                               \
+    (item)->prev                = NULL;                         \
+    (item)->next                = (head);                       \
+    if ( (head) )                                               \
+      (head)->prev              = (item);                       \
+    (head)                      = (item);                       \
+} while(0)
+
+/* Remove 'item' from a list built with ADD_TO_DLIST() in constant time, and
+ * clear its links.  An item that is on no list is left alone.
+ * @param item  Pointer to item to remove from the list.
+ * @param head  Pointer to the head of the linked list.
+ * @param next  The variable name pointing to the next in the list.
+ * @param prev  The variable name pointing to the previous in the list.
+ * */
+#define REMOVE_FROM_DLIST(item, head, next, prev)               \
+do                                                              \
+{                                                               \
+    if ( (item)->prev || (head) == (item) )                     \
+    {                                                           \
+      if ( (item)->prev )                                       \
+        (item)->prev->next      = (item)->next;                 \
+      else                                                      \
+        (head)                  = (item)->next;                 \
+      if ( (item)->next )                                       \
+        (item)->next->prev      = (item)->prev;                 \
+    }                                                           \
+    (item)->next                = NULL;                         \
+    (item)->prev                = NULL;                         \
+} while(0)
+
 /* Free a pointer, and log if it was NULL
  * @param point The pointer to be free'd.
  * */
@@ -668,9 +712,11 @@ do                                                              \
 /** Defines if ch is neither good nor evil. */
 #define IS_NEUTRAL(ch) (!IS_GOOD(ch) && !IS_EVIL(ch))
 
-/** Old wait state function.
+/** Old wait state function. Also wakes ch's descriptor so game_loop() keeps
+ * counting the wait down.
  * @deprecated Use GET_WAIT_STATE */
-#define WAIT_STATE(ch, cycle) do { GET_WAIT_STATE(ch) = (cycle); } while(0)
+#define WAIT_STATE(ch, cycle) do { GET_WAIT_STATE(ch) = (cycle); \
+  if ((ch)->desc) reactor_wake((ch)->desc); } while(0)
 /** Old check wait.
  * @deprecated Use GET_WAIT_STATE */
 #define CHECK_WAIT(ch)                ((ch)->wait > 0)
@@ -973,6 +1019,10 @@ do                                                              \
 #define CONFIG_LOAD_INVENTORY   config_info.play.load_into_inventory
 /** Get the track through doors setting. */
 #define CONFIG_TRACK_T_DOORS    config_info.play.track_through_doors
+/** Should track and hunting mobiles reuse cached paths? */
+#define CONFIG_TRACK_CACHE      config_info.play.track_path_cache
+/** How track and hunting mobiles search for a path. */
+#define CONFIG_TRACK_SEARCH     config_info.play.track_search_mode
 /** Get the permission to level up from mortal to immortal. */
 #define CONFIG_NO_MORT_TO_IMMORT config_info.play.no_mort_to_immort
 /** Get the OK message. */
@@ -1011,6 +1061,8 @@ do                                                              \
 #define CONFIG_CRASH_TIMEOUT    config_info.csd.crash_file_timeout
 /** Get legnth of time to hold rent files. */
 #define CONFIG_RENT_TIMEOUT     config_info.csd.rent_file_timeout
+/** Are player files saved in the binary format? */
+#define CONFIG_BINARY_PFILES    config_info.csd.binary_pfiles
 
 /* Room Numbers */
 /** Get the mortal start room. */